@@ -0,0 +1,139 @@
+/**
+* Headless benchmark runner for the upload, command buffer, barrier and resource creation paths
+*
+* Needs nothing but a compute capable queue, so it runs on software drivers. For example against lavapipe:
+*   g++ -std=c++17 -O2 -I.. computeBenchmarks.cpp -lvulkan -o computeBenchmarks
+*   VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json ./computeBenchmarks results.json
+*
+* Usage: computeBenchmarks [output.json] [physical device index]
+*/
+
+#include <vulkan/vulkan.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../computeBenchmark.hpp"
+
+int main(int argc, char **argv)
+{
+    const std::string outputPath = argc > 1 ? argv[1] : "benchmark_results.json";
+    const uint32_t deviceIndex = argc > 2 ? static_cast<uint32_t>(atoi(argv[2])) : 0;
+
+    VkApplicationInfo applicationInfo = {};
+    applicationInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    applicationInfo.pApplicationName = "computeBenchmarks";
+    applicationInfo.apiVersion = VK_API_VERSION_1_1;
+
+    VkInstanceCreateInfo instanceCreateInfo = {};
+    instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instanceCreateInfo.pApplicationInfo = &applicationInfo;
+
+    VkInstance instance;
+    if (vkCreateInstance(&instanceCreateInfo, nullptr, &instance) != VK_SUCCESS)
+    {
+        fprintf(stderr, "Could not create a Vulkan instance\n");
+        return 1;
+    }
+
+    uint32_t physicalDeviceCount = 0;
+    vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, nullptr);
+    std::vector<VkPhysicalDevice> physicalDevices(physicalDeviceCount);
+    vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, physicalDevices.data());
+    if (deviceIndex >= physicalDeviceCount)
+    {
+        fprintf(stderr, "No physical device %u, %u available\n", deviceIndex, physicalDeviceCount);
+        vkDestroyInstance(instance, nullptr);
+        return 1;
+    }
+    VkPhysicalDevice physicalDevice = physicalDevices[deviceIndex];
+
+    int status = 0;
+    try
+    {
+        const uint32_t queueFamilyIndex = sourav::utils::getQueueFamilyIndex(physicalDevice, VK_QUEUE_COMPUTE_BIT);
+
+        const float queuePriority = 1.0f;
+        VkDeviceQueueCreateInfo queueCreateInfo = {};
+        queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueCreateInfo.queueFamilyIndex = queueFamilyIndex;
+        queueCreateInfo.queueCount = 1;
+        queueCreateInfo.pQueuePriorities = &queuePriority;
+
+        VkDeviceCreateInfo deviceCreateInfo = {};
+        deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        deviceCreateInfo.queueCreateInfoCount = 1;
+        deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
+
+        VkDevice logicalDevice;
+        ST_CHECK_RESULT(vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &logicalDevice));
+
+        VkQueue queue;
+        vkGetDeviceQueue(logicalDevice, queueFamilyIndex, 0, &queue);
+
+        sourav::Device::computeDevice device;
+        device.create(physicalDevice, logicalDevice, queueFamilyIndex);
+
+        std::vector<sourav::Benchmark::computeBenchmarkResult> results;
+        auto append = [&results](const std::vector<sourav::Benchmark::computeBenchmarkResult> &more)
+        {
+            results.insert(results.end(), more.begin(), more.end());
+        };
+
+        // Staging strategies, reported as two results
+        {
+            VkCommandPoolCreateInfo poolCreateInfo = sourav::initializers::commandPoolCreateInfo();
+            poolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+            poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+            VkCommandPool pool;
+            ST_CHECK_RESULT(vkCreateCommandPool(logicalDevice, &poolCreateInfo, nullptr, &pool));
+
+            sourav::Benchmark::computeStagingBenchmarkResult staging =
+                sourav::Benchmark::benchmarkStagingUploads(device, pool, queue, 1024 * 1024, 200);
+            vkDestroyCommandPool(logicalDevice, pool, nullptr);
+
+            const double megabytes = (double)staging.uploadSize / (1024.0 * 1024.0);
+            const std::string parameters = "size=" + std::to_string(staging.uploadSize);
+            results.push_back({ "staging.perUpload", parameters, staging.iterations, staging.perUploadStaging, megabytes / (staging.perUploadStaging * 1e-9) });
+            results.push_back({ "staging.ring", parameters, staging.iterations, staging.stagingRing, megabytes / (staging.stagingRing * 1e-9) });
+        }
+
+        append(sourav::Benchmark::benchmarkTextureUploads(device, queue,
+            { VK_FORMAT_R8_UNORM, VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R16G16B16A16_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT },
+            { 64, 256, 1024, 2048 }, 20));
+        append(sourav::Benchmark::benchmarkTexelConversion(
+            { { VK_FORMAT_R8G8B8_UNORM, VK_FORMAT_R8G8B8A8_UNORM }, { VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM },
+              { VK_FORMAT_R32G32B32_SFLOAT, VK_FORMAT_R32G32B32A32_SFLOAT } },
+            1024 * 1024, 20));
+        append(sourav::Benchmark::benchmarkCommandBuffers(device, queue, 1000));
+        append(sourav::Benchmark::benchmarkBarriers(device, queue, 64, 200));
+        append(sourav::Benchmark::benchmarkResourceCreation(device, 64 * 1024, 256, 1000));
+
+        printf("%-24s %-32s %14s %12s\n", "benchmark", "parameters", "ns/op", "MB/s");
+        for (const sourav::Benchmark::computeBenchmarkResult &result : results)
+        {
+            printf("%-24s %-32s %14.1f %12.2f\n", result.name.c_str(), result.parameters.c_str(), result.nsPerOperation, result.megabytesPerSecond);
+        }
+
+        if (!sourav::Benchmark::writeResultsJson(outputPath, physicalDevice, results))
+        {
+            fprintf(stderr, "Could not write %s\n", outputPath.c_str());
+            status = 1;
+        }
+
+        device.destroy();
+        vkDestroyDevice(logicalDevice, nullptr);
+    }
+    catch (const std::exception &exception)
+    {
+        fprintf(stderr, "Benchmark failed: %s\n", exception.what());
+        status = 1;
+    }
+
+    sourav::Device::clearDeviceCaps();
+    vkDestroyInstance(instance, nullptr);
+    return status;
+}
@@ -0,0 +1,633 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "computeDeviceUtils.hpp"
+
+namespace sourav
+{
+    namespace Sync
+    {
+        /** @brief Layout of an image together with the last stages and accesses that used it */
+        struct computeImageState
+        {
+            VkImageLayout         layout     = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkPipelineStageFlags2 stageMask  = VK_PIPELINE_STAGE_2_NONE;
+            VkAccessFlags2        accessMask = VK_ACCESS_2_NONE;
+        };
+
+        /** @brief Accesses that have to be made available before anything else touches the memory */
+        static const VkAccessFlags2 WRITE_ACCESS_MASK =
+            VK_ACCESS_2_SHADER_WRITE_BIT |
+            VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+            VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+            VK_ACCESS_2_TRANSFER_WRITE_BIT |
+            VK_ACCESS_2_HOST_WRITE_BIT |
+            VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+        /******************************************************************************************************************************
+        * Narrowest stages and accesses an image in layout is normally used with
+        *
+        * Shader layouts assume the compute stage. Layouts without a specific use fall back to ALL_COMMANDS and
+        * MEMORY_READ | MEMORY_WRITE, which is always correct, only slow
+        ********************************************************************************************************************************/
+        inline computeImageState layoutState(VkImageLayout layout)
+        {
+            computeImageState state;
+            state.layout = layout;
+            switch (layout)
+            {
+                case VK_IMAGE_LAYOUT_UNDEFINED:
+                    break;
+                case VK_IMAGE_LAYOUT_PREINITIALIZED:
+                    state.stageMask = VK_PIPELINE_STAGE_2_HOST_BIT;
+                    state.accessMask = VK_ACCESS_2_HOST_WRITE_BIT;
+                    break;
+                case VK_IMAGE_LAYOUT_GENERAL:
+                    // Storage image in a compute shader
+                    state.stageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+                    state.accessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+                    break;
+                case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+                    state.stageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+                    state.accessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+                    break;
+                case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+                    state.stageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+                    state.accessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+                    break;
+                case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+                    state.stageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+                    state.accessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+                    break;
+                case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL:
+                    state.stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+                    state.accessMask = VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT;
+                    break;
+                case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL:
+                    state.stageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+                    state.accessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+                    break;
+                case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+                    state.stageMask = VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+                    state.accessMask = VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+                    break;
+                case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+                    // The presentation engine synchronizes through semaphores
+                    break;
+                default:
+                    state.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+                    state.accessMask = VK_ACCESS_2_MEMORY_READ_BIT | VK_ACCESS_2_MEMORY_WRITE_BIT;
+                    break;
+            }
+            return state;
+        }
+
+        /** @brief Stage mask for vkCmdPipelineBarrier, the split transfer stages fold into TRANSFER */
+        inline VkPipelineStageFlags legacyStageMask(VkPipelineStageFlags2 stageMask)
+        {
+            VkPipelineStageFlags legacy = static_cast<VkPipelineStageFlags>(stageMask & 0xffffffffull);
+            if (stageMask & (VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT))
+            {
+                legacy |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+                stageMask &= ~(VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT);
+            }
+            if (stageMask >> 32)
+            {
+                legacy |= VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+            }
+            return legacy;
+        }
+
+        /** @brief Access mask for vkCmdPipelineBarrier, sampled and storage accesses fold into SHADER_READ / SHADER_WRITE */
+        inline VkAccessFlags legacyAccessMask(VkAccessFlags2 accessMask)
+        {
+            VkAccessFlags legacy = static_cast<VkAccessFlags>(accessMask & 0xffffffffull);
+            if (accessMask & (VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT))
+            {
+                legacy |= VK_ACCESS_SHADER_READ_BIT;
+            }
+            if (accessMask & VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT)
+            {
+                legacy |= VK_ACCESS_SHADER_WRITE_BIT;
+            }
+            accessMask &= ~(VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+            if (accessMask >> 32)
+            {
+                legacy |= VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+            }
+            return legacy;
+        }
+
+        /** @brief vkCmdPipelineBarrier2 from Vulkan 1.3 or VK_KHR_synchronization2, null if the device has neither */
+        inline PFN_vkCmdPipelineBarrier2 loadPipelineBarrier2(VkDevice logicalDevice)
+        {
+            PFN_vkCmdPipelineBarrier2 pfnCmdPipelineBarrier2 =
+                reinterpret_cast<PFN_vkCmdPipelineBarrier2>(vkGetDeviceProcAddr(logicalDevice, "vkCmdPipelineBarrier2"));
+            if (!pfnCmdPipelineBarrier2)
+            {
+                pfnCmdPipelineBarrier2 =
+                    reinterpret_cast<PFN_vkCmdPipelineBarrier2>(vkGetDeviceProcAddr(logicalDevice, "vkCmdPipelineBarrier2KHR"));
+            }
+            return pfnCmdPipelineBarrier2;
+        }
+
+        /**
+        * @brief Barriers collected for one synchronization point
+        *
+        * flush() records all of them with a single vkCmdPipelineBarrier2, or a single vkCmdPipelineBarrier with the union
+        * of the stage masks when synchronization2 is not available
+        */
+        class computeBarrierBatch
+        {
+            public:
+                size_t imageBarrier(
+                    VkImage                        image,
+                    const VkImageSubresourceRange &subresourceRange,
+                    const computeImageState       &oldState,
+                    const computeImageState       &newState,
+                    uint32_t                       srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    uint32_t                       dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED);
+                /** @brief Add stages and accesses to the second scope of a queued image barrier, index from imageBarrier() */
+                void widenImageBarrier(size_t index, VkPipelineStageFlags2 dstStageMask, VkAccessFlags2 dstAccessMask);
+                void memoryBarrier(
+                    VkPipelineStageFlags2 srcStageMask,
+                    VkAccessFlags2        srcAccessMask,
+                    VkPipelineStageFlags2 dstStageMask,
+                    VkAccessFlags2        dstAccessMask);
+
+                void flush(VkCommandBuffer commandBuffer, PFN_vkCmdPipelineBarrier2 pfnCmdPipelineBarrier2 = nullptr);
+
+                bool empty() const { return imageBarriers.empty() && !hasMemoryBarrier; }
+
+            private:
+                std::vector<VkImageMemoryBarrier2> imageBarriers;
+                VkMemoryBarrier2                   globalBarrier    = {};
+                bool                               hasMemoryBarrier = false;
+        };
+
+        /**
+        * @brief Tracks the layout, stages and accesses of every mip level of the images it knows about
+        *
+        * transition() works out the barrier from the tracked state and queues it, flush() records everything queued in
+        * one barrier command. The last write is kept apart from the reads that already wait for it: a read in the same
+        * layout only gets a barrier if its stages or accesses are not synchronized with that write yet, and a level whose
+        * barrier is still queued has the queued barrier widened instead. Every use widens the tracked state, so a later
+        * write waits for all of them. A level can be written or change layout once per flush
+        */
+        class computeResourceTracker
+        {
+            public:
+                void create(VkDevice logicalDevice, bool useSynchronization2 = true);
+                void destroy();
+
+                void trackImage(
+                    VkImage                  image,
+                    uint32_t                 mipLevels,
+                    uint32_t                 layerCount   = 1,
+                    VkImageAspectFlags       aspectMask   = VK_IMAGE_ASPECT_COLOR_BIT,
+                    const computeImageState &initialState = computeImageState());
+                void forgetImage(VkImage image);
+
+                void transition(
+                    VkImage                  image,
+                    const computeImageState &newState,
+                    uint32_t                 baseMipLevel = 0,
+                    uint32_t                 levelCount   = VK_REMAINING_MIP_LEVELS);
+                /** @brief Transition to newLayout for its usual use, see layoutState() */
+                void transition(VkImage image, VkImageLayout newLayout, uint32_t baseMipLevel = 0, uint32_t levelCount = VK_REMAINING_MIP_LEVELS);
+
+                void memoryBarrier(
+                    VkPipelineStageFlags2 srcStageMask,
+                    VkAccessFlags2        srcAccessMask,
+                    VkPipelineStageFlags2 dstStageMask,
+                    VkAccessFlags2        dstAccessMask);
+
+                void flush(VkCommandBuffer commandBuffer);
+
+                computeImageState state(VkImage image, uint32_t mipLevel = 0);
+                bool usesSynchronization2() const { return pfnCmdPipelineBarrier2 != nullptr; }
+
+            private:
+                struct trackedLevel
+                {
+                    // Layout and every use since the last write or layout change
+                    computeImageState     state;
+                    // Stages a later read has to wait for, and the write accesses it has to see
+                    VkPipelineStageFlags2 writeStageMask  = VK_PIPELINE_STAGE_2_NONE;
+                    VkAccessFlags2        writeAccessMask = VK_ACCESS_2_NONE;
+                    // Reads that already wait for the last write
+                    VkPipelineStageFlags2 readStageMask   = VK_PIPELINE_STAGE_2_NONE;
+                    VkAccessFlags2        readAccessMask  = VK_ACCESS_2_NONE;
+                    // Queued barrier of the level, NO_BARRIER once flushed
+                    size_t                barrier = NO_BARRIER;
+                    // The queued barrier is for a write, which has not happened yet
+                    bool                  writePending = false;
+
+                    bool sameSynchronization(const trackedLevel &other) const;
+                };
+
+                struct trackedImage
+                {
+                    VkImageAspectFlags        aspectMask;
+                    uint32_t                  layerCount;
+                    std::vector<trackedLevel> levels;
+                };
+
+                static const size_t NO_BARRIER = ~size_t(0);
+
+                PFN_vkCmdPipelineBarrier2                  pfnCmdPipelineBarrier2 = nullptr;
+                std::unordered_map<VkImage, trackedImage>  images;
+                std::vector<VkImage>                       pendingImages;
+                computeBarrierBatch                        batch;
+
+                trackedImage &find(VkImage image);
+        };
+
+
+        inline size_t computeBarrierBatch::imageBarrier(
+            VkImage                        image,
+            const VkImageSubresourceRange &subresourceRange,
+            const computeImageState       &oldState,
+            const computeImageState       &newState,
+            uint32_t                       srcQueueFamilyIndex,
+            uint32_t                       dstQueueFamilyIndex)
+        {
+            VkImageMemoryBarrier2 imageMemoryBarrier = {};
+            imageMemoryBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+            imageMemoryBarrier.srcStageMask = oldState.stageMask;
+            // Only writes have to be made available, reads just have to finish
+            imageMemoryBarrier.srcAccessMask = oldState.accessMask & WRITE_ACCESS_MASK;
+            imageMemoryBarrier.dstStageMask = newState.stageMask;
+            imageMemoryBarrier.dstAccessMask = newState.accessMask;
+            imageMemoryBarrier.oldLayout = oldState.layout;
+            imageMemoryBarrier.newLayout = newState.layout;
+            imageMemoryBarrier.srcQueueFamilyIndex = srcQueueFamilyIndex;
+            imageMemoryBarrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+            imageMemoryBarrier.image = image;
+            imageMemoryBarrier.subresourceRange = subresourceRange;
+            imageBarriers.push_back(imageMemoryBarrier);
+            return imageBarriers.size() - 1;
+        }
+
+
+        inline void computeBarrierBatch::widenImageBarrier(size_t index, VkPipelineStageFlags2 dstStageMask, VkAccessFlags2 dstAccessMask)
+        {
+            imageBarriers[index].dstStageMask |= dstStageMask;
+            imageBarriers[index].dstAccessMask |= dstAccessMask;
+        }
+
+
+        inline void computeBarrierBatch::memoryBarrier(
+            VkPipelineStageFlags2 srcStageMask,
+            VkAccessFlags2        srcAccessMask,
+            VkPipelineStageFlags2 dstStageMask,
+            VkAccessFlags2        dstAccessMask)
+        {
+            globalBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+            globalBarrier.srcStageMask |= srcStageMask;
+            globalBarrier.srcAccessMask |= srcAccessMask;
+            globalBarrier.dstStageMask |= dstStageMask;
+            globalBarrier.dstAccessMask |= dstAccessMask;
+            hasMemoryBarrier = true;
+        }
+
+
+        /******************************************************************************************************************************
+        * Record every collected barrier and clear the batch
+        *
+        * @param commandBuffer Command buffer in the recording state
+        * @param pfnCmdPipelineBarrier2 (Optional) See loadPipelineBarrier2, null records a legacy vkCmdPipelineBarrier
+        ********************************************************************************************************************************/
+        inline void computeBarrierBatch::flush(VkCommandBuffer commandBuffer, PFN_vkCmdPipelineBarrier2 pfnCmdPipelineBarrier2)
+        {
+            if (empty())
+            {
+                return;
+            }
+
+            if (pfnCmdPipelineBarrier2)
+            {
+                VkDependencyInfo dependencyInfo = {};
+                dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+                dependencyInfo.memoryBarrierCount = hasMemoryBarrier ? 1 : 0;
+                dependencyInfo.pMemoryBarriers = &globalBarrier;
+                dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size());
+                dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
+                pfnCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+            }
+            else
+            {
+                // One pair of stage masks for the whole command, the union of all barriers
+                VkPipelineStageFlags srcStageMask = 0;
+                VkPipelineStageFlags dstStageMask = 0;
+
+                std::vector<VkImageMemoryBarrier> legacyBarriers;
+                legacyBarriers.reserve(imageBarriers.size());
+                for (const VkImageMemoryBarrier2 &barrier : imageBarriers)
+                {
+                    VkImageMemoryBarrier imageMemoryBarrier =
+                        sourav::initializers::imageMemoryBarrier(barrier.srcQueueFamilyIndex, barrier.dstQueueFamilyIndex);
+                    imageMemoryBarrier.srcAccessMask = legacyAccessMask(barrier.srcAccessMask);
+                    imageMemoryBarrier.dstAccessMask = legacyAccessMask(barrier.dstAccessMask);
+                    imageMemoryBarrier.oldLayout = barrier.oldLayout;
+                    imageMemoryBarrier.newLayout = barrier.newLayout;
+                    imageMemoryBarrier.image = barrier.image;
+                    imageMemoryBarrier.subresourceRange = barrier.subresourceRange;
+                    legacyBarriers.push_back(imageMemoryBarrier);
+
+                    srcStageMask |= legacyStageMask(barrier.srcStageMask);
+                    dstStageMask |= legacyStageMask(barrier.dstStageMask);
+                }
+
+                VkMemoryBarrier memoryBarrier = {};
+                memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+                if (hasMemoryBarrier)
+                {
+                    memoryBarrier.srcAccessMask = legacyAccessMask(globalBarrier.srcAccessMask);
+                    memoryBarrier.dstAccessMask = legacyAccessMask(globalBarrier.dstAccessMask);
+                    srcStageMask |= legacyStageMask(globalBarrier.srcStageMask);
+                    dstStageMask |= legacyStageMask(globalBarrier.dstStageMask);
+                }
+
+                // Legacy barriers need a non-empty stage mask on both sides
+                if (srcStageMask == 0)
+                {
+                    srcStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+                }
+                if (dstStageMask == 0)
+                {
+                    dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+                }
+
+                vkCmdPipelineBarrier(
+                    commandBuffer,
+                    srcStageMask,
+                    dstStageMask,
+                    0,
+                    hasMemoryBarrier ? 1 : 0, &memoryBarrier,
+                    0, nullptr,
+                    static_cast<uint32_t>(legacyBarriers.size()), legacyBarriers.data());
+            }
+
+            imageBarriers.clear();
+            globalBarrier = {};
+            hasMemoryBarrier = false;
+        }
+
+
+        /******************************************************************************************************************************
+        * Set up the tracker
+        *
+        * @param logicalDevice Device the command buffers belong to
+        * @param useSynchronization2 Record vkCmdPipelineBarrier2 if the device has it, the synchronization2 feature has to be
+        *        enabled on the device. False always records legacy barriers
+        ********************************************************************************************************************************/
+        inline void computeResourceTracker::create(VkDevice logicalDevice, bool useSynchronization2)
+        {
+            pfnCmdPipelineBarrier2 = useSynchronization2 ? loadPipelineBarrier2(logicalDevice) : nullptr;
+        }
+
+
+        inline void computeResourceTracker::destroy()
+        {
+            images.clear();
+            pendingImages.clear();
+            batch = computeBarrierBatch();
+        }
+
+
+        /******************************************************************************************************************************
+        * Start tracking an image
+        *
+        * @param mipLevels Number of levels, each level is tracked on its own. All layers of a level share one state
+        * @param initialState State of the image when it is first transitioned, UNDEFINED for a new image
+        ********************************************************************************************************************************/
+        inline void computeResourceTracker::trackImage(
+            VkImage                  image,
+            uint32_t                 mipLevels,
+            uint32_t                 layerCount,
+            VkImageAspectFlags       aspectMask,
+            const computeImageState &initialState)
+        {
+            // Whatever the image was used for before counts as a write, reads in other stages wait for it
+            trackedLevel level;
+            level.state = initialState;
+            level.writeStageMask = initialState.stageMask;
+            level.writeAccessMask = initialState.accessMask & WRITE_ACCESS_MASK;
+            if (level.writeAccessMask == 0)
+            {
+                level.readStageMask = initialState.stageMask;
+                level.readAccessMask = initialState.accessMask;
+            }
+
+            trackedImage &tracked = images[image];
+            tracked.aspectMask = aspectMask;
+            tracked.layerCount = layerCount;
+            tracked.levels.assign(mipLevels, level);
+        }
+
+
+        inline bool computeResourceTracker::trackedLevel::sameSynchronization(const trackedLevel &other) const
+        {
+            return state.layout == other.state.layout &&
+                state.stageMask == other.state.stageMask &&
+                state.accessMask == other.state.accessMask &&
+                writeStageMask == other.writeStageMask &&
+                writeAccessMask == other.writeAccessMask &&
+                readStageMask == other.readStageMask &&
+                readAccessMask == other.readAccessMask;
+        }
+
+
+        inline void computeResourceTracker::forgetImage(VkImage image)
+        {
+            images.erase(image);
+        }
+
+
+        inline computeResourceTracker::trackedImage &computeResourceTracker::find(VkImage image)
+        {
+            auto it = images.find(image);
+            if (it == images.end())
+            {
+                throw std::runtime_error("Image is not tracked");
+            }
+            return it->second;
+        }
+
+
+        /******************************************************************************************************************************
+        * Queue the barrier that makes a range of mip levels ready for the next use
+        *
+        * Neighbouring levels with the same tracked state share one barrier. A read in the current layout waits for the
+        * last write unless an earlier barrier already covers its stages and accesses
+        *
+        * @param newState Layout, stages and accesses of the next use
+        ********************************************************************************************************************************/
+        inline void computeResourceTracker::transition(
+            VkImage                  image,
+            const computeImageState &newState,
+            uint32_t                 baseMipLevel,
+            uint32_t                 levelCount)
+        {
+            trackedImage &tracked = find(image);
+            const uint32_t mipLevels = static_cast<uint32_t>(tracked.levels.size());
+            if (levelCount == VK_REMAINING_MIP_LEVELS)
+            {
+                levelCount = mipLevels - baseMipLevel;
+            }
+            assert(baseMipLevel + levelCount <= mipLevels);
+
+            VkImageSubresourceRange subresourceRange = {};
+            subresourceRange.aspectMask = tracked.aspectMask;
+            subresourceRange.layerCount = tracked.layerCount;
+
+            const bool read = (newState.accessMask & WRITE_ACCESS_MASK) == 0;
+
+            uint32_t level = baseMipLevel;
+            const uint32_t endLevel = baseMipLevel + levelCount;
+            while (level < endLevel)
+            {
+                trackedLevel &current = tracked.levels[level];
+
+                if (read && current.state.layout == newState.layout && current.state.layout != VK_IMAGE_LAYOUT_UNDEFINED &&
+                    !current.writePending)
+                {
+                    // Read in the current layout, a later write has to wait for it as well
+                    bool synchronized = (newState.stageMask & ~current.readStageMask) == 0 &&
+                        (newState.accessMask & ~current.readAccessMask) == 0;
+                    bool written = current.writeStageMask != VK_PIPELINE_STAGE_2_NONE || current.writeAccessMask != VK_ACCESS_2_NONE;
+                    if (synchronized || !written || current.barrier != NO_BARRIER)
+                    {
+                        if (!synchronized && written)
+                        {
+                            // The write's barrier has not been recorded yet, it can wait for this read too
+                            batch.widenImageBarrier(current.barrier, newState.stageMask, newState.accessMask);
+                        }
+                        current.state.stageMask |= newState.stageMask;
+                        current.state.accessMask |= newState.accessMask;
+                        current.readStageMask |= newState.stageMask;
+                        current.readAccessMask |= newState.accessMask;
+                        level++;
+                        continue;
+                    }
+
+                    // Wait for the last write, or for the stages that already waited for it
+                    uint32_t runEnd = level + 1;
+                    while (runEnd < endLevel && tracked.levels[runEnd].barrier == NO_BARRIER &&
+                        tracked.levels[runEnd].sameSynchronization(current))
+                    {
+                        runEnd++;
+                    }
+
+                    computeImageState writeState;
+                    writeState.layout = current.state.layout;
+                    writeState.stageMask = current.writeStageMask;
+                    writeState.accessMask = current.writeAccessMask;
+
+                    subresourceRange.baseMipLevel = level;
+                    subresourceRange.levelCount = runEnd - level;
+                    size_t barrier = batch.imageBarrier(image, subresourceRange, writeState, newState);
+
+                    for (uint32_t i = level; i < runEnd; i++)
+                    {
+                        tracked.levels[i].state.stageMask |= newState.stageMask;
+                        tracked.levels[i].state.accessMask |= newState.accessMask;
+                        tracked.levels[i].readStageMask |= newState.stageMask;
+                        tracked.levels[i].readAccessMask |= newState.accessMask;
+                        tracked.levels[i].barrier = barrier;
+                    }
+                    pendingImages.push_back(image);
+                    level = runEnd;
+                    continue;
+                }
+
+                if (current.barrier != NO_BARRIER)
+                {
+                    throw std::runtime_error("Mip level transitioned twice without a flush in between");
+                }
+
+                // Extend the barrier over the following levels in the same state
+                const computeImageState oldState = current.state;
+                uint32_t runEnd = level + 1;
+                while (runEnd < endLevel && tracked.levels[runEnd].barrier == NO_BARRIER &&
+                    tracked.levels[runEnd].state.layout == oldState.layout &&
+                    tracked.levels[runEnd].state.stageMask == oldState.stageMask &&
+                    tracked.levels[runEnd].state.accessMask == oldState.accessMask)
+                {
+                    runEnd++;
+                }
+
+                subresourceRange.baseMipLevel = level;
+                subresourceRange.levelCount = runEnd - level;
+                size_t barrier = batch.imageBarrier(image, subresourceRange, oldState, newState);
+
+                // The write or layout change is what later reads wait for, the new use itself is only synchronized if it reads
+                for (uint32_t i = level; i < runEnd; i++)
+                {
+                    trackedLevel &next = tracked.levels[i];
+                    next.state = newState;
+                    next.writeStageMask = newState.stageMask;
+                    next.writeAccessMask = newState.accessMask & WRITE_ACCESS_MASK;
+                    next.readStageMask = read ? newState.stageMask : VK_PIPELINE_STAGE_2_NONE;
+                    next.readAccessMask = read ? newState.accessMask : VK_ACCESS_2_NONE;
+                    next.barrier = barrier;
+                    next.writePending = !read;
+                }
+                pendingImages.push_back(image);
+                level = runEnd;
+            }
+        }
+
+
+        inline void computeResourceTracker::transition(VkImage image, VkImageLayout newLayout, uint32_t baseMipLevel, uint32_t levelCount)
+        {
+            transition(image, layoutState(newLayout), baseMipLevel, levelCount);
+        }
+
+
+        /** @brief Queue a global memory barrier, for buffers and other resources that are not tracked */
+        inline void computeResourceTracker::memoryBarrier(
+            VkPipelineStageFlags2 srcStageMask,
+            VkAccessFlags2        srcAccessMask,
+            VkPipelineStageFlags2 dstStageMask,
+            VkAccessFlags2        dstAccessMask)
+        {
+            batch.memoryBarrier(srcStageMask, srcAccessMask, dstStageMask, dstAccessMask);
+        }
+
+
+        /** @brief Record every queued barrier with one barrier command */
+        inline void computeResourceTracker::flush(VkCommandBuffer commandBuffer)
+        {
+            batch.flush(commandBuffer, pfnCmdPipelineBarrier2);
+
+            for (VkImage image : pendingImages)
+            {
+                auto it = images.find(image);
+                if (it != images.end())
+                {
+                    for (trackedLevel &level : it->second.levels)
+                    {
+                        level.barrier = NO_BARRIER;
+                        level.writePending = false;
+                    }
+                }
+            }
+            pendingImages.clear();
+        }
+
+
+        inline computeImageState computeResourceTracker::state(VkImage image, uint32_t mipLevel)
+        {
+            return find(image).levels[mipLevel].state;
+        }
+    }
+}
@@ -0,0 +1,547 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "computeBarriers.hpp"
+#include "computeConvert.hpp"
+#include "computeDevice.hpp"
+#include "computeDeviceUtils.hpp"
+#include "computeTexture.hpp"
+
+namespace sourav
+{
+    namespace Benchmark
+    {
+        /** @brief One measurement of the suite, written as one entry by writeResultsJson */
+        struct computeBenchmarkResult
+        {
+            std::string name;
+            /** @brief What was varied, e.g. "format=37 extent=1024x1024" */
+            std::string parameters;
+            uint32_t    iterations         = 0;
+            /** @brief Average host time per operation including the wait for the GPU */
+            double      nsPerOperation     = 0.0;
+            /** @brief Payload bytes per second, 0 where nothing is transferred */
+            double      megabytesPerSecond = 0.0;
+        };
+
+        /** @brief Average host time per upload in nanoseconds for the two staging strategies */
+        struct computeStagingBenchmarkResult
+        {
+            VkDeviceSize uploadSize       = 0;
+            uint32_t     iterations       = 0;
+            double       perUploadStaging = 0.0;
+            double       stagingRing      = 0.0;
+        };
+
+
+        /******************************************************************************************************************************
+        * Compare a create/allocate/map/copy/unmap/free staging buffer per upload against the persistently mapped staging ring
+        *
+        * Both variants copy into the same device local buffer and wait for the copy, so the difference is the staging overhead.
+        * Only needs a transfer capable queue, runs on software drivers such as lavapipe or SwiftShader
+        *
+        * @param device Device context, its staging ring must be at least uploadSize large
+        * @param pool Command pool for the copy commands
+        * @param queue Queue the copies are submitted to
+        * @param uploadSize Size of every upload in bytes
+        * @param iterations Number of uploads per variant
+        ********************************************************************************************************************************/
+        inline computeStagingBenchmarkResult benchmarkStagingUploads(
+            sourav::Device::computeDevice &device,
+            VkCommandPool                  pool,
+            VkQueue                        queue,
+            VkDeviceSize                   uploadSize,
+            uint32_t                       iterations)
+        {
+            using clock = std::chrono::high_resolution_clock;
+
+            VkDevice logicalDevice = device.logicalDevice;
+            std::vector<uint8_t> source(uploadSize, 0x5a);
+
+            computeStagingBenchmarkResult result;
+            result.uploadSize = uploadSize;
+            result.iterations = iterations;
+
+            VkBuffer target;
+            VkBufferCreateInfo bufferCreateInfo = sourav::initializers::bufferCreateInfo();
+            bufferCreateInfo.size = uploadSize;
+            bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+            bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            ST_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &target));
+            sourav::Memory::computeAllocation targetAllocation = device.allocator.allocateBuffer(target, sourav::Memory::computeMemoryUsage::gpuOnly());
+
+            VkBufferCopy copyRegion = {};
+            copyRegion.size = uploadSize;
+
+            // Previous path: a dedicated staging buffer and memory allocation for every upload
+            auto start = clock::now();
+            for (uint32_t i = 0; i < iterations; i++)
+            {
+                VkBuffer stagingBuffer;
+                VkDeviceMemory stagingMemory;
+                VkMemoryRequirements memReqs;
+
+                bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+                ST_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
+                vkGetBufferMemoryRequirements(logicalDevice, stagingBuffer, &memReqs);
+
+                VkMemoryAllocateInfo memAllocInfo = sourav::initializers::memoryAllocateInfo();
+                memAllocInfo.allocationSize = memReqs.size;
+                memAllocInfo.memoryTypeIndex = sourav::utils::getMemoryType(device.physicalDevice, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, nullptr);
+                ST_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
+                ST_CHECK_RESULT(vkBindBufferMemory(logicalDevice, stagingBuffer, stagingMemory, 0));
+
+                void *data;
+                ST_CHECK_RESULT(vkMapMemory(logicalDevice, stagingMemory, 0, memReqs.size, 0, &data));
+                memcpy(data, source.data(), uploadSize);
+                vkUnmapMemory(logicalDevice, stagingMemory);
+
+                VkCommandBuffer copyCmd = sourav::utils::createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, pool, logicalDevice);
+                vkCmdCopyBuffer(copyCmd, stagingBuffer, target, 1, &copyRegion);
+                sourav::utils::flushCommandBuffer(logicalDevice, copyCmd, queue, pool);
+
+                vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
+                vkFreeMemory(logicalDevice, stagingMemory, nullptr);
+            }
+            result.perUploadStaging = std::chrono::duration<double, std::nano>(clock::now() - start).count() / iterations;
+
+            // Ring path: carve a region out of the persistent mapping
+            start = clock::now();
+            for (uint32_t i = 0; i < iterations; i++)
+            {
+                uint64_t submission = device.beginSubmission();
+                sourav::Memory::computeStagingRegion staging;
+                if (!device.stagingRing.allocate(uploadSize, STAGING_REGION_ALIGNMENT, submission, &staging))
+                {
+                    throw std::runtime_error("Staging ring is too small for the benchmark upload size");
+                }
+                memcpy(staging.mapped, source.data(), uploadSize);
+
+                copyRegion.srcOffset = staging.offset;
+                VkCommandBuffer copyCmd = sourav::utils::createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, pool, logicalDevice);
+                vkCmdCopyBuffer(copyCmd, staging.buffer, target, 1, &copyRegion);
+                sourav::utils::flushCommandBuffer(logicalDevice, copyCmd, queue, pool);
+
+                device.completeSubmission(submission);
+            }
+            result.stagingRing = std::chrono::duration<double, std::nano>(clock::now() - start).count() / iterations;
+
+            vkDestroyBuffer(logicalDevice, target, nullptr);
+            device.allocator.free(targetAllocation);
+
+            return result;
+        }
+
+
+        /** @brief Average nanoseconds per operation since start */
+        inline double elapsedPerOperation(std::chrono::high_resolution_clock::time_point start, uint64_t operations)
+        {
+            return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count() / operations;
+        }
+
+        /******************************************************************************************************************************
+        * Upload throughput of computeTexture::fromBuffer for every combination of format and extent
+        *
+        * Every iteration creates the image, stages and copies the texels, waits for the copy and destroys the texture, so
+        * the rate is what a loader sees per texture. One untimed upload per combination warms up the allocator and pools.
+        * Formats the device cannot sample are skipped
+        *
+        * @param device Device context the textures are created through
+        * @param queue Queue the uploads are submitted to, of device.queueFamilyIndex
+        * @param formats Formats to upload
+        * @param extents Widths and heights of the square textures
+        * @param iterations Number of timed uploads per combination
+        * @param uploadMode Staged, or Direct to measure the host write path where the device has one
+        ********************************************************************************************************************************/
+        inline std::vector<computeBenchmarkResult> benchmarkTextureUploads(
+            sourav::Device::computeDevice       &device,
+            VkQueue                              queue,
+            const std::vector<VkFormat>         &formats,
+            const std::vector<uint32_t>         &extents,
+            uint32_t                             iterations,
+            sourav::Texture::computeUploadMode   uploadMode = sourav::Texture::computeUploadMode::Staged)
+        {
+            std::vector<computeBenchmarkResult> results;
+
+            for (VkFormat format : formats)
+            {
+                if (!sourav::Formats::supportsUsage(device.physicalDevice, format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT))
+                {
+                    continue;
+                }
+
+                for (uint32_t extent : extents)
+                {
+                    const VkDeviceSize size = (VkDeviceSize)sourav::Formats::texelSize(format) * extent * extent;
+                    std::vector<uint8_t> texels(size, 0x5a);
+
+                    auto upload = [&]()
+                    {
+                        sourav::Texture::computeTexture texture;
+                        texture.fromBuffer(device, texels.data(), size, format, extent, extent, queue, VK_FILTER_LINEAR,
+                            VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, sourav::Texture::computeMipMode::None, uploadMode);
+                    };
+
+                    upload();
+
+                    auto start = std::chrono::high_resolution_clock::now();
+                    for (uint32_t i = 0; i < iterations; i++)
+                    {
+                        upload();
+                    }
+
+                    computeBenchmarkResult result;
+                    result.name = uploadMode == sourav::Texture::computeUploadMode::Direct ? "upload.direct" : "upload.staged";
+                    result.parameters = "format=" + std::to_string(format) + " extent=" + std::to_string(extent) + "x" + std::to_string(extent);
+                    result.iterations = iterations;
+                    result.nsPerOperation = elapsedPerOperation(start, iterations);
+                    result.megabytesPerSecond = (double)size / (1024.0 * 1024.0) / (result.nsPerOperation * 1e-9);
+                    results.push_back(result);
+                }
+            }
+            return results;
+        }
+
+
+        /******************************************************************************************************************************
+        * Per-call cost of getting a command buffer, submitting it empty and waiting for it
+        *
+        * Measures the unpooled utils::createCommandBuffer / flushCommandBuffer pair, which allocates and frees the command
+        * buffer and a fence every call, against the pooled overloads that recycle both through device.commandPool
+        *
+        * @param device Device context
+        * @param queue Queue of device.queueFamilyIndex the command buffers are submitted to
+        * @param iterations Number of command buffers per variant
+        ********************************************************************************************************************************/
+        inline std::vector<computeBenchmarkResult> benchmarkCommandBuffers(
+            sourav::Device::computeDevice &device,
+            VkQueue                        queue,
+            uint32_t                       iterations)
+        {
+            VkDevice logicalDevice = device.logicalDevice;
+            std::vector<computeBenchmarkResult> results(2);
+
+            VkCommandPoolCreateInfo poolCreateInfo = sourav::initializers::commandPoolCreateInfo();
+            poolCreateInfo.queueFamilyIndex = device.queueFamilyIndex;
+            poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+            VkCommandPool pool;
+            ST_CHECK_RESULT(vkCreateCommandPool(logicalDevice, &poolCreateInfo, nullptr, &pool));
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (uint32_t i = 0; i < iterations; i++)
+            {
+                VkCommandBuffer commandBuffer = sourav::utils::createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, pool, logicalDevice);
+                sourav::utils::flushCommandBuffer(logicalDevice, commandBuffer, queue, pool);
+            }
+            results[0].name = "commandBuffer.unpooled";
+            results[0].nsPerOperation = elapsedPerOperation(start, iterations);
+
+            start = std::chrono::high_resolution_clock::now();
+            for (uint32_t i = 0; i < iterations; i++)
+            {
+                VkCommandBuffer commandBuffer = sourav::utils::createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, device.commandPool);
+                sourav::utils::flushCommandBuffer(commandBuffer, queue, device.commandPool);
+            }
+            results[1].name = "commandBuffer.pooled";
+            results[1].nsPerOperation = elapsedPerOperation(start, iterations);
+
+            vkDestroyCommandPool(logicalDevice, pool, nullptr);
+
+            for (computeBenchmarkResult &result : results)
+            {
+                result.iterations = iterations;
+            }
+            return results;
+        }
+
+
+        /******************************************************************************************************************************
+        * Cost per image layout transition, recorded one barrier per call or batched through the resource tracker
+        *
+        * Every iteration moves imageCount small images from TRANSFER_DST_OPTIMAL to SHADER_READ_ONLY_OPTIMAL and back in
+        * one command buffer and waits for it. The result is the time per transition, recording and execution included
+        *
+        * @param device Device context the images are created through
+        * @param queue Queue of device.queueFamilyIndex the transitions are submitted to
+        * @param imageCount Number of images transitioned per command buffer
+        * @param iterations Number of command buffers per variant
+        * @param useSynchronization2 Let the tracker record vkCmdPipelineBarrier2, the feature has to be enabled on the device
+        ********************************************************************************************************************************/
+        inline std::vector<computeBenchmarkResult> benchmarkBarriers(
+            sourav::Device::computeDevice &device,
+            VkQueue                        queue,
+            uint32_t                       imageCount,
+            uint32_t                       iterations,
+            bool                           useSynchronization2 = false)
+        {
+            VkDevice logicalDevice = device.logicalDevice;
+
+            std::vector<VkImage> images(imageCount);
+            std::vector<sourav::Memory::computeAllocation> allocations(imageCount);
+            VkImageCreateInfo imageCreateInfo = sourav::initializers::imageCreateInfo();
+            imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+            imageCreateInfo.extent = { 64, 64, 1 };
+            imageCreateInfo.mipLevels = 1;
+            imageCreateInfo.arrayLayers = 1;
+            imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+            for (uint32_t i = 0; i < imageCount; i++)
+            {
+                ST_CHECK_RESULT(vkCreateImage(logicalDevice, &imageCreateInfo, nullptr, &images[i]));
+                allocations[i] = device.allocator.allocateImage(images[i], sourav::Memory::computeMemoryUsage::gpuOnly());
+            }
+
+            const VkImageSubresourceRange range = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+            // Bring every image out of UNDEFINED once, both variants start from TRANSFER_DST_OPTIMAL
+            VkCommandBuffer commandBuffer = sourav::utils::createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, device.commandPool);
+            for (VkImage image : images)
+            {
+                sourav::utils::setImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, range);
+            }
+            sourav::utils::flushCommandBuffer(commandBuffer, queue, device.commandPool);
+
+            std::vector<computeBenchmarkResult> results(2);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (uint32_t i = 0; i < iterations; i++)
+            {
+                commandBuffer = sourav::utils::createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, device.commandPool);
+                for (VkImage image : images)
+                {
+                    sourav::utils::setImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                        range, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+                }
+                for (VkImage image : images)
+                {
+                    sourav::utils::setImageLayout(commandBuffer, image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        range, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+                }
+                sourav::utils::flushCommandBuffer(commandBuffer, queue, device.commandPool);
+            }
+            results[0].name = "barrier.setImageLayout";
+            results[0].nsPerOperation = elapsedPerOperation(start, (uint64_t)iterations * imageCount * 2);
+
+            sourav::Sync::computeResourceTracker tracker;
+            tracker.create(logicalDevice, useSynchronization2);
+            for (VkImage image : images)
+            {
+                tracker.trackImage(image, 1, 1, VK_IMAGE_ASPECT_COLOR_BIT, sourav::Sync::layoutState(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL));
+            }
+
+            start = std::chrono::high_resolution_clock::now();
+            for (uint32_t i = 0; i < iterations; i++)
+            {
+                commandBuffer = sourav::utils::createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, device.commandPool);
+                for (VkImage image : images)
+                {
+                    tracker.transition(image, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+                }
+                tracker.flush(commandBuffer);
+                for (VkImage image : images)
+                {
+                    tracker.transition(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+                }
+                tracker.flush(commandBuffer);
+                sourav::utils::flushCommandBuffer(commandBuffer, queue, device.commandPool);
+            }
+            results[1].name = tracker.usesSynchronization2() ? "barrier.tracker.sync2" : "barrier.tracker";
+            results[1].nsPerOperation = elapsedPerOperation(start, (uint64_t)iterations * imageCount * 2);
+
+            tracker.destroy();
+            for (uint32_t i = 0; i < imageCount; i++)
+            {
+                vkDestroyImage(logicalDevice, images[i], nullptr);
+                device.allocator.free(allocations[i]);
+            }
+
+            for (computeBenchmarkResult &result : results)
+            {
+                result.parameters = "images=" + std::to_string(imageCount);
+                result.iterations = iterations;
+            }
+            return results;
+        }
+
+
+        /******************************************************************************************************************************
+        * Time to create, bind and destroy buffers and images through the device's allocator
+        *
+        * @param device Device context
+        * @param bufferSize Size of every buffer in bytes
+        * @param imageExtent Width and height of every RGBA8 image
+        * @param iterations Number of resources per kind
+        ********************************************************************************************************************************/
+        inline std::vector<computeBenchmarkResult> benchmarkResourceCreation(
+            sourav::Device::computeDevice &device,
+            VkDeviceSize                   bufferSize,
+            uint32_t                       imageExtent,
+            uint32_t                       iterations)
+        {
+            VkDevice logicalDevice = device.logicalDevice;
+            std::vector<computeBenchmarkResult> results(2);
+
+            VkBufferCreateInfo bufferCreateInfo = sourav::initializers::bufferCreateInfo();
+            bufferCreateInfo.size = bufferSize;
+            bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+            bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (uint32_t i = 0; i < iterations; i++)
+            {
+                VkBuffer buffer;
+                ST_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &buffer));
+                sourav::Memory::computeAllocation allocation = device.allocator.allocateBuffer(buffer, sourav::Memory::computeMemoryUsage::gpuOnly());
+                vkDestroyBuffer(logicalDevice, buffer, nullptr);
+                device.allocator.free(allocation);
+            }
+            results[0].name = "create.buffer";
+            results[0].parameters = "size=" + std::to_string(bufferSize);
+            results[0].nsPerOperation = elapsedPerOperation(start, iterations);
+
+            VkImageCreateInfo imageCreateInfo = sourav::initializers::imageCreateInfo();
+            imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+            imageCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+            imageCreateInfo.extent = { imageExtent, imageExtent, 1 };
+            imageCreateInfo.mipLevels = 1;
+            imageCreateInfo.arrayLayers = 1;
+            imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageCreateInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+            start = std::chrono::high_resolution_clock::now();
+            for (uint32_t i = 0; i < iterations; i++)
+            {
+                VkImage image;
+                ST_CHECK_RESULT(vkCreateImage(logicalDevice, &imageCreateInfo, nullptr, &image));
+                sourav::Memory::computeAllocation allocation = device.allocator.allocateImage(image, sourav::Memory::computeMemoryUsage::gpuOnly());
+                vkDestroyImage(logicalDevice, image, nullptr);
+                device.allocator.free(allocation);
+            }
+            results[1].name = "create.image";
+            results[1].parameters = "extent=" + std::to_string(imageExtent) + "x" + std::to_string(imageExtent);
+            results[1].nsPerOperation = elapsedPerOperation(start, iterations);
+
+            for (computeBenchmarkResult &result : results)
+            {
+                result.iterations = iterations;
+            }
+            return results;
+        }
+
+
+        /******************************************************************************************************************************
+        * Host throughput of the texel conversions uploads run into staging memory, no device work
+        *
+        * Compares the vectorized kernels (whichever of AVX2, SSSE3 or NEON the build targets) against the component by
+        * component path on the same texels
+        *
+        * @param conversions Source and destination format pairs, pairs without a conversion are skipped
+        * @param texelCount Texels converted per operation
+        * @param iterations Number of conversions per variant
+        ********************************************************************************************************************************/
+        inline std::vector<computeBenchmarkResult> benchmarkTexelConversion(
+            const std::vector<std::pair<VkFormat, VkFormat>> &conversions,
+            size_t                                            texelCount,
+            uint32_t                                          iterations)
+        {
+            std::vector<computeBenchmarkResult> results;
+
+            for (const std::pair<VkFormat, VkFormat> &formats : conversions)
+            {
+                const sourav::Formats::computeTexelConversion conversion = sourav::Formats::texelConversion(formats.first, formats.second);
+                if (!conversion.valid)
+                {
+                    continue;
+                }
+
+                std::vector<uint8_t> src(texelCount * conversion.srcTexelSize, 0x5a);
+                std::vector<uint8_t> dst(texelCount * conversion.dstTexelSize);
+                const std::string parameters = "src=" + std::to_string(formats.first) + " dst=" + std::to_string(formats.second) +
+                    " texels=" + std::to_string(texelCount);
+
+                for (int scalar = 0; scalar < 2; scalar++)
+                {
+                    auto start = std::chrono::high_resolution_clock::now();
+                    for (uint32_t i = 0; i < iterations; i++)
+                    {
+                        if (scalar)
+                        {
+                            sourav::Formats::detail::convertTexelsScalar(conversion, src.data(), dst.data(), 0, texelCount);
+                        }
+                        else
+                        {
+                            sourav::Formats::convertTexels(conversion, src.data(), dst.data(), texelCount);
+                        }
+                    }
+
+                    computeBenchmarkResult result;
+                    result.name = scalar ? "convert.scalar" : "convert.kernel";
+                    result.parameters = parameters;
+                    result.iterations = iterations;
+                    result.nsPerOperation = elapsedPerOperation(start, iterations);
+                    result.megabytesPerSecond = (double)dst.size() / (1024.0 * 1024.0) / (result.nsPerOperation * 1e-9);
+                    results.push_back(result);
+                }
+            }
+            return results;
+        }
+
+
+        /******************************************************************************************************************************
+        * Write results as JSON, one object per result under "results"
+        *
+        * @param path File to write, replaced if it exists
+        * @param physicalDevice Device the results were measured on, its name and driver version are recorded
+        * @param results Results to write
+        *
+        * @return False if the file could not be written
+        ********************************************************************************************************************************/
+        inline bool writeResultsJson(
+            const std::string                         &path,
+            VkPhysicalDevice                           physicalDevice,
+            const std::vector<computeBenchmarkResult> &results)
+        {
+            const VkPhysicalDeviceProperties &properties = sourav::Device::getDeviceCaps(physicalDevice).properties;
+
+            std::ofstream file(path, std::ios::trunc);
+            if (!file.is_open())
+            {
+                return false;
+            }
+
+            // Names come from the driver and the callers, escape them so quotes or backslashes cannot break the file
+            char numbers[256];
+            snprintf(numbers, sizeof(numbers), "\"vendorID\": %u,\n  \"deviceID\": %u,\n  \"driverVersion\": %u,\n",
+                properties.vendorID, properties.deviceID, properties.driverVersion);
+            file << "{\n  \"device\": \"" << sourav::utils::escapeJson(properties.deviceName) << "\",\n  " << numbers << "  \"results\": [";
+
+            for (size_t i = 0; i < results.size(); i++)
+            {
+                const computeBenchmarkResult &result = results[i];
+                snprintf(numbers, sizeof(numbers), "\"iterations\": %u, \"nsPerOperation\": %.1f, \"megabytesPerSecond\": %.2f",
+                    result.iterations, result.nsPerOperation, result.megabytesPerSecond);
+                file << (i ? "," : "") << "\n    { \"name\": \"" << sourav::utils::escapeJson(result.name)
+                     << "\", \"parameters\": \"" << sourav::utils::escapeJson(result.parameters) << "\", " << numbers << " }";
+            }
+            file << "\n  ]\n}\n";
+
+            return static_cast<bool>(file.flush());
+        }
+    }
+}
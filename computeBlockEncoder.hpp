@@ -0,0 +1,568 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+#include <vector>
+
+#include "computeFormats.hpp"
+#include "computeThreadPool.hpp"
+
+namespace sourav
+{
+    namespace Compression
+    {
+        /** @brief Block format the CPU encoder produces */
+        enum class computeBlockEncoding
+        {
+            /** @brief 4 bits per texel, RGB with 1-bit alpha for four component sources */
+            BC1,
+            /** @brief 8 bits per texel, RGBA at much higher quality than BC1 */
+            BC7
+        };
+
+        namespace detail
+        {
+            /** @brief Mean and principal axis of the 16 texels of a block over the first components channels */
+            inline void principalAxis(const uint8_t *block, uint32_t components, float mean[4], float axis[4])
+            {
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    mean[c] = 0.0f;
+                    axis[c] = 0.0f;
+                }
+                for (uint32_t i = 0; i < 16; i++)
+                {
+                    for (uint32_t c = 0; c < components; c++)
+                    {
+                        mean[c] += block[i * 4 + c];
+                    }
+                }
+                for (uint32_t c = 0; c < components; c++)
+                {
+                    mean[c] /= 16.0f;
+                }
+
+                float covariance[4][4] = {};
+                for (uint32_t i = 0; i < 16; i++)
+                {
+                    for (uint32_t a = 0; a < components; a++)
+                    {
+                        for (uint32_t b = a; b < components; b++)
+                        {
+                            covariance[a][b] += (block[i * 4 + a] - mean[a]) * (block[i * 4 + b] - mean[b]);
+                        }
+                    }
+                }
+
+                // Power iteration, starting from the channel with the largest spread
+                uint32_t widest = 0;
+                for (uint32_t c = 1; c < components; c++)
+                {
+                    widest = covariance[c][c] > covariance[widest][widest] ? c : widest;
+                }
+                for (uint32_t c = 0; c < components; c++)
+                {
+                    axis[c] = widest < c ? covariance[widest][c] : covariance[c][widest];
+                }
+                for (uint32_t iteration = 0; iteration < 8; iteration++)
+                {
+                    float next[4] = {};
+                    float length = 0.0f;
+                    for (uint32_t a = 0; a < components; a++)
+                    {
+                        for (uint32_t b = 0; b < components; b++)
+                        {
+                            next[a] += (a < b ? covariance[a][b] : covariance[b][a]) * axis[b];
+                        }
+                        length += next[a] * next[a];
+                    }
+                    if (length < 1e-12f)
+                    {
+                        // Flat block, any axis will do
+                        for (uint32_t c = 0; c < components; c++)
+                        {
+                            axis[c] = 0.0f;
+                        }
+                        return;
+                    }
+                    length = 1.0f / std::sqrt(length);
+                    for (uint32_t c = 0; c < components; c++)
+                    {
+                        axis[c] = next[c] * length;
+                    }
+                }
+            }
+
+            /** @brief Extreme points of the block along axis, low first */
+            inline void axisEndpoints(const uint8_t *block, uint32_t components, const float mean[4], const float axis[4],
+                float low[4], float high[4])
+            {
+                float minT = 0.0f;
+                float maxT = 0.0f;
+                for (uint32_t i = 0; i < 16; i++)
+                {
+                    float t = 0.0f;
+                    for (uint32_t c = 0; c < components; c++)
+                    {
+                        t += (block[i * 4 + c] - mean[c]) * axis[c];
+                    }
+                    minT = std::min(minT, t);
+                    maxT = std::max(maxT, t);
+                }
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    low[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * minT));
+                    high[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * maxT));
+                }
+            }
+
+            inline uint16_t packRGB565(const float color[4])
+            {
+                const uint32_t r = (uint32_t)(color[0] * 31.0f / 255.0f + 0.5f);
+                const uint32_t g = (uint32_t)(color[1] * 63.0f / 255.0f + 0.5f);
+                const uint32_t b = (uint32_t)(color[2] * 31.0f / 255.0f + 0.5f);
+                return (uint16_t)((r << 11) | (g << 5) | b);
+            }
+
+            inline void unpackRGB565(uint16_t packed, int color[3])
+            {
+                const int r = packed >> 11;
+                const int g = (packed >> 5) & 63;
+                const int b = packed & 31;
+                color[0] = (r << 3) | (r >> 2);
+                color[1] = (g << 2) | (g >> 4);
+                color[2] = (b << 3) | (b >> 2);
+            }
+
+            /** @brief Gather the 4x4 block at (blockX, blockY) as RGBA8, texels past the edge repeat the last row / column */
+            inline void fetchBlock(const uint8_t *rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, uint8_t block[64])
+            {
+                for (uint32_t y = 0; y < 4; y++)
+                {
+                    const uint32_t sourceY = std::min(blockY * 4 + y, height - 1);
+                    for (uint32_t x = 0; x < 4; x++)
+                    {
+                        const uint32_t sourceX = std::min(blockX * 4 + x, width - 1);
+                        memcpy(block + (y * 4 + x) * 4, rgba + ((size_t)sourceY * width + sourceX) * 4, 4);
+                    }
+                }
+            }
+
+            /** @brief Appends bit fields to a 128-bit block, least significant bit first */
+            struct blockWriter
+            {
+                uint8_t *block;
+                uint32_t position = 0;
+
+                void write(uint32_t value, uint32_t bits)
+                {
+                    for (uint32_t bit = 0; bit < bits; bit++, position++)
+                    {
+                        block[position >> 3] |= (uint8_t)(((value >> bit) & 1) << (position & 7));
+                    }
+                }
+            };
+
+            /**
+            * @brief Least squares endpoints for texels interpolated at weights (0 at the first endpoint, 1 at the second)
+            *
+            * False if every weight is the same, then any pair of endpoints on the line fits equally well
+            */
+            inline bool fitEndpoints(const uint8_t *texels, const float weights[16], float endpoints[2][4])
+            {
+                float a = 0.0f;
+                float b = 0.0f;
+                float c = 0.0f;
+                float first[4] = {};
+                float second[4] = {};
+                for (uint32_t i = 0; i < 16; i++)
+                {
+                    const float w = weights[i];
+                    a += (1.0f - w) * (1.0f - w);
+                    b += (1.0f - w) * w;
+                    c += w * w;
+                    for (uint32_t channel = 0; channel < 4; channel++)
+                    {
+                        first[channel] += (1.0f - w) * texels[i * 4 + channel];
+                        second[channel] += w * texels[i * 4 + channel];
+                    }
+                }
+
+                const float determinant = a * c - b * b;
+                if (std::fabs(determinant) < 1e-6f)
+                {
+                    return false;
+                }
+                for (uint32_t channel = 0; channel < 4; channel++)
+                {
+                    const float e0 = (c * first[channel] - b * second[channel]) / determinant;
+                    const float e1 = (a * second[channel] - b * first[channel]) / determinant;
+                    endpoints[0][channel] = std::min(255.0f, std::max(0.0f, e0));
+                    endpoints[1][channel] = std::min(255.0f, std::max(0.0f, e1));
+                }
+                return true;
+            }
+
+            /** @brief BC1 endpoints, palette and indices of one candidate encoding */
+            struct bc1Candidate
+            {
+                uint16_t color0  = 0;
+                uint16_t color1  = 0;
+                uint32_t indices = 0;
+                int      error   = 0;
+            };
+
+            /** @brief Order the endpoints for the mode, build the palette and pick the nearest entry for every texel */
+            inline bc1Candidate evaluateBC1(const uint8_t *texels, const float high[4], const float low[4], bool transparent)
+            {
+                bc1Candidate candidate;
+                candidate.color0 = packRGB565(high);
+                candidate.color1 = packRGB565(low);
+                // color0 > color1 selects four colors, color0 <= color1 three colors and transparent black
+                if ((candidate.color0 < candidate.color1) != transparent)
+                {
+                    std::swap(candidate.color0, candidate.color1);
+                }
+
+                int palette[4][3];
+                unpackRGB565(candidate.color0, palette[0]);
+                unpackRGB565(candidate.color1, palette[1]);
+                const bool fourColors = candidate.color0 > candidate.color1;
+                for (uint32_t c = 0; c < 3; c++)
+                {
+                    if (fourColors)
+                    {
+                        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+                    }
+                    else
+                    {
+                        palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                        palette[3][c] = 0;
+                    }
+                }
+
+                for (uint32_t i = 0; i < 16; i++)
+                {
+                    const uint8_t *texel = texels + i * 4;
+                    uint32_t best = 3;
+                    if (!transparent || texel[3] >= 128)
+                    {
+                        int bestError = 1 << 30;
+                        for (uint32_t entry = 0; entry < (fourColors ? 4u : 3u); entry++)
+                        {
+                            const int dr = texel[0] - palette[entry][0];
+                            const int dg = texel[1] - palette[entry][1];
+                            const int db = texel[2] - palette[entry][2];
+                            const int error = dr * dr + dg * dg + db * db;
+                            if (error < bestError)
+                            {
+                                bestError = error;
+                                best = entry;
+                            }
+                        }
+                        candidate.error += bestError;
+                    }
+                    candidate.indices |= best << (i * 2);
+                }
+                return candidate;
+            }
+
+            /** @brief Interpolation weights of BC7's 4-bit indices, in 64ths */
+            static const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+            /** @brief BC7 mode 6 endpoints and indices of one candidate encoding */
+            struct bc7Candidate
+            {
+                /** @brief 7 bits per channel, the p-bit is the endpoint's shared lowest bit */
+                uint32_t quantized[2][4];
+                uint32_t pbits[2];
+                uint32_t indices[16];
+                int      error = 0;
+            };
+
+            /** @brief Quantize the endpoints with the better p-bit each and pick the nearest of the 16 steps for every texel */
+            inline bc7Candidate evaluateBC7(const uint8_t *texels, const float endpoints[2][4])
+            {
+                bc7Candidate candidate;
+                int decoded[2][4];
+                for (uint32_t e = 0; e < 2; e++)
+                {
+                    float bestError = 1e30f;
+                    for (uint32_t p = 0; p < 2; p++)
+                    {
+                        uint32_t q[4];
+                        float error = 0.0f;
+                        for (uint32_t c = 0; c < 4; c++)
+                        {
+                            q[c] = (uint32_t)std::min(127.0f, std::max(0.0f, std::floor((endpoints[e][c] - p) / 2.0f + 0.5f)));
+                            const float difference = (float)((q[c] << 1) | p) - endpoints[e][c];
+                            error += difference * difference;
+                        }
+                        if (error < bestError)
+                        {
+                            bestError = error;
+                            candidate.pbits[e] = p;
+                            for (uint32_t c = 0; c < 4; c++)
+                            {
+                                candidate.quantized[e][c] = q[c];
+                                decoded[e][c] = (int)((q[c] << 1) | p);
+                            }
+                        }
+                    }
+                }
+
+                for (uint32_t i = 0; i < 16; i++)
+                {
+                    const uint8_t *texel = texels + i * 4;
+                    int bestError = 1 << 30;
+                    candidate.indices[i] = 0;
+                    for (uint32_t index = 0; index < 16; index++)
+                    {
+                        int error = 0;
+                        for (uint32_t c = 0; c < 4; c++)
+                        {
+                            const int value = ((64 - BC7_WEIGHTS[index]) * decoded[0][c] + BC7_WEIGHTS[index] * decoded[1][c] + 32) >> 6;
+                            error += (texel[c] - value) * (texel[c] - value);
+                        }
+                        if (error < bestError)
+                        {
+                            bestError = error;
+                            candidate.indices[i] = index;
+                        }
+                    }
+                    candidate.error += bestError;
+                }
+                return candidate;
+            }
+        }
+
+        /******************************************************************************************************************************
+        * Encode one 4x4 RGBA8 block as BC1
+        *
+        * Starts from the extremes along the block's principal axis, then refits the endpoints to the chosen indices by
+        * least squares while that lowers the error
+        *
+        * @param texels 16 RGBA8 texels, row by row
+        * @param block Receives the 8 byte block
+        * @param punchThrough Texels with alpha below 128 become transparent (BC1_RGBA), alpha is ignored otherwise
+        ********************************************************************************************************************************/
+        inline void encodeBC1Block(const uint8_t texels[64], uint8_t block[8], bool punchThrough)
+        {
+            float mean[4];
+            float axis[4];
+            float low[4];
+            float high[4];
+            detail::principalAxis(texels, 3, mean, axis);
+            detail::axisEndpoints(texels, 3, mean, axis, low, high);
+
+            bool transparent = false;
+            for (uint32_t i = 0; punchThrough && i < 16; i++)
+            {
+                transparent = transparent || texels[i * 4 + 3] < 128;
+            }
+
+            detail::bc1Candidate best = detail::evaluateBC1(texels, high, low, transparent);
+
+            // Refit in four color mode only, the three color palette has a different set of weights
+            for (uint32_t iteration = 0; iteration < 2 && !transparent && best.color0 > best.color1; iteration++)
+            {
+                // Index 0 is color0 and 1 is color1, 2 and 3 lie a third and two thirds of the way to color1
+                static const float positions[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+                float weights[16];
+                for (uint32_t i = 0; i < 16; i++)
+                {
+                    weights[i] = positions[(best.indices >> (i * 2)) & 3];
+                }
+                float endpoints[2][4];
+                if (!detail::fitEndpoints(texels, weights, endpoints))
+                {
+                    break;
+                }
+                detail::bc1Candidate refined = detail::evaluateBC1(texels, endpoints[0], endpoints[1], false);
+                if (refined.error >= best.error)
+                {
+                    break;
+                }
+                best = refined;
+            }
+
+            block[0] = (uint8_t)(best.color0 & 0xff);
+            block[1] = (uint8_t)(best.color0 >> 8);
+            block[2] = (uint8_t)(best.color1 & 0xff);
+            block[3] = (uint8_t)(best.color1 >> 8);
+            memcpy(block + 4, &best.indices, 4);
+        }
+
+
+        /******************************************************************************************************************************
+        * Encode one 4x4 RGBA8 block as BC7 mode 6
+        *
+        * Mode 6 has a single subset with 7.7.7.7 endpoints, a p-bit each and 4-bit indices, which keeps the encoder fast
+        * while still beating BC1 by a wide margin on smooth content. Endpoints are refit like in encodeBC1Block
+        *
+        * @param texels 16 RGBA8 texels, row by row
+        * @param block Receives the 16 byte block
+        ********************************************************************************************************************************/
+        inline void encodeBC7Block(const uint8_t texels[64], uint8_t block[16])
+        {
+            float mean[4];
+            float axis[4];
+            float endpoints[2][4];
+            detail::principalAxis(texels, 4, mean, axis);
+            detail::axisEndpoints(texels, 4, mean, axis, endpoints[0], endpoints[1]);
+
+            detail::bc7Candidate best = detail::evaluateBC7(texels, endpoints);
+            for (uint32_t iteration = 0; iteration < 2; iteration++)
+            {
+                float weights[16];
+                for (uint32_t i = 0; i < 16; i++)
+                {
+                    weights[i] = detail::BC7_WEIGHTS[best.indices[i]] / 64.0f;
+                }
+                if (!detail::fitEndpoints(texels, weights, endpoints))
+                {
+                    break;
+                }
+                detail::bc7Candidate refined = detail::evaluateBC7(texels, endpoints);
+                if (refined.error >= best.error)
+                {
+                    break;
+                }
+                best = refined;
+            }
+
+            // The first index is stored without its top bit, which therefore has to be 0
+            if (best.indices[0] & 8)
+            {
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    std::swap(best.quantized[0][c], best.quantized[1][c]);
+                }
+                std::swap(best.pbits[0], best.pbits[1]);
+                for (uint32_t i = 0; i < 16; i++)
+                {
+                    best.indices[i] = 15 - best.indices[i];
+                }
+            }
+
+            memset(block, 0, 16);
+            detail::blockWriter writer = { block };
+            writer.write(1u << 6, 7);
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                writer.write(best.quantized[0][c], 7);
+                writer.write(best.quantized[1][c], 7);
+            }
+            writer.write(best.pbits[0], 1);
+            writer.write(best.pbits[1], 1);
+            writer.write(best.indices[0], 3);
+            for (uint32_t i = 1; i < 16; i++)
+            {
+                writer.write(best.indices[i], 4);
+            }
+        }
+
+
+        /** @brief BC1 / BC7 format encoding texels of format produces, VK_FORMAT_UNDEFINED if the encoder cannot take format */
+        inline VkFormat encodedFormat(VkFormat format, computeBlockEncoding encoding)
+        {
+            const sourav::Formats::computeFormatInfo info = sourav::Formats::formatInfo(format);
+            const bool srgb = info.type == sourav::Formats::computeComponentType::Srgb;
+            if (info.componentSize != 1 || info.componentCount < 3 ||
+                (info.type != sourav::Formats::computeComponentType::Unorm && !srgb))
+            {
+                return VK_FORMAT_UNDEFINED;
+            }
+
+            if (encoding == computeBlockEncoding::BC7)
+            {
+                return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+            }
+            if (info.componentCount == 4)
+            {
+                return srgb ? VK_FORMAT_BC1_RGBA_SRGB_BLOCK : VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+            }
+            return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+        }
+
+
+        /******************************************************************************************************************************
+        * Compress an RGBA8 image to BC1 or BC7, spread over a thread pool by rows of blocks
+        *
+        * @param format BC1 (RGB or RGBA) or BC7 format to produce, see encodedFormat
+        * @param rgba width x height RGBA8 texels, row by row
+        * @param width Width of the image, need not be a multiple of 4
+        * @param height Height of the image, need not be a multiple of 4
+        * @param blocks Receives Formats::blockImageSize(format, width, height) bytes
+        * @param threadPool (Optional) Pool to encode on, the calling thread encodes alone without one
+        *
+        * @throw Throws an exception if format is not BC1 or BC7
+        ********************************************************************************************************************************/
+        inline void compressImage(
+            VkFormat                              format,
+            const uint8_t                        *rgba,
+            uint32_t                              width,
+            uint32_t                              height,
+            uint8_t                              *blocks,
+            sourav::Threading::computeThreadPool *threadPool = nullptr)
+        {
+            const bool bc7 = format == VK_FORMAT_BC7_UNORM_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK;
+            const bool punchThrough = format == VK_FORMAT_BC1_RGBA_UNORM_BLOCK || format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+            if (!bc7 && !punchThrough && format != VK_FORMAT_BC1_RGB_UNORM_BLOCK && format != VK_FORMAT_BC1_RGB_SRGB_BLOCK)
+            {
+                throw std::runtime_error("The block encoder produces BC1 and BC7 only");
+            }
+
+            const uint32_t blockSize = bc7 ? 16 : 8;
+            const uint32_t blocksWide = (width + 3) / 4;
+            const uint32_t blocksHigh = (height + 3) / 4;
+
+            auto encodeRows = [=](uint32_t firstRow, uint32_t endRow)
+            {
+                uint8_t texels[64];
+                for (uint32_t blockY = firstRow; blockY < endRow; blockY++)
+                {
+                    uint8_t *target = blocks + (size_t)blockY * blocksWide * blockSize;
+                    for (uint32_t blockX = 0; blockX < blocksWide; blockX++, target += blockSize)
+                    {
+                        detail::fetchBlock(rgba, width, height, blockX, blockY, texels);
+                        if (bc7)
+                        {
+                            encodeBC7Block(texels, target);
+                        }
+                        else
+                        {
+                            encodeBC1Block(texels, target, punchThrough);
+                        }
+                    }
+                }
+            };
+
+            if (!threadPool || threadPool->threadCount() == 0 || blocksHigh < 2)
+            {
+                encodeRows(0, blocksHigh);
+                return;
+            }
+
+            // A few tasks per worker, so a slow band does not leave the others idle
+            const uint32_t taskCount = std::min(blocksHigh, threadPool->threadCount() * 4);
+            std::vector<std::future<void>> tasks;
+            for (uint32_t task = 0; task < taskCount; task++)
+            {
+                const uint32_t firstRow = (uint32_t)((uint64_t)blocksHigh * task / taskCount);
+                const uint32_t endRow = (uint32_t)((uint64_t)blocksHigh * (task + 1) / taskCount);
+                tasks.push_back(threadPool->submit([=]() { encodeRows(firstRow, endRow); }));
+            }
+            for (std::future<void> &task : tasks)
+            {
+                threadPool->wait(task);
+            }
+        }
+    }
+}
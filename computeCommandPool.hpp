@@ -0,0 +1,366 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "computeDeviceUtils.hpp"
+
+namespace sourav
+{
+    namespace Command
+    {
+        /** @brief Pool counters, a hit is an object handed out from the free lists, a miss one that had to be created */
+        struct computeCommandPoolStats
+        {
+            uint64_t commandBufferHits             = 0;
+            uint64_t commandBufferMisses           = 0;
+            uint64_t fenceHits                     = 0;
+            uint64_t fenceMisses                   = 0;
+            uint32_t outstandingCommandBuffers     = 0;
+            uint32_t peakOutstandingCommandBuffers = 0;
+            uint32_t outstandingFences             = 0;
+            uint32_t peakOutstandingFences         = 0;
+        };
+
+        /**
+        * @brief Recycles command buffers and fences instead of creating them per use
+        *
+        * Every thread gets its own VkCommandPool, since pools must be externally synchronized. A command buffer must be
+        * recorded on the thread that acquired it, but may be released from any thread: it goes back to its owner's free
+        * list and is reset implicitly when it is begun again. Fences are not tied to a pool and are shared
+        */
+        class computeCommandPool
+        {
+            public:
+                VkDevice logicalDevice    = VK_NULL_HANDLE;
+                uint32_t queueFamilyIndex = 0;
+
+                void create(VkDevice logicalDevice, uint32_t queueFamilyIndex);
+                void destroy();
+
+                VkCommandBuffer acquireCommandBuffer(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY, bool begin = true);
+                void releaseCommandBuffer(VkCommandBuffer commandBuffer);
+                void discardCommandBuffer(VkCommandBuffer commandBuffer);
+
+                VkFence acquireFence();
+                void releaseFence(VkFence fence);
+
+                void flush(VkCommandBuffer commandBuffer, VkQueue queue);
+
+                computeCommandPoolStats getStats();
+
+            private:
+                struct threadPool
+                {
+                    VkCommandPool                pool = VK_NULL_HANDLE;
+                    std::mutex                   mutex;
+                    std::vector<VkCommandBuffer> freeCommandBuffers[2];
+                };
+
+                std::mutex                                                    poolsMutex;
+                std::unordered_map<std::thread::id, std::unique_ptr<threadPool>> threadPools;
+                std::unordered_map<VkCommandBuffer, std::pair<threadPool *, VkCommandBufferLevel>> owners;
+
+                std::mutex           fenceMutex;
+                std::vector<VkFence> freeFences;
+                std::vector<VkFence> allFences;
+
+                std::atomic<uint64_t> commandBufferHits { 0 };
+                std::atomic<uint64_t> commandBufferMisses { 0 };
+                std::atomic<uint64_t> fenceHits { 0 };
+                std::atomic<uint64_t> fenceMisses { 0 };
+                std::atomic<uint32_t> outstandingCommandBuffers { 0 };
+                std::atomic<uint32_t> peakOutstandingCommandBuffers { 0 };
+                std::atomic<uint32_t> outstandingFences { 0 };
+                std::atomic<uint32_t> peakOutstandingFences { 0 };
+
+                threadPool *currentThreadPool();
+                static void trackPeak(std::atomic<uint32_t> &outstanding, std::atomic<uint32_t> &peak);
+        };
+
+
+        inline void computeCommandPool::create(VkDevice logicalDevice, uint32_t queueFamilyIndex)
+        {
+            this->logicalDevice = logicalDevice;
+            this->queueFamilyIndex = queueFamilyIndex;
+        }
+
+
+        /** @brief Destroy every per-thread pool and fence, nothing handed out may still be in use */
+        inline void computeCommandPool::destroy()
+        {
+            {
+                std::lock_guard<std::mutex> lock(poolsMutex);
+                for (auto &entry : threadPools)
+                {
+                    // Destroying the pool frees all command buffers allocated from it
+                    vkDestroyCommandPool(logicalDevice, entry.second->pool, nullptr);
+                }
+                threadPools.clear();
+                owners.clear();
+            }
+
+            std::lock_guard<std::mutex> lock(fenceMutex);
+            for (VkFence fence : allFences)
+            {
+                vkDestroyFence(logicalDevice, fence, nullptr);
+            }
+            allFences.clear();
+            freeFences.clear();
+        }
+
+
+        inline computeCommandPool::threadPool *computeCommandPool::currentThreadPool()
+        {
+            std::lock_guard<std::mutex> lock(poolsMutex);
+
+            std::unique_ptr<threadPool> &entry = threadPools[std::this_thread::get_id()];
+            if (!entry)
+            {
+                entry.reset(new threadPool());
+
+                // Command buffers are reset individually when they are begun again
+                VkCommandPoolCreateInfo poolCreateInfo = sourav::initializers::commandPoolCreateInfo();
+                poolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+                poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+                ST_CHECK_RESULT(vkCreateCommandPool(logicalDevice, &poolCreateInfo, nullptr, &entry->pool));
+            }
+            return entry.get();
+        }
+
+
+        inline void computeCommandPool::trackPeak(std::atomic<uint32_t> &outstanding, std::atomic<uint32_t> &peak)
+        {
+            uint32_t current = ++outstanding;
+            uint32_t previous = peak.load();
+            while (current > previous && !peak.compare_exchange_weak(previous, current))
+            {
+            }
+        }
+
+
+        /******************************************************************************************************************************
+        * Get a command buffer from the calling thread's pool
+        *
+        * @param level Level of the command buffer
+        * @param begin If true, recording is started (same as utils::createCommandBuffer)
+        *
+        * @return A reset command buffer, to be returned with releaseCommandBuffer or flush, or discardCommandBuffer if it is
+        *         dropped while still recording
+        ********************************************************************************************************************************/
+        inline VkCommandBuffer computeCommandPool::acquireCommandBuffer(VkCommandBufferLevel level, bool begin)
+        {
+            threadPool *owner = currentThreadPool();
+
+            VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+            {
+                std::lock_guard<std::mutex> lock(owner->mutex);
+                std::vector<VkCommandBuffer> &freeList = owner->freeCommandBuffers[level == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? 0 : 1];
+                if (!freeList.empty())
+                {
+                    cmdBuffer = freeList.back();
+                    freeList.pop_back();
+                }
+            }
+
+            if (cmdBuffer != VK_NULL_HANDLE)
+            {
+                commandBufferHits++;
+            }
+            else
+            {
+                commandBufferMisses++;
+
+                VkCommandBufferAllocateInfo cmdBufAllocateInfo = sourav::initializers::commandBufferAllocateInfo(owner->pool, level, 1);
+                {
+                    // discardCommandBuffer frees through the same pool
+                    std::lock_guard<std::mutex> lock(owner->mutex);
+                    ST_CHECK_RESULT(vkAllocateCommandBuffers(logicalDevice, &cmdBufAllocateInfo, &cmdBuffer));
+                }
+
+                std::lock_guard<std::mutex> lock(poolsMutex);
+                owners[cmdBuffer] = std::make_pair(owner, level);
+            }
+            trackPeak(outstandingCommandBuffers, peakOutstandingCommandBuffers);
+
+            if (begin)
+            {
+                // Beginning a command buffer from a pool with RESET_COMMAND_BUFFER_BIT implicitly resets it
+                VkCommandBufferBeginInfo cmdBufInfo = sourav::initializers::commandBufferBeginInfo();
+                ST_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
+            }
+
+            return cmdBuffer;
+        }
+
+
+        /** @brief Hand a command buffer back to the pool of the thread that acquired it, it must no longer be pending on a queue */
+        inline void computeCommandPool::releaseCommandBuffer(VkCommandBuffer commandBuffer)
+        {
+            if (commandBuffer == VK_NULL_HANDLE)
+            {
+                return;
+            }
+
+            std::pair<threadPool *, VkCommandBufferLevel> owner;
+            {
+                std::lock_guard<std::mutex> lock(poolsMutex);
+                auto it = owners.find(commandBuffer);
+                assert(it != owners.end());
+                owner = it->second;
+            }
+
+            std::lock_guard<std::mutex> lock(owner.first->mutex);
+            owner.first->freeCommandBuffers[owner.second == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? 0 : 1].push_back(commandBuffer);
+            outstandingCommandBuffers--;
+        }
+
+
+        /**
+        * @brief Hand back a command buffer that will not be submitted, e.g. after recording it failed
+        *
+        * The command buffer may still be recording, it is reset before it goes back to the free list. Does not throw so it
+        * can be called while unwinding, a command buffer that fails to reset is freed instead. Like recording, call it on
+        * the thread that acquired the command buffer
+        */
+        inline void computeCommandPool::discardCommandBuffer(VkCommandBuffer commandBuffer)
+        {
+            if (commandBuffer == VK_NULL_HANDLE)
+            {
+                return;
+            }
+
+            std::pair<threadPool *, VkCommandBufferLevel> owner;
+            {
+                std::lock_guard<std::mutex> lock(poolsMutex);
+                auto it = owners.find(commandBuffer);
+                assert(it != owners.end());
+                owner = it->second;
+            }
+
+            // Resetting needs the owning pool to be externally synchronized, like allocating from it.
+            // The per-thread pools are created with RESET_COMMAND_BUFFER_BIT, resetting is valid in the recording state
+            std::lock_guard<std::mutex> lock(owner.first->mutex);
+            if (vkResetCommandBuffer(commandBuffer, 0) == VK_SUCCESS)
+            {
+                owner.first->freeCommandBuffers[owner.second == VK_COMMAND_BUFFER_LEVEL_PRIMARY ? 0 : 1].push_back(commandBuffer);
+            }
+            else
+            {
+                vkFreeCommandBuffers(logicalDevice, owner.first->pool, 1, &commandBuffer);
+
+                std::lock_guard<std::mutex> poolsLock(poolsMutex);
+                owners.erase(commandBuffer);
+            }
+            outstandingCommandBuffers--;
+        }
+
+
+        /** @brief Get an unsignaled fence */
+        inline VkFence computeCommandPool::acquireFence()
+        {
+            VkFence fence = VK_NULL_HANDLE;
+            {
+                std::lock_guard<std::mutex> lock(fenceMutex);
+                if (!freeFences.empty())
+                {
+                    fence = freeFences.back();
+                    freeFences.pop_back();
+                }
+            }
+
+            if (fence != VK_NULL_HANDLE)
+            {
+                fenceHits++;
+            }
+            else
+            {
+                fenceMisses++;
+
+                VkFenceCreateInfo fenceInfo = sourav::initializers::fenceCreateInfo(VK_FLAGS_NONE);
+                ST_CHECK_RESULT(vkCreateFence(logicalDevice, &fenceInfo, nullptr, &fence));
+
+                std::lock_guard<std::mutex> lock(fenceMutex);
+                allFences.push_back(fence);
+            }
+            trackPeak(outstandingFences, peakOutstandingFences);
+
+            return fence;
+        }
+
+
+        /** @brief Return a fence that is signaled or was never submitted, it is reset here */
+        inline void computeCommandPool::releaseFence(VkFence fence)
+        {
+            if (fence == VK_NULL_HANDLE)
+            {
+                return;
+            }
+
+            ST_CHECK_RESULT(vkResetFences(logicalDevice, 1, &fence));
+
+            std::lock_guard<std::mutex> lock(fenceMutex);
+            freeFences.push_back(fence);
+            outstandingFences--;
+        }
+
+
+        /** @brief Pooled equivalent of utils::flushCommandBuffer: end, submit, wait and recycle the command buffer and fence */
+        inline void computeCommandPool::flush(VkCommandBuffer commandBuffer, VkQueue queue)
+        {
+            if (commandBuffer == VK_NULL_HANDLE)
+                return;
+
+            ST_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+
+            VkSubmitInfo submitInfo = sourav::initializers::submitInfo();
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &commandBuffer;
+
+            VkFence fence = acquireFence();
+
+            ST_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
+            ST_CHECK_RESULT(vkWaitForFences(logicalDevice, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+
+            releaseFence(fence);
+            releaseCommandBuffer(commandBuffer);
+        }
+
+
+        inline computeCommandPoolStats computeCommandPool::getStats()
+        {
+            computeCommandPoolStats stats;
+            stats.commandBufferHits = commandBufferHits;
+            stats.commandBufferMisses = commandBufferMisses;
+            stats.fenceHits = fenceHits;
+            stats.fenceMisses = fenceMisses;
+            stats.outstandingCommandBuffers = outstandingCommandBuffers;
+            stats.peakOutstandingCommandBuffers = peakOutstandingCommandBuffers;
+            stats.outstandingFences = outstandingFences;
+            stats.peakOutstandingFences = peakOutstandingFences;
+            return stats;
+        }
+    }
+
+    namespace utils
+    {
+        /** @brief Pooled overload of createCommandBuffer, the command buffer comes back begun */
+        inline VkCommandBuffer createCommandBuffer(VkCommandBufferLevel level, sourav::Command::computeCommandPool &pool)
+        {
+            return pool.acquireCommandBuffer(level, true);
+        }
+
+        /** @brief Pooled overload of flushCommandBuffer, same blocking behavior without creating or freeing anything */
+        inline void flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, sourav::Command::computeCommandPool &pool)
+        {
+            pool.flush(commandBuffer, queue);
+        }
+    }
+}
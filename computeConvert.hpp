@@ -0,0 +1,332 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define ST_CONVERT_AVX2
+#endif
+#if defined(__SSSE3__) || defined(__AVX2__)
+#include <tmmintrin.h>
+#define ST_CONVERT_SSSE3
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define ST_CONVERT_NEON
+#endif
+
+#include "computeFormats.hpp"
+
+namespace sourav
+{
+    namespace Formats
+    {
+        /** @brief sourceComponent entry for a component the source lacks that is filled with the format's 1 (alpha) */
+        static const uint8_t CONVERT_ONE = 0xff;
+        /** @brief sourceComponent entry for a component the source lacks that is filled with 0 */
+        static const uint8_t CONVERT_ZERO = 0xfe;
+
+        /**
+        * @brief How texels of one format are rewritten as texels of another with the same component type and size
+        *
+        * Covers widening (RGB -> RGBA, alpha set to 1) and reordering (BGRA <-> RGBA), the cases where a device lacks
+        * optimal tiling support for the source format
+        */
+        struct computeTexelConversion
+        {
+            bool     valid         = false;
+            /** @brief Same bits per texel in the same order, converting is a copy */
+            bool     identity      = false;
+            uint32_t srcTexelSize  = 0;
+            uint32_t dstTexelSize  = 0;
+            uint32_t componentSize = 0;
+            uint32_t dstComponents = 0;
+            /** @brief For every destination component, the source component it comes from or CONVERT_ONE / CONVERT_ZERO */
+            uint8_t  sourceComponent[4] = { 0, 1, 2, 3 };
+            /** @brief Bits of 1 in one component: all ones for UNORM, 1.0 for floats, 1 for integers */
+            uint32_t one           = 0;
+        };
+
+        /**
+        * @brief Conversion from texels of srcFormat to texels of dstFormat, valid is false if there is none
+        *
+        * sRGB and UNORM components are copied bit for bit without decoding, selectUploadFormat only pairs them for storage
+        */
+        inline computeTexelConversion texelConversion(VkFormat srcFormat, VkFormat dstFormat)
+        {
+            computeTexelConversion conversion;
+
+            const computeFormatInfo src = formatInfo(srcFormat);
+            const computeFormatInfo dst = formatInfo(dstFormat);
+            if (src.texelSize == 0 || dst.texelSize == 0)
+            {
+                return conversion;
+            }
+
+            const bool unormPair =
+                (src.type == computeComponentType::Unorm || src.type == computeComponentType::Srgb) &&
+                (dst.type == computeComponentType::Unorm || dst.type == computeComponentType::Srgb);
+            if (srcFormat != dstFormat &&
+                (src.type == computeComponentType::Packed || dst.type == computeComponentType::Packed ||
+                 src.componentSize != dst.componentSize || dst.componentCount < src.componentCount ||
+                 (src.type != dst.type && !unormPair)))
+            {
+                return conversion;
+            }
+
+            conversion.valid = true;
+            conversion.srcTexelSize = src.texelSize;
+            conversion.dstTexelSize = dst.texelSize;
+            conversion.componentSize = src.componentSize;
+            conversion.dstComponents = dst.componentCount;
+
+            bool inOrder = src.texelSize == dst.texelSize;
+            for (uint32_t c = 0; c < dst.componentCount; c++)
+            {
+                // Logical channel (R, G, B, A) stored at c, then where the source stores it
+                uint32_t channel = (dst.blueFirst && c < 3) ? 2 - c : c;
+                uint8_t source;
+                if (channel < src.componentCount)
+                {
+                    source = static_cast<uint8_t>((src.blueFirst && channel < 3) ? 2 - channel : channel);
+                }
+                else
+                {
+                    source = channel == 3 ? CONVERT_ONE : CONVERT_ZERO;
+                }
+                conversion.sourceComponent[c] = source;
+                inOrder = inOrder && source == c;
+            }
+            conversion.identity = inOrder || src.type == computeComponentType::Packed;
+
+            switch (dst.type)
+            {
+                case computeComponentType::Sfloat:
+                    conversion.one = dst.componentSize == 2 ? 0x3c00u : 0x3f800000u;
+                    break;
+                case computeComponentType::Uint:
+                case computeComponentType::Sint:
+                    conversion.one = 1;
+                    break;
+                case computeComponentType::Snorm:
+                    conversion.one = dst.componentSize == 4 ? 0x7fffffffu : (1u << (8 * dst.componentSize - 1)) - 1;
+                    break;
+                default:
+                    conversion.one = dst.componentSize == 4 ? 0xffffffffu : (1u << (8 * dst.componentSize)) - 1;
+                    break;
+            }
+            return conversion;
+        }
+
+        namespace detail
+        {
+            /**
+            * @brief Vectorized RGB8 -> RGBA8 (swapRB: BGR8 -> RGBA8 or RGB8 -> BGRA8), returns the number of texels done
+            *
+            * SSSE3 / AVX2 load 16 bytes per 4 texels and stop early enough never to read past the source
+            */
+            inline size_t expandRGB8(const uint8_t *src, uint8_t *dst, size_t texels, bool swapRB, uint8_t alpha)
+            {
+                size_t i = 0;
+#if defined(ST_CONVERT_SSSE3)
+                const __m128i shuffle = swapRB ?
+                    _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1) :
+                    _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+                const __m128i alphaMask = _mm_set1_epi32((int)((uint32_t)alpha << 24));
+#if defined(ST_CONVERT_AVX2)
+                const __m256i shuffle256 = _mm256_broadcastsi128_si256(shuffle);
+                const __m256i alphaMask256 = _mm256_broadcastsi128_si256(alphaMask);
+                // 8 texels per iteration, the second load ends 4 bytes past the 24 used
+                for (; i + 10 <= texels; i += 8)
+                {
+                    __m128i lo = _mm_loadu_si128((const __m128i *)(src + i * 3));
+                    __m128i hi = _mm_loadu_si128((const __m128i *)(src + i * 3 + 12));
+                    __m256i texels256 = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+                    texels256 = _mm256_or_si256(_mm256_shuffle_epi8(texels256, shuffle256), alphaMask256);
+                    _mm256_storeu_si256((__m256i *)(dst + i * 4), texels256);
+                }
+#endif
+                for (; i + 6 <= texels; i += 4)
+                {
+                    __m128i texels128 = _mm_loadu_si128((const __m128i *)(src + i * 3));
+                    texels128 = _mm_or_si128(_mm_shuffle_epi8(texels128, shuffle), alphaMask);
+                    _mm_storeu_si128((__m128i *)(dst + i * 4), texels128);
+                }
+#elif defined(ST_CONVERT_NEON)
+                const uint8x16_t alpha16 = vdupq_n_u8(alpha);
+                for (; i + 16 <= texels; i += 16)
+                {
+                    uint8x16x3_t rgb = vld3q_u8(src + i * 3);
+                    uint8x16x4_t rgba;
+                    rgba.val[0] = swapRB ? rgb.val[2] : rgb.val[0];
+                    rgba.val[1] = rgb.val[1];
+                    rgba.val[2] = swapRB ? rgb.val[0] : rgb.val[2];
+                    rgba.val[3] = alpha16;
+                    vst4q_u8(dst + i * 4, rgba);
+                }
+#else
+                (void)src;
+                (void)dst;
+                (void)texels;
+                (void)swapRB;
+                (void)alpha;
+#endif
+                return i;
+            }
+
+            /** @brief Vectorized reorder of four 8-bit components, order[c] is the source of component c, returns the texels done */
+            inline size_t swizzleRGBA8(const uint8_t *src, uint8_t *dst, size_t texels, const uint8_t order[4])
+            {
+                size_t i = 0;
+#if defined(ST_CONVERT_SSSE3)
+                const __m128i shuffle = _mm_setr_epi8(
+                    (char)order[0], (char)order[1], (char)order[2], (char)order[3],
+                    (char)(order[0] + 4), (char)(order[1] + 4), (char)(order[2] + 4), (char)(order[3] + 4),
+                    (char)(order[0] + 8), (char)(order[1] + 8), (char)(order[2] + 8), (char)(order[3] + 8),
+                    (char)(order[0] + 12), (char)(order[1] + 12), (char)(order[2] + 12), (char)(order[3] + 12));
+#if defined(ST_CONVERT_AVX2)
+                const __m256i shuffle256 = _mm256_broadcastsi128_si256(shuffle);
+                for (; i + 8 <= texels; i += 8)
+                {
+                    __m256i texels256 = _mm256_loadu_si256((const __m256i *)(src + i * 4));
+                    _mm256_storeu_si256((__m256i *)(dst + i * 4), _mm256_shuffle_epi8(texels256, shuffle256));
+                }
+#endif
+                for (; i + 4 <= texels; i += 4)
+                {
+                    __m128i texels128 = _mm_loadu_si128((const __m128i *)(src + i * 4));
+                    _mm_storeu_si128((__m128i *)(dst + i * 4), _mm_shuffle_epi8(texels128, shuffle));
+                }
+#elif defined(ST_CONVERT_NEON)
+                for (; i + 16 <= texels; i += 16)
+                {
+                    uint8x16x4_t in = vld4q_u8(src + i * 4);
+                    uint8x16x4_t out;
+                    out.val[0] = in.val[order[0]];
+                    out.val[1] = in.val[order[1]];
+                    out.val[2] = in.val[order[2]];
+                    out.val[3] = in.val[order[3]];
+                    vst4q_u8(dst + i * 4, out);
+                }
+#else
+                (void)src;
+                (void)dst;
+                (void)texels;
+                (void)order;
+#endif
+                return i;
+            }
+
+            /** @brief Component by component conversion of the texels from first on, for any component size */
+            inline void convertTexelsScalar(const computeTexelConversion &conversion, const uint8_t *src, uint8_t *dst, size_t first, size_t texels)
+            {
+                const uint32_t componentSize = conversion.componentSize;
+                for (size_t i = first; i < texels; i++)
+                {
+                    const uint8_t *srcTexel = src + i * conversion.srcTexelSize;
+                    uint8_t *dstTexel = dst + i * conversion.dstTexelSize;
+                    for (uint32_t c = 0; c < conversion.dstComponents; c++)
+                    {
+                        const uint8_t source = conversion.sourceComponent[c];
+                        if (source == CONVERT_ONE || source == CONVERT_ZERO)
+                        {
+                            // Little endian, the low bytes of one hold the component
+                            const uint32_t value = source == CONVERT_ONE ? conversion.one : 0;
+                            memcpy(dstTexel + c * componentSize, &value, componentSize);
+                        }
+                        else
+                        {
+                            memcpy(dstTexel + c * componentSize, srcTexel + source * componentSize, componentSize);
+                        }
+                    }
+                }
+            }
+        }
+
+        /******************************************************************************************************************************
+        * Convert tightly packed texels, e.g. straight from the caller's buffer into staging memory
+        *
+        * 8-bit RGB -> RGBA expansion and 8-bit four component swizzles use AVX2, SSSE3 or NEON when the compiler targets
+        * them, everything else goes component by component. Identity conversions are a memcpy
+        *
+        * @param conversion From texelConversion, must be valid
+        * @param src texelCount source texels
+        * @param dst Receives texelCount destination texels, must not overlap src
+        * @param texelCount Number of texels
+        ********************************************************************************************************************************/
+        inline void convertTexels(const computeTexelConversion &conversion, const void *src, void *dst, size_t texelCount)
+        {
+            if (!conversion.valid)
+            {
+                throw std::runtime_error("No texel conversion between these formats");
+            }
+            if (texelCount == 0)
+            {
+                // src and dst may be null, memcpy must not see them
+                return;
+            }
+
+            const uint8_t *srcBytes = static_cast<const uint8_t *>(src);
+            uint8_t *dstBytes = static_cast<uint8_t *>(dst);
+            if (conversion.identity)
+            {
+                memcpy(dstBytes, srcBytes, texelCount * conversion.dstTexelSize);
+                return;
+            }
+
+            size_t done = 0;
+            const uint8_t *order = conversion.sourceComponent;
+            if (conversion.componentSize == 1 && conversion.dstComponents == 4 && order[3] == CONVERT_ONE &&
+                conversion.srcTexelSize == 3)
+            {
+                const bool swapRB = order[0] == 2 && order[1] == 1 && order[2] == 0;
+                if (swapRB || (order[0] == 0 && order[1] == 1 && order[2] == 2))
+                {
+                    done = detail::expandRGB8(srcBytes, dstBytes, texelCount, swapRB, static_cast<uint8_t>(conversion.one));
+                }
+            }
+            else if (conversion.componentSize == 1 && conversion.dstComponents == 4 && conversion.srcTexelSize == 4 &&
+                order[0] < 4 && order[1] < 4 && order[2] < 4 && order[3] < 4)
+            {
+                done = detail::swizzleRGBA8(srcBytes, dstBytes, texelCount, order);
+            }
+
+            detail::convertTexelsScalar(conversion, srcBytes, dstBytes, done, texelCount);
+        }
+
+        /******************************************************************************************************************************
+        * Pick format, a fallback with the same bits, or a fallback the texels can be converted to, that supports usage
+        *
+        * sRGB data only goes to a UNORM image for storage usage, see acceptsFallback(), plain sampled images keep sRGB
+        *
+        * @return format if it is supported, otherwise the first accepted fallback. Use texelConversion(format, result)
+        * to fill the image
+        *
+        * @throw Throws an exception if neither format nor any accepted fallback supports usage
+        ********************************************************************************************************************************/
+        inline VkFormat selectUploadFormat(
+            VkPhysicalDevice  physicalDevice,
+            VkFormat          format,
+            VkImageUsageFlags usage,
+            VkImageTiling     tiling = VK_IMAGE_TILING_OPTIMAL)
+        {
+            if (supportsUsage(physicalDevice, format, usage, tiling))
+            {
+                return format;
+            }
+            for (const computeFormatFallback &fallback : fallbackFormats(format))
+            {
+                if ((fallback.sameBits || texelConversion(format, fallback.format).valid) &&
+                    acceptsFallback(format, fallback.format, usage) &&
+                    supportsUsage(physicalDevice, fallback.format, usage, tiling))
+                {
+                    return fallback.format;
+                }
+            }
+            throw std::runtime_error("Format does not support the requested image usage");
+        }
+    }
+}
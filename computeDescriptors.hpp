@@ -0,0 +1,679 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "computeDeviceUtils.hpp"
+
+// Sets in the first pool of a descriptor allocator, each new pool doubles it up to the maximum
+#define DEFAULT_DESCRIPTOR_POOL_SETS 64
+#define MAX_DESCRIPTOR_POOL_SETS 4096
+
+namespace sourav
+{
+    namespace Descriptor
+    {
+        /**
+        * @brief Creates each distinct descriptor set layout once
+        *
+        * Layouts are keyed by their bindings (sorted by binding number, so declaration order does not matter) and live
+        * until the cache is destroyed
+        */
+        class computeDescriptorLayoutCache
+        {
+            public:
+                void create(VkDevice logicalDevice);
+                void destroy();
+
+                VkDescriptorSetLayout getLayout(std::vector<VkDescriptorSetLayoutBinding> bindings);
+                size_t size();
+
+            private:
+                struct layoutKey
+                {
+                    std::vector<VkDescriptorSetLayoutBinding> bindings;
+                    std::vector<VkSampler>                    immutableSamplers;
+                    /** @brief Where each binding's samplers start in immutableSamplers, one entry per binding */
+                    std::vector<size_t>                       samplerOffsets;
+
+                    bool operator==(const layoutKey &other) const;
+                };
+
+                struct layoutKeyHash
+                {
+                    size_t operator()(const layoutKey &key) const;
+                };
+
+                VkDevice   logicalDevice = VK_NULL_HANDLE;
+                std::mutex mutex;
+                std::unordered_map<layoutKey, VkDescriptorSetLayout, layoutKeyHash> layouts;
+        };
+
+        /** @brief Descriptors of one type reserved per set in a pool */
+        struct computeDescriptorPoolRatio
+        {
+            VkDescriptorType type;
+            float            ratio;
+        };
+
+        struct computeDescriptorAllocatorStats
+        {
+            uint32_t poolCount     = 0;
+            uint32_t usedPoolCount = 0;
+            uint64_t setsAllocated = 0;
+            /** @brief Allocations that found their pool exhausted and moved on to another one */
+            uint64_t rollovers     = 0;
+        };
+
+        /** @brief Pool ratios that fit compute work: mostly storage images and buffers */
+        inline std::vector<computeDescriptorPoolRatio> defaultPoolRatios()
+        {
+            return {
+                { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f },
+                { VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,          1.0f },
+                { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,          2.0f },
+                { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,         1.0f },
+                { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,         2.0f },
+                { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0.5f },
+                { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 0.5f },
+                { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER,   0.5f },
+                { VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER,   0.5f },
+                { VK_DESCRIPTOR_TYPE_SAMPLER,                0.5f }
+            };
+        }
+
+        /**
+        * @brief Allocates descriptor sets from a growing list of pools
+        *
+        * When the current pool runs out (OUT_OF_POOL_MEMORY or FRAGMENTED_POOL) allocation rolls over to a recycled or
+        * new pool. Sets are never freed one by one, reset() returns every pool at once
+        */
+        class computeDescriptorAllocator
+        {
+            public:
+                void create(
+                    VkDevice                                       logicalDevice,
+                    const std::vector<computeDescriptorPoolRatio> &ratios      = defaultPoolRatios(),
+                    uint32_t                                       setsPerPool = DEFAULT_DESCRIPTOR_POOL_SETS);
+                void destroy();
+
+                VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+                void reset();
+
+                computeDescriptorAllocatorStats getStats();
+
+            private:
+                VkDevice                                logicalDevice = VK_NULL_HANDLE;
+                std::vector<computeDescriptorPoolRatio> ratios;
+                uint32_t                                setsPerPool   = DEFAULT_DESCRIPTOR_POOL_SETS;
+
+                std::mutex                              mutex;
+                VkDescriptorPool                        currentPool   = VK_NULL_HANDLE;
+                std::vector<VkDescriptorPool>           usedPools;
+                std::vector<VkDescriptorPool>           freePools;
+                uint64_t                                setsAllocated = 0;
+                uint64_t                                rollovers     = 0;
+
+                VkDescriptorPool grabPool();
+        };
+
+        /**
+        * @brief One descriptor allocator per frame in flight
+        *
+        * beginFrame() resets the pools of the frame that is about to be recorded, the caller must have waited for the GPU
+        * work that last used that frame's sets
+        */
+        class computeFrameDescriptorAllocator
+        {
+            public:
+                void create(
+                    VkDevice                                       logicalDevice,
+                    uint32_t                                       framesInFlight,
+                    const std::vector<computeDescriptorPoolRatio> &ratios      = defaultPoolRatios(),
+                    uint32_t                                       setsPerPool = DEFAULT_DESCRIPTOR_POOL_SETS);
+                void destroy();
+
+                void beginFrame(uint32_t frameIndex);
+                VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+
+                computeDescriptorAllocator &frame(uint32_t frameIndex) { return *frames[frameIndex]; }
+
+            private:
+                std::vector<std::unique_ptr<computeDescriptorAllocator>> frames;
+                uint32_t                                                 currentFrame = 0;
+        };
+
+        /**
+        * @brief Writes all descriptors of a set in one call
+        *
+        * Descriptors are staged with set*() and written by update(), through a descriptor update template when the device
+        * provides vkUpdateDescriptorSetWithTemplate, otherwise with a single batched vkUpdateDescriptorSets. The staged
+        * values persist, so updating another set only needs the bindings that differ to be set again
+        */
+        class computeDescriptorUpdater
+        {
+            public:
+                void create(
+                    VkDevice                                         logicalDevice,
+                    const std::vector<VkDescriptorSetLayoutBinding> &bindings,
+                    VkDescriptorSetLayout                            layout,
+                    bool                                             useTemplate = true);
+                void destroy();
+
+                computeDescriptorUpdater &setImage(uint32_t binding, const VkDescriptorImageInfo &imageInfo, uint32_t arrayElement = 0);
+                computeDescriptorUpdater &setBuffer(uint32_t binding, const VkDescriptorBufferInfo &bufferInfo, uint32_t arrayElement = 0);
+                computeDescriptorUpdater &setTexelBuffer(uint32_t binding, VkBufferView bufferView, uint32_t arrayElement = 0);
+
+                void update(VkDescriptorSet descriptorSet);
+
+                bool usesTemplate() const { return updateTemplate != VK_NULL_HANDLE; }
+
+            private:
+                enum class slotKind { Image, Buffer, TexelBuffer };
+
+                struct bindingSlot
+                {
+                    uint32_t         binding;
+                    VkDescriptorType type;
+                    uint32_t         count;
+                    slotKind         kind;
+                    size_t           offset;
+                    size_t           stride;
+                };
+
+                VkDevice                             logicalDevice  = VK_NULL_HANDLE;
+                std::vector<bindingSlot>             slots;
+                // 8 byte aligned storage for the staged descriptor infos, also the template's data
+                std::vector<uint64_t>                storage;
+                std::vector<VkWriteDescriptorSet>    writes;
+
+                VkDescriptorUpdateTemplate           updateTemplate = VK_NULL_HANDLE;
+                PFN_vkUpdateDescriptorSetWithTemplate  pfnUpdateDescriptorSetWithTemplate  = nullptr;
+                PFN_vkDestroyDescriptorUpdateTemplate  pfnDestroyDescriptorUpdateTemplate  = nullptr;
+
+                uint8_t *slotData(uint32_t binding, slotKind kind, uint32_t arrayElement);
+        };
+
+
+        inline void computeDescriptorLayoutCache::create(VkDevice logicalDevice)
+        {
+            this->logicalDevice = logicalDevice;
+        }
+
+
+        inline void computeDescriptorLayoutCache::destroy()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto &entry : layouts)
+            {
+                vkDestroyDescriptorSetLayout(logicalDevice, entry.second, nullptr);
+            }
+            layouts.clear();
+        }
+
+
+        inline bool computeDescriptorLayoutCache::layoutKey::operator==(const layoutKey &other) const
+        {
+            if (bindings.size() != other.bindings.size() || immutableSamplers != other.immutableSamplers)
+            {
+                return false;
+            }
+            for (size_t i = 0; i < bindings.size(); i++)
+            {
+                const VkDescriptorSetLayoutBinding &a = bindings[i];
+                const VkDescriptorSetLayoutBinding &b = other.bindings[i];
+                if (a.binding != b.binding || a.descriptorType != b.descriptorType || a.descriptorCount != b.descriptorCount ||
+                    a.stageFlags != b.stageFlags || (a.pImmutableSamplers == nullptr) != (b.pImmutableSamplers == nullptr))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+
+        inline size_t computeDescriptorLayoutCache::layoutKeyHash::operator()(const layoutKey &key) const
+        {
+            uint64_t hash = 14695981039346656037ull;
+            auto combine = [&hash](uint64_t value)
+            {
+                hash ^= value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+            };
+
+            for (const VkDescriptorSetLayoutBinding &binding : key.bindings)
+            {
+                combine(binding.binding);
+                combine(((uint64_t)binding.descriptorType << 32) | binding.descriptorCount);
+                combine(((uint64_t)binding.stageFlags << 1) | (binding.pImmutableSamplers != nullptr ? 1 : 0));
+            }
+            for (VkSampler sampler : key.immutableSamplers)
+            {
+                combine((uint64_t)(uintptr_t)sampler);
+            }
+            return static_cast<size_t>(hash);
+        }
+
+
+        /******************************************************************************************************************************
+        * Get the layout for a set of bindings, creating it on first use
+        *
+        * @param bindings Bindings of the set, in any order. Immutable samplers are part of the key by handle
+        *
+        * @return Layout owned by the cache
+        ********************************************************************************************************************************/
+        inline VkDescriptorSetLayout computeDescriptorLayoutCache::getLayout(std::vector<VkDescriptorSetLayoutBinding> bindings)
+        {
+            std::sort(bindings.begin(), bindings.end(),
+                [](const VkDescriptorSetLayoutBinding &a, const VkDescriptorSetLayoutBinding &b) { return a.binding < b.binding; });
+
+            layoutKey key;
+            key.bindings = bindings;
+            for (const VkDescriptorSetLayoutBinding &binding : bindings)
+            {
+                key.samplerOffsets.push_back(key.immutableSamplers.size());
+                if (binding.pImmutableSamplers)
+                {
+                    key.immutableSamplers.insert(key.immutableSamplers.end(), binding.pImmutableSamplers, binding.pImmutableSamplers + binding.descriptorCount);
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+
+            auto it = layouts.find(key);
+            if (it != layouts.end())
+            {
+                return it->second;
+            }
+
+            VkDescriptorSetLayoutCreateInfo descriptorLayout =
+                sourav::initializers::descriptorSetLayoutCreateInfo(bindings.data(), static_cast<uint32_t>(bindings.size()));
+            VkDescriptorSetLayout layout;
+            ST_CHECK_RESULT(vkCreateDescriptorSetLayout(logicalDevice, &descriptorLayout, nullptr, &layout));
+
+            // The key must not keep pointers into the caller's sampler arrays, moving it keeps its own array in place
+            for (size_t i = 0; i < key.bindings.size(); i++)
+            {
+                VkDescriptorSetLayoutBinding &binding = key.bindings[i];
+                binding.pImmutableSamplers = binding.pImmutableSamplers ? key.immutableSamplers.data() + key.samplerOffsets[i] : nullptr;
+            }
+            layouts.emplace(std::move(key), layout);
+            return layout;
+        }
+
+
+        inline size_t computeDescriptorLayoutCache::size()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return layouts.size();
+        }
+
+
+        /******************************************************************************************************************************
+        * Set up the allocator, no pool is created until the first allocation
+        *
+        * @param logicalDevice Device the pools are created on
+        * @param ratios Descriptors of each type reserved per set
+        * @param setsPerPool Sets in the first pool, later pools double in size up to MAX_DESCRIPTOR_POOL_SETS
+        ********************************************************************************************************************************/
+        inline void computeDescriptorAllocator::create(
+            VkDevice                                       logicalDevice,
+            const std::vector<computeDescriptorPoolRatio> &ratios,
+            uint32_t                                       setsPerPool)
+        {
+            this->logicalDevice = logicalDevice;
+            this->ratios = ratios;
+            this->setsPerPool = setsPerPool;
+        }
+
+
+        inline void computeDescriptorAllocator::destroy()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (VkDescriptorPool pool : usedPools)
+            {
+                vkDestroyDescriptorPool(logicalDevice, pool, nullptr);
+            }
+            for (VkDescriptorPool pool : freePools)
+            {
+                vkDestroyDescriptorPool(logicalDevice, pool, nullptr);
+            }
+            usedPools.clear();
+            freePools.clear();
+            currentPool = VK_NULL_HANDLE;
+        }
+
+
+        /** @brief A reset pool if there is one, otherwise a new pool larger than the previous one */
+        inline VkDescriptorPool computeDescriptorAllocator::grabPool()
+        {
+            if (!freePools.empty())
+            {
+                VkDescriptorPool pool = freePools.back();
+                freePools.pop_back();
+                return pool;
+            }
+
+            std::vector<VkDescriptorPoolSize> poolSizes;
+            for (const computeDescriptorPoolRatio &ratio : ratios)
+            {
+                VkDescriptorPoolSize poolSize;
+                poolSize.type = ratio.type;
+                poolSize.descriptorCount = std::max(1u, static_cast<uint32_t>(ratio.ratio * setsPerPool));
+                poolSizes.push_back(poolSize);
+            }
+
+            VkDescriptorPoolCreateInfo descriptorPoolInfo =
+                sourav::initializers::descriptorPoolCreateInfo(poolSizes.data(), static_cast<uint32_t>(poolSizes.size()), setsPerPool);
+            VkDescriptorPool pool;
+            ST_CHECK_RESULT(vkCreateDescriptorPool(logicalDevice, &descriptorPoolInfo, nullptr, &pool));
+
+            setsPerPool = std::min(setsPerPool * 2, (uint32_t)MAX_DESCRIPTOR_POOL_SETS);
+            return pool;
+        }
+
+
+        /** @brief Allocate a set, rolling over to another pool when the current one is exhausted */
+        inline VkDescriptorSet computeDescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (currentPool == VK_NULL_HANDLE)
+            {
+                currentPool = grabPool();
+                usedPools.push_back(currentPool);
+            }
+
+            VkDescriptorSetAllocateInfo allocInfo = sourav::initializers::descriptorSetAllocateInfo(currentPool, &layout, 1);
+            VkDescriptorSet descriptorSet;
+            VkResult result = vkAllocateDescriptorSets(logicalDevice, &allocInfo, &descriptorSet);
+
+            if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+            {
+                rollovers++;
+                currentPool = grabPool();
+                usedPools.push_back(currentPool);
+
+                allocInfo.descriptorPool = currentPool;
+                result = vkAllocateDescriptorSets(logicalDevice, &allocInfo, &descriptorSet);
+            }
+
+            // A fresh pool that cannot hold the set means the ratios do not cover the layout
+            if (result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+            {
+                throw std::runtime_error("Descriptor set layout does not fit the descriptor pool ratios");
+            }
+            ST_CHECK_RESULT(result);
+
+            setsAllocated++;
+            return descriptorSet;
+        }
+
+
+        /** @brief Reset every pool, all sets allocated so far become invalid */
+        inline void computeDescriptorAllocator::reset()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (VkDescriptorPool pool : usedPools)
+            {
+                ST_CHECK_RESULT(vkResetDescriptorPool(logicalDevice, pool, 0));
+                freePools.push_back(pool);
+            }
+            usedPools.clear();
+            currentPool = VK_NULL_HANDLE;
+        }
+
+
+        inline computeDescriptorAllocatorStats computeDescriptorAllocator::getStats()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            computeDescriptorAllocatorStats stats;
+            stats.poolCount = static_cast<uint32_t>(usedPools.size() + freePools.size());
+            stats.usedPoolCount = static_cast<uint32_t>(usedPools.size());
+            stats.setsAllocated = setsAllocated;
+            stats.rollovers = rollovers;
+            return stats;
+        }
+
+
+        inline void computeFrameDescriptorAllocator::create(
+            VkDevice                                       logicalDevice,
+            uint32_t                                       framesInFlight,
+            const std::vector<computeDescriptorPoolRatio> &ratios,
+            uint32_t                                       setsPerPool)
+        {
+            for (uint32_t i = 0; i < framesInFlight; i++)
+            {
+                frames.emplace_back(new computeDescriptorAllocator());
+                frames.back()->create(logicalDevice, ratios, setsPerPool);
+            }
+            currentFrame = 0;
+        }
+
+
+        inline void computeFrameDescriptorAllocator::destroy()
+        {
+            for (auto &frame : frames)
+            {
+                frame->destroy();
+            }
+            frames.clear();
+        }
+
+
+        /** @brief Switch to frameIndex and reset its pools */
+        inline void computeFrameDescriptorAllocator::beginFrame(uint32_t frameIndex)
+        {
+            assert(frameIndex < frames.size());
+            currentFrame = frameIndex;
+            frames[currentFrame]->reset();
+        }
+
+
+        inline VkDescriptorSet computeFrameDescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+        {
+            return frames[currentFrame]->allocate(layout);
+        }
+
+
+        /******************************************************************************************************************************
+        * Set up the updater for sets of one layout
+        *
+        * @param logicalDevice Device the sets belong to
+        * @param bindings Bindings the layout was created with
+        * @param layout Layout of the sets that are updated
+        * @param useTemplate Create a descriptor update template if the device has the entry points (Vulkan 1.1 or
+        *        VK_KHR_descriptor_update_template), batched writes are used otherwise
+        ********************************************************************************************************************************/
+        inline void computeDescriptorUpdater::create(
+            VkDevice                                         logicalDevice,
+            const std::vector<VkDescriptorSetLayoutBinding> &bindings,
+            VkDescriptorSetLayout                            layout,
+            bool                                             useTemplate)
+        {
+            this->logicalDevice = logicalDevice;
+
+            size_t offset = 0;
+            for (const VkDescriptorSetLayoutBinding &binding : bindings)
+            {
+                bindingSlot slot;
+                slot.binding = binding.binding;
+                slot.type = binding.descriptorType;
+                slot.count = binding.descriptorCount;
+
+                switch (binding.descriptorType)
+                {
+                    case VK_DESCRIPTOR_TYPE_SAMPLER:
+                    case VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER:
+                    case VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE:
+                    case VK_DESCRIPTOR_TYPE_STORAGE_IMAGE:
+                    case VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT:
+                        slot.kind = slotKind::Image;
+                        slot.stride = sizeof(VkDescriptorImageInfo);
+                        break;
+                    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER:
+                    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER:
+                    case VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC:
+                    case VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC:
+                        slot.kind = slotKind::Buffer;
+                        slot.stride = sizeof(VkDescriptorBufferInfo);
+                        break;
+                    case VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER:
+                    case VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER:
+                        slot.kind = slotKind::TexelBuffer;
+                        slot.stride = sizeof(VkBufferView);
+                        break;
+                    default:
+                        throw std::runtime_error("Descriptor type is not supported by computeDescriptorUpdater");
+                }
+
+                slot.offset = offset;
+                offset += (slot.stride * slot.count + 7) & ~(size_t)7;
+                slots.push_back(slot);
+            }
+            storage.assign(offset / sizeof(uint64_t), 0);
+
+            // Writes for the fallback path, only dstSet changes between updates
+            for (const bindingSlot &slot : slots)
+            {
+                VkWriteDescriptorSet write = {};
+                write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                write.dstBinding = slot.binding;
+                write.descriptorCount = slot.count;
+                write.descriptorType = slot.type;
+                uint8_t *data = reinterpret_cast<uint8_t *>(storage.data()) + slot.offset;
+                switch (slot.kind)
+                {
+                    case slotKind::Image:       write.pImageInfo = reinterpret_cast<VkDescriptorImageInfo *>(data); break;
+                    case slotKind::Buffer:      write.pBufferInfo = reinterpret_cast<VkDescriptorBufferInfo *>(data); break;
+                    case slotKind::TexelBuffer: write.pTexelBufferView = reinterpret_cast<VkBufferView *>(data); break;
+                }
+                writes.push_back(write);
+            }
+
+            if (!useTemplate || slots.empty())
+            {
+                return;
+            }
+
+            PFN_vkCreateDescriptorUpdateTemplate pfnCreateDescriptorUpdateTemplate =
+                reinterpret_cast<PFN_vkCreateDescriptorUpdateTemplate>(vkGetDeviceProcAddr(logicalDevice, "vkCreateDescriptorUpdateTemplate"));
+            pfnUpdateDescriptorSetWithTemplate =
+                reinterpret_cast<PFN_vkUpdateDescriptorSetWithTemplate>(vkGetDeviceProcAddr(logicalDevice, "vkUpdateDescriptorSetWithTemplate"));
+            pfnDestroyDescriptorUpdateTemplate =
+                reinterpret_cast<PFN_vkDestroyDescriptorUpdateTemplate>(vkGetDeviceProcAddr(logicalDevice, "vkDestroyDescriptorUpdateTemplate"));
+            if (!pfnCreateDescriptorUpdateTemplate)
+            {
+                pfnCreateDescriptorUpdateTemplate =
+                    reinterpret_cast<PFN_vkCreateDescriptorUpdateTemplate>(vkGetDeviceProcAddr(logicalDevice, "vkCreateDescriptorUpdateTemplateKHR"));
+                pfnUpdateDescriptorSetWithTemplate =
+                    reinterpret_cast<PFN_vkUpdateDescriptorSetWithTemplate>(vkGetDeviceProcAddr(logicalDevice, "vkUpdateDescriptorSetWithTemplateKHR"));
+                pfnDestroyDescriptorUpdateTemplate =
+                    reinterpret_cast<PFN_vkDestroyDescriptorUpdateTemplate>(vkGetDeviceProcAddr(logicalDevice, "vkDestroyDescriptorUpdateTemplateKHR"));
+            }
+            if (!pfnCreateDescriptorUpdateTemplate || !pfnUpdateDescriptorSetWithTemplate || !pfnDestroyDescriptorUpdateTemplate)
+            {
+                return;
+            }
+
+            std::vector<VkDescriptorUpdateTemplateEntry> entries;
+            for (const bindingSlot &slot : slots)
+            {
+                VkDescriptorUpdateTemplateEntry entry = {};
+                entry.dstBinding = slot.binding;
+                entry.dstArrayElement = 0;
+                entry.descriptorCount = slot.count;
+                entry.descriptorType = slot.type;
+                entry.offset = slot.offset;
+                entry.stride = slot.stride;
+                entries.push_back(entry);
+            }
+
+            VkDescriptorUpdateTemplateCreateInfo templateCreateInfo = {};
+            templateCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO;
+            templateCreateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+            templateCreateInfo.pDescriptorUpdateEntries = entries.data();
+            templateCreateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+            templateCreateInfo.descriptorSetLayout = layout;
+            if (pfnCreateDescriptorUpdateTemplate(logicalDevice, &templateCreateInfo, nullptr, &updateTemplate) != VK_SUCCESS)
+            {
+                updateTemplate = VK_NULL_HANDLE;
+            }
+        }
+
+
+        inline void computeDescriptorUpdater::destroy()
+        {
+            if (updateTemplate != VK_NULL_HANDLE)
+            {
+                pfnDestroyDescriptorUpdateTemplate(logicalDevice, updateTemplate, nullptr);
+                updateTemplate = VK_NULL_HANDLE;
+            }
+            slots.clear();
+            storage.clear();
+            writes.clear();
+        }
+
+
+        inline uint8_t *computeDescriptorUpdater::slotData(uint32_t binding, slotKind kind, uint32_t arrayElement)
+        {
+            for (const bindingSlot &slot : slots)
+            {
+                if (slot.binding == binding)
+                {
+                    if (slot.kind != kind || arrayElement >= slot.count)
+                    {
+                        throw std::runtime_error("Descriptor does not match the binding it is written to");
+                    }
+                    return reinterpret_cast<uint8_t *>(storage.data()) + slot.offset + slot.stride * arrayElement;
+                }
+            }
+            throw std::runtime_error("Binding is not part of the descriptor set layout");
+        }
+
+
+        inline computeDescriptorUpdater &computeDescriptorUpdater::setImage(uint32_t binding, const VkDescriptorImageInfo &imageInfo, uint32_t arrayElement)
+        {
+            memcpy(slotData(binding, slotKind::Image, arrayElement), &imageInfo, sizeof(imageInfo));
+            return *this;
+        }
+
+
+        inline computeDescriptorUpdater &computeDescriptorUpdater::setBuffer(uint32_t binding, const VkDescriptorBufferInfo &bufferInfo, uint32_t arrayElement)
+        {
+            memcpy(slotData(binding, slotKind::Buffer, arrayElement), &bufferInfo, sizeof(bufferInfo));
+            return *this;
+        }
+
+
+        inline computeDescriptorUpdater &computeDescriptorUpdater::setTexelBuffer(uint32_t binding, VkBufferView bufferView, uint32_t arrayElement)
+        {
+            memcpy(slotData(binding, slotKind::TexelBuffer, arrayElement), &bufferView, sizeof(bufferView));
+            return *this;
+        }
+
+
+        /** @brief Write every staged descriptor to descriptorSet in a single call */
+        inline void computeDescriptorUpdater::update(VkDescriptorSet descriptorSet)
+        {
+            if (updateTemplate != VK_NULL_HANDLE)
+            {
+                pfnUpdateDescriptorSetWithTemplate(logicalDevice, descriptorSet, updateTemplate, storage.data());
+                return;
+            }
+
+            for (VkWriteDescriptorSet &write : writes)
+            {
+                write.dstSet = descriptorSet;
+            }
+            vkUpdateDescriptorSets(logicalDevice, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+        }
+    }
+}
@@ -0,0 +1,405 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "computeCommandPool.hpp"
+#include "computeDeviceUtils.hpp"
+#include "computeMemoryAllocator.hpp"
+#include "computeProfiler.hpp"
+#include "computeReadbackPool.hpp"
+#include "computeSamplerCache.hpp"
+#include "computeStagingRing.hpp"
+
+namespace sourav
+{
+    namespace Device
+    {
+        /** @brief Handles destroyed together once the last submission using them has completed, null members are skipped */
+        struct computeDeferredResources
+        {
+            VkImage                           image   = VK_NULL_HANDLE;
+            VkImageView                       view    = VK_NULL_HANDLE;
+            VkSampler                         sampler = VK_NULL_HANDLE;
+            VkBuffer                          buffer  = VK_NULL_HANDLE;
+            sourav::Memory::computeAllocation allocation;
+        };
+
+        /**
+        * @brief Per-device context that owns the subsystems every resource is created through
+        *
+        * Submissions are numbered with beginSubmission(). Resources tied to a submission (staging regions, readback
+        * buffers, transient staging buffers, resources queued with deferDestruction, ...) are recycled once
+        * completedSubmission() has passed its value
+        */
+        class computeDevice
+        {
+            public:
+                VkPhysicalDevice                          physicalDevice = VK_NULL_HANDLE;
+                VkDevice                                  logicalDevice  = VK_NULL_HANDLE;
+                sourav::Memory::computeMemoryAllocator    allocator;
+                sourav::Memory::computeStagingRing        stagingRing;
+                /** @brief Host cached buffers GPU results are copied into, see sourav::Transfer::computeReadback */
+                sourav::Memory::computeReadbackPool       readbackPool;
+                /** @brief Per-thread command buffers and fences for queueFamilyIndex */
+                sourav::Command::computeCommandPool       commandPool;
+                /** @brief Shared samplers of every texture created through the context */
+                sourav::Texture::computeSamplerCache      samplerCache;
+                uint32_t                                  queueFamilyIndex = 0;
+
+                /** @brief VK_EXT_host_image_copy entry points, null until enableHostImageCopy() succeeds */
+                PFN_vkCopyMemoryToImageEXT                copyMemoryToImage     = nullptr;
+                PFN_vkTransitionImageLayoutEXT            transitionImageLayout = nullptr;
+                /** @brief Layouts vkCopyMemoryToImageEXT can write images in */
+                std::vector<VkImageLayout>                hostImageCopyDstLayouts;
+
+                /** @brief Optional, not owned. Uploads record profiler scopes into it and completed submissions are collected */
+                sourav::Profiler::computeProfiler        *profiler = nullptr;
+
+                void create(
+                    VkPhysicalDevice physicalDevice,
+                    VkDevice         logicalDevice,
+                    uint32_t         queueFamilyIndex,
+                    VkDeviceSize     stagingRingSize = DEFAULT_STAGING_RING_SIZE);
+                void destroy();
+
+                uint64_t beginSubmission();
+                void completeSubmission(uint64_t submissionValue);
+                uint64_t completedSubmission();
+                bool isSubmissionComplete(uint64_t submissionValue);
+
+                sourav::Memory::computeStagingRegion acquireStaging(VkDeviceSize size, uint64_t submissionValue);
+
+                void deferDestruction(const computeDeferredResources &resources, uint64_t submissionValue);
+                size_t pendingDestructionCount();
+
+                bool enableHostImageCopy();
+                bool supportsHostImageCopy(VkImageLayout layout) const;
+                bool hasHostVisibleDeviceMemory() const;
+
+            private:
+                std::mutex         submissionMutex;
+                uint64_t           lastSubmission = 0;
+                // Highest value for which every submission up to and including it has completed
+                uint64_t           completedWatermark = 0;
+                std::set<uint64_t> completedOutOfOrder;
+                uint32_t           completedWaiter = 0;
+
+                struct transientStaging
+                {
+                    uint64_t                          submissionValue;
+                    VkBuffer                          buffer;
+                    sourav::Memory::computeAllocation allocation;
+                };
+
+                std::mutex                    transientMutex;
+                std::vector<transientStaging> transientStagingBuffers;
+
+                void releaseTransientStaging(uint64_t completedValue);
+
+                std::mutex                                                  deferredMutex;
+                std::vector<std::pair<uint64_t, computeDeferredResources>> deferredResources;
+
+                void releaseDeferred(uint64_t completedValue);
+                void destroyResources(computeDeferredResources resources);
+        };
+
+        /******************************************************************************************************************************
+        * Set up the context for a device
+        *
+        * @param physicalDevice Physical device logicalDevice was created from
+        * @param logicalDevice Device the resources are created on
+        * @param queueFamilyIndex Family of the queue uploads are submitted to, the pooled command buffers are allocated for it
+        * @param stagingRingSize Capacity of the persistently mapped staging ring
+        ********************************************************************************************************************************/
+        inline void computeDevice::create(
+            VkPhysicalDevice physicalDevice,
+            VkDevice         logicalDevice,
+            uint32_t         queueFamilyIndex,
+            VkDeviceSize     stagingRingSize)
+        {
+            this->physicalDevice = physicalDevice;
+            this->logicalDevice = logicalDevice;
+            this->queueFamilyIndex = queueFamilyIndex;
+
+            allocator.create(physicalDevice, logicalDevice);
+            stagingRing.create(allocator, stagingRingSize);
+            // Claims submissions that already completed out of order, their submitter has forgotten them by now
+            completedWaiter = stagingRing.addSubmissionWaiter([this](uint64_t submissionValue)
+            {
+                return isSubmissionComplete(submissionValue);
+            });
+            readbackPool.create(allocator);
+            commandPool.create(logicalDevice, queueFamilyIndex);
+            samplerCache.create(physicalDevice, logicalDevice);
+        }
+
+        /**
+        * @brief Release everything owned by the context, all resources created through it must be destroyed first
+        *
+        * Resources still waiting in the deferred destruction queue are destroyed, the device must be idle
+        */
+        inline void computeDevice::destroy()
+        {
+            releaseDeferred(UINT64_MAX);
+            releaseTransientStaging(UINT64_MAX);
+            samplerCache.destroy();
+            commandPool.destroy();
+            readbackPool.destroy(allocator);
+            stagingRing.removeSubmissionWaiter(completedWaiter);
+            stagingRing.destroy(allocator);
+            allocator.destroy();
+        }
+
+        /** @brief Reserve the value for a new submission */
+        inline uint64_t computeDevice::beginSubmission()
+        {
+            std::lock_guard<std::mutex> lock(submissionMutex);
+            return ++lastSubmission;
+        }
+
+        /**
+        * @brief Mark a submission as finished on the GPU and recycle what it was holding
+        *
+        * Submissions may complete out of order across threads, the watermark only advances over gap-free ranges
+        */
+        inline void computeDevice::completeSubmission(uint64_t submissionValue)
+        {
+            uint64_t watermark;
+            {
+                std::lock_guard<std::mutex> lock(submissionMutex);
+
+                completedOutOfOrder.insert(submissionValue);
+                while (!completedOutOfOrder.empty() && *completedOutOfOrder.begin() == completedWatermark + 1)
+                {
+                    completedWatermark++;
+                    completedOutOfOrder.erase(completedOutOfOrder.begin());
+                }
+                watermark = completedWatermark;
+            }
+
+            stagingRing.retire(watermark);
+            readbackPool.retire(watermark);
+            releaseTransientStaging(watermark);
+            releaseDeferred(watermark);
+            if (profiler)
+            {
+                profiler->collect(watermark);
+            }
+        }
+
+        inline uint64_t computeDevice::completedSubmission()
+        {
+            std::lock_guard<std::mutex> lock(submissionMutex);
+            return completedWatermark;
+        }
+
+        /** @brief True once submissionValue itself has completed, even while older submissions are still open */
+        inline bool computeDevice::isSubmissionComplete(uint64_t submissionValue)
+        {
+            std::lock_guard<std::mutex> lock(submissionMutex);
+            return submissionValue <= completedWatermark || completedOutOfOrder.count(submissionValue) > 0;
+        }
+
+        /******************************************************************************************************************************
+        * Get host visible staging memory for one submission
+        *
+        * Comes from the staging ring when it fits, otherwise from a transient buffer. Either way it is recycled
+        * automatically once the submission has completed
+        *
+        * @param size Size of the staging region in bytes
+        * @param submissionValue Submission that reads from the region (from beginSubmission)
+        ********************************************************************************************************************************/
+        inline sourav::Memory::computeStagingRegion computeDevice::acquireStaging(VkDeviceSize size, uint64_t submissionValue)
+        {
+            sourav::Memory::computeStagingRegion staging;
+            if (stagingRing.allocate(size, STAGING_REGION_ALIGNMENT, submissionValue, &staging))
+            {
+                return staging;
+            }
+
+            transientStaging transient;
+            transient.submissionValue = submissionValue;
+
+            VkBufferCreateInfo bufferCreateInfo = sourav::initializers::bufferCreateInfo();
+            bufferCreateInfo.size = size;
+            bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+            bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            ST_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &transient.buffer));
+
+            transient.allocation = allocator.allocateBuffer(transient.buffer, sourav::Memory::computeMemoryUsage::upload());
+
+            staging.buffer = transient.buffer;
+            staging.offset = 0;
+            staging.size = size;
+            staging.mapped = transient.allocation.mapped;
+
+            std::lock_guard<std::mutex> lock(transientMutex);
+            transientStagingBuffers.push_back(transient);
+            return staging;
+        }
+
+        /******************************************************************************************************************************
+        * Use VK_EXT_host_image_copy for direct texture uploads
+        *
+        * The extension and its hostImageCopy feature must have been enabled when logicalDevice was created, the device
+        * cannot be asked whether the feature is on
+        *
+        * @return False if the device does not expose the extension's entry points
+        ********************************************************************************************************************************/
+        inline bool computeDevice::enableHostImageCopy()
+        {
+            copyMemoryToImage = reinterpret_cast<PFN_vkCopyMemoryToImageEXT>(vkGetDeviceProcAddr(logicalDevice, "vkCopyMemoryToImageEXT"));
+            transitionImageLayout = reinterpret_cast<PFN_vkTransitionImageLayoutEXT>(vkGetDeviceProcAddr(logicalDevice, "vkTransitionImageLayoutEXT"));
+            if (!copyMemoryToImage || !transitionImageLayout)
+            {
+                copyMemoryToImage = nullptr;
+                transitionImageLayout = nullptr;
+                return false;
+            }
+
+            VkPhysicalDeviceHostImageCopyPropertiesEXT hostImageCopyProperties = {};
+            hostImageCopyProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_HOST_IMAGE_COPY_PROPERTIES_EXT;
+            VkPhysicalDeviceProperties2 properties = {};
+            properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+            properties.pNext = &hostImageCopyProperties;
+            vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+            hostImageCopyDstLayouts.resize(hostImageCopyProperties.copyDstLayoutCount);
+            hostImageCopyProperties.pCopyDstLayouts = hostImageCopyDstLayouts.data();
+            hostImageCopyProperties.copySrcLayoutCount = 0;
+            vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+            hostImageCopyDstLayouts.resize(hostImageCopyProperties.copyDstLayoutCount);
+            return true;
+        }
+
+        /** @brief True if host image copies are enabled and can write images in layout */
+        inline bool computeDevice::supportsHostImageCopy(VkImageLayout layout) const
+        {
+            return copyMemoryToImage != nullptr &&
+                std::find(hostImageCopyDstLayouts.begin(), hostImageCopyDstLayouts.end(), layout) != hostImageCopyDstLayouts.end();
+        }
+
+        /** @brief True if a memory type is both device local and host visible (integrated GPUs, resizable BAR) */
+        inline bool computeDevice::hasHostVisibleDeviceMemory() const
+        {
+            VkBool32 found = VK_FALSE;
+            allocator.findMemoryType(~0u, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &found);
+            return found == VK_TRUE;
+        }
+
+        /******************************************************************************************************************************
+        * Destroy resources once the GPU is done with them
+        *
+        * Queued resources are destroyed in one batch per completeSubmission() that passes their value. If the submission
+        * has already completed they are destroyed right away. Does not throw, so destructors and moves can call it
+        *
+        * @param resources Handles and memory to destroy, null members are skipped
+        * @param submissionValue Last submission that uses the resources, 0 if none is pending
+        ********************************************************************************************************************************/
+        inline void computeDevice::deferDestruction(const computeDeferredResources &resources, uint64_t submissionValue)
+        {
+            {
+                // Checked under the same lock as the push, completeSubmission() advances the watermark before it takes
+                // deferredMutex so it either sees the entry or the check here sees its watermark
+                std::lock_guard<std::mutex> lock(deferredMutex);
+                if (submissionValue > completedSubmission())
+                {
+                    try
+                    {
+                        deferredResources.emplace_back(submissionValue, resources);
+                    }
+                    catch (...)
+                    {
+                        // Out of memory, the GPU may still use the resources so leaking them is the only safe choice
+                    }
+                    return;
+                }
+            }
+
+            // Outside the lock, freeing takes the allocator's locks
+            try
+            {
+                destroyResources(resources);
+            }
+            catch (...)
+            {
+                // The allocator ran out of memory for its free lists, whatever was not freed yet leaks
+            }
+        }
+
+        /** @brief Number of resource sets waiting for their submission to complete */
+        inline size_t computeDevice::pendingDestructionCount()
+        {
+            std::lock_guard<std::mutex> lock(deferredMutex);
+            return deferredResources.size();
+        }
+
+        inline void computeDevice::releaseDeferred(uint64_t completedValue)
+        {
+            std::vector<computeDeferredResources> retired;
+            {
+                std::lock_guard<std::mutex> lock(deferredMutex);
+
+                auto first = std::partition(deferredResources.begin(), deferredResources.end(),
+                    [completedValue](const std::pair<uint64_t, computeDeferredResources> &d) { return d.first > completedValue; });
+                for (auto it = first; it != deferredResources.end(); ++it)
+                {
+                    retired.push_back(it->second);
+                }
+                deferredResources.erase(first, deferredResources.end());
+            }
+
+            // Outside the lock, freeing takes the allocator's locks
+            for (const computeDeferredResources &resources : retired)
+            {
+                destroyResources(resources);
+            }
+        }
+
+        inline void computeDevice::destroyResources(computeDeferredResources resources)
+        {
+            // Cached samplers are shared, only the last reference destroys them
+            if (resources.sampler != VK_NULL_HANDLE && !samplerCache.release(resources.sampler))
+            {
+                vkDestroySampler(logicalDevice, resources.sampler, nullptr);
+            }
+            if (resources.view != VK_NULL_HANDLE)
+            {
+                vkDestroyImageView(logicalDevice, resources.view, nullptr);
+            }
+            if (resources.image != VK_NULL_HANDLE)
+            {
+                vkDestroyImage(logicalDevice, resources.image, nullptr);
+            }
+            if (resources.buffer != VK_NULL_HANDLE)
+            {
+                vkDestroyBuffer(logicalDevice, resources.buffer, nullptr);
+            }
+            if (resources.allocation.memory != VK_NULL_HANDLE)
+            {
+                allocator.free(resources.allocation);
+            }
+        }
+
+        inline void computeDevice::releaseTransientStaging(uint64_t completedValue)
+        {
+            std::lock_guard<std::mutex> lock(transientMutex);
+
+            auto retired = std::partition(transientStagingBuffers.begin(), transientStagingBuffers.end(),
+                [completedValue](const transientStaging &t) { return t.submissionValue > completedValue; });
+            for (auto it = retired; it != transientStagingBuffers.end(); ++it)
+            {
+                vkDestroyBuffer(logicalDevice, it->buffer, nullptr);
+                allocator.free(it->allocation);
+            }
+            transientStagingBuffers.erase(retired, transientStagingBuffers.end());
+        }
+    }
+}
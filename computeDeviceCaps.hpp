@@ -0,0 +1,141 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace sourav
+{
+    namespace Device
+    {
+        /**
+        * @brief Everything about a physical device that does not change while the instance lives
+        *
+        * Queried once per VkPhysicalDevice by getDeviceCaps(), so hot paths (memory type selection, format checks) never
+        * go back to the driver. Format properties are filled in lazily the first time a format is asked for
+        */
+        class computeDeviceCaps
+        {
+            public:
+                VkPhysicalDevice                     physicalDevice = VK_NULL_HANDLE;
+                VkPhysicalDeviceProperties           properties = {};
+                VkPhysicalDeviceMemoryProperties     memoryProperties = {};
+                std::vector<VkQueueFamilyProperties> queueFamilies;
+                std::vector<VkExtensionProperties>   extensions;
+
+                /** @brief True if the device exposes VK_EXT_memory_budget, it still has to be enabled on the logical device */
+                bool                                 memoryBudget = false;
+
+                void query(VkPhysicalDevice physicalDevice);
+                bool supportsExtension(const char *extensionName) const;
+                VkFormatProperties formatProperties(VkFormat format) const;
+
+            private:
+                mutable std::mutex                                     formatMutex;
+                mutable std::unordered_map<int32_t, VkFormatProperties> formats;
+        };
+
+
+        inline void computeDeviceCaps::query(VkPhysicalDevice physicalDevice)
+        {
+            this->physicalDevice = physicalDevice;
+            vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+            vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+            uint32_t queueFamilyCount = 0;
+            vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+            queueFamilies.resize(queueFamilyCount);
+            vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+            // A failed enumeration only means no optional extension gets used
+            uint32_t extensionCount = 0;
+            if (vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr) == VK_SUCCESS)
+            {
+                extensions.resize(extensionCount);
+                if (vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data()) != VK_SUCCESS)
+                {
+                    extensionCount = 0;
+                }
+                extensions.resize(extensionCount);
+            }
+
+            memoryBudget = supportsExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        }
+
+
+        inline bool computeDeviceCaps::supportsExtension(const char *extensionName) const
+        {
+            for (const VkExtensionProperties &extension : extensions)
+            {
+                if (strcmp(extension.extensionName, extensionName) == 0)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+
+        inline VkFormatProperties computeDeviceCaps::formatProperties(VkFormat format) const
+        {
+            std::lock_guard<std::mutex> lock(formatMutex);
+
+            auto it = formats.find(static_cast<int32_t>(format));
+            if (it != formats.end())
+            {
+                return it->second;
+            }
+
+            VkFormatProperties result;
+            vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &result);
+            formats.emplace(static_cast<int32_t>(format), result);
+            return result;
+        }
+
+
+        /** @brief Caps of every physical device seen so far, entries are never moved so references stay valid */
+        struct computeDeviceCapsRegistry
+        {
+            std::mutex                                                              mutex;
+            std::unordered_map<VkPhysicalDevice, std::unique_ptr<computeDeviceCaps>> devices;
+        };
+
+        inline computeDeviceCapsRegistry &deviceCapsRegistry()
+        {
+            static computeDeviceCapsRegistry registry;
+            return registry;
+        }
+
+        /** @brief Caps of physicalDevice, queried on the first call and cached from then on */
+        inline const computeDeviceCaps &getDeviceCaps(VkPhysicalDevice physicalDevice)
+        {
+            computeDeviceCapsRegistry &registry = deviceCapsRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+
+            std::unique_ptr<computeDeviceCaps> &caps = registry.devices[physicalDevice];
+            if (!caps)
+            {
+                caps.reset(new computeDeviceCaps());
+                caps->query(physicalDevice);
+            }
+            return *caps;
+        }
+
+        /**
+        * @brief Drop every cached entry
+        *
+        * Call when the instance is destroyed, a new instance may hand out the same VkPhysicalDevice values. References
+        * returned by getDeviceCaps() become invalid
+        */
+        inline void clearDeviceCaps()
+        {
+            computeDeviceCapsRegistry &registry = deviceCapsRegistry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.devices.clear();
+        }
+    }
+}
@@ -1,6 +1,15 @@
+#pragma once
+
 #include <vulkan/vulkan.h>
 
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "computeDeviceCaps.hpp"
 #include "computeInitializers.hpp"
+#include "computeMemoryPolicy.hpp"
 
 namespace sourav
 {
@@ -56,53 +65,27 @@ namespace sourav
 
 
         /******************************************************************************************************************************
-        * Get the index of a memory type that has all the requested property bits set
+        * Get the index of the memory type that fits usage best, from the cached caps of physicalDevice
         *
         * @param typeBits Bit mask with bits set for each memory type supported by the resource to request for (from VkMemoryRequirements)
-        * @param properties Bit mask of properties for the memory type to request
+        * @param usage Required, preferred and avoided property flags, plain property flags are all required
         * @param (Optional) memTypeFound Pointer to a bool that is set to true if a matching memory type has been found
         * 
         * @return Index of the requested memory type
         *
         * @throw Throws an exception if memTypeFound is null and no memory type could be found that supports the requested properties
         ********************************************************************************************************************************/
-        uint32_t getMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeBits, VkMemoryPropertyFlags properties, VkBool32 *memTypeFound)
+        uint32_t getMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeBits, const sourav::Memory::computeMemoryUsage &usage, VkBool32 *memTypeFound)
         {
-            /** @brief Memory types and heaps of the physical device */
-            VkPhysicalDeviceMemoryProperties memoryProperties;
-            vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
-
-            for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
-            {
-                if ((typeBits & 1) == 1)
-                {
-                    if ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
-                    {
-                        if (memTypeFound)
-                        {
-                            *memTypeFound = true;
-                        }
-                        return i;
-                    }
-                }
-                typeBits >>= 1;
-            }
-
-            if (memTypeFound)
-            {
-                *memTypeFound = false;
-                return 0;
-            }
-            else
-            {
-                throw std::runtime_error("Could not find a matching memory type");
-            }
+            const sourav::Device::computeDeviceCaps &caps = sourav::Device::getDeviceCaps(physicalDevice);
+            return sourav::Memory::selectMemoryType(caps.memoryProperties, typeBits, usage, 0, nullptr, memTypeFound);
         }
 
         
         // Create an image memory barrier for changing the layout of
 		// an image and put it into an active command buffer
 		// See chapter 11.4 "Image Layout" for details
+		// Records one barrier per call, sourav::Sync::computeResourceTracker batches transitions with narrow masks
 
 		void setImageLayout(
 			VkCommandBuffer cmdbuffer,
@@ -168,8 +151,27 @@ namespace sourav
 				// Make sure any shader reads from the image have been finished
 				imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
 				break;
+
+			case VK_IMAGE_LAYOUT_GENERAL:
+				// Image is a storage image
+				// Make sure any shader writes to the image have been finished
+				imageMemoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+				break;
+
+			case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+				// Image is a read only depth/stencil attachment or is sampled
+				// Reads only need the execution dependency
+				imageMemoryBarrier.srcAccessMask = 0;
+				break;
+
+			case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+				// Image was presented, the acquire semaphore orders the presentation engine's reads
+				imageMemoryBarrier.srcAccessMask = 0;
+				break;
+
 			default:
-				// Other source layouts aren't handled (yet)
+				// Unknown layout, make every write available
+				imageMemoryBarrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
 				break;
 			}
 
@@ -210,8 +212,26 @@ namespace sourav
 				}
 				imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 				break;
+
+			case VK_IMAGE_LAYOUT_GENERAL:
+				// Image will be used as a storage image
+				// Make sure any writes to the image have been finished before it is read or written
+				imageMemoryBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+				break;
+
+			case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+				// Image will be a read only depth/stencil attachment or sampled
+				imageMemoryBarrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+				break;
+
+			case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+				// Image will be presented, visibility is handled by the present semaphore
+				imageMemoryBarrier.dstAccessMask = 0;
+				break;
+
 			default:
-				// Other source layouts aren't handled (yet)
+				// Unknown layout, make the image visible to every access
+				imageMemoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
 				break;
 			}
 
@@ -254,5 +274,163 @@ namespace sourav
             vkFreeCommandBuffers(logicalDevice, pool, 1, &commandBuffer);
         }
 
+
+        /******************************************************************************************************************************
+        * Get the index of a queue family that supports the requested queue flags
+        *
+        * Dedicated families are preferred: a compute request first looks for a family without graphics, a transfer
+        * request first looks for a family without graphics and compute. Those run beside the graphics queue
+        *
+        * @param queueFlags Queue flags to find a queue family index for
+        *
+        * @return Index of the queue family
+        *
+        * @throw Throws an exception if no queue family supports queueFlags
+        ********************************************************************************************************************************/
+        inline uint32_t getQueueFamilyIndex(VkPhysicalDevice physicalDevice, VkQueueFlags queueFlags)
+        {
+            const std::vector<VkQueueFamilyProperties> &queueFamilyProperties = sourav::Device::getDeviceCaps(physicalDevice).queueFamilies;
+            const uint32_t queueFamilyCount = static_cast<uint32_t>(queueFamilyProperties.size());
+
+            // Dedicated compute queue
+            if (queueFlags & VK_QUEUE_COMPUTE_BIT)
+            {
+                for (uint32_t i = 0; i < queueFamilyCount; i++)
+                {
+                    if ((queueFamilyProperties[i].queueFlags & queueFlags) == queueFlags &&
+                        !(queueFamilyProperties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+                    {
+                        return i;
+                    }
+                }
+            }
+
+            // Dedicated transfer queue
+            if (queueFlags & VK_QUEUE_TRANSFER_BIT)
+            {
+                for (uint32_t i = 0; i < queueFamilyCount; i++)
+                {
+                    if ((queueFamilyProperties[i].queueFlags & queueFlags) == queueFlags &&
+                        !(queueFamilyProperties[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+                    {
+                        return i;
+                    }
+                }
+            }
+
+            // Any family that supports the requested flags
+            for (uint32_t i = 0; i < queueFamilyCount; i++)
+            {
+                if ((queueFamilyProperties[i].queueFlags & queueFlags) == queueFlags)
+                {
+                    return i;
+                }
+            }
+
+            throw std::runtime_error("Could not find a matching queue family index");
+        }
+
+
+        /******************************************************************************************************************************
+        * Record the release half of an image queue family ownership transfer, on a queue of srcQueueFamilyIndex
+        *
+        * The layout transition in the barrier happens once, the matching acquireImageOwnership must use the same layouts
+        *
+        * @param srcStageMask Stages that access the image before the release
+        * @param srcAccessMask Accesses that have to be made available before the release
+        ********************************************************************************************************************************/
+        inline void releaseImageOwnership(
+            VkCommandBuffer         cmdbuffer,
+            VkImage                 image,
+            VkImageLayout           oldImageLayout,
+            VkImageLayout           newImageLayout,
+            VkImageSubresourceRange subresourceRange,
+            uint32_t                srcQueueFamilyIndex,
+            uint32_t                dstQueueFamilyIndex,
+            VkPipelineStageFlags    srcStageMask,
+            VkAccessFlags           srcAccessMask)
+        {
+            VkImageMemoryBarrier imageMemoryBarrier = sourav::initializers::imageMemoryBarrier(srcQueueFamilyIndex, dstQueueFamilyIndex);
+            imageMemoryBarrier.oldLayout = oldImageLayout;
+            imageMemoryBarrier.newLayout = newImageLayout;
+            imageMemoryBarrier.image = image;
+            imageMemoryBarrier.subresourceRange = subresourceRange;
+            imageMemoryBarrier.srcAccessMask = srcAccessMask;
+            // Destination access is ignored for a release
+            imageMemoryBarrier.dstAccessMask = 0;
+
+            vkCmdPipelineBarrier(
+                cmdbuffer,
+                srcStageMask,
+                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                0,
+                0, nullptr,
+                0, nullptr,
+                1, &imageMemoryBarrier);
+        }
+
+
+        /******************************************************************************************************************************
+        * Record the acquire half of an image queue family ownership transfer, on a queue of dstQueueFamilyIndex
+        *
+        * The submission must wait (e.g. on a semaphore) for the one containing the release
+        *
+        * @param dstStageMask Stages that access the image after the acquire
+        * @param dstAccessMask Accesses that are made visible by the acquire
+        ********************************************************************************************************************************/
+        inline void acquireImageOwnership(
+            VkCommandBuffer         cmdbuffer,
+            VkImage                 image,
+            VkImageLayout           oldImageLayout,
+            VkImageLayout           newImageLayout,
+            VkImageSubresourceRange subresourceRange,
+            uint32_t                srcQueueFamilyIndex,
+            uint32_t                dstQueueFamilyIndex,
+            VkPipelineStageFlags    dstStageMask,
+            VkAccessFlags           dstAccessMask)
+        {
+            VkImageMemoryBarrier imageMemoryBarrier = sourav::initializers::imageMemoryBarrier(srcQueueFamilyIndex, dstQueueFamilyIndex);
+            imageMemoryBarrier.oldLayout = oldImageLayout;
+            imageMemoryBarrier.newLayout = newImageLayout;
+            imageMemoryBarrier.image = image;
+            imageMemoryBarrier.subresourceRange = subresourceRange;
+            // Source access is ignored for an acquire
+            imageMemoryBarrier.srcAccessMask = 0;
+            imageMemoryBarrier.dstAccessMask = dstAccessMask;
+
+            vkCmdPipelineBarrier(
+                cmdbuffer,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                dstStageMask,
+                0,
+                0, nullptr,
+                0, nullptr,
+                1, &imageMemoryBarrier);
+        }
+
+        /** @brief Escape text for use inside a JSON string: quotes, backslashes and control characters */
+        inline std::string escapeJson(const std::string &text)
+        {
+            std::string escaped;
+            for (char c : text)
+            {
+                if (c == '"' || c == '\\')
+                {
+                    escaped += '\\';
+                    escaped += c;
+                }
+                else if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char code[8];
+                    snprintf(code, sizeof(code), "\\u%04x", c);
+                    escaped += code;
+                }
+                else
+                {
+                    escaped += c;
+                }
+            }
+            return escaped;
+        }
     }
 }
\ No newline at end of file
@@ -0,0 +1,341 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <stdexcept>
+#include <vector>
+
+#include "computeDeviceCaps.hpp"
+
+namespace sourav
+{
+    namespace Formats
+    {
+        enum class computeComponentType
+        {
+            Unorm,
+            Snorm,
+            Uint,
+            Sint,
+            Srgb,
+            Sfloat,
+            Packed,
+            Unknown
+        };
+
+        /** @brief Texel layout of an uncompressed color format */
+        struct computeFormatInfo
+        {
+            uint32_t             texelSize      = 0;
+            uint32_t             componentCount = 0;
+            uint32_t             componentSize  = 0;
+            computeComponentType type           = computeComponentType::Unknown;
+            /** @brief Components stored as B, G, R (, A) instead of R, G, B (, A) */
+            bool                 blueFirst      = false;
+        };
+
+        struct computeFormatEntry
+        {
+            VkFormat          format;
+            computeFormatInfo info;
+        };
+
+        #define INFO(components, size, t) computeFormatInfo { (components) * (size), components, size, computeComponentType::t, false }
+        #define BGR(components, size, t)  computeFormatInfo { (components) * (size), components, size, computeComponentType::t, true }
+        /** @brief Every format formatInfo knows, usable in constant expressions */
+        static constexpr computeFormatEntry FORMAT_TABLE[] =
+        {
+            { VK_FORMAT_R8_UNORM,                 INFO(1, 1, Unorm) },
+            { VK_FORMAT_R8_SNORM,                 INFO(1, 1, Snorm) },
+            { VK_FORMAT_R8_UINT,                  INFO(1, 1, Uint) },
+            { VK_FORMAT_R8_SINT,                  INFO(1, 1, Sint) },
+            { VK_FORMAT_R8_SRGB,                  INFO(1, 1, Srgb) },
+            { VK_FORMAT_R8G8_UNORM,               INFO(2, 1, Unorm) },
+            { VK_FORMAT_R8G8_SNORM,               INFO(2, 1, Snorm) },
+            { VK_FORMAT_R8G8_UINT,                INFO(2, 1, Uint) },
+            { VK_FORMAT_R8G8_SINT,                INFO(2, 1, Sint) },
+            { VK_FORMAT_R8G8_SRGB,                INFO(2, 1, Srgb) },
+            { VK_FORMAT_R8G8B8_UNORM,             INFO(3, 1, Unorm) },
+            { VK_FORMAT_R8G8B8_SNORM,             INFO(3, 1, Snorm) },
+            { VK_FORMAT_R8G8B8_UINT,              INFO(3, 1, Uint) },
+            { VK_FORMAT_R8G8B8_SINT,              INFO(3, 1, Sint) },
+            { VK_FORMAT_R8G8B8_SRGB,              INFO(3, 1, Srgb) },
+            { VK_FORMAT_B8G8R8_UNORM,             BGR(3, 1, Unorm) },
+            { VK_FORMAT_B8G8R8_SRGB,              BGR(3, 1, Srgb) },
+            { VK_FORMAT_R8G8B8A8_UNORM,           INFO(4, 1, Unorm) },
+            { VK_FORMAT_R8G8B8A8_SNORM,           INFO(4, 1, Snorm) },
+            { VK_FORMAT_R8G8B8A8_UINT,            INFO(4, 1, Uint) },
+            { VK_FORMAT_R8G8B8A8_SINT,            INFO(4, 1, Sint) },
+            { VK_FORMAT_R8G8B8A8_SRGB,            INFO(4, 1, Srgb) },
+            { VK_FORMAT_B8G8R8A8_UNORM,           BGR(4, 1, Unorm) },
+            { VK_FORMAT_B8G8R8A8_SRGB,            BGR(4, 1, Srgb) },
+            { VK_FORMAT_A2B10G10R10_UNORM_PACK32, INFO(1, 4, Packed) },
+            { VK_FORMAT_B10G11R11_UFLOAT_PACK32,  INFO(1, 4, Packed) },
+            { VK_FORMAT_R16_UNORM,                INFO(1, 2, Unorm) },
+            { VK_FORMAT_R16_UINT,                 INFO(1, 2, Uint) },
+            { VK_FORMAT_R16_SINT,                 INFO(1, 2, Sint) },
+            { VK_FORMAT_R16_SFLOAT,               INFO(1, 2, Sfloat) },
+            { VK_FORMAT_R16G16_UNORM,             INFO(2, 2, Unorm) },
+            { VK_FORMAT_R16G16_SFLOAT,            INFO(2, 2, Sfloat) },
+            { VK_FORMAT_R16G16B16_SFLOAT,         INFO(3, 2, Sfloat) },
+            { VK_FORMAT_R16G16B16A16_UNORM,       INFO(4, 2, Unorm) },
+            { VK_FORMAT_R16G16B16A16_UINT,        INFO(4, 2, Uint) },
+            { VK_FORMAT_R16G16B16A16_SINT,        INFO(4, 2, Sint) },
+            { VK_FORMAT_R16G16B16A16_SFLOAT,      INFO(4, 2, Sfloat) },
+            { VK_FORMAT_R32_UINT,                 INFO(1, 4, Uint) },
+            { VK_FORMAT_R32_SINT,                 INFO(1, 4, Sint) },
+            { VK_FORMAT_R32_SFLOAT,               INFO(1, 4, Sfloat) },
+            { VK_FORMAT_R32G32_UINT,              INFO(2, 4, Uint) },
+            { VK_FORMAT_R32G32_SINT,              INFO(2, 4, Sint) },
+            { VK_FORMAT_R32G32_SFLOAT,            INFO(2, 4, Sfloat) },
+            { VK_FORMAT_R32G32B32_UINT,           INFO(3, 4, Uint) },
+            { VK_FORMAT_R32G32B32_SINT,           INFO(3, 4, Sint) },
+            { VK_FORMAT_R32G32B32_SFLOAT,         INFO(3, 4, Sfloat) },
+            { VK_FORMAT_R32G32B32A32_UINT,        INFO(4, 4, Uint) },
+            { VK_FORMAT_R32G32B32A32_SINT,        INFO(4, 4, Sint) },
+            { VK_FORMAT_R32G32B32A32_SFLOAT,      INFO(4, 4, Sfloat) },
+        };
+        #undef INFO
+        #undef BGR
+
+        /** @brief Look up the texel layout of a format, texelSize is 0 for formats that are not handled */
+        constexpr computeFormatInfo formatInfo(VkFormat format)
+        {
+            for (const computeFormatEntry &entry : FORMAT_TABLE)
+            {
+                if (entry.format == format)
+                {
+                    return entry.info;
+                }
+            }
+            return computeFormatInfo();
+        }
+
+        /**
+        * @brief Compile-time texel layout of Format, fails to compile for formats that are not in FORMAT_TABLE
+        *
+        * computeFormatTraits<VK_FORMAT_R8G8B8A8_UNORM>::texelSize is 4
+        */
+        template <VkFormat Format>
+        struct computeFormatTraits
+        {
+            static constexpr computeFormatInfo info = formatInfo(Format);
+            static_assert(info.texelSize != 0, "Format is not in FORMAT_TABLE");
+
+            static constexpr uint32_t texelSize      = info.texelSize;
+            static constexpr uint32_t componentCount = info.componentCount;
+            static constexpr uint32_t componentSize  = info.componentSize;
+
+            /** @brief Bytes of a tightly packed width x height level */
+            static constexpr VkDeviceSize levelSize(uint32_t width, uint32_t height)
+            {
+                return (VkDeviceSize)texelSize * width * height;
+            }
+        };
+
+        /** @brief A format to use when the requested one lacks a feature */
+        struct computeFormatFallback
+        {
+            VkFormat format;
+            /** @brief Same bits per texel in the same order, texel data can be copied without conversion */
+            bool     sameBits;
+        };
+
+        /** @brief Format features an image created with usage needs */
+        inline VkFormatFeatureFlags requiredFormatFeatures(VkImageUsageFlags usage)
+        {
+            VkFormatFeatureFlags features = 0;
+            if (usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+            {
+                features |= VK_FORMAT_FEATURE_TRANSFER_SRC_BIT;
+            }
+            if (usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT)
+            {
+                features |= VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+            }
+            if (usage & VK_IMAGE_USAGE_SAMPLED_BIT)
+            {
+                features |= VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+            }
+            if (usage & VK_IMAGE_USAGE_STORAGE_BIT)
+            {
+                features |= VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT;
+            }
+            if (usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
+            {
+                features |= VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT;
+            }
+            return features;
+        }
+
+        /** @brief True if images of format with the given usage and tiling can be created on physicalDevice */
+        inline bool supportsUsage(
+            VkPhysicalDevice  physicalDevice,
+            VkFormat          format,
+            VkImageUsageFlags usage,
+            VkImageTiling     tiling = VK_IMAGE_TILING_OPTIMAL)
+        {
+            const VkFormatProperties formatProperties = sourav::Device::getDeviceCaps(physicalDevice).formatProperties(format);
+
+            const VkFormatFeatureFlags supported =
+                tiling == VK_IMAGE_TILING_LINEAR ? formatProperties.linearTilingFeatures : formatProperties.optimalTilingFeatures;
+            const VkFormatFeatureFlags required = requiredFormatFeatures(usage);
+            return (supported & required) == required;
+        }
+
+        /**
+        * @brief Formats that can stand in for format, best first
+        *
+        * sRGB formats are rarely storage capable, their UNORM twin holds the same bits. Three component formats are
+        * rarely supported for anything and widen to four components. See acceptsFallback() for the usages an sRGB to
+        * UNORM fallback is allowed for
+        */
+        inline std::vector<computeFormatFallback> fallbackFormats(VkFormat format)
+        {
+            switch (format)
+            {
+                case VK_FORMAT_R8_SRGB:             return { { VK_FORMAT_R8_UNORM, true } };
+                case VK_FORMAT_R8G8_SRGB:           return { { VK_FORMAT_R8G8_UNORM, true } };
+                case VK_FORMAT_R8G8B8A8_SRGB:       return { { VK_FORMAT_R8G8B8A8_UNORM, true } };
+                case VK_FORMAT_B8G8R8A8_SRGB:       return { { VK_FORMAT_B8G8R8A8_UNORM, true }, { VK_FORMAT_R8G8B8A8_SRGB, false }, { VK_FORMAT_R8G8B8A8_UNORM, false } };
+                case VK_FORMAT_B8G8R8A8_UNORM:      return { { VK_FORMAT_R8G8B8A8_UNORM, false } };
+                case VK_FORMAT_R8G8B8_UNORM:        return { { VK_FORMAT_R8G8B8A8_UNORM, false } };
+                case VK_FORMAT_R8G8B8_SRGB:         return { { VK_FORMAT_R8G8B8A8_SRGB, false }, { VK_FORMAT_R8G8B8A8_UNORM, false } };
+                case VK_FORMAT_B8G8R8_UNORM:        return { { VK_FORMAT_B8G8R8A8_UNORM, false }, { VK_FORMAT_R8G8B8A8_UNORM, false } };
+                case VK_FORMAT_B8G8R8_SRGB:         return { { VK_FORMAT_B8G8R8A8_SRGB, false }, { VK_FORMAT_R8G8B8A8_SRGB, false }, { VK_FORMAT_R8G8B8A8_UNORM, false } };
+                case VK_FORMAT_B10G11R11_UFLOAT_PACK32: return { { VK_FORMAT_R16G16B16A16_SFLOAT, false } };
+                case VK_FORMAT_R16G16B16_SFLOAT:    return { { VK_FORMAT_R16G16B16A16_SFLOAT, false }, { VK_FORMAT_R32G32B32A32_SFLOAT, false } };
+                case VK_FORMAT_R16G16B16A16_SFLOAT: return { { VK_FORMAT_R32G32B32A32_SFLOAT, false } };
+                case VK_FORMAT_R32G32B32_SFLOAT:    return { { VK_FORMAT_R32G32B32A32_SFLOAT, false } };
+                case VK_FORMAT_R32G32B32_UINT:      return { { VK_FORMAT_R32G32B32A32_UINT, false } };
+                case VK_FORMAT_R32G32B32_SINT:      return { { VK_FORMAT_R32G32B32A32_SINT, false } };
+                default:                            return {};
+            }
+        }
+
+        /**
+        * @brief True if fallback may stand in for format in an image with usage
+        *
+        * An sRGB format only falls back to UNORM for storage images, which cannot be sRGB anyway. Sampling or rendering
+        * the UNORM twin would silently skip the sRGB decode and encode
+        */
+        inline bool acceptsFallback(VkFormat format, VkFormat fallback, VkImageUsageFlags usage)
+        {
+            const bool dropsSrgb = formatInfo(format).type == computeComponentType::Srgb &&
+                formatInfo(fallback).type != computeComponentType::Srgb;
+            return !dropsSrgb || (usage & VK_IMAGE_USAGE_STORAGE_BIT) != 0;
+        }
+
+        /******************************************************************************************************************************
+        * Pick format or the first fallback that supports usage, see acceptsFallback()
+        *
+        * @param sameBitsOnly Only accept fallbacks with the same texel layout, for images whose contents are uploaded as is
+        *
+        * @return format if it is supported, otherwise the fallback
+        *
+        * @throw Throws an exception if neither format nor any accepted fallback supports usage
+        ********************************************************************************************************************************/
+        inline VkFormat selectFormat(
+            VkPhysicalDevice  physicalDevice,
+            VkFormat          format,
+            VkImageUsageFlags usage,
+            bool              sameBitsOnly = true,
+            VkImageTiling     tiling       = VK_IMAGE_TILING_OPTIMAL)
+        {
+            if (supportsUsage(physicalDevice, format, usage, tiling))
+            {
+                return format;
+            }
+            for (const computeFormatFallback &fallback : fallbackFormats(format))
+            {
+                if ((fallback.sameBits || !sameBitsOnly) && acceptsFallback(format, fallback.format, usage) &&
+                    supportsUsage(physicalDevice, fallback.format, usage, tiling))
+                {
+                    return fallback.format;
+                }
+            }
+            throw std::runtime_error("Format does not support the requested image usage");
+        }
+
+        /** @brief Texel block of a format: 1x1 texels for uncompressed formats, 4x4 and larger for BC and ASTC */
+        struct computeBlockInfo
+        {
+            uint32_t blockWidth  = 0;
+            uint32_t blockHeight = 0;
+            /** @brief Bytes per block, 0 for formats blockInfo does not know */
+            uint32_t blockSize   = 0;
+        };
+
+        /** @brief Block layout of format, covers BC1 - BC7, ASTC LDR and every format formatInfo knows */
+        inline computeBlockInfo blockInfo(VkFormat format)
+        {
+            switch (format)
+            {
+                case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+                case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+                case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+                case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                case VK_FORMAT_BC4_UNORM_BLOCK:
+                case VK_FORMAT_BC4_SNORM_BLOCK:
+                    return { 4, 4, 8 };
+                case VK_FORMAT_BC2_UNORM_BLOCK:
+                case VK_FORMAT_BC2_SRGB_BLOCK:
+                case VK_FORMAT_BC3_UNORM_BLOCK:
+                case VK_FORMAT_BC3_SRGB_BLOCK:
+                case VK_FORMAT_BC5_UNORM_BLOCK:
+                case VK_FORMAT_BC5_SNORM_BLOCK:
+                case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+                case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+                case VK_FORMAT_BC7_UNORM_BLOCK:
+                case VK_FORMAT_BC7_SRGB_BLOCK:
+                    return { 4, 4, 16 };
+                default:
+                    break;
+            }
+
+            // ASTC formats come in UNORM / SRGB pairs, every block is 16 bytes
+            if (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK)
+            {
+                static const uint32_t astcBlocks[][2] =
+                {
+                    { 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 },
+                    { 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 }
+                };
+                const uint32_t *block = astcBlocks[(format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2];
+                return { block[0], block[1], 16 };
+            }
+
+            const uint32_t size = formatInfo(format).texelSize;
+            return size ? computeBlockInfo { 1, 1, size } : computeBlockInfo();
+        }
+
+        /** @brief True for BC and ASTC formats */
+        inline bool isBlockCompressed(VkFormat format)
+        {
+            return blockInfo(format).blockWidth > 1;
+        }
+
+        /** @brief Bytes of a width x height image of format, partial blocks at the right and bottom edge count as whole blocks */
+        inline VkDeviceSize blockImageSize(VkFormat format, uint32_t width, uint32_t height)
+        {
+            const computeBlockInfo block = blockInfo(format);
+            if (block.blockSize == 0)
+            {
+                throw std::runtime_error("Unsupported format");
+            }
+            return (VkDeviceSize)((width + block.blockWidth - 1) / block.blockWidth) *
+                ((height + block.blockHeight - 1) / block.blockHeight) * block.blockSize;
+        }
+
+        /** @brief Texel size of a format, throws for formats formatInfo does not know */
+        inline uint32_t texelSize(VkFormat format)
+        {
+            uint32_t size = formatInfo(format).texelSize;
+            if (size == 0)
+            {
+                throw std::runtime_error("Unsupported format");
+            }
+            return size;
+        }
+    }
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "computeFormats.hpp"
+
+// Identifier, header and section index of a KTX2 file, the level index follows
+#define KTX2_HEADER_SIZE 80
+
+namespace sourav
+{
+    namespace Transfer
+    {
+        /** @brief One mip level of a KTX2 file, every layer, face and depth slice of the level back to back */
+        struct computeKtx2Level
+        {
+            /** @brief From the start of the file */
+            VkDeviceSize offset = 0;
+            VkDeviceSize size   = 0;
+        };
+
+        /** @brief What parseKtx2 reads from a KTX2 header, sizes are at least 1 */
+        struct computeKtx2Info
+        {
+            VkFormat format = VK_FORMAT_UNDEFINED;
+            uint32_t width  = 0;
+            uint32_t height = 1;
+            uint32_t depth  = 1;
+            /** @brief 0 if the file is not an array, the array size otherwise */
+            uint32_t layers = 0;
+            /** @brief 6 for a cubemap, 1 otherwise */
+            uint32_t faces  = 1;
+            /** @brief Base level first */
+            std::vector<computeKtx2Level> levels;
+        };
+
+        namespace detail
+        {
+            template <typename T>
+            inline T readKtx2(const uint8_t *data, size_t offset)
+            {
+                // KTX2 is little endian like every platform Vulkan runs on, the fields are not aligned
+                T value;
+                memcpy(&value, data + offset, sizeof(T));
+                return value;
+            }
+        }
+
+        /******************************************************************************************************************************
+        * Read the header and level index of a KTX2 container
+        *
+        * Level data is used as stored, so the payload must not be supercompressed and must have a Vulkan format
+        * (BasisU / UASTC files need a transcoder first). Level sizes are checked against the format's block size
+        *
+        * @param data The file, e.g. a computeMappedFile
+        * @param size Size of the file in bytes
+        *
+        * @throw Throws an exception if the file is not KTX2, is truncated or holds data this loader cannot upload
+        ********************************************************************************************************************************/
+        inline computeKtx2Info parseKtx2(const uint8_t *data, size_t size)
+        {
+            static const uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+            if (!data || size < KTX2_HEADER_SIZE || memcmp(data, identifier, sizeof(identifier)) != 0)
+            {
+                throw std::runtime_error("Not a KTX2 file");
+            }
+
+            computeKtx2Info info;
+            info.format = static_cast<VkFormat>(detail::readKtx2<uint32_t>(data, 12));
+            info.width = detail::readKtx2<uint32_t>(data, 20);
+            info.height = std::max(1u, detail::readKtx2<uint32_t>(data, 24));
+            info.depth = std::max(1u, detail::readKtx2<uint32_t>(data, 28));
+            info.layers = detail::readKtx2<uint32_t>(data, 32);
+            info.faces = detail::readKtx2<uint32_t>(data, 36);
+            const uint32_t levelCount = std::max(1u, detail::readKtx2<uint32_t>(data, 40));
+            const uint32_t supercompression = detail::readKtx2<uint32_t>(data, 44);
+
+            if (info.format == VK_FORMAT_UNDEFINED || supercompression != 0)
+            {
+                throw std::runtime_error("KTX2 file needs transcoding or decompression");
+            }
+            if (sourav::Formats::blockInfo(info.format).blockSize == 0)
+            {
+                throw std::runtime_error("Unsupported KTX2 format");
+            }
+            if (info.width == 0 || (info.faces != 1 && info.faces != 6) || (info.depth > 1 && (info.layers > 0 || info.faces > 1)) ||
+                levelCount > 32)
+            {
+                throw std::runtime_error("Unsupported KTX2 image shape");
+            }
+            if (size < KTX2_HEADER_SIZE + (size_t)levelCount * 24)
+            {
+                throw std::runtime_error("KTX2 file is truncated");
+            }
+
+            const uint32_t images = std::max(1u, info.layers) * info.faces;
+            for (uint32_t level = 0; level < levelCount; level++)
+            {
+                const size_t entry = KTX2_HEADER_SIZE + (size_t)level * 24;
+                computeKtx2Level levelInfo;
+                levelInfo.offset = detail::readKtx2<uint64_t>(data, entry);
+                levelInfo.size = detail::readKtx2<uint64_t>(data, entry + 8);
+
+                const uint32_t levelDepth = std::max(1u, info.depth >> level);
+                const VkDeviceSize expected = sourav::Formats::blockImageSize(info.format,
+                    std::max(1u, info.width >> level), std::max(1u, info.height >> level)) * levelDepth * images;
+                if (levelInfo.size != expected)
+                {
+                    throw std::runtime_error("KTX2 level size does not match its format and extent");
+                }
+                if (levelInfo.offset > size || levelInfo.size > size - levelInfo.offset)
+                {
+                    throw std::runtime_error("KTX2 file is truncated");
+                }
+                info.levels.push_back(levelInfo);
+            }
+            return info;
+        }
+    }
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace sourav
+{
+    namespace Transfer
+    {
+        /**
+        * @brief Read-only memory mapping of a whole file
+        *
+        * Pages are read in by the OS as they are touched, so nothing is copied up front. Sequential consumers can hand
+        * ranges they are done with back through release(), which keeps the resident set small for files larger than RAM
+        */
+        class computeMappedFile
+        {
+            public:
+                const uint8_t *data = nullptr;
+                size_t         size = 0;
+
+                void open(const std::string &path);
+                void close();
+
+                void release(size_t offset, size_t length);
+
+            private:
+#ifdef _WIN32
+                HANDLE file    = INVALID_HANDLE_VALUE;
+                HANDLE mapping = NULL;
+#else
+                int    fd      = -1;
+#endif
+                size_t pageSize = 4096;
+        };
+
+
+        /** @brief Map path, throws if it cannot be opened or mapped. Empty files map to a null data pointer */
+        inline void computeMappedFile::open(const std::string &path)
+        {
+            close();
+
+#ifdef _WIN32
+            SYSTEM_INFO systemInfo;
+            GetSystemInfo(&systemInfo);
+            pageSize = systemInfo.dwPageSize;
+
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+            LARGE_INTEGER fileSize;
+            if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize))
+            {
+                close();
+                throw std::runtime_error("Could not open file " + path);
+            }
+            size = static_cast<size_t>(fileSize.QuadPart);
+            if (size == 0)
+            {
+                return;
+            }
+
+            mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            data = mapping ? static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+#else
+            pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+            fd = ::open(path.c_str(), O_RDONLY);
+            struct stat fileStat;
+            if (fd < 0 || fstat(fd, &fileStat) != 0)
+            {
+                close();
+                throw std::runtime_error("Could not open file " + path);
+            }
+            size = static_cast<size_t>(fileStat.st_size);
+            if (size == 0)
+            {
+                return;
+            }
+
+            void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            data = mapped == MAP_FAILED ? nullptr : static_cast<const uint8_t *>(mapped);
+            if (data)
+            {
+                // Larger read-ahead, pages behind the consumer are dropped with release()
+                madvise(mapped, size, MADV_SEQUENTIAL);
+            }
+#endif
+            if (!data)
+            {
+                close();
+                throw std::runtime_error("Could not map file " + path);
+            }
+        }
+
+
+        inline void computeMappedFile::close()
+        {
+#ifdef _WIN32
+            if (data)
+            {
+                UnmapViewOfFile(data);
+            }
+            if (mapping)
+            {
+                CloseHandle(mapping);
+            }
+            if (file != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(file);
+            }
+            mapping = NULL;
+            file = INVALID_HANDLE_VALUE;
+#else
+            if (data)
+            {
+                munmap(const_cast<uint8_t *>(data), size);
+            }
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+            fd = -1;
+#endif
+            data = nullptr;
+            size = 0;
+        }
+
+
+        /**
+        * @brief Drop the resident pages of a range that will not be read again, reading it later faults the pages back in
+        *
+        * Only whole pages inside the range are dropped. A no-op on Windows, where the working set of a read-only view
+        * is trimmed by the OS under memory pressure
+        */
+        inline void computeMappedFile::release(size_t offset, size_t length)
+        {
+#ifndef _WIN32
+            size_t begin = (offset + pageSize - 1) / pageSize * pageSize;
+            size_t end = (offset + length) / pageSize * pageSize;
+            if (data && end > begin && end <= size)
+            {
+                madvise(const_cast<uint8_t *>(data) + begin, end - begin, MADV_DONTNEED);
+            }
+#else
+            (void)offset;
+            (void)length;
+#endif
+        }
+    }
+}
@@ -0,0 +1,703 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "computeDeviceCaps.hpp"
+#include "computeDeviceUtils.hpp"
+#include "computeMemoryPolicy.hpp"
+
+// Default size of the device memory blocks sub-allocations are carved from
+#define DEFAULT_MEMORY_BLOCK_SIZE (64ull * 1024 * 1024)
+// Smallest node the buddy allocator hands out, smaller requests are rounded up to this
+#define MEMORY_BLOCK_MIN_NODE_SIZE 256ull
+// Number of device memory allocations after which VK_EXT_memory_budget is queried again
+#define MEMORY_BUDGET_REFRESH_INTERVAL 30
+
+namespace sourav
+{
+    namespace Memory
+    {
+        /** @brief Linear resources (buffers, linear images) and optimal images are kept in separate blocks to honour bufferImageGranularity */
+        enum class computeResourceTiling
+        {
+            Linear,
+            Optimal
+        };
+
+        /**
+        * @brief Entry points the allocator uses to talk to the driver
+        *
+        * Defaults to the loader functions, tests can swap in mocks to run without a device
+        */
+        struct computeAllocatorFunctions
+        {
+            PFN_vkGetPhysicalDeviceProperties        getPhysicalDeviceProperties        = vkGetPhysicalDeviceProperties;
+            PFN_vkGetPhysicalDeviceMemoryProperties  getPhysicalDeviceMemoryProperties  = vkGetPhysicalDeviceMemoryProperties;
+            PFN_vkGetPhysicalDeviceMemoryProperties2 getPhysicalDeviceMemoryProperties2 = vkGetPhysicalDeviceMemoryProperties2;
+            PFN_vkAllocateMemory                     allocateMemory                     = vkAllocateMemory;
+            PFN_vkFreeMemory                         freeMemory                         = vkFreeMemory;
+            PFN_vkMapMemory                          mapMemory                          = vkMapMemory;
+            PFN_vkUnmapMemory                        unmapMemory                        = vkUnmapMemory;
+        };
+
+        class computeMemoryBlock;
+
+        /** @brief A sub-range of a device memory block handed out by the allocator */
+        struct computeAllocation
+        {
+            VkDeviceMemory      memory          = VK_NULL_HANDLE;
+            VkDeviceSize        offset          = 0;
+            VkDeviceSize        size            = 0;
+            /** @brief Host pointer to the start of the allocation, null unless the memory type is host visible */
+            void *              mapped          = nullptr;
+            uint32_t            memoryTypeIndex = 0;
+            computeMemoryBlock *block           = nullptr;
+        };
+
+        /** @brief Allocator statistics, fragmentation is 1 - (largest free node / total free bytes) over all shared blocks */
+        struct computeAllocatorStats
+        {
+            VkDeviceSize bytesReserved   = 0;
+            VkDeviceSize bytesUsed       = 0;
+            VkDeviceSize bytesFree       = 0;
+            VkDeviceSize largestFreeNode = 0;
+            uint32_t     blockCount      = 0;
+            uint32_t     allocationCount = 0;
+            float        fragmentation   = 0.0f;
+            /** @brief Budget and usage of every heap, see computeMemoryAllocator::getHeapBudgets */
+            uint32_t          heapCount = 0;
+            computeHeapBudget heaps[VK_MAX_MEMORY_HEAPS];
+        };
+
+        /**
+        * @brief One VkDeviceMemory object split with a binary buddy allocator
+        *
+        * Nodes are power-of-two sized and naturally aligned to their size, so any power-of-two
+        * alignment up to the node size comes for free
+        */
+        class computeMemoryBlock
+        {
+            public:
+                VkDeviceMemory memory          = VK_NULL_HANDLE;
+                VkDeviceSize   size            = 0;
+                uint32_t       memoryTypeIndex = 0;
+                uint32_t       poolIndex       = 0;
+                void *         mapped          = nullptr;
+                bool           dedicated       = false;
+                VkDeviceSize   bytesUsed       = 0;
+                uint32_t       allocationCount = 0;
+
+                void init(VkDeviceSize blockSize, bool dedicatedBlock);
+                bool allocate(VkDeviceSize allocSize, VkDeviceSize alignment, VkDeviceSize *offset);
+                void free(VkDeviceSize offset, VkDeviceSize allocSize);
+                VkDeviceSize freeBytes() const;
+                VkDeviceSize largestFreeNode() const;
+
+            private:
+                // Level 0 is the whole block, every level below halves the node size
+                uint32_t                               levelCount = 0;
+                std::vector<std::set<VkDeviceSize>>    freeLists;
+                std::unordered_map<VkDeviceSize, uint32_t> allocatedLevels;
+                VkDeviceSize                           freeNodeBytes = 0;
+
+                VkDeviceSize nodeSize(uint32_t level) const { return size >> level; }
+        };
+
+        class computeMemoryAllocator
+        {
+            public:
+                VkPhysicalDevice                 physicalDevice = VK_NULL_HANDLE;
+                VkDevice                         logicalDevice  = VK_NULL_HANDLE;
+                VkPhysicalDeviceMemoryProperties memoryProperties {};
+                VkDeviceSize                     bufferImageGranularity = 1;
+                VkDeviceSize                     blockSize = DEFAULT_MEMORY_BLOCK_SIZE;
+
+                void create(
+                    VkPhysicalDevice                 physicalDevice,
+                    VkDevice                         logicalDevice,
+                    VkDeviceSize                     blockSize = DEFAULT_MEMORY_BLOCK_SIZE,
+                    const computeAllocatorFunctions *functions = nullptr);
+                void destroy();
+
+                bool enableMemoryBudget();
+                bool usesMemoryBudget() const { return memoryBudgetEnabled; }
+
+                uint32_t findMemoryType(uint32_t typeBits, const computeMemoryUsage &usage, VkBool32 *memTypeFound = nullptr) const;
+
+                computeAllocation allocate(const VkMemoryRequirements &memReqs, const computeMemoryUsage &usage, computeResourceTiling tiling);
+                computeAllocation allocateBuffer(VkBuffer buffer, const computeMemoryUsage &usage);
+                computeAllocation allocateImage(VkImage image, const computeMemoryUsage &usage, VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL);
+                void free(computeAllocation &allocation);
+
+                void getHeapBudgets(computeHeapBudget *budgets);
+                computeAllocatorStats getStats();
+
+            private:
+                computeAllocatorFunctions                         functions;
+                std::mutex                                        mutex;
+                // Indexed by poolIndex(), holds every shared block of one memory type and tiling class
+                std::vector<std::vector<std::unique_ptr<computeMemoryBlock>>> pools;
+                std::vector<std::unique_ptr<computeMemoryBlock>>  dedicatedBlocks;
+                VkDeviceSize                                      bytesUsed = 0;
+
+                // Bytes of VkDeviceMemory this allocator holds in every heap, now and when the budget was last queried
+                bool                                              memoryBudgetEnabled = false;
+                VkDeviceSize                                      heapBlockBytes[VK_MAX_MEMORY_HEAPS] = {};
+                VkDeviceSize                                      heapBlockBytesAtQuery[VK_MAX_MEMORY_HEAPS] = {};
+                computeHeapBudget                                 queriedBudgets[VK_MAX_MEMORY_HEAPS];
+                uint32_t                                          allocationsSinceQuery = 0;
+
+                void queryMemoryBudget();
+                void estimateHeapBudgets(computeHeapBudget *budgets);
+                uint32_t poolIndex(uint32_t memoryTypeIndex, computeResourceTiling tiling) const;
+                computeMemoryBlock *createBlock(uint32_t memoryTypeIndex, uint32_t poolIndex, VkDeviceSize size, bool dedicated);
+                void destroyBlock(computeMemoryBlock *block);
+        };
+
+
+        inline VkDeviceSize nextPowerOfTwo(VkDeviceSize value)
+        {
+            VkDeviceSize result = 1;
+            while (result < value)
+            {
+                result <<= 1;
+            }
+            return result;
+        }
+
+
+        inline void computeMemoryBlock::init(VkDeviceSize blockSize, bool dedicatedBlock)
+        {
+            size = blockSize;
+            dedicated = dedicatedBlock;
+            bytesUsed = 0;
+            allocationCount = 0;
+            allocatedLevels.clear();
+            freeLists.clear();
+
+            if (dedicated)
+            {
+                // Dedicated blocks hold exactly one allocation at offset 0, no buddy tree needed
+                levelCount = 0;
+                freeNodeBytes = 0;
+                return;
+            }
+
+            levelCount = 1;
+            while (nodeSize(levelCount - 1) > MEMORY_BLOCK_MIN_NODE_SIZE)
+            {
+                levelCount++;
+            }
+            freeLists.resize(levelCount);
+            freeLists[0].insert(0);
+            freeNodeBytes = size;
+        }
+
+
+        inline bool computeMemoryBlock::allocate(VkDeviceSize allocSize, VkDeviceSize alignment, VkDeviceSize *offset)
+        {
+            if (dedicated)
+            {
+                if (allocationCount > 0 || allocSize > size)
+                {
+                    return false;
+                }
+                *offset = 0;
+                allocationCount = 1;
+                bytesUsed = allocSize;
+                return true;
+            }
+
+            VkDeviceSize needed = nextPowerOfTwo(std::max({ allocSize, alignment, (VkDeviceSize)MEMORY_BLOCK_MIN_NODE_SIZE }));
+            if (needed > size)
+            {
+                return false;
+            }
+
+            uint32_t targetLevel = 0;
+            while (nodeSize(targetLevel) > needed)
+            {
+                targetLevel++;
+            }
+
+            // Find the smallest free node that fits, walking towards the root
+            int32_t level = (int32_t)targetLevel;
+            while (level >= 0 && freeLists[level].empty())
+            {
+                level--;
+            }
+            if (level < 0)
+            {
+                return false;
+            }
+
+            VkDeviceSize nodeOffset = *freeLists[level].begin();
+            freeLists[level].erase(freeLists[level].begin());
+
+            // Split down to the requested size, the upper halves go onto the free lists
+            while ((uint32_t)level < targetLevel)
+            {
+                level++;
+                freeLists[level].insert(nodeOffset + nodeSize(level));
+            }
+
+            allocatedLevels[nodeOffset] = targetLevel;
+            freeNodeBytes -= nodeSize(targetLevel);
+            bytesUsed += allocSize;
+            allocationCount++;
+            *offset = nodeOffset;
+            return true;
+        }
+
+
+        inline void computeMemoryBlock::free(VkDeviceSize offset, VkDeviceSize allocSize)
+        {
+            assert(allocationCount > 0);
+            bytesUsed -= allocSize;
+            allocationCount--;
+
+            if (dedicated)
+            {
+                return;
+            }
+
+            auto it = allocatedLevels.find(offset);
+            assert(it != allocatedLevels.end());
+            uint32_t level = it->second;
+            allocatedLevels.erase(it);
+            freeNodeBytes += nodeSize(level);
+
+            // Merge with the buddy as long as it is free as well
+            while (level > 0)
+            {
+                VkDeviceSize buddy = offset ^ nodeSize(level);
+                auto buddyIt = freeLists[level].find(buddy);
+                if (buddyIt == freeLists[level].end())
+                {
+                    break;
+                }
+                freeLists[level].erase(buddyIt);
+                offset = std::min(offset, buddy);
+                level--;
+            }
+            freeLists[level].insert(offset);
+        }
+
+
+        inline VkDeviceSize computeMemoryBlock::freeBytes() const
+        {
+            return freeNodeBytes;
+        }
+
+
+        inline VkDeviceSize computeMemoryBlock::largestFreeNode() const
+        {
+            for (uint32_t level = 0; level < levelCount; level++)
+            {
+                if (!freeLists[level].empty())
+                {
+                    return nodeSize(level);
+                }
+            }
+            return 0;
+        }
+
+
+        /******************************************************************************************************************************
+        * Set up the allocator for a device, no memory is allocated until the first request
+        *
+        * @param physicalDevice Physical device the memory types are queried from
+        * @param logicalDevice Device memory blocks are allocated on
+        * @param blockSize Size of the shared blocks, rounded up to a power of two. Requests larger than half a block get their own allocation
+        * @param (Optional) functions Replacement driver entry points, e.g. mocks for testing without a device
+        ********************************************************************************************************************************/
+        inline void computeMemoryAllocator::create(
+            VkPhysicalDevice                 physicalDevice,
+            VkDevice                         logicalDevice,
+            VkDeviceSize                     blockSize,
+            const computeAllocatorFunctions *functions)
+        {
+            this->physicalDevice = physicalDevice;
+            this->logicalDevice = logicalDevice;
+            this->blockSize = nextPowerOfTwo(std::max(blockSize, (VkDeviceSize)MEMORY_BLOCK_MIN_NODE_SIZE));
+            if (functions)
+            {
+                this->functions = *functions;
+            }
+
+            this->functions.getPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+            VkPhysicalDeviceProperties deviceProperties;
+            this->functions.getPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+            bufferImageGranularity = deviceProperties.limits.bufferImageGranularity;
+
+            pools.clear();
+            pools.resize(memoryProperties.memoryTypeCount * 2);
+            bytesUsed = 0;
+
+            memoryBudgetEnabled = false;
+            allocationsSinceQuery = 0;
+            for (uint32_t i = 0; i < VK_MAX_MEMORY_HEAPS; i++)
+            {
+                heapBlockBytes[i] = 0;
+                heapBlockBytesAtQuery[i] = 0;
+                queriedBudgets[i] = computeHeapBudget();
+            }
+        }
+
+
+        inline void computeMemoryAllocator::destroy()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            for (auto &pool : pools)
+            {
+                for (auto &block : pool)
+                {
+                    if (block->mapped)
+                    {
+                        functions.unmapMemory(logicalDevice, block->memory);
+                    }
+                    functions.freeMemory(logicalDevice, block->memory, nullptr);
+                }
+                pool.clear();
+            }
+            for (auto &block : dedicatedBlocks)
+            {
+                if (block->mapped)
+                {
+                    functions.unmapMemory(logicalDevice, block->memory);
+                }
+                functions.freeMemory(logicalDevice, block->memory, nullptr);
+            }
+            dedicatedBlocks.clear();
+            bytesUsed = 0;
+            for (uint32_t i = 0; i < VK_MAX_MEMORY_HEAPS; i++)
+            {
+                heapBlockBytes[i] = 0;
+            }
+        }
+
+
+        /******************************************************************************************************************************
+        * Steer allocations by the budgets VK_EXT_memory_budget reports
+        *
+        * The extension must have been enabled when logicalDevice was created. Without it the budget of a heap is estimated as
+        * MEMORY_BUDGET_DEFAULT_SHARE of its size and only this allocator's own blocks count as usage
+        *
+        * @return False if the physical device does not expose the extension
+        ********************************************************************************************************************************/
+        inline bool computeMemoryAllocator::enableMemoryBudget()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (!sourav::Device::getDeviceCaps(physicalDevice).memoryBudget || !functions.getPhysicalDeviceMemoryProperties2)
+            {
+                return false;
+            }
+            memoryBudgetEnabled = true;
+            queryMemoryBudget();
+            return true;
+        }
+
+
+        /** @brief Snapshot the driver's budgets, allocations made after it are added on top by estimateHeapBudgets */
+        inline void computeMemoryAllocator::queryMemoryBudget()
+        {
+            VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+            budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+            VkPhysicalDeviceMemoryProperties2 properties = {};
+            properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+            properties.pNext = &budgetProperties;
+            functions.getPhysicalDeviceMemoryProperties2(physicalDevice, &properties);
+
+            for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+            {
+                queriedBudgets[i].budget = budgetProperties.heapBudget[i];
+                queriedBudgets[i].usage = budgetProperties.heapUsage[i];
+                heapBlockBytesAtQuery[i] = heapBlockBytes[i];
+            }
+            allocationsSinceQuery = 0;
+        }
+
+
+        /** @brief Current budget of every heap, the mutex must be held */
+        inline void computeMemoryAllocator::estimateHeapBudgets(computeHeapBudget *budgets)
+        {
+            if (memoryBudgetEnabled && allocationsSinceQuery >= MEMORY_BUDGET_REFRESH_INTERVAL)
+            {
+                queryMemoryBudget();
+            }
+
+            for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+            {
+                if (memoryBudgetEnabled)
+                {
+                    // Usage other processes caused since the query is unknown, this allocator's own changes are not
+                    budgets[i].budget = queriedBudgets[i].budget;
+                    budgets[i].usage = queriedBudgets[i].usage + heapBlockBytes[i] > heapBlockBytesAtQuery[i]
+                        ? queriedBudgets[i].usage + heapBlockBytes[i] - heapBlockBytesAtQuery[i]
+                        : 0;
+                }
+                else
+                {
+                    budgets[i].budget = (VkDeviceSize)((double)memoryProperties.memoryHeaps[i].size * MEMORY_BUDGET_DEFAULT_SHARE);
+                    budgets[i].usage = heapBlockBytes[i];
+                }
+            }
+        }
+
+
+        /** @brief Budget and usage of every heap, one entry per memoryProperties.memoryHeapCount */
+        inline void computeMemoryAllocator::getHeapBudgets(computeHeapBudget *budgets)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            estimateHeapBudgets(budgets);
+        }
+
+
+        /******************************************************************************************************************************
+        * Get the index of the memory type that fits usage best, using the cached memory properties
+        *
+        * Budgets are not looked at, see selectMemoryType for the ranking
+        *
+        * @param typeBits Bit mask with bits set for each memory type supported by the resource to request for (from VkMemoryRequirements)
+        * @param usage Required, preferred and avoided property flags, plain property flags are all required
+        * @param (Optional) memTypeFound Pointer to a bool that is set to true if a matching memory type has been found
+        *
+        * @return Index of the requested memory type
+        *
+        * @throw Throws an exception if memTypeFound is null and no memory type could be found that supports the requested properties
+        ********************************************************************************************************************************/
+        inline uint32_t computeMemoryAllocator::findMemoryType(uint32_t typeBits, const computeMemoryUsage &usage, VkBool32 *memTypeFound) const
+        {
+            return selectMemoryType(memoryProperties, typeBits, usage, 0, nullptr, memTypeFound);
+        }
+
+
+        inline uint32_t computeMemoryAllocator::poolIndex(uint32_t memoryTypeIndex, computeResourceTiling tiling) const
+        {
+            // With a granularity of 1 linear and optimal resources may share a page, so there is no need to split them
+            if (bufferImageGranularity <= 1)
+            {
+                return memoryTypeIndex * 2;
+            }
+            return memoryTypeIndex * 2 + (tiling == computeResourceTiling::Optimal ? 1 : 0);
+        }
+
+
+        inline computeMemoryBlock *computeMemoryAllocator::createBlock(uint32_t memoryTypeIndex, uint32_t poolIndex, VkDeviceSize size, bool dedicated)
+        {
+            VkMemoryAllocateInfo memAllocInfo = sourav::initializers::memoryAllocateInfo();
+            memAllocInfo.allocationSize = size;
+            memAllocInfo.memoryTypeIndex = memoryTypeIndex;
+
+            std::unique_ptr<computeMemoryBlock> block(new computeMemoryBlock());
+            ST_CHECK_RESULT(functions.allocateMemory(logicalDevice, &memAllocInfo, nullptr, &block->memory));
+            block->memoryTypeIndex = memoryTypeIndex;
+            block->poolIndex = poolIndex;
+            block->init(size, dedicated);
+            heapBlockBytes[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex] += size;
+            allocationsSinceQuery++;
+
+            // Host visible blocks stay mapped for their whole lifetime, memory can only be mapped once
+            if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+            {
+                ST_CHECK_RESULT(functions.mapMemory(logicalDevice, block->memory, 0, VK_WHOLE_SIZE, 0, &block->mapped));
+            }
+
+            computeMemoryBlock *result = block.get();
+            (dedicated ? dedicatedBlocks : pools[poolIndex]).push_back(std::move(block));
+            return result;
+        }
+
+
+        inline void computeMemoryAllocator::destroyBlock(computeMemoryBlock *block)
+        {
+            if (block->mapped)
+            {
+                functions.unmapMemory(logicalDevice, block->memory);
+            }
+            functions.freeMemory(logicalDevice, block->memory, nullptr);
+            heapBlockBytes[memoryProperties.memoryTypes[block->memoryTypeIndex].heapIndex] -= block->size;
+            allocationsSinceQuery++;
+
+            auto &owner = block->dedicated ? dedicatedBlocks : pools[block->poolIndex];
+            owner.erase(std::remove_if(owner.begin(), owner.end(),
+                [block](const std::unique_ptr<computeMemoryBlock> &b) { return b.get() == block; }), owner.end());
+        }
+
+
+        /******************************************************************************************************************************
+        * Sub-allocate memory for a resource
+        *
+        * A heap close to its budget is only picked when no other memory type has the required flags
+        *
+        * @param memReqs Memory requirements of the resource (size, alignment, memory type bits)
+        * @param usage Required, preferred and avoided property flags, plain property flags are all required
+        * @param tiling Whether the resource is linear (buffers, linear images) or an optimal tiled image
+        *
+        * @return The allocation, memory and offset are ready to be bound
+        ********************************************************************************************************************************/
+        inline computeAllocation computeMemoryAllocator::allocate(const VkMemoryRequirements &memReqs, const computeMemoryUsage &usage, computeResourceTiling tiling)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            computeHeapBudget budgets[VK_MAX_MEMORY_HEAPS];
+            estimateHeapBudgets(budgets);
+
+            computeAllocation allocation;
+            allocation.memoryTypeIndex = selectMemoryType(memoryProperties, memReqs.memoryTypeBits, usage, memReqs.size, budgets);
+            allocation.size = memReqs.size;
+
+            // Anything larger than half a block would waste most of a fresh block, give it its own memory
+            if (memReqs.size > blockSize / 2)
+            {
+                computeMemoryBlock *block = createBlock(allocation.memoryTypeIndex, 0, memReqs.size, true);
+                if (!block->allocate(memReqs.size, memReqs.alignment, &allocation.offset))
+                {
+                    destroyBlock(block);
+                    throw std::runtime_error("Dedicated memory block does not fit the allocation");
+                }
+                allocation.block = block;
+            }
+            else
+            {
+                uint32_t index = poolIndex(allocation.memoryTypeIndex, tiling);
+
+                for (auto &block : pools[index])
+                {
+                    if (block->allocate(memReqs.size, memReqs.alignment, &allocation.offset))
+                    {
+                        allocation.block = block.get();
+                        break;
+                    }
+                }
+
+                if (!allocation.block)
+                {
+                    computeMemoryBlock *block = createBlock(allocation.memoryTypeIndex, index, blockSize, false);
+                    // Fails if the alignment is larger than a whole block
+                    if (!block->allocate(memReqs.size, memReqs.alignment, &allocation.offset))
+                    {
+                        destroyBlock(block);
+                        throw std::runtime_error("Allocation does not fit in a fresh memory block");
+                    }
+                    allocation.block = block;
+                }
+            }
+
+            allocation.memory = allocation.block->memory;
+            if (allocation.block->mapped)
+            {
+                allocation.mapped = (uint8_t *)allocation.block->mapped + allocation.offset;
+            }
+            bytesUsed += allocation.size;
+            return allocation;
+        }
+
+
+        inline computeAllocation computeMemoryAllocator::allocateBuffer(VkBuffer buffer, const computeMemoryUsage &usage)
+        {
+            VkMemoryRequirements memReqs;
+            vkGetBufferMemoryRequirements(logicalDevice, buffer, &memReqs);
+
+            computeAllocation allocation = allocate(memReqs, usage, computeResourceTiling::Linear);
+            ST_CHECK_RESULT(vkBindBufferMemory(logicalDevice, buffer, allocation.memory, allocation.offset));
+            return allocation;
+        }
+
+
+        inline computeAllocation computeMemoryAllocator::allocateImage(VkImage image, const computeMemoryUsage &usage, VkImageTiling tiling)
+        {
+            VkMemoryRequirements memReqs;
+            vkGetImageMemoryRequirements(logicalDevice, image, &memReqs);
+
+            computeAllocation allocation = allocate(memReqs, usage,
+                tiling == VK_IMAGE_TILING_LINEAR ? computeResourceTiling::Linear : computeResourceTiling::Optimal);
+            ST_CHECK_RESULT(vkBindImageMemory(logicalDevice, image, allocation.memory, allocation.offset));
+            return allocation;
+        }
+
+
+        /** @brief Return an allocation to its block, empty blocks are released except for one spare per pool */
+        inline void computeMemoryAllocator::free(computeAllocation &allocation)
+        {
+            if (!allocation.block)
+            {
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+
+            computeMemoryBlock *block = allocation.block;
+            block->free(allocation.offset, allocation.size);
+            bytesUsed -= allocation.size;
+
+            if (block->allocationCount == 0)
+            {
+                if (block->dedicated)
+                {
+                    destroyBlock(block);
+                }
+                else
+                {
+                    // Keep one empty block around so alloc/free patterns around a block boundary don't hit the driver every time
+                    auto &pool = pools[block->poolIndex];
+                    uint32_t emptyBlocks = (uint32_t)std::count_if(pool.begin(), pool.end(),
+                        [](const std::unique_ptr<computeMemoryBlock> &b) { return b->allocationCount == 0; });
+                    if (emptyBlocks > 1)
+                    {
+                        destroyBlock(block);
+                    }
+                }
+            }
+
+            allocation = computeAllocation();
+        }
+
+
+        inline computeAllocatorStats computeMemoryAllocator::getStats()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            computeAllocatorStats stats;
+            stats.bytesUsed = bytesUsed;
+
+            for (auto &pool : pools)
+            {
+                for (auto &block : pool)
+                {
+                    stats.bytesReserved += block->size;
+                    stats.bytesFree += block->freeBytes();
+                    stats.largestFreeNode = std::max(stats.largestFreeNode, block->largestFreeNode());
+                    stats.allocationCount += block->allocationCount;
+                    stats.blockCount++;
+                }
+            }
+            for (auto &block : dedicatedBlocks)
+            {
+                stats.bytesReserved += block->size;
+                stats.allocationCount += block->allocationCount;
+                stats.blockCount++;
+            }
+
+            if (stats.bytesFree > 0)
+            {
+                stats.fragmentation = 1.0f - (float)stats.largestFreeNode / (float)stats.bytesFree;
+            }
+
+            stats.heapCount = memoryProperties.memoryHeapCount;
+            estimateHeapBudgets(stats.heaps);
+            return stats;
+        }
+    }
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <stdexcept>
+
+// A heap is treated as nearly full once an allocation would push its usage past this share of the budget
+#define MEMORY_BUDGET_HEADROOM 0.9
+// Without VK_EXT_memory_budget the budget of a heap is assumed to be this share of its size
+#define MEMORY_BUDGET_DEFAULT_SHARE 0.8
+
+namespace sourav
+{
+    namespace Memory
+    {
+        /**
+        * @brief What a resource wants from its memory type
+        *
+        * Required flags must all be present. Types are then ranked by how many preferred flags they have and how many
+        * avoided flags they lack. Plain property flags convert to a usage with everything required
+        */
+        struct computeMemoryUsage
+        {
+            VkMemoryPropertyFlags required  = 0;
+            VkMemoryPropertyFlags preferred = 0;
+            VkMemoryPropertyFlags avoided   = 0;
+
+            computeMemoryUsage() = default;
+            computeMemoryUsage(VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0, VkMemoryPropertyFlags avoided = 0)
+                : required(required), preferred(preferred), avoided(avoided)
+            {
+            }
+
+            /** @brief Only touched by the GPU */
+            static computeMemoryUsage gpuOnly()
+            {
+                return computeMemoryUsage(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+            }
+
+            /** @brief Written once by the host and copied from, kept out of the small host visible VRAM heap */
+            static computeMemoryUsage upload()
+            {
+                return computeMemoryUsage(
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            }
+
+            /** @brief Written by the host and read directly by the GPU */
+            static computeMemoryUsage dynamic()
+            {
+                return computeMemoryUsage(
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            }
+
+            /** @brief Written by the GPU and read back by the host */
+            static computeMemoryUsage readback()
+            {
+                return computeMemoryUsage(
+                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, VK_MEMORY_PROPERTY_HOST_CACHED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            }
+        };
+
+        /** @brief Bytes a heap may hold and bytes it currently holds, from VK_EXT_memory_budget or estimated */
+        struct computeHeapBudget
+        {
+            VkDeviceSize budget = 0;
+            VkDeviceSize usage  = 0;
+        };
+
+        inline uint32_t countBits(uint32_t value)
+        {
+            uint32_t count = 0;
+            for (; value; value &= value - 1)
+            {
+                count++;
+            }
+            return count;
+        }
+
+        /******************************************************************************************************************************
+        * Pick the memory type that fits usage best
+        *
+        * Candidates are ranked by, in order:
+        *  - whether the heap stays below MEMORY_BUDGET_HEADROOM of its budget with size added
+        *  - the number of missing preferred flags plus present avoided flags
+        *  - heap size, larger first
+        * so a nearly full heap is only used when no other type meets the required flags
+        *
+        * @param memoryProperties Memory types and heaps of the device
+        * @param typeBits Memory type bits of the resource (from VkMemoryRequirements)
+        * @param usage Required, preferred and avoided property flags
+        * @param size (Optional) Bytes about to be allocated, checked against the budgets
+        * @param budgets (Optional) One entry per heap, null to ignore budgets
+        * @param memTypeFound (Optional) Set to true if a type meets the required flags
+        *
+        * @return Index of the memory type
+        *
+        * @throw Throws an exception if memTypeFound is null and no memory type has the required flags
+        ********************************************************************************************************************************/
+        inline uint32_t selectMemoryType(
+            const VkPhysicalDeviceMemoryProperties &memoryProperties,
+            uint32_t                                typeBits,
+            const computeMemoryUsage               &usage,
+            VkDeviceSize                            size = 0,
+            const computeHeapBudget                *budgets = nullptr,
+            VkBool32                               *memTypeFound = nullptr)
+        {
+            // Never end up in protected or lazily allocated memory by accident
+            const VkMemoryPropertyFlags special =
+                (VK_MEMORY_PROPERTY_PROTECTED_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) & ~usage.required;
+
+            uint32_t     bestIndex = UINT32_MAX;
+            bool         bestFull = true;
+            uint32_t     bestCost = UINT32_MAX;
+            VkDeviceSize bestHeapSize = 0;
+
+            for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+            {
+                const VkMemoryType &type = memoryProperties.memoryTypes[i];
+                if (!(typeBits & (1u << i)) || (type.propertyFlags & usage.required) != usage.required || (type.propertyFlags & special))
+                {
+                    continue;
+                }
+
+                bool full = false;
+                if (budgets && budgets[type.heapIndex].budget > 0)
+                {
+                    const computeHeapBudget &budget = budgets[type.heapIndex];
+                    full = (double)(budget.usage + size) > (double)budget.budget * MEMORY_BUDGET_HEADROOM;
+                }
+                const uint32_t cost = countBits(usage.preferred & ~type.propertyFlags) + countBits(usage.avoided & type.propertyFlags);
+                const VkDeviceSize heapSize = memoryProperties.memoryHeaps[type.heapIndex].size;
+
+                const bool better =
+                    bestIndex == UINT32_MAX ||
+                    (full != bestFull ? !full :
+                    cost != bestCost ? cost < bestCost :
+                    heapSize > bestHeapSize);
+                if (better)
+                {
+                    bestIndex = i;
+                    bestFull = full;
+                    bestCost = cost;
+                    bestHeapSize = heapSize;
+                }
+            }
+
+            if (memTypeFound)
+            {
+                *memTypeFound = bestIndex != UINT32_MAX;
+            }
+            if (bestIndex != UINT32_MAX)
+            {
+                return bestIndex;
+            }
+            if (memTypeFound)
+            {
+                return 0;
+            }
+            throw std::runtime_error("Could not find a matching memory type");
+        }
+    }
+}
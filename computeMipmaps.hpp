@@ -0,0 +1,467 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ST_MIPMAPS_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define ST_MIPMAPS_NEON
+#endif
+
+#include "computeBarriers.hpp"
+#include "computeDeviceUtils.hpp"
+#include "computeFormats.hpp"
+
+namespace sourav
+{
+    namespace Mipmaps
+    {
+        /** @brief Number of levels in a full chain down to 1x1 */
+        inline uint32_t mipLevelCount(uint32_t width, uint32_t height)
+        {
+            uint32_t levels = 1;
+            for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+            {
+                levels++;
+            }
+            return levels;
+        }
+
+        /** @brief Size of one dimension at a mip level */
+        inline uint32_t mipExtent(uint32_t extent, uint32_t level)
+        {
+            return std::max(1u, extent >> level);
+        }
+
+        /** @brief Tightly packed size of one mip level */
+        inline VkDeviceSize mipLevelSize(uint32_t texelSize, uint32_t width, uint32_t height, uint32_t level)
+        {
+            return (VkDeviceSize)texelSize * mipExtent(width, level) * mipExtent(height, level);
+        }
+
+        /**
+        * @brief Number of levels in a buffer holding a tightly packed chain, largest level first
+        *
+        * Throws if bufferSize does not end exactly on a level boundary
+        */
+        inline uint32_t pregeneratedLevelCount(VkFormat format, uint32_t width, uint32_t height, VkDeviceSize bufferSize)
+        {
+            uint32_t texelSize = sourav::Formats::texelSize(format);
+            uint32_t maxLevels = mipLevelCount(width, height);
+
+            VkDeviceSize packedSize = 0;
+            for (uint32_t level = 0; level < maxLevels; level++)
+            {
+                packedSize += mipLevelSize(texelSize, width, height, level);
+                if (packedSize == bufferSize)
+                {
+                    return level + 1;
+                }
+            }
+            throw std::runtime_error("Buffer size does not match a mip chain of the given format and extent");
+        }
+
+        /**
+        * @brief Whether the chain can be generated with linear blits for optimal tiled images of this format, recorded for
+        * a queue of queueFamilyIndex. vkCmdBlitImage needs a graphics queue, compute and transfer only families can't blit
+        */
+        inline bool supportsBlitGeneration(VkPhysicalDevice physicalDevice, VkFormat format, uint32_t queueFamilyIndex)
+        {
+            const sourav::Device::computeDeviceCaps &caps = sourav::Device::getDeviceCaps(physicalDevice);
+            if (queueFamilyIndex >= caps.queueFamilies.size() || !(caps.queueFamilies[queueFamilyIndex].queueFlags & VK_QUEUE_GRAPHICS_BIT))
+            {
+                return false;
+            }
+
+            const VkFormatProperties formatProperties = caps.formatProperties(format);
+
+            const VkFormatFeatureFlags required =
+                VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+            return (formatProperties.optimalTilingFeatures & required) == required;
+        }
+
+        /******************************************************************************************************************************
+        * Record the generation of levels 1..mipLevels-1 from level 0 with linear blits
+        *
+        * Every level must be in TRANSFER_DST_OPTIMAL with level 0 already written, and the image must have been created
+        * with TRANSFER_SRC usage. All levels end up in finalLayout
+        *
+        * @param commandBuffer Command buffer to record to
+        * @param image Image to generate the chain of
+        * @param width Width of level 0
+        * @param height Height of level 0
+        * @param mipLevels Number of levels in the image
+        * @param layerCount Number of array layers, all are generated
+        * @param finalLayout Layout all levels are transitioned to
+        ********************************************************************************************************************************/
+        inline void recordBlitChain(
+            VkCommandBuffer commandBuffer,
+            VkImage         image,
+            uint32_t        width,
+            uint32_t        height,
+            uint32_t        mipLevels,
+            uint32_t        layerCount,
+            VkImageLayout   finalLayout)
+        {
+            VkImageSubresourceRange subresourceRange = {};
+            subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            subresourceRange.levelCount = 1;
+            subresourceRange.layerCount = layerCount;
+
+            for (uint32_t level = 1; level < mipLevels; level++)
+            {
+                // The previous level is complete, read from it
+                subresourceRange.baseMipLevel = level - 1;
+                sourav::utils::setImageLayout(
+                    commandBuffer,
+                    image,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    subresourceRange,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+                VkImageBlit imageBlit = {};
+                imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                imageBlit.srcSubresource.mipLevel = level - 1;
+                imageBlit.srcSubresource.layerCount = layerCount;
+                imageBlit.srcOffsets[1].x = (int32_t)mipExtent(width, level - 1);
+                imageBlit.srcOffsets[1].y = (int32_t)mipExtent(height, level - 1);
+                imageBlit.srcOffsets[1].z = 1;
+                imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                imageBlit.dstSubresource.mipLevel = level;
+                imageBlit.dstSubresource.layerCount = layerCount;
+                imageBlit.dstOffsets[1].x = (int32_t)mipExtent(width, level);
+                imageBlit.dstOffsets[1].y = (int32_t)mipExtent(height, level);
+                imageBlit.dstOffsets[1].z = 1;
+
+                vkCmdBlitImage(
+                    commandBuffer,
+                    image,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    image,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    1,
+                    &imageBlit,
+                    VK_FILTER_LINEAR);
+            }
+
+            // All but the last level were read from, the last one was only written. Both go to finalLayout in one barrier
+            sourav::Sync::computeImageState finalState = sourav::Sync::layoutState(finalLayout);
+            sourav::Sync::computeBarrierBatch barriers;
+            if (mipLevels > 1)
+            {
+                subresourceRange.baseMipLevel = 0;
+                subresourceRange.levelCount = mipLevels - 1;
+                barriers.imageBarrier(image, subresourceRange, sourav::Sync::layoutState(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL), finalState);
+            }
+
+            subresourceRange.baseMipLevel = mipLevels - 1;
+            subresourceRange.levelCount = 1;
+            barriers.imageBarrier(image, subresourceRange, sourav::Sync::layoutState(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL), finalState);
+            barriers.flush(commandBuffer);
+        }
+
+        namespace detail
+        {
+            inline float halfToFloat(uint16_t h)
+            {
+                uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+                uint32_t exponent = (h >> 10) & 0x1f;
+                uint32_t mantissa = h & 0x3ff;
+                uint32_t bits;
+
+                if (exponent == 0x1f)
+                {
+                    bits = sign | 0x7f800000 | (mantissa << 13);
+                }
+                else if (exponent != 0)
+                {
+                    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+                }
+                else if (mantissa != 0)
+                {
+                    // Denormal, renormalize
+                    exponent = 113;
+                    while (!(mantissa & 0x400))
+                    {
+                        mantissa <<= 1;
+                        exponent--;
+                    }
+                    bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+                }
+                else
+                {
+                    bits = sign;
+                }
+
+                float f;
+                memcpy(&f, &bits, sizeof(f));
+                return f;
+            }
+
+            inline uint16_t floatToHalf(float f)
+            {
+                uint32_t bits;
+                memcpy(&bits, &f, sizeof(bits));
+
+                uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+                int32_t exponent = (int32_t)((bits >> 23) & 0xff) - 112;
+                uint32_t mantissa = bits & 0x7fffff;
+
+                if (((bits >> 23) & 0xff) == 0xff)
+                {
+                    return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+                }
+                if (exponent >= 0x1f)
+                {
+                    return sign | 0x7c00;
+                }
+                if (exponent <= 0)
+                {
+                    if (exponent < -10)
+                    {
+                        return sign;
+                    }
+                    mantissa |= 0x800000;
+                    uint32_t shift = (uint32_t)(14 - exponent);
+                    uint32_t half = mantissa >> shift;
+                    // Round to nearest even
+                    uint32_t remainder = mantissa & ((1u << shift) - 1);
+                    uint32_t midpoint = 1u << (shift - 1);
+                    if (remainder > midpoint || (remainder == midpoint && (half & 1)))
+                    {
+                        half++;
+                    }
+                    return sign | (uint16_t)half;
+                }
+
+                uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+                uint32_t remainder = mantissa & 0x1fff;
+                if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+                {
+                    // May carry into the exponent, which rounds up to the next power of two or infinity as it should
+                    half++;
+                }
+                return sign | (uint16_t)half;
+            }
+
+            inline const float *srgbToLinearTable()
+            {
+                static const std::vector<float> table = []()
+                {
+                    std::vector<float> values(256);
+                    for (uint32_t i = 0; i < 256; i++)
+                    {
+                        float c = i / 255.0f;
+                        values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+                    }
+                    return values;
+                }();
+                return table.data();
+            }
+
+            inline uint8_t linearToSrgb(float linear)
+            {
+                linear = std::min(std::max(linear, 0.0f), 1.0f);
+                float c = linear <= 0.0031308f ? linear * 12.92f : 1.055f * std::pow(linear, 1.0f / 2.4f) - 0.055f;
+                return (uint8_t)(c * 255.0f + 0.5f);
+            }
+
+            /** @brief Averages of four values per component type, rounding to nearest */
+            template <typename T>
+            inline T average(T a, T b, T c, T d)
+            {
+                int64_t sum = (int64_t)a + b + c + d;
+                return (T)std::floor((sum + 2) / 4.0);
+            }
+
+            template <>
+            inline float average<float>(float a, float b, float c, float d)
+            {
+                return (a + b + c + d) * 0.25f;
+            }
+
+            template <typename T>
+            inline void boxFilterTexel(const uint8_t *s00, const uint8_t *s01, const uint8_t *s10, const uint8_t *s11, uint8_t *dst, uint32_t components)
+            {
+                for (uint32_t c = 0; c < components; c++)
+                {
+                    T a, b, e, f;
+                    memcpy(&a, s00 + c * sizeof(T), sizeof(T));
+                    memcpy(&b, s01 + c * sizeof(T), sizeof(T));
+                    memcpy(&e, s10 + c * sizeof(T), sizeof(T));
+                    memcpy(&f, s11 + c * sizeof(T), sizeof(T));
+                    T result = average<T>(a, b, e, f);
+                    memcpy(dst + c * sizeof(T), &result, sizeof(T));
+                }
+            }
+
+            inline void boxFilterHalfTexel(const uint8_t *s00, const uint8_t *s01, const uint8_t *s10, const uint8_t *s11, uint8_t *dst, uint32_t components)
+            {
+                for (uint32_t c = 0; c < components; c++)
+                {
+                    uint16_t h[4];
+                    memcpy(&h[0], s00 + c * 2, 2);
+                    memcpy(&h[1], s01 + c * 2, 2);
+                    memcpy(&h[2], s10 + c * 2, 2);
+                    memcpy(&h[3], s11 + c * 2, 2);
+                    uint16_t result = floatToHalf(average<float>(halfToFloat(h[0]), halfToFloat(h[1]), halfToFloat(h[2]), halfToFloat(h[3])));
+                    memcpy(dst + c * 2, &result, 2);
+                }
+            }
+
+            inline void boxFilterSrgbTexel(const uint8_t *s00, const uint8_t *s01, const uint8_t *s10, const uint8_t *s11, uint8_t *dst, uint32_t components)
+            {
+                const float *toLinear = srgbToLinearTable();
+                for (uint32_t c = 0; c < components; c++)
+                {
+                    if (components == 4 && c == 3)
+                    {
+                        // Alpha is stored linearly
+                        dst[c] = average<uint8_t>(s00[c], s01[c], s10[c], s11[c]);
+                    }
+                    else
+                    {
+                        dst[c] = linearToSrgb(average<float>(toLinear[s00[c]], toLinear[s01[c]], toLinear[s10[c]], toLinear[s11[c]]));
+                    }
+                }
+            }
+
+            /**
+            * @brief Vectorized 2x2 average for four 8-bit unsigned components, returns the number of destination texels done
+            *
+            * Handles two destination texels per iteration as long as all four source texels of both rows are in range
+            */
+            inline uint32_t boxFilterRowRGBA8(const uint8_t *row0, const uint8_t *row1, uint8_t *dst, uint32_t srcWidth, uint32_t dstWidth)
+            {
+                uint32_t x = 0;
+#if defined(ST_MIPMAPS_SSE2)
+                const __m128i zero = _mm_setzero_si128();
+                const __m128i bias = _mm_set1_epi16(2);
+                for (; x + 2 <= dstWidth && 2 * x + 4 <= srcWidth; x += 2)
+                {
+                    __m128i r0 = _mm_loadu_si128((const __m128i *)(row0 + x * 8));
+                    __m128i r1 = _mm_loadu_si128((const __m128i *)(row1 + x * 8));
+
+                    // Vertical sums, widened to 16 bits: texels 0,1 in lo and 2,3 in hi
+                    __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(r0, zero), _mm_unpacklo_epi8(r1, zero));
+                    __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(r0, zero), _mm_unpackhi_epi8(r1, zero));
+
+                    // Horizontal sums of the texel pairs
+                    lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+                    hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+
+                    __m128i sum = _mm_unpacklo_epi64(lo, hi);
+                    sum = _mm_srli_epi16(_mm_add_epi16(sum, bias), 2);
+                    _mm_storel_epi64((__m128i *)(dst + x * 4), _mm_packus_epi16(sum, sum));
+                }
+#elif defined(ST_MIPMAPS_NEON)
+                for (; x + 2 <= dstWidth && 2 * x + 4 <= srcWidth; x += 2)
+                {
+                    uint8x16_t r0 = vld1q_u8(row0 + x * 8);
+                    uint8x16_t r1 = vld1q_u8(row1 + x * 8);
+
+                    uint16x8_t lo = vaddl_u8(vget_low_u8(r0), vget_low_u8(r1));
+                    uint16x8_t hi = vaddl_u8(vget_high_u8(r0), vget_high_u8(r1));
+
+                    uint16x8_t sum = vcombine_u16(
+                        vadd_u16(vget_low_u16(lo), vget_high_u16(lo)),
+                        vadd_u16(vget_low_u16(hi), vget_high_u16(hi)));
+                    vst1_u8(dst + x * 4, vrshrn_n_u16(sum, 2));
+                }
+#else
+                (void)row0;
+                (void)row1;
+                (void)dst;
+                (void)srcWidth;
+                (void)dstWidth;
+#endif
+                return x;
+            }
+        }
+
+        /******************************************************************************************************************************
+        * Downsample one level to the next on the host with a 2x2 box filter
+        *
+        * Odd source dimensions drop their last row / column, like a blit would. sRGB formats are filtered in linear space.
+        * Four component 8-bit UNORM / UINT formats use SSE2 or NEON when available
+        *
+        * @param format Format of both levels, must be known to Formats::formatInfo and not packed
+        * @param src Tightly packed source level
+        * @param srcWidth Width of the source level
+        * @param srcHeight Height of the source level
+        * @param dst Receives the tightly packed level of max(1, srcWidth / 2) x max(1, srcHeight / 2)
+        ********************************************************************************************************************************/
+        inline void downsample(VkFormat format, const void *src, uint32_t srcWidth, uint32_t srcHeight, void *dst)
+        {
+            using sourav::Formats::computeComponentType;
+
+            sourav::Formats::computeFormatInfo info = sourav::Formats::formatInfo(format);
+            if (info.texelSize == 0 || info.type == computeComponentType::Packed)
+            {
+                throw std::runtime_error("Host mip generation is not supported for this format");
+            }
+
+            const uint32_t dstWidth = mipExtent(srcWidth, 1);
+            const uint32_t dstHeight = mipExtent(srcHeight, 1);
+            const size_t srcPitch = (size_t)srcWidth * info.texelSize;
+            const size_t dstPitch = (size_t)dstWidth * info.texelSize;
+            const bool vectorized = info.componentCount == 4 && info.componentSize == 1 &&
+                (info.type == computeComponentType::Unorm || info.type == computeComponentType::Uint);
+
+            for (uint32_t y = 0; y < dstHeight; y++)
+            {
+                const uint8_t *row0 = (const uint8_t *)src + std::min(2 * y, srcHeight - 1) * srcPitch;
+                const uint8_t *row1 = (const uint8_t *)src + std::min(2 * y + 1, srcHeight - 1) * srcPitch;
+                uint8_t *dstRow = (uint8_t *)dst + y * dstPitch;
+
+                uint32_t x = vectorized ? detail::boxFilterRowRGBA8(row0, row1, dstRow, srcWidth, dstWidth) : 0;
+                for (; x < dstWidth; x++)
+                {
+                    size_t x0 = (size_t)std::min(2 * x, srcWidth - 1) * info.texelSize;
+                    size_t x1 = (size_t)std::min(2 * x + 1, srcWidth - 1) * info.texelSize;
+                    uint8_t *out = dstRow + (size_t)x * info.texelSize;
+
+                    switch (info.type)
+                    {
+                        case computeComponentType::Srgb:
+                            detail::boxFilterSrgbTexel(row0 + x0, row0 + x1, row1 + x0, row1 + x1, out, info.componentCount);
+                            break;
+                        case computeComponentType::Sfloat:
+                            if (info.componentSize == 2)
+                                detail::boxFilterHalfTexel(row0 + x0, row0 + x1, row1 + x0, row1 + x1, out, info.componentCount);
+                            else
+                                detail::boxFilterTexel<float>(row0 + x0, row0 + x1, row1 + x0, row1 + x1, out, info.componentCount);
+                            break;
+                        case computeComponentType::Snorm:
+                        case computeComponentType::Sint:
+                            if (info.componentSize == 1)
+                                detail::boxFilterTexel<int8_t>(row0 + x0, row0 + x1, row1 + x0, row1 + x1, out, info.componentCount);
+                            else if (info.componentSize == 2)
+                                detail::boxFilterTexel<int16_t>(row0 + x0, row0 + x1, row1 + x0, row1 + x1, out, info.componentCount);
+                            else
+                                detail::boxFilterTexel<int32_t>(row0 + x0, row0 + x1, row1 + x0, row1 + x1, out, info.componentCount);
+                            break;
+                        default:
+                            if (info.componentSize == 1)
+                                detail::boxFilterTexel<uint8_t>(row0 + x0, row0 + x1, row1 + x0, row1 + x1, out, info.componentCount);
+                            else if (info.componentSize == 2)
+                                detail::boxFilterTexel<uint16_t>(row0 + x0, row0 + x1, row1 + x0, row1 + x1, out, info.componentCount);
+                            else
+                                detail::boxFilterTexel<uint32_t>(row0 + x0, row0 + x1, row1 + x0, row1 + x1, out, info.componentCount);
+                            break;
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,288 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "computeDescriptors.hpp"
+#include "computeDeviceUtils.hpp"
+
+// First word of every SPIR-V module
+#define SPIRV_MAGIC 0x07230203
+
+namespace sourav
+{
+    namespace Pipeline
+    {
+        /** @brief Builds the VkSpecializationInfo of a pipeline, values are packed in the order they are first set */
+        class computeSpecializationConstants
+        {
+            public:
+                template <typename T>
+                computeSpecializationConstants &set(uint32_t constantID, const T &value);
+
+                /** @brief Boolean constants are 32 bits wide in SPIR-V */
+                computeSpecializationConstants &set(uint32_t constantID, bool value)
+                {
+                    return set<VkBool32>(constantID, value ? VK_TRUE : VK_FALSE);
+                }
+
+                /** @brief Points into this object, which has to outlive the pipeline creation */
+                VkSpecializationInfo info() const;
+                bool empty() const { return entries.empty(); }
+
+            private:
+                std::vector<VkSpecializationMapEntry> entries;
+                std::vector<uint8_t>                  data;
+        };
+
+        /** @brief Everything a compute pipeline is created from */
+        struct computePipelineDesc
+        {
+            std::vector<uint32_t>                     spirv;
+            std::string                               entryPoint = "main";
+            /** @brief Bindings of descriptor set 0, a stageFlags of 0 means the compute stage */
+            std::vector<VkDescriptorSetLayoutBinding> bindings;
+            computeSpecializationConstants            specialization;
+            /** @brief Size of the push constant block in bytes, 0 for none */
+            uint32_t                                  pushConstantSize = 0;
+            /** @brief Workgroup size declared in the shader, dispatchThreads rounds up to it */
+            uint32_t                                  localSize[3] = { 1, 1, 1 };
+        };
+
+        /** @brief Read a SPIR-V binary, throws if the file is missing or is not SPIR-V */
+        inline std::vector<uint32_t> loadSPIRV(const std::string &path)
+        {
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file.is_open())
+            {
+                throw std::runtime_error("Could not open shader file " + path);
+            }
+
+            std::streamsize size = file.tellg();
+            if (size <= 0 || size % 4 != 0)
+            {
+                throw std::runtime_error("Shader file " + path + " is not a SPIR-V binary");
+            }
+
+            std::vector<uint32_t> code(static_cast<size_t>(size) / 4);
+            file.seekg(0);
+            file.read(reinterpret_cast<char *>(code.data()), size);
+            if (!file || code[0] != SPIRV_MAGIC)
+            {
+                throw std::runtime_error("Shader file " + path + " is not a SPIR-V binary");
+            }
+            return code;
+        }
+
+        /**
+        * @brief Compute pipeline with its descriptor set layout and pipeline layout
+        *
+        * Uses a single descriptor set (set 0) and an optional push constant block, both visible to the compute stage. The
+        * descriptor set layout is owned by the pipeline unless it came from a computeDescriptorLayoutCache
+        */
+        class computePipeline
+        {
+            public:
+                VkDevice              logicalDevice       = VK_NULL_HANDLE;
+                VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+                VkPipelineLayout      pipelineLayout      = VK_NULL_HANDLE;
+                VkPipeline            pipeline            = VK_NULL_HANDLE;
+                uint32_t              pushConstantSize    = 0;
+                uint32_t              localSize[3]        = { 1, 1, 1 };
+
+                void create(
+                    VkDevice                                          logicalDevice,
+                    const computePipelineDesc                        &desc,
+                    VkPipelineCache                                   pipelineCache = VK_NULL_HANDLE,
+                    sourav::Descriptor::computeDescriptorLayoutCache *layoutCache   = nullptr);
+                void destroy();
+
+                void bind(VkCommandBuffer commandBuffer);
+                void bindDescriptorSet(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet);
+                void pushConstants(VkCommandBuffer commandBuffer, const void *data, uint32_t size, uint32_t offset = 0);
+                void dispatch(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1);
+                void dispatchThreads(VkCommandBuffer commandBuffer, uint32_t threadCountX, uint32_t threadCountY = 1, uint32_t threadCountZ = 1);
+
+            private:
+                bool ownsDescriptorSetLayout = true;
+        };
+
+
+        template <typename T>
+        inline computeSpecializationConstants &computeSpecializationConstants::set(uint32_t constantID, const T &value)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "Specialization constants must be trivially copyable");
+
+            for (const VkSpecializationMapEntry &entry : entries)
+            {
+                if (entry.constantID == constantID)
+                {
+                    if (entry.size != sizeof(T))
+                    {
+                        throw std::runtime_error("Specialization constant set again with a different size");
+                    }
+                    memcpy(data.data() + entry.offset, &value, sizeof(T));
+                    return *this;
+                }
+            }
+
+            VkSpecializationMapEntry entry;
+            entry.constantID = constantID;
+            entry.offset = static_cast<uint32_t>(data.size());
+            entry.size = sizeof(T);
+            entries.push_back(entry);
+
+            data.resize(data.size() + sizeof(T));
+            memcpy(data.data() + entry.offset, &value, sizeof(T));
+            return *this;
+        }
+
+
+        inline VkSpecializationInfo computeSpecializationConstants::info() const
+        {
+            VkSpecializationInfo specializationInfo = {};
+            specializationInfo.mapEntryCount = static_cast<uint32_t>(entries.size());
+            specializationInfo.pMapEntries = entries.data();
+            specializationInfo.dataSize = data.size();
+            specializationInfo.pData = data.data();
+            return specializationInfo;
+        }
+
+
+        /******************************************************************************************************************************
+        * Create the layouts and the pipeline
+        *
+        * The shader module only lives for the duration of this call
+        *
+        * @param logicalDevice Device the pipeline is created on
+        * @param desc Shader, bindings and constants of the pipeline
+        * @param pipelineCache (Optional) Cache to create the pipeline through, see computePipelineCache
+        * @param layoutCache (Optional) Cache to take the descriptor set layout from, so pipelines with the same bindings share
+        *        one layout and sets allocated for it
+        ********************************************************************************************************************************/
+        inline void computePipeline::create(
+            VkDevice                                          logicalDevice,
+            const computePipelineDesc                        &desc,
+            VkPipelineCache                                   pipelineCache,
+            sourav::Descriptor::computeDescriptorLayoutCache *layoutCache)
+        {
+            this->logicalDevice = logicalDevice;
+            pushConstantSize = desc.pushConstantSize;
+            memcpy(localSize, desc.localSize, sizeof(localSize));
+
+            if (desc.spirv.empty() || desc.spirv[0] != SPIRV_MAGIC)
+            {
+                throw std::runtime_error("Compute pipeline needs a SPIR-V module");
+            }
+
+            std::vector<VkDescriptorSetLayoutBinding> bindings = desc.bindings;
+            for (VkDescriptorSetLayoutBinding &binding : bindings)
+            {
+                if (binding.stageFlags == 0)
+                {
+                    binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+                }
+            }
+
+            ownsDescriptorSetLayout = layoutCache == nullptr;
+            if (layoutCache)
+            {
+                descriptorSetLayout = layoutCache->getLayout(bindings);
+            }
+            else
+            {
+                VkDescriptorSetLayoutCreateInfo descriptorLayout =
+                    sourav::initializers::descriptorSetLayoutCreateInfo(bindings.data(), static_cast<uint32_t>(bindings.size()));
+                ST_CHECK_RESULT(vkCreateDescriptorSetLayout(logicalDevice, &descriptorLayout, nullptr, &descriptorSetLayout));
+            }
+
+            VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = sourav::initializers::pipelineLayoutCreateInfo(&descriptorSetLayout, 1);
+            VkPushConstantRange pushConstantRange = sourav::initializers::pushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT, pushConstantSize, 0);
+            if (pushConstantSize > 0)
+            {
+                pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+                pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+            }
+            ST_CHECK_RESULT(vkCreatePipelineLayout(logicalDevice, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout));
+
+            VkShaderModuleCreateInfo moduleCreateInfo =
+                sourav::initializers::shaderModuleCreateInfo(desc.spirv.data(), desc.spirv.size() * sizeof(uint32_t));
+            VkShaderModule shaderModule;
+            ST_CHECK_RESULT(vkCreateShaderModule(logicalDevice, &moduleCreateInfo, nullptr, &shaderModule));
+
+            VkSpecializationInfo specializationInfo = desc.specialization.info();
+
+            VkComputePipelineCreateInfo computePipelineCreateInfo = sourav::initializers::computePipelineCreateInfo(pipelineLayout);
+            computePipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            computePipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            computePipelineCreateInfo.stage.module = shaderModule;
+            computePipelineCreateInfo.stage.pName = desc.entryPoint.c_str();
+            computePipelineCreateInfo.stage.pSpecializationInfo = desc.specialization.empty() ? nullptr : &specializationInfo;
+            ST_CHECK_RESULT(vkCreateComputePipelines(logicalDevice, pipelineCache, 1, &computePipelineCreateInfo, nullptr, &pipeline));
+
+            vkDestroyShaderModule(logicalDevice, shaderModule, nullptr);
+        }
+
+
+        inline void computePipeline::destroy()
+        {
+            if (logicalDevice == VK_NULL_HANDLE)
+            {
+                return;
+            }
+
+            vkDestroyPipeline(logicalDevice, pipeline, nullptr);
+            vkDestroyPipelineLayout(logicalDevice, pipelineLayout, nullptr);
+            if (ownsDescriptorSetLayout)
+            {
+                vkDestroyDescriptorSetLayout(logicalDevice, descriptorSetLayout, nullptr);
+            }
+            pipeline = VK_NULL_HANDLE;
+            pipelineLayout = VK_NULL_HANDLE;
+            descriptorSetLayout = VK_NULL_HANDLE;
+            logicalDevice = VK_NULL_HANDLE;
+        }
+
+
+        inline void computePipeline::bind(VkCommandBuffer commandBuffer)
+        {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+        }
+
+
+        inline void computePipeline::bindDescriptorSet(VkCommandBuffer commandBuffer, VkDescriptorSet descriptorSet)
+        {
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+        }
+
+
+        inline void computePipeline::pushConstants(VkCommandBuffer commandBuffer, const void *data, uint32_t size, uint32_t offset)
+        {
+            assert(offset + size <= pushConstantSize);
+            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, offset, size, data);
+        }
+
+
+        inline void computePipeline::dispatch(VkCommandBuffer commandBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+        {
+            vkCmdDispatch(commandBuffer, groupCountX, groupCountY, groupCountZ);
+        }
+
+
+        /** @brief Dispatch enough workgroups to cover the given number of invocations, the shader must bounds check */
+        inline void computePipeline::dispatchThreads(VkCommandBuffer commandBuffer, uint32_t threadCountX, uint32_t threadCountY, uint32_t threadCountZ)
+        {
+            vkCmdDispatch(
+                commandBuffer,
+                (threadCountX + localSize[0] - 1) / localSize[0],
+                (threadCountY + localSize[1] - 1) / localSize[1],
+                (threadCountZ + localSize[2] - 1) / localSize[2]);
+        }
+    }
+}
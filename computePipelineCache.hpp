@@ -0,0 +1,249 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "computeDeviceUtils.hpp"
+
+// "STPC", first word of a pipeline cache file
+#define PIPELINE_CACHE_FILE_MAGIC 0x43505453
+#define PIPELINE_CACHE_FILE_VERSION 1
+
+namespace sourav
+{
+    namespace Pipeline
+    {
+        /** @brief Header written in front of the driver's cache data */
+        struct computePipelineCacheFileHeader
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t vendorID;
+            uint32_t deviceID;
+            uint32_t driverVersion;
+            uint8_t  pipelineCacheUUID[VK_UUID_SIZE];
+            uint64_t dataSize;
+            uint64_t checksum;
+        };
+
+        /**
+        * @brief VkPipelineCache that is loaded from and saved to disk
+        *
+        * The file name holds the device's pipelineCacheUUID and driverVersion, so a driver update or another GPU starts
+        * from an empty cache instead of feeding the driver data it cannot use. The header and the driver's own cache
+        * header are validated before the data is handed to vkCreatePipelineCache, a corrupt or truncated file is ignored
+        */
+        class computePipelineCache
+        {
+            public:
+                VkPipelineCache cache = VK_NULL_HANDLE;
+                std::string     path;
+                /** @brief True if the cache was created from a valid file */
+                bool            loadedFromDisk = false;
+
+                void create(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, const std::string &directory);
+                bool save();
+                void destroy();
+
+            private:
+                VkDevice                   logicalDevice = VK_NULL_HANDLE;
+                VkPhysicalDeviceProperties properties = {};
+
+                static uint64_t checksum(const uint8_t *data, size_t size);
+                bool readFile(std::vector<uint8_t> &data);
+        };
+
+
+        /** @brief FNV-1a, only guards against truncated or damaged files */
+        inline uint64_t computePipelineCache::checksum(const uint8_t *data, size_t size)
+        {
+            uint64_t hash = 14695981039346656037ull;
+            for (size_t i = 0; i < size; i++)
+            {
+                hash ^= data[i];
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+
+
+        /******************************************************************************************************************************
+        * Create the pipeline cache, seeded from the file for this device and driver if there is a valid one
+        *
+        * @param physicalDevice Physical device logicalDevice was created from
+        * @param logicalDevice Device the cache is created on
+        * @param directory Existing directory the cache file is kept in
+        ********************************************************************************************************************************/
+        inline void computePipelineCache::create(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, const std::string &directory)
+        {
+            this->logicalDevice = logicalDevice;
+            properties = sourav::Device::getDeviceCaps(physicalDevice).properties;
+
+            char key[2 * VK_UUID_SIZE + 1];
+            for (uint32_t i = 0; i < VK_UUID_SIZE; i++)
+            {
+                snprintf(key + 2 * i, 3, "%02x", properties.pipelineCacheUUID[i]);
+            }
+            char driver[9];
+            snprintf(driver, sizeof(driver), "%08x", properties.driverVersion);
+
+            path = directory;
+            if (!path.empty() && path.back() != '/' && path.back() != '\\')
+            {
+                path += '/';
+            }
+            path += std::string("pipeline_cache_") + key + "_" + driver + ".bin";
+
+            std::vector<uint8_t> data;
+            loadedFromDisk = readFile(data);
+
+            VkPipelineCacheCreateInfo pipelineCacheCreateInfo = sourav::initializers::pipelineCacheCreateInfo();
+            if (loadedFromDisk)
+            {
+                pipelineCacheCreateInfo.initialDataSize = data.size();
+                pipelineCacheCreateInfo.pInitialData = data.data();
+            }
+            ST_CHECK_RESULT(vkCreatePipelineCache(logicalDevice, &pipelineCacheCreateInfo, nullptr, &cache));
+        }
+
+
+        /** @brief Read and validate the cache file, false if it is missing or does not belong to this device and driver */
+        inline bool computePipelineCache::readFile(std::vector<uint8_t> &data)
+        {
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file.is_open())
+            {
+                return false;
+            }
+
+            std::streamoff fileSize = file.tellg();
+            if (fileSize < static_cast<std::streamoff>(sizeof(computePipelineCacheFileHeader)) || !file.seekg(0))
+            {
+                return false;
+            }
+
+            computePipelineCacheFileHeader header;
+            if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)))
+            {
+                return false;
+            }
+
+            if (header.magic != PIPELINE_CACHE_FILE_MAGIC ||
+                header.version != PIPELINE_CACHE_FILE_VERSION ||
+                header.vendorID != properties.vendorID ||
+                header.deviceID != properties.deviceID ||
+                header.driverVersion != properties.driverVersion ||
+                memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0 ||
+                header.dataSize < sizeof(VkPipelineCacheHeaderVersionOne) ||
+                header.dataSize != static_cast<uint64_t>(fileSize) - sizeof(header))
+            {
+                // A damaged dataSize is never used to size the read, the file has to hold exactly that much
+                return false;
+            }
+
+            data.resize(header.dataSize);
+            if (!file.read(reinterpret_cast<char *>(data.data()), data.size()) || checksum(data.data(), data.size()) != header.checksum)
+            {
+                return false;
+            }
+
+            // The driver's own header has to agree as well
+            VkPipelineCacheHeaderVersionOne cacheHeader;
+            memcpy(&cacheHeader, data.data(), sizeof(cacheHeader));
+            return cacheHeader.headerSize >= sizeof(VkPipelineCacheHeaderVersionOne) &&
+                cacheHeader.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+                cacheHeader.vendorID == properties.vendorID &&
+                cacheHeader.deviceID == properties.deviceID &&
+                memcmp(cacheHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+        }
+
+
+        /******************************************************************************************************************************
+        * Write the current cache contents to disk
+        *
+        * The data goes to a uniquely named temporary file that replaces the old one, so a crash while saving never leaves a
+        * partial cache and two processes saving at once do not write into the same file
+        *
+        * @return False if the file could not be written, the cache itself stays usable
+        ********************************************************************************************************************************/
+        inline bool computePipelineCache::save()
+        {
+            if (cache == VK_NULL_HANDLE)
+            {
+                return false;
+            }
+
+            size_t dataSize = 0;
+            ST_CHECK_RESULT(vkGetPipelineCacheData(logicalDevice, cache, &dataSize, nullptr));
+            std::vector<uint8_t> data(dataSize);
+            ST_CHECK_RESULT(vkGetPipelineCacheData(logicalDevice, cache, &dataSize, data.data()));
+            data.resize(dataSize);
+
+            if (dataSize < sizeof(VkPipelineCacheHeaderVersionOne))
+            {
+                return false;
+            }
+
+            computePipelineCacheFileHeader header = {};
+            header.magic = PIPELINE_CACHE_FILE_MAGIC;
+            header.version = PIPELINE_CACHE_FILE_VERSION;
+            header.vendorID = properties.vendorID;
+            header.deviceID = properties.deviceID;
+            header.driverVersion = properties.driverVersion;
+            memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+            header.dataSize = dataSize;
+            header.checksum = checksum(data.data(), data.size());
+
+            std::random_device random;
+            char suffix[20];
+            snprintf(suffix, sizeof(suffix), ".%08x%08x", random(), random());
+            std::string temporaryPath = path + suffix + ".tmp";
+            {
+                std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+                if (!file.is_open())
+                {
+                    return false;
+                }
+                file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+                file.write(reinterpret_cast<const char *>(data.data()), data.size());
+                if (!file.flush())
+                {
+                    file.close();
+                    std::remove(temporaryPath.c_str());
+                    return false;
+                }
+            }
+
+#ifdef _WIN32
+            // rename() does not replace an existing file on Windows
+            std::remove(path.c_str());
+#endif
+            if (std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+            {
+                std::remove(temporaryPath.c_str());
+                return false;
+            }
+            return true;
+        }
+
+
+        /** @brief Save and destroy the cache, pipelines created from it stay valid */
+        inline void computePipelineCache::destroy()
+        {
+            if (cache == VK_NULL_HANDLE)
+            {
+                return;
+            }
+
+            save();
+            vkDestroyPipelineCache(logicalDevice, cache, nullptr);
+            cache = VK_NULL_HANDLE;
+        }
+    }
+}
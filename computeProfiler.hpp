@@ -0,0 +1,618 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "computeDeviceCaps.hpp"
+#include "computeDeviceUtils.hpp"
+
+// Queries per timestamp query pool, every scope takes two
+#define PROFILER_TIMESTAMP_POOL_SIZE 512
+// Queries per pipeline statistics query pool, every scope with statistics takes one
+#define PROFILER_STATISTICS_POOL_SIZE 64
+// Finished scopes kept for the trace, later ones still count towards the stats
+#define PROFILER_MAX_TRACE_EVENTS 65536
+
+namespace sourav
+{
+    namespace Profiler
+    {
+        /** @brief GPU time of every finished scope with one label, in nanoseconds */
+        struct computeProfileStats
+        {
+            std::string label;
+            uint64_t    count = 0;
+            double      mean  = 0.0;
+            double      p50   = 0.0;
+            double      p99   = 0.0;
+            double      min   = 0.0;
+            double      max   = 0.0;
+            /** @brief Mean compute shader invocations of the scopes that recorded pipeline statistics */
+            double      invocations = 0.0;
+        };
+
+        /** @brief One finished scope, start is in nanoseconds from the earliest scope kept */
+        struct computeProfileEvent
+        {
+            std::string label;
+            double      start       = 0.0;
+            double      duration    = 0.0;
+            /** @brief Small index of the thread that recorded the scope */
+            uint32_t    thread      = 0;
+            bool        statistics  = false;
+            uint64_t    invocations = 0;
+        };
+
+        /**
+        * @brief GPU timestamps and pipeline statistics for labelled ranges of command buffers
+        *
+        * A scope writes a timestamp at its begin and end, and optionally counts compute shader invocations. Queries come
+        * from pools that grow on demand and are recycled like staging memory: a scope belongs to a submission value and
+        * its results are read by collect() once that submission has completed. Queries are only recorded where the
+        * command buffer's queue family can run them: resetting and beginning queries needs a graphics or compute family,
+        * timestamps need timestampValidBits, so scopes on transfer-only families are labels only. Labels also go to
+        * VK_EXT_debug_utils after enableDebugLabels(), so captures in RenderDoc or Nsight show the same ranges
+        */
+        class computeProfiler
+        {
+            public:
+                VkDevice logicalDevice   = VK_NULL_HANDLE;
+                /** @brief Nanoseconds per timestamp tick */
+                double   timestampPeriod = 1.0;
+                /** @brief Valid timestamp bits of the create() queue family, 0 if its queues cannot write timestamps */
+                uint64_t timestampMask   = 0;
+
+                void create(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, uint32_t queueFamilyIndex, bool pipelineStatistics = false);
+                void destroy();
+
+                bool enableDebugLabels(VkInstance instance);
+
+                uint64_t beginScope(
+                    VkCommandBuffer commandBuffer,
+                    const char     *label,
+                    uint64_t        submissionValue,
+                    bool            statistics       = false,
+                    uint32_t        queueFamilyIndex = VK_QUEUE_FAMILY_IGNORED);
+                void endScope(VkCommandBuffer commandBuffer, uint64_t scope);
+
+                uint32_t collect(uint64_t completedValue);
+                void reset();
+
+                std::vector<computeProfileStats> getStats();
+                std::vector<computeProfileEvent> getEvents();
+                bool writeChromeTrace(const std::string &path);
+
+            private:
+                struct scopeRecord
+                {
+                    std::string     label;
+                    uint64_t        submissionValue = 0;
+                    VkCommandBuffer commandBuffer   = VK_NULL_HANDLE;
+                    uint32_t        timestampSlot   = UINT32_MAX;
+                    uint64_t        timestampMask   = 0;
+                    uint32_t        statisticsSlot  = UINT32_MAX;
+                    uint32_t        thread          = 0;
+                    bool            ended           = false;
+                };
+
+                struct traceEvent
+                {
+                    std::string label;
+                    uint64_t    begin;
+                    double      duration;
+                    uint32_t    thread;
+                    bool        statistics;
+                    uint64_t    invocations;
+                };
+
+                /** @brief What the queues of one family can record */
+                struct queueFamilyQueries
+                {
+                    uint64_t timestampMask = 0;
+                    // vkCmdResetQueryPool and vkCmdBeginQuery need a graphics or compute queue
+                    bool     queries       = false;
+                };
+
+                struct labelSamples
+                {
+                    std::vector<double> durations;
+                    uint64_t            invocations = 0;
+                    uint64_t            statisticsCount = 0;
+                };
+
+                std::mutex mutex;
+                bool       pipelineStatistics = false;
+
+                uint32_t                        queueFamilyIndex = 0;
+                std::vector<queueFamilyQueries> queueFamilies;
+
+                std::vector<VkQueryPool> timestampPools;
+                std::vector<uint32_t>    freeTimestampSlots;
+                std::vector<VkQueryPool> statisticsPools;
+                std::vector<uint32_t>    freeStatisticsSlots;
+
+                uint64_t                                      nextScope = 1;
+                std::unordered_map<uint64_t, scopeRecord>     scopes;
+                // Statistics queries of one type cannot nest, only the outermost scope of a command buffer gets one
+                std::unordered_map<VkCommandBuffer, uint64_t> activeStatistics;
+                std::unordered_map<std::thread::id, uint32_t> threadIndices;
+
+                std::unordered_map<std::string, labelSamples> samples;
+                std::vector<traceEvent>                       events;
+
+                PFN_vkCmdBeginDebugUtilsLabelEXT beginDebugLabel = nullptr;
+                PFN_vkCmdEndDebugUtilsLabelEXT   endDebugLabel   = nullptr;
+
+                uint32_t acquireSlot(std::vector<VkQueryPool> &pools, std::vector<uint32_t> &freeSlots, VkQueryType type, uint32_t poolSize);
+        };
+
+        /**
+        * @brief Profiler scope that ends when it goes out of scope
+        *
+        * A null profiler makes it a no-op, so call sites can be instrumented unconditionally
+        */
+        class computeProfileScope
+        {
+            public:
+                computeProfileScope(
+                    computeProfiler *profiler,
+                    VkCommandBuffer  commandBuffer,
+                    const char      *label,
+                    uint64_t         submissionValue,
+                    bool             statistics       = false,
+                    uint32_t         queueFamilyIndex = VK_QUEUE_FAMILY_IGNORED)
+                    : profiler(profiler), commandBuffer(commandBuffer)
+                {
+                    if (profiler)
+                    {
+                        scope = profiler->beginScope(commandBuffer, label, submissionValue, statistics, queueFamilyIndex);
+                    }
+                }
+
+                ~computeProfileScope()
+                {
+                    if (profiler)
+                    {
+                        profiler->endScope(commandBuffer, scope);
+                    }
+                }
+
+                computeProfileScope(const computeProfileScope &) = delete;
+                computeProfileScope &operator=(const computeProfileScope &) = delete;
+
+            private:
+                computeProfiler *profiler;
+                VkCommandBuffer  commandBuffer;
+                uint64_t         scope = 0;
+        };
+
+
+        /******************************************************************************************************************************
+        * Set up the profiler
+        *
+        * @param physicalDevice Physical device logicalDevice was created from
+        * @param logicalDevice Device the query pools are created on
+        * @param queueFamilyIndex Family of the queues the profiled command buffers are submitted to, scopes can name
+        *        another one
+        * @param pipelineStatistics True if the pipelineStatisticsQuery feature was enabled on logicalDevice, the device
+        * cannot be asked whether it is on. Scopes asking for statistics without it only get timestamps
+        ********************************************************************************************************************************/
+        inline void computeProfiler::create(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, uint32_t queueFamilyIndex, bool pipelineStatistics)
+        {
+            this->logicalDevice = logicalDevice;
+            this->pipelineStatistics = pipelineStatistics;
+
+            const sourav::Device::computeDeviceCaps &caps = sourav::Device::getDeviceCaps(physicalDevice);
+            timestampPeriod = caps.properties.limits.timestampPeriod;
+
+            queueFamilies.clear();
+            for (const VkQueueFamilyProperties &family : caps.queueFamilies)
+            {
+                queueFamilyQueries queries;
+                queries.timestampMask = family.timestampValidBits >= 64 ? UINT64_MAX : (1ull << family.timestampValidBits) - 1;
+                queries.queries = (family.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) != 0;
+                queueFamilies.push_back(queries);
+            }
+
+            this->queueFamilyIndex = queueFamilyIndex;
+            timestampMask = queueFamilyIndex < queueFamilies.size() ? queueFamilies[queueFamilyIndex].timestampMask : 0;
+        }
+
+
+        /** @brief Destroy the query pools, no command buffer with a scope may still be pending */
+        inline void computeProfiler::destroy()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            for (VkQueryPool pool : timestampPools)
+            {
+                vkDestroyQueryPool(logicalDevice, pool, nullptr);
+            }
+            for (VkQueryPool pool : statisticsPools)
+            {
+                vkDestroyQueryPool(logicalDevice, pool, nullptr);
+            }
+            timestampPools.clear();
+            freeTimestampSlots.clear();
+            statisticsPools.clear();
+            freeStatisticsSlots.clear();
+            scopes.clear();
+            activeStatistics.clear();
+        }
+
+
+        /******************************************************************************************************************************
+        * Also emit every scope as a VK_EXT_debug_utils label
+        *
+        * @param instance Instance created with VK_EXT_debug_utils enabled
+        *
+        * @return False if the instance does not expose the label entry points
+        ********************************************************************************************************************************/
+        inline bool computeProfiler::enableDebugLabels(VkInstance instance)
+        {
+            beginDebugLabel = reinterpret_cast<PFN_vkCmdBeginDebugUtilsLabelEXT>(vkGetInstanceProcAddr(instance, "vkCmdBeginDebugUtilsLabelEXT"));
+            endDebugLabel = reinterpret_cast<PFN_vkCmdEndDebugUtilsLabelEXT>(vkGetInstanceProcAddr(instance, "vkCmdEndDebugUtilsLabelEXT"));
+            if (!beginDebugLabel || !endDebugLabel)
+            {
+                beginDebugLabel = nullptr;
+                endDebugLabel = nullptr;
+                return false;
+            }
+            return true;
+        }
+
+
+        /******************************************************************************************************************************
+        * Open a labelled range in a command buffer
+        *
+        * Timestamps are written at the top of the pipe for the begin and the bottom of the pipe for the end, so a scope
+        * covers its commands from the moment they may start until everything before its end has finished
+        *
+        * @param commandBuffer Command buffer in the recording state, outside of a render pass
+        * @param label Name the range is aggregated and exported under
+        * @param submissionValue Submission commandBuffer will be part of, results are read once it has completed
+        * @param statistics Count compute shader invocations, ignored without the feature or inside another statistics scope
+        * @param queueFamilyIndex Family commandBuffer was allocated for, VK_QUEUE_FAMILY_IGNORED for the one given to create().
+        *        Queries the family cannot record are left out
+        *
+        * @return Handle for endScope
+        ********************************************************************************************************************************/
+        inline uint64_t computeProfiler::beginScope(
+            VkCommandBuffer commandBuffer,
+            const char     *label,
+            uint64_t        submissionValue,
+            bool            statistics,
+            uint32_t        queueFamilyIndex)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if (queueFamilyIndex == VK_QUEUE_FAMILY_IGNORED)
+            {
+                queueFamilyIndex = this->queueFamilyIndex;
+            }
+            const queueFamilyQueries family = queueFamilyIndex < queueFamilies.size() ? queueFamilies[queueFamilyIndex] : queueFamilyQueries();
+
+            uint64_t scope = nextScope++;
+            scopeRecord &record = scopes[scope];
+            record.label = label;
+            record.submissionValue = submissionValue;
+            record.commandBuffer = commandBuffer;
+
+            auto thread = threadIndices.emplace(std::this_thread::get_id(), static_cast<uint32_t>(threadIndices.size()));
+            record.thread = thread.first->second;
+
+            if (beginDebugLabel)
+            {
+                VkDebugUtilsLabelEXT debugLabel = {};
+                debugLabel.sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_LABEL_EXT;
+                debugLabel.pLabelName = label;
+                beginDebugLabel(commandBuffer, &debugLabel);
+            }
+
+            if (family.queries && family.timestampMask != 0)
+            {
+                record.timestampMask = family.timestampMask;
+                record.timestampSlot = acquireSlot(timestampPools, freeTimestampSlots, VK_QUERY_TYPE_TIMESTAMP, PROFILER_TIMESTAMP_POOL_SIZE / 2);
+                VkQueryPool pool = timestampPools[record.timestampSlot / (PROFILER_TIMESTAMP_POOL_SIZE / 2)];
+                uint32_t query = record.timestampSlot % (PROFILER_TIMESTAMP_POOL_SIZE / 2) * 2;
+
+                // Reset in the command buffer, host resets need hostQueryReset
+                vkCmdResetQueryPool(commandBuffer, pool, query, 2);
+                vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, pool, query);
+            }
+
+            if (statistics && pipelineStatistics && family.queries && activeStatistics.find(commandBuffer) == activeStatistics.end())
+            {
+                record.statisticsSlot = acquireSlot(statisticsPools, freeStatisticsSlots, VK_QUERY_TYPE_PIPELINE_STATISTICS, PROFILER_STATISTICS_POOL_SIZE);
+                VkQueryPool pool = statisticsPools[record.statisticsSlot / PROFILER_STATISTICS_POOL_SIZE];
+                uint32_t query = record.statisticsSlot % PROFILER_STATISTICS_POOL_SIZE;
+
+                vkCmdResetQueryPool(commandBuffer, pool, query, 1);
+                vkCmdBeginQuery(commandBuffer, pool, query, 0);
+                activeStatistics[commandBuffer] = scope;
+            }
+
+            return scope;
+        }
+
+
+        /** @brief Close a range opened by beginScope on the same command buffer, scopes must nest */
+        inline void computeProfiler::endScope(VkCommandBuffer commandBuffer, uint64_t scope)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            auto it = scopes.find(scope);
+            if (it == scopes.end() || it->second.ended)
+            {
+                return;
+            }
+            scopeRecord &record = it->second;
+
+            if (record.statisticsSlot != UINT32_MAX)
+            {
+                vkCmdEndQuery(commandBuffer, statisticsPools[record.statisticsSlot / PROFILER_STATISTICS_POOL_SIZE],
+                    record.statisticsSlot % PROFILER_STATISTICS_POOL_SIZE);
+                activeStatistics.erase(commandBuffer);
+            }
+
+            if (record.timestampSlot != UINT32_MAX)
+            {
+                vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                    timestampPools[record.timestampSlot / (PROFILER_TIMESTAMP_POOL_SIZE / 2)],
+                    record.timestampSlot % (PROFILER_TIMESTAMP_POOL_SIZE / 2) * 2 + 1);
+            }
+
+            if (endDebugLabel)
+            {
+                endDebugLabel(commandBuffer);
+            }
+
+            record.ended = true;
+        }
+
+
+        /******************************************************************************************************************************
+        * Read the results of every ended scope whose submission has completed and recycle its queries
+        *
+        * Scopes of submissions that have not completed yet are left for a later call. Reading waits for nothing, since
+        * the results of a completed submission are available
+        *
+        * @param completedValue Every submission up to and including this value has completed (completedSubmission)
+        *
+        * @return Number of scopes collected
+        ********************************************************************************************************************************/
+        inline uint32_t computeProfiler::collect(uint64_t completedValue)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            uint32_t collected = 0;
+            for (auto it = scopes.begin(); it != scopes.end();)
+            {
+                scopeRecord &record = it->second;
+                if (!record.ended || record.submissionValue > completedValue)
+                {
+                    ++it;
+                    continue;
+                }
+
+                // Value and availability of each query
+                uint64_t timestamps[4] = {};
+                uint64_t invocations[2] = {};
+                bool timed = false;
+                bool counted = false;
+
+                if (record.timestampSlot != UINT32_MAX)
+                {
+                    VkResult result = vkGetQueryPoolResults(logicalDevice,
+                        timestampPools[record.timestampSlot / (PROFILER_TIMESTAMP_POOL_SIZE / 2)],
+                        record.timestampSlot % (PROFILER_TIMESTAMP_POOL_SIZE / 2) * 2, 2,
+                        sizeof(timestamps), timestamps, sizeof(uint64_t) * 2,
+                        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+                    timed = result == VK_SUCCESS && timestamps[1] != 0 && timestamps[3] != 0;
+                    freeTimestampSlots.push_back(record.timestampSlot);
+                }
+                if (record.statisticsSlot != UINT32_MAX)
+                {
+                    VkResult result = vkGetQueryPoolResults(logicalDevice,
+                        statisticsPools[record.statisticsSlot / PROFILER_STATISTICS_POOL_SIZE],
+                        record.statisticsSlot % PROFILER_STATISTICS_POOL_SIZE, 1,
+                        sizeof(invocations), invocations, sizeof(invocations),
+                        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+                    counted = result == VK_SUCCESS && invocations[1] != 0;
+                    freeStatisticsSlots.push_back(record.statisticsSlot);
+                }
+
+                if (timed)
+                {
+                    const uint64_t ticks = (timestamps[2] - timestamps[0]) & record.timestampMask;
+                    const double duration = static_cast<double>(ticks) * timestampPeriod;
+
+                    labelSamples &label = samples[record.label];
+                    label.durations.push_back(duration);
+                    if (counted)
+                    {
+                        label.invocations += invocations[0];
+                        label.statisticsCount++;
+                    }
+
+                    if (events.size() < PROFILER_MAX_TRACE_EVENTS)
+                    {
+                        events.push_back({ record.label, timestamps[0] & record.timestampMask, duration, record.thread, counted, invocations[0] });
+                    }
+                    collected++;
+                }
+
+                it = scopes.erase(it);
+            }
+            return collected;
+        }
+
+
+        /** @brief Drop the aggregated samples and trace events, pending scopes are kept */
+        inline void computeProfiler::reset()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            samples.clear();
+            events.clear();
+        }
+
+
+        /** @brief Count, mean, min, max, p50 and p99 per label (nearest rank), sorted by total time, largest first */
+        inline std::vector<computeProfileStats> computeProfiler::getStats()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            std::vector<computeProfileStats> result;
+            std::vector<double> totals;
+            for (auto &entry : samples)
+            {
+                std::vector<double> sorted = entry.second.durations;
+                std::sort(sorted.begin(), sorted.end());
+
+                computeProfileStats stats;
+                stats.label = entry.first;
+                stats.count = sorted.size();
+
+                double total = 0.0;
+                for (double duration : sorted)
+                {
+                    total += duration;
+                }
+                stats.mean = total / sorted.size();
+                stats.min = sorted.front();
+                stats.max = sorted.back();
+
+                auto percentile = [&sorted](double p)
+                {
+                    size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+                    return sorted[std::max<size_t>(rank, 1) - 1];
+                };
+                stats.p50 = percentile(0.50);
+                stats.p99 = percentile(0.99);
+
+                if (entry.second.statisticsCount > 0)
+                {
+                    stats.invocations = static_cast<double>(entry.second.invocations) / entry.second.statisticsCount;
+                }
+
+                result.push_back(stats);
+            }
+
+            std::sort(result.begin(), result.end(), [](const computeProfileStats &a, const computeProfileStats &b)
+                { return a.mean * a.count > b.mean * b.count; });
+            return result;
+        }
+
+
+        /** @brief Kept scopes ordered by their start */
+        inline std::vector<computeProfileEvent> computeProfiler::getEvents()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            uint64_t origin = UINT64_MAX;
+            for (const traceEvent &event : events)
+            {
+                origin = std::min(origin, event.begin);
+            }
+
+            std::vector<computeProfileEvent> result;
+            result.reserve(events.size());
+            for (const traceEvent &event : events)
+            {
+                computeProfileEvent profileEvent;
+                profileEvent.label = event.label;
+                profileEvent.start = static_cast<double>(event.begin - origin) * timestampPeriod;
+                profileEvent.duration = event.duration;
+                profileEvent.thread = event.thread;
+                profileEvent.statistics = event.statistics;
+                profileEvent.invocations = event.invocations;
+                result.push_back(profileEvent);
+            }
+
+            std::stable_sort(result.begin(), result.end(), [](const computeProfileEvent &a, const computeProfileEvent &b)
+                { return a.start < b.start; });
+            return result;
+        }
+
+
+        /******************************************************************************************************************************
+        * Write the kept scopes as Chrome trace events, viewable in chrome://tracing or Perfetto
+        *
+        * Every scope is a complete ("X") event on the track of the thread that recorded it, nested scopes stack
+        *
+        * @param path File to write, replaced if it exists
+        *
+        * @return False if the file could not be written
+        ********************************************************************************************************************************/
+        inline bool computeProfiler::writeChromeTrace(const std::string &path)
+        {
+            std::vector<computeProfileEvent> profileEvents = getEvents();
+
+            std::ofstream file(path, std::ios::trunc);
+            if (!file.is_open())
+            {
+                return false;
+            }
+
+            file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+            char number[64];
+            for (size_t i = 0; i < profileEvents.size(); i++)
+            {
+                const computeProfileEvent &event = profileEvents[i];
+
+                // Trace timestamps are in microseconds
+                file << (i ? ",\n" : "\n") << "{\"name\":\"" << sourav::utils::escapeJson(event.label) << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":0";
+                snprintf(number, sizeof(number), ",\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f", event.thread, event.start / 1000.0, event.duration / 1000.0);
+                file << number;
+                if (event.statistics)
+                {
+                    file << ",\"args\":{\"invocations\":" << event.invocations << "}";
+                }
+                file << "}";
+            }
+            file << "\n]}\n";
+
+            return static_cast<bool>(file.flush());
+        }
+
+
+        inline uint32_t computeProfiler::acquireSlot(std::vector<VkQueryPool> &pools, std::vector<uint32_t> &freeSlots, VkQueryType type, uint32_t poolSize)
+        {
+            if (freeSlots.empty())
+            {
+                VkQueryPoolCreateInfo queryPoolCreateInfo = {};
+                queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+                queryPoolCreateInfo.queryType = type;
+                queryPoolCreateInfo.queryCount = type == VK_QUERY_TYPE_TIMESTAMP ? poolSize * 2 : poolSize;
+                if (type == VK_QUERY_TYPE_PIPELINE_STATISTICS)
+                {
+                    queryPoolCreateInfo.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+                }
+
+                VkQueryPool pool;
+                ST_CHECK_RESULT(vkCreateQueryPool(logicalDevice, &queryPoolCreateInfo, nullptr, &pool));
+                pools.push_back(pool);
+
+                // Hand out the lowest slots first
+                uint32_t base = static_cast<uint32_t>(pools.size() - 1) * poolSize;
+                for (uint32_t slot = poolSize; slot > 0; slot--)
+                {
+                    freeSlots.push_back(base + slot - 1);
+                }
+            }
+
+            uint32_t slot = freeSlots.back();
+            freeSlots.pop_back();
+            return slot;
+        }
+    }
+}
@@ -0,0 +1,243 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include "computeDevice.hpp"
+#include "computeDeviceUtils.hpp"
+
+namespace sourav
+{
+    namespace Transfer
+    {
+        /** @brief Read-only view of mapped readback memory, valid while the computeReadback it came from lives */
+        struct computeReadbackView
+        {
+            const uint8_t *data = nullptr;
+            size_t         size = 0;
+
+            const uint8_t *begin() const { return data; }
+            const uint8_t *end() const { return data + size; }
+            bool empty() const { return size == 0; }
+
+            /** @brief The data as an array of T, count() elements long */
+            template <typename T>
+            const T *as() const { return reinterpret_cast<const T *>(data); }
+            template <typename T>
+            size_t count() const { return size / sizeof(T); }
+        };
+
+        /**
+        * @brief Result of a GPU to host copy into a buffer from the device's readback pool, move-only
+        *
+        * Recorded into any submission (a blocking flush, a computeTaskGraph task, ...), the data can be read through
+        * view() without another copy once the device has completed submissionValue. destroy() and the destructor hand
+        * the buffer back to the pool, a readback dropped before its copy finished is recycled only after it
+        */
+        class computeReadback
+        {
+            public:
+                sourav::Memory::computeReadbackBuffer buffer;
+                /** @brief Bytes the copies write, from the start of buffer */
+                VkDeviceSize                          size            = 0;
+                uint64_t                              submissionValue = 0;
+                sourav::Device::computeDevice        *owner           = nullptr;
+
+                computeReadback() = default;
+                ~computeReadback();
+                computeReadback(const computeReadback &) = delete;
+                computeReadback &operator=(const computeReadback &) = delete;
+                computeReadback(computeReadback &&other) noexcept;
+                computeReadback &operator=(computeReadback &&other) noexcept;
+
+                void allocate(sourav::Device::computeDevice &device, VkDeviceSize size, uint64_t submissionValue);
+                void destroy();
+
+                void recordHostBarrier(VkCommandBuffer cmd);
+
+                bool isReady() const;
+                computeReadbackView view();
+                void copyTo(void *dst, VkDeviceSize dstSize);
+
+            private:
+                bool invalidated = false;
+
+                void forget();
+        };
+
+
+        inline computeReadback::~computeReadback()
+        {
+            destroy();
+        }
+
+        inline computeReadback::computeReadback(computeReadback &&other) noexcept
+        {
+            *this = std::move(other);
+        }
+
+        inline computeReadback &computeReadback::operator=(computeReadback &&other) noexcept
+        {
+            if (this != &other)
+            {
+                destroy();
+
+                buffer = other.buffer;
+                size = other.size;
+                submissionValue = other.submissionValue;
+                owner = other.owner;
+                invalidated = other.invalidated;
+                other.forget();
+            }
+            return *this;
+        }
+
+
+        /******************************************************************************************************************************
+        * Take a buffer from the device's readback pool for a copy recorded into submissionValue
+        *
+        * @param device Device context owning the pool
+        * @param size Bytes the copies will write
+        * @param submissionValue Submission the copies are recorded into (from beginSubmission)
+        ********************************************************************************************************************************/
+        inline void computeReadback::allocate(sourav::Device::computeDevice &device, VkDeviceSize size, uint64_t submissionValue)
+        {
+            destroy();
+
+            buffer = device.readbackPool.acquire(device.allocator, size);
+            this->size = size;
+            this->submissionValue = submissionValue;
+            owner = &device;
+        }
+
+
+        /** @brief Give the buffer back to the pool, views into it become invalid */
+        inline void computeReadback::destroy()
+        {
+            if (owner)
+            {
+                owner->readbackPool.release(buffer, isReady() ? 0 : submissionValue);
+            }
+            forget();
+        }
+
+
+        inline void computeReadback::forget()
+        {
+            buffer = sourav::Memory::computeReadbackBuffer();
+            size = 0;
+            submissionValue = 0;
+            owner = nullptr;
+            invalidated = false;
+        }
+
+
+        /** @brief Record after the copies: makes their writes available to host reads once the submission has completed */
+        inline void computeReadback::recordHostBarrier(VkCommandBuffer cmd)
+        {
+            VkBufferMemoryBarrier bufferBarrier = sourav::initializers::bufferMemoryBarrier();
+            bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            bufferBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+            bufferBarrier.buffer = buffer.buffer;
+            bufferBarrier.offset = 0;
+            bufferBarrier.size = size;
+            vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+        }
+
+
+        /** @brief True once the device has completed the submission the copies were recorded into, older open ones do not matter */
+        inline bool computeReadback::isReady() const
+        {
+            return owner && owner->isSubmissionComplete(submissionValue);
+        }
+
+
+        /******************************************************************************************************************************
+        * Get the copied data through the persistent mapping, without copying it
+        *
+        * Non-coherent memory is invalidated on the first call
+        *
+        * @throw Throws an exception if the readback is empty or its submission has not completed yet
+        ********************************************************************************************************************************/
+        inline computeReadbackView computeReadback::view()
+        {
+            if (!isReady())
+            {
+                throw std::runtime_error("Readback has not completed");
+            }
+
+            if (!invalidated)
+            {
+                owner->readbackPool.invalidate(buffer, 0, size);
+                invalidated = true;
+            }
+
+            computeReadbackView readbackView;
+            readbackView.data = static_cast<const uint8_t *>(buffer.allocation.mapped);
+            readbackView.size = static_cast<size_t>(size);
+            return readbackView;
+        }
+
+
+        /** @brief Copy the data out of the mapping, dstSize must hold size bytes */
+        inline void computeReadback::copyTo(void *dst, VkDeviceSize dstSize)
+        {
+            if (dstSize < size)
+            {
+                throw std::runtime_error("Readback destination is too small");
+            }
+
+            computeReadbackView readbackView = view();
+            memcpy(dst, readbackView.data, readbackView.size);
+        }
+
+
+        /******************************************************************************************************************************
+        * Record a copy of a buffer range (e.g. a compute shader's output) into a pooled readback buffer
+        *
+        * @param device Device context owning the readback pool
+        * @param cmd Command buffer of submissionValue
+        * @param submissionValue Submission cmd is part of (from beginSubmission)
+        * @param srcBuffer Buffer to read, needs TRANSFER_SRC usage
+        * @param srcOffset Start of the range in srcBuffer
+        * @param size Size of the range in bytes
+        * @param srcStageMask Stages that last wrote the range
+        * @param srcAccessMask Accesses that last wrote the range
+        *
+        * @return Readback whose view() holds the range once submissionValue has completed
+        ********************************************************************************************************************************/
+        inline computeReadback recordBufferReadback(
+            sourav::Device::computeDevice &device,
+            VkCommandBuffer       cmd,
+            uint64_t              submissionValue,
+            VkBuffer              srcBuffer,
+            VkDeviceSize          srcOffset,
+            VkDeviceSize          size,
+            VkPipelineStageFlags  srcStageMask  = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+            VkAccessFlags         srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT)
+        {
+            computeReadback readback;
+            readback.allocate(device, size, submissionValue);
+
+            VkBufferMemoryBarrier bufferBarrier = sourav::initializers::bufferMemoryBarrier();
+            bufferBarrier.srcAccessMask = srcAccessMask;
+            bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+            bufferBarrier.buffer = srcBuffer;
+            bufferBarrier.offset = srcOffset;
+            bufferBarrier.size = size;
+            vkCmdPipelineBarrier(cmd, srcStageMask, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
+
+            VkBufferCopy copyRegion = {};
+            copyRegion.srcOffset = srcOffset;
+            copyRegion.dstOffset = 0;
+            copyRegion.size = size;
+            vkCmdCopyBuffer(cmd, srcBuffer, readback.buffer.buffer, 1, &copyRegion);
+
+            readback.recordHostBarrier(cmd);
+            return readback;
+        }
+    }
+}
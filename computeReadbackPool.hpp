@@ -0,0 +1,255 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "computeDeviceCaps.hpp"
+#include "computeDeviceUtils.hpp"
+#include "computeMemoryAllocator.hpp"
+
+// Smallest pooled readback buffer, larger requests are rounded up to a power of two so similar sizes reuse buffers
+#define READBACK_MIN_BUFFER_SIZE (64ull * 1024)
+
+namespace sourav
+{
+    namespace Memory
+    {
+        /** @brief Persistently mapped buffer the GPU copies results into, from computeReadbackPool */
+        struct computeReadbackBuffer
+        {
+            VkBuffer          buffer   = VK_NULL_HANDLE;
+            computeAllocation allocation;
+            VkDeviceSize      capacity = 0;
+            /** @brief False if GPU writes only become visible to the host after invalidate() */
+            bool              coherent = true;
+        };
+
+        /** @brief Pool counters, a hit is a buffer handed out again, a miss one that had to be created */
+        struct computeReadbackPoolStats
+        {
+            uint64_t     hits          = 0;
+            uint64_t     misses        = 0;
+            uint32_t     buffers       = 0;
+            VkDeviceSize bytesReserved = 0;
+        };
+
+        /**
+        * @brief Recycles host visible buffers for GPU to host copies, preferring HOST_CACHED memory
+        *
+        * Cached memory makes host reads fast but is usually not coherent. Every buffer starts on a nonCoherentAtomSize
+        * boundary and spans a multiple of it, so invalidate() never touches memory of another allocation. Released
+        * buffers are handed out again once the submission that wrote them has been retired
+        */
+        class computeReadbackPool
+        {
+            public:
+                void create(computeMemoryAllocator &allocator);
+                void destroy(computeMemoryAllocator &allocator);
+
+                computeReadbackBuffer acquire(computeMemoryAllocator &allocator, VkDeviceSize size);
+                void release(const computeReadbackBuffer &buffer, uint64_t submissionValue);
+                void retire(uint64_t completedValue);
+
+                void invalidate(const computeReadbackBuffer &buffer, VkDeviceSize offset, VkDeviceSize size);
+
+                computeReadbackPoolStats getStats();
+
+            private:
+                VkDevice     logicalDevice       = VK_NULL_HANDLE;
+                VkDeviceSize nonCoherentAtomSize = 1;
+
+                std::mutex                                              mutex;
+                std::vector<computeReadbackBuffer>                      freeBuffers;
+                std::vector<std::pair<uint64_t, computeReadbackBuffer>> pendingBuffers;
+                uint64_t                                                hits          = 0;
+                uint64_t                                                misses        = 0;
+                uint32_t                                                bufferCount   = 0;
+                VkDeviceSize                                            bytesReserved = 0;
+        };
+
+
+        inline void computeReadbackPool::create(computeMemoryAllocator &allocator)
+        {
+            logicalDevice = allocator.logicalDevice;
+            nonCoherentAtomSize = std::max<VkDeviceSize>(1,
+                sourav::Device::getDeviceCaps(allocator.physicalDevice).properties.limits.nonCoherentAtomSize);
+        }
+
+
+        /** @brief Free every buffer, including those still waiting for their submission, nothing may be in use */
+        inline void computeReadbackPool::destroy(computeMemoryAllocator &allocator)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            for (auto &pending : pendingBuffers)
+            {
+                freeBuffers.push_back(pending.second);
+            }
+            pendingBuffers.clear();
+
+            for (computeReadbackBuffer &buffer : freeBuffers)
+            {
+                vkDestroyBuffer(logicalDevice, buffer.buffer, nullptr);
+                allocator.free(buffer.allocation);
+            }
+            freeBuffers.clear();
+            bufferCount = 0;
+            bytesReserved = 0;
+        }
+
+
+        /******************************************************************************************************************************
+        * Get a mapped buffer of at least size bytes
+        *
+        * The smallest free buffer that fits is reused, otherwise one of the next power of two (at least
+        * READBACK_MIN_BUFFER_SIZE) is created
+        *
+        * @return Buffer to hand back with release() once it has been read
+        ********************************************************************************************************************************/
+        inline computeReadbackBuffer computeReadbackPool::acquire(computeMemoryAllocator &allocator, VkDeviceSize size)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+
+                auto best = freeBuffers.end();
+                for (auto it = freeBuffers.begin(); it != freeBuffers.end(); ++it)
+                {
+                    if (it->capacity >= size && (best == freeBuffers.end() || it->capacity < best->capacity))
+                    {
+                        best = it;
+                    }
+                }
+                if (best != freeBuffers.end())
+                {
+                    computeReadbackBuffer buffer = *best;
+                    freeBuffers.erase(best);
+                    hits++;
+                    return buffer;
+                }
+                misses++;
+            }
+
+            computeReadbackBuffer buffer;
+            buffer.capacity = READBACK_MIN_BUFFER_SIZE;
+            while (buffer.capacity < size)
+            {
+                buffer.capacity *= 2;
+            }
+            buffer.capacity = (buffer.capacity + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize;
+
+            VkBufferCreateInfo bufferCreateInfo = sourav::initializers::bufferCreateInfo();
+            bufferCreateInfo.size = buffer.capacity;
+            bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+            bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            ST_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &buffer.buffer));
+
+            // Atom aligned start, so the invalidated range cannot reach into the allocation before this one
+            VkMemoryRequirements memReqs;
+            vkGetBufferMemoryRequirements(logicalDevice, buffer.buffer, &memReqs);
+            memReqs.alignment = std::max(memReqs.alignment, nonCoherentAtomSize);
+            memReqs.size = std::max(memReqs.size, buffer.capacity);
+            buffer.allocation = allocator.allocate(memReqs, computeMemoryUsage::readback(), computeResourceTiling::Linear);
+            ST_CHECK_RESULT(vkBindBufferMemory(logicalDevice, buffer.buffer, buffer.allocation.memory, buffer.allocation.offset));
+
+            buffer.coherent = (allocator.memoryProperties.memoryTypes[buffer.allocation.memoryTypeIndex].propertyFlags &
+                VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            try
+            {
+                // Room for every buffer in both lists, so release() never allocates and cannot throw
+                freeBuffers.reserve(bufferCount + 1);
+                pendingBuffers.reserve(bufferCount + 1);
+            }
+            catch (...)
+            {
+                vkDestroyBuffer(logicalDevice, buffer.buffer, nullptr);
+                allocator.free(buffer.allocation);
+                throw;
+            }
+            bufferCount++;
+            bytesReserved += buffer.capacity;
+            return buffer;
+        }
+
+
+        /** @brief Hand a buffer back, it is reused once submissionValue has been retired, right away for 0. Does not throw */
+        inline void computeReadbackPool::release(const computeReadbackBuffer &buffer, uint64_t submissionValue)
+        {
+            if (buffer.buffer == VK_NULL_HANDLE)
+            {
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (submissionValue == 0)
+            {
+                freeBuffers.push_back(buffer);
+            }
+            else
+            {
+                pendingBuffers.emplace_back(submissionValue, buffer);
+            }
+        }
+
+
+        /** @brief Make buffers released with a submission up to completedValue available again */
+        inline void computeReadbackPool::retire(uint64_t completedValue)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            auto retired = std::partition(pendingBuffers.begin(), pendingBuffers.end(),
+                [completedValue](const std::pair<uint64_t, computeReadbackBuffer> &p) { return p.first > completedValue; });
+            for (auto it = retired; it != pendingBuffers.end(); ++it)
+            {
+                freeBuffers.push_back(it->second);
+            }
+            pendingBuffers.erase(retired, pendingBuffers.end());
+        }
+
+
+        /******************************************************************************************************************************
+        * Make GPU writes to a range of buffer visible to host reads through the mapping
+        *
+        * A no-op for coherent memory. The range is widened to whole nonCoherentAtomSize units, which stay inside the buffer
+        *
+        * @param buffer Buffer from acquire
+        * @param offset Start of the range, relative to the buffer
+        * @param size Size of the range in bytes
+        ********************************************************************************************************************************/
+        inline void computeReadbackPool::invalidate(const computeReadbackBuffer &buffer, VkDeviceSize offset, VkDeviceSize size)
+        {
+            if (buffer.coherent || size == 0)
+            {
+                return;
+            }
+
+            VkDeviceSize begin = offset / nonCoherentAtomSize * nonCoherentAtomSize;
+            VkDeviceSize end = std::min((offset + size + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize, buffer.capacity);
+
+            VkMappedMemoryRange range = {};
+            range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+            range.memory = buffer.allocation.memory;
+            range.offset = buffer.allocation.offset + begin;
+            range.size = end - begin;
+            ST_CHECK_RESULT(vkInvalidateMappedMemoryRanges(logicalDevice, 1, &range));
+        }
+
+
+        inline computeReadbackPoolStats computeReadbackPool::getStats()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            computeReadbackPoolStats stats;
+            stats.hits = hits;
+            stats.misses = misses;
+            stats.buffers = bufferCount;
+            stats.bytesReserved = bytesReserved;
+            return stats;
+        }
+    }
+}
@@ -0,0 +1,250 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+#include "computeDeviceCaps.hpp"
+#include "computeDeviceUtils.hpp"
+
+namespace sourav
+{
+    namespace Texture
+    {
+        /**
+        * @brief Sampler settings, textures with equal descriptions share one VkSampler
+        *
+        * Defaults to trilinear filtering with repeat addressing over the whole mip chain. The setters return the
+        * description so they can be chained: computeSamplerDesc().setAddressMode(...).setAnisotropy(8.0f)
+        */
+        struct computeSamplerDesc
+        {
+            VkFilter             magFilter     = VK_FILTER_LINEAR;
+            VkFilter             minFilter     = VK_FILTER_LINEAR;
+            VkSamplerMipmapMode  mipmapMode    = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+            VkSamplerAddressMode addressModeU  = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+            VkSamplerAddressMode addressModeV  = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+            VkSamplerAddressMode addressModeW  = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+            VkBorderColor        borderColor   = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+            float                mipLodBias    = 0.0f;
+            /** @brief 1 disables anisotropic filtering, larger values need the samplerAnisotropy feature */
+            float                maxAnisotropy = 1.0f;
+            float                minLod        = 0.0f;
+            float                maxLod        = VK_LOD_CLAMP_NONE;
+
+            computeSamplerDesc &setFilter(VkFilter filter, VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR)
+            {
+                magFilter = filter;
+                minFilter = filter;
+                this->mipmapMode = mipmapMode;
+                return *this;
+            }
+
+            /** @brief Same mode on all three axes */
+            computeSamplerDesc &setAddressMode(VkSamplerAddressMode mode, VkBorderColor borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK)
+            {
+                addressModeU = mode;
+                addressModeV = mode;
+                addressModeW = mode;
+                this->borderColor = borderColor;
+                return *this;
+            }
+
+            computeSamplerDesc &setAnisotropy(float maxAnisotropy)
+            {
+                this->maxAnisotropy = maxAnisotropy;
+                return *this;
+            }
+
+            computeSamplerDesc &setLodRange(float minLod, float maxLod, float mipLodBias = 0.0f)
+            {
+                this->minLod = minLod;
+                this->maxLod = maxLod;
+                this->mipLodBias = mipLodBias;
+                return *this;
+            }
+
+            bool operator==(const computeSamplerDesc &other) const
+            {
+                return magFilter == other.magFilter && minFilter == other.minFilter && mipmapMode == other.mipmapMode &&
+                    addressModeU == other.addressModeU && addressModeV == other.addressModeV && addressModeW == other.addressModeW &&
+                    borderColor == other.borderColor && mipLodBias == other.mipLodBias && maxAnisotropy == other.maxAnisotropy &&
+                    minLod == other.minLod && maxLod == other.maxLod;
+            }
+        };
+
+        struct computeSamplerDescHash
+        {
+            size_t operator()(const computeSamplerDesc &desc) const
+            {
+                // -0.0f compares equal to 0.0f but has other bits, hash both as 0.0f
+                const float values[] = { desc.mipLodBias, desc.maxAnisotropy, desc.minLod, desc.maxLod };
+                uint32_t floats[4];
+                for (uint32_t i = 0; i < 4; i++)
+                {
+                    const float value = values[i] == 0.0f ? 0.0f : values[i];
+                    memcpy(&floats[i], &value, sizeof(float));
+                }
+
+                const uint32_t fields[] = {
+                    (uint32_t)desc.magFilter, (uint32_t)desc.minFilter, (uint32_t)desc.mipmapMode,
+                    (uint32_t)desc.addressModeU, (uint32_t)desc.addressModeV, (uint32_t)desc.addressModeW,
+                    (uint32_t)desc.borderColor, floats[0], floats[1], floats[2], floats[3] };
+
+                size_t hash = 0;
+                for (uint32_t field : fields)
+                {
+                    hash ^= std::hash<uint32_t>()(field) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+                }
+                return hash;
+            }
+        };
+
+        struct computeSamplerCacheStats
+        {
+            uint32_t samplers = 0;
+            uint64_t hits     = 0;
+            uint64_t misses   = 0;
+        };
+
+        /**
+        * @brief Shares one VkSampler between every user of an equal computeSamplerDesc
+        *
+        * Samplers are reference counted and destroyed when the last reference is released. Releases that may race GPU
+        * work go through the device's deferred destruction queue, so a sampler is only destroyed once nothing uses it
+        */
+        class computeSamplerCache
+        {
+            public:
+                void create(VkPhysicalDevice physicalDevice, VkDevice logicalDevice);
+                void destroy();
+
+                VkSampler acquire(const computeSamplerDesc &desc);
+                bool release(VkSampler sampler);
+
+                computeSamplerCacheStats getStats();
+
+            private:
+                struct cachedSampler
+                {
+                    VkSampler sampler;
+                    uint32_t  references;
+                };
+
+                VkDevice logicalDevice = VK_NULL_HANDLE;
+                float    maxSamplerAnisotropy = 1.0f;
+
+                std::mutex mutex;
+                std::unordered_map<computeSamplerDesc, cachedSampler, computeSamplerDescHash> samplers;
+                std::unordered_map<VkSampler, computeSamplerDesc>                             descs;
+                uint64_t hits   = 0;
+                uint64_t misses = 0;
+        };
+
+
+        inline void computeSamplerCache::create(VkPhysicalDevice physicalDevice, VkDevice logicalDevice)
+        {
+            this->logicalDevice = logicalDevice;
+            maxSamplerAnisotropy = sourav::Device::getDeviceCaps(physicalDevice).properties.limits.maxSamplerAnisotropy;
+        }
+
+
+        /** @brief Destroy every cached sampler, whether or not it is still referenced */
+        inline void computeSamplerCache::destroy()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto &entry : samplers)
+            {
+                vkDestroySampler(logicalDevice, entry.second.sampler, nullptr);
+            }
+            samplers.clear();
+            descs.clear();
+        }
+
+
+        /******************************************************************************************************************************
+        * Get the sampler for desc, created on the first request
+        *
+        * maxAnisotropy is clamped to the device limit, so equal requests above the limit share a sampler
+        *
+        * @return Sampler holding one reference, to be returned with release()
+        ********************************************************************************************************************************/
+        inline VkSampler computeSamplerCache::acquire(const computeSamplerDesc &desc)
+        {
+            computeSamplerDesc key = desc;
+            key.maxAnisotropy = std::max(1.0f, std::min(desc.maxAnisotropy, maxSamplerAnisotropy));
+
+            std::lock_guard<std::mutex> lock(mutex);
+
+            auto it = samplers.find(key);
+            if (it != samplers.end())
+            {
+                hits++;
+                it->second.references++;
+                return it->second.sampler;
+            }
+            misses++;
+
+            VkSamplerCreateInfo samplerCreateInfo = {};
+            samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+            samplerCreateInfo.magFilter = key.magFilter;
+            samplerCreateInfo.minFilter = key.minFilter;
+            samplerCreateInfo.mipmapMode = key.mipmapMode;
+            samplerCreateInfo.addressModeU = key.addressModeU;
+            samplerCreateInfo.addressModeV = key.addressModeV;
+            samplerCreateInfo.addressModeW = key.addressModeW;
+            samplerCreateInfo.mipLodBias = key.mipLodBias;
+            samplerCreateInfo.anisotropyEnable = key.maxAnisotropy > 1.0f ? VK_TRUE : VK_FALSE;
+            samplerCreateInfo.maxAnisotropy = key.maxAnisotropy;
+            samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
+            samplerCreateInfo.minLod = key.minLod;
+            samplerCreateInfo.maxLod = key.maxLod;
+            samplerCreateInfo.borderColor = key.borderColor;
+
+            VkSampler sampler = VK_NULL_HANDLE;
+            ST_CHECK_RESULT(vkCreateSampler(logicalDevice, &samplerCreateInfo, nullptr, &sampler));
+
+            samplers.emplace(key, cachedSampler { sampler, 1 });
+            descs.emplace(sampler, key);
+            return sampler;
+        }
+
+
+        /** @brief Drop one reference, the last one destroys the sampler. False if sampler did not come from this cache */
+        inline bool computeSamplerCache::release(VkSampler sampler)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            auto desc = descs.find(sampler);
+            if (desc == descs.end())
+            {
+                return false;
+            }
+
+            auto it = samplers.find(desc->second);
+            if (--it->second.references == 0)
+            {
+                vkDestroySampler(logicalDevice, sampler, nullptr);
+                samplers.erase(it);
+                descs.erase(desc);
+            }
+            return true;
+        }
+
+
+        inline computeSamplerCacheStats computeSamplerCache::getStats()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            computeSamplerCacheStats stats;
+            stats.samplers = static_cast<uint32_t>(samplers.size());
+            stats.hits = hits;
+            stats.misses = misses;
+            return stats;
+        }
+    }
+}
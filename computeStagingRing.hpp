@@ -0,0 +1,299 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "computeDeviceUtils.hpp"
+#include "computeMemoryAllocator.hpp"
+
+// Default capacity of the persistently mapped staging ring
+#define DEFAULT_STAGING_RING_SIZE (32ull * 1024 * 1024)
+// Region alignment, a multiple of every uncompressed texel size (1..32 bytes incl. 3 byte RGB) and of the 4 byte copy offset rule
+#define STAGING_REGION_ALIGNMENT 96ull
+
+namespace sourav
+{
+    namespace Memory
+    {
+        /** @brief A slice of the staging ring, valid until the submission it was committed with retires */
+        struct computeStagingRegion
+        {
+            VkBuffer     buffer = VK_NULL_HANDLE;
+            VkDeviceSize offset = 0;
+            VkDeviceSize size   = 0;
+            void *       mapped = nullptr;
+        };
+
+        /**
+        * @brief Called with the oldest in-flight submission value when the staging ring is full
+        *
+        * Returns false right away if the submission belongs to someone else, otherwise blocks until it has completed
+        * and returns true. Must not block on a lock another thread may hold while it allocates from the ring, it
+        * returns false instead and the allocation falls back
+        */
+        typedef std::function<bool(uint64_t submissionValue)> computeSubmissionWaiter;
+
+        /**
+        * @brief Ring allocator over one persistently mapped host visible buffer
+        *
+        * Every region is tagged with the submission value that reads from it, retire() gives the space
+        * back once all submissions up to a value have completed
+        */
+        class computeStagingRing
+        {
+            public:
+                VkDevice          logicalDevice = VK_NULL_HANDLE;
+                VkBuffer          buffer        = VK_NULL_HANDLE;
+                computeAllocation allocation;
+                VkDeviceSize      capacity      = 0;
+
+                void create(computeMemoryAllocator &allocator, VkDeviceSize capacity = DEFAULT_STAGING_RING_SIZE);
+                void destroy(computeMemoryAllocator &allocator);
+
+                uint32_t addSubmissionWaiter(computeSubmissionWaiter waiter);
+                void removeSubmissionWaiter(uint32_t id);
+
+                bool allocate(VkDeviceSize size, VkDeviceSize alignment, uint64_t submissionValue, computeStagingRegion *region);
+                void retire(uint64_t completedValue);
+
+                VkDeviceSize bytesInUse();
+
+            private:
+                struct inFlightRange
+                {
+                    uint64_t     submissionValue;
+                    VkDeviceSize end;
+                    VkDeviceSize bytes;
+                };
+
+                std::mutex                mutex;
+                VkDeviceSize              head         = 0;
+                VkDeviceSize              tail         = 0;
+                VkDeviceSize              usedBytes    = 0;
+                std::deque<inFlightRange> inFlight;
+                uint32_t                  nextWaiterId = 1;
+                std::vector<std::pair<uint32_t, computeSubmissionWaiter>> waiters;
+
+                bool tryAllocate(VkDeviceSize size, VkDeviceSize alignment, uint64_t submissionValue, VkDeviceSize *offset);
+                void track(uint64_t submissionValue, VkDeviceSize bytes);
+                void popFront();
+        };
+
+
+        inline void computeStagingRing::create(computeMemoryAllocator &allocator, VkDeviceSize capacity)
+        {
+            logicalDevice = allocator.logicalDevice;
+            this->capacity = capacity;
+
+            VkBufferCreateInfo bufferCreateInfo = sourav::initializers::bufferCreateInfo();
+            bufferCreateInfo.size = capacity;
+            bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+            bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            ST_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &buffer));
+
+            allocation = allocator.allocateBuffer(buffer, computeMemoryUsage::upload());
+
+            head = tail = usedBytes = 0;
+            inFlight.clear();
+        }
+
+
+        /******************************************************************************************************************************
+        * Register a waiter for the submissions of one submitter (upload scheduler, task graph, ...)
+        *
+        * When the ring is full every waiter is asked in turn until one owns the oldest in-flight submission
+        *
+        * @return Id to pass to removeSubmissionWaiter before the owner goes away
+        ********************************************************************************************************************************/
+        inline uint32_t computeStagingRing::addSubmissionWaiter(computeSubmissionWaiter waiter)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            waiters.emplace_back(nextWaiterId, std::move(waiter));
+            return nextWaiterId++;
+        }
+
+
+        inline void computeStagingRing::removeSubmissionWaiter(uint32_t id)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            waiters.erase(std::remove_if(waiters.begin(), waiters.end(),
+                [id](const std::pair<uint32_t, computeSubmissionWaiter> &w) { return w.first == id; }), waiters.end());
+        }
+
+
+        inline void computeStagingRing::destroy(computeMemoryAllocator &allocator)
+        {
+            if (buffer == VK_NULL_HANDLE)
+            {
+                return;
+            }
+            vkDestroyBuffer(logicalDevice, buffer, nullptr);
+            allocator.free(allocation);
+            buffer = VK_NULL_HANDLE;
+        }
+
+
+        inline void computeStagingRing::track(uint64_t submissionValue, VkDeviceSize bytes)
+        {
+            usedBytes += bytes;
+
+            // Consecutive regions of the same submission share one entry
+            if (!inFlight.empty() && inFlight.back().submissionValue == submissionValue)
+            {
+                inFlight.back().end = head;
+                inFlight.back().bytes += bytes;
+                return;
+            }
+            inFlight.push_back({ submissionValue, head, bytes });
+        }
+
+
+        inline bool computeStagingRing::tryAllocate(VkDeviceSize size, VkDeviceSize alignment, uint64_t submissionValue, VkDeviceSize *offset)
+        {
+            if (usedBytes == 0)
+            {
+                // Nothing in flight, start over at the front so large requests get the whole ring
+                head = tail = 0;
+            }
+            else if (head == tail)
+            {
+                // Completely full
+                return false;
+            }
+
+            VkDeviceSize aligned = ((head + alignment - 1) / alignment) * alignment;
+
+            if (head >= tail)
+            {
+                // Free space is [head, capacity) followed by [0, tail)
+                if (aligned + size <= capacity)
+                {
+                    VkDeviceSize consumed = aligned + size - head;
+                    head = aligned + size;
+                    track(submissionValue, consumed);
+                    *offset = aligned;
+                    return true;
+                }
+                if (size <= tail)
+                {
+                    // Wrap around, the unused tail end of the ring is accounted to this submission
+                    VkDeviceSize consumed = (capacity - head) + size;
+                    head = size;
+                    track(submissionValue, consumed);
+                    *offset = 0;
+                    return true;
+                }
+                return false;
+            }
+
+            // Free space is [head, tail)
+            if (aligned + size <= tail)
+            {
+                VkDeviceSize consumed = aligned + size - head;
+                head = aligned + size;
+                track(submissionValue, consumed);
+                *offset = aligned;
+                return true;
+            }
+            return false;
+        }
+
+
+        /******************************************************************************************************************************
+        * Carve an aligned region out of the ring
+        *
+        * @param size Size of the region in bytes
+        * @param alignment Required offset alignment, does not need to be a power of two
+        * @param submissionValue Submission that will read from the region, see computeDevice::beginSubmission
+        * @param region Filled with the buffer, offset and mapped pointer of the region
+        *
+        * @return False if the request can never fit, or the ring is full and no waiter owns the oldest submission
+        ********************************************************************************************************************************/
+        inline bool computeStagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment, uint64_t submissionValue, computeStagingRegion *region)
+        {
+            if (size > capacity)
+            {
+                return false;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+
+            VkDeviceSize offset = 0;
+            while (!tryAllocate(size, alignment, submissionValue, &offset))
+            {
+                // Never wait on the caller's own submission, it has not been submitted yet
+                if (inFlight.empty() || inFlight.front().submissionValue >= submissionValue)
+                {
+                    return false;
+                }
+
+                // Waiters take their owner's locks, which may be held by a thread that is allocating right now
+                uint64_t oldest = inFlight.front().submissionValue;
+                std::vector<std::pair<uint32_t, computeSubmissionWaiter>> candidates = waiters;
+                lock.unlock();
+                bool completed = false;
+                for (size_t i = 0; i < candidates.size() && !completed; i++)
+                {
+                    completed = candidates[i].second(oldest);
+                }
+                lock.lock();
+
+                if (!completed)
+                {
+                    // Owned by a blocking submitter, it completes on its own, the caller falls back to other memory
+                    return false;
+                }
+
+                // Regions are in allocation order, not submission order: an entry behind this one may belong to an older
+                // submission that is still in flight, only the watermark in retire() reclaims in bulk
+                if (!inFlight.empty() && inFlight.front().submissionValue == oldest)
+                {
+                    popFront();
+                }
+            }
+
+            region->buffer = buffer;
+            region->offset = offset;
+            region->size = size;
+            region->mapped = (uint8_t *)allocation.mapped + offset;
+            return true;
+        }
+
+
+        inline void computeStagingRing::popFront()
+        {
+            tail = inFlight.front().end;
+            usedBytes -= inFlight.front().bytes;
+            inFlight.pop_front();
+        }
+
+
+        /**
+        * @brief Reclaim the regions of every submission up to and including completedValue
+        *
+        * completedValue must be a gap-free watermark (computeDevice::completedSubmission), every submission up to it has
+        * completed
+        */
+        inline void computeStagingRing::retire(uint64_t completedValue)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while (!inFlight.empty() && inFlight.front().submissionValue <= completedValue)
+            {
+                popFront();
+            }
+        }
+
+
+        inline VkDeviceSize computeStagingRing::bytesInUse()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return usedBytes;
+        }
+    }
+}
@@ -0,0 +1,515 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "computeDevice.hpp"
+#include "computeDeviceUtils.hpp"
+
+namespace sourav
+{
+    namespace Sync
+    {
+        /** @brief Index of a task in the graph being built, valid until the next submit() */
+        typedef uint32_t computeTaskHandle;
+
+        /**
+        * @brief Records the commands of a task into a begun command buffer
+        *
+        * submissionValue is the device submission the task runs as, for acquireStaging, markUsed, profiler scopes, ...
+        */
+        typedef std::function<void(VkCommandBuffer commandBuffer, uint64_t submissionValue)> computeTaskRecorder;
+
+        /** @brief Completion point of a submitted task: a value on the timeline semaphore of the queue it ran on */
+        struct computeTaskTicket
+        {
+            uint32_t queueIndex      = 0;
+            uint64_t timelineValue   = 0;
+            uint64_t submissionValue = 0;
+        };
+
+        /**
+        * @brief Submits upload -> dispatch -> readback chains as a dependency graph ordered by timeline semaphores
+        *
+        * Every queue added to the graph gets one timeline semaphore (VK_KHR_timeline_semaphore / Vulkan 1.2, the
+        * timelineSemaphore feature must be enabled). Each task is one submission that signals the next value of its
+        * queue's semaphore and waits on the values of the tasks it depends on, so dependent work on other queues starts
+        * as soon as its inputs are done while independent transfers overlap compute. The host only blocks in wait()
+        *
+        * Tasks record into command buffers from pools the graph keeps per queue. Resources with exclusive sharing that
+        * move between queue families still need the release / acquire barriers recorded by the tasks themselves
+        * (see recordFromBuffer's queue family parameters). The graph is the only submitter to its queues while submit()
+        * runs
+        */
+        class computeTaskGraph
+        {
+            public:
+                void create(sourav::Device::computeDevice &device);
+                void destroy();
+
+                uint32_t addQueue(VkQueue queue, uint32_t queueFamilyIndex);
+
+                computeTaskHandle addTask(uint32_t queueIndex, computeTaskRecorder record);
+                void addDependency(computeTaskHandle before, computeTaskHandle after, VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+                void addDependency(const computeTaskTicket &before, computeTaskHandle after, VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+
+                std::vector<computeTaskTicket> submit();
+
+                bool isComplete(const computeTaskTicket &ticket);
+                void wait(const computeTaskTicket &ticket);
+                void waitIdle();
+
+            private:
+                struct taskQueue
+                {
+                    VkQueue                      queue         = VK_NULL_HANDLE;
+                    uint32_t                     familyIndex   = 0;
+                    VkSemaphore                  semaphore     = VK_NULL_HANDLE;
+                    uint64_t                     lastValue     = 0;
+                    VkCommandPool                commandPool   = VK_NULL_HANDLE;
+                    std::vector<VkCommandBuffer> freeCommandBuffers;
+                };
+
+                struct taskWait
+                {
+                    uint32_t             queueIndex;
+                    uint64_t             timelineValue;
+                    VkPipelineStageFlags waitStage;
+                };
+
+                struct task
+                {
+                    uint32_t                                                      queueIndex;
+                    computeTaskRecorder                                           record;
+                    std::vector<std::pair<computeTaskHandle, VkPipelineStageFlags>> dependencies;
+                    std::vector<taskWait>                                         externalWaits;
+                };
+
+                struct submittedTask
+                {
+                    computeTaskTicket ticket;
+                    VkCommandBuffer   commandBuffer;
+                };
+
+                sourav::Device::computeDevice *device = nullptr;
+                uint32_t                       stagingWaiter = 0;
+
+                // Recursive because a full staging ring calls back into waitForSubmission while a task is recorded.
+                // Held while recording, other threads' ring waits only try to take it
+                std::recursive_mutex       mutex;
+                std::vector<taskQueue>     queues;
+                std::vector<task>          tasks;
+                std::vector<submittedTask> inFlight;
+
+                std::vector<computeTaskHandle> sortTasks();
+                void submitTask(const task &pending, computeTaskTicket *ticket, const std::vector<computeTaskTicket> &tickets);
+                void retire();
+                bool waitForSubmission(uint64_t submissionValue);
+        };
+
+
+        /** @brief Set up the graph, it registers a waiter for its tasks with the staging ring */
+        inline void computeTaskGraph::create(sourav::Device::computeDevice &device)
+        {
+            this->device = &device;
+
+            stagingWaiter = device.stagingRing.addSubmissionWaiter([this](uint64_t submissionValue) { return waitForSubmission(submissionValue); });
+        }
+
+
+        /** @brief Wait for every submitted task and destroy the semaphores and command pools */
+        inline void computeTaskGraph::destroy()
+        {
+            if (!device)
+            {
+                return;
+            }
+
+            waitIdle();
+            device->stagingRing.removeSubmissionWaiter(stagingWaiter);
+            stagingWaiter = 0;
+
+            for (taskQueue &queue : queues)
+            {
+                // Destroying the pool frees every command buffer allocated from it
+                vkDestroyCommandPool(device->logicalDevice, queue.commandPool, nullptr);
+                vkDestroySemaphore(device->logicalDevice, queue.semaphore, nullptr);
+            }
+            queues.clear();
+            tasks.clear();
+            device = nullptr;
+        }
+
+
+        /******************************************************************************************************************************
+        * Add a queue tasks can be submitted to
+        *
+        * @param queue Queue the tasks are submitted to, several indices may share a VkQueue
+        * @param queueFamilyIndex Family of queue, the command buffers of its tasks are allocated for it
+        *
+        * @return Index to pass to addTask
+        ********************************************************************************************************************************/
+        inline uint32_t computeTaskGraph::addQueue(VkQueue queue, uint32_t queueFamilyIndex)
+        {
+            std::lock_guard<std::recursive_mutex> lock(mutex);
+
+            taskQueue added;
+            added.queue = queue;
+            added.familyIndex = queueFamilyIndex;
+
+            VkSemaphoreTypeCreateInfo semaphoreTypeInfo = {};
+            semaphoreTypeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+            semaphoreTypeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+            semaphoreTypeInfo.initialValue = 0;
+            VkSemaphoreCreateInfo semaphoreCreateInfo = sourav::initializers::semaphoreCreateInfo();
+            semaphoreCreateInfo.pNext = &semaphoreTypeInfo;
+            ST_CHECK_RESULT(vkCreateSemaphore(device->logicalDevice, &semaphoreCreateInfo, nullptr, &added.semaphore));
+
+            VkCommandPoolCreateInfo poolCreateInfo = sourav::initializers::commandPoolCreateInfo();
+            poolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+            poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            ST_CHECK_RESULT(vkCreateCommandPool(device->logicalDevice, &poolCreateInfo, nullptr, &added.commandPool));
+
+            queues.push_back(added);
+            return static_cast<uint32_t>(queues.size() - 1);
+        }
+
+
+        /******************************************************************************************************************************
+        * Add a task to the graph being built, it is recorded and submitted by the next submit()
+        *
+        * @param queueIndex Queue from addQueue the task runs on
+        * @param record Called once from submit() with a begun command buffer, must not end it
+        *
+        * @return Handle for addDependency and for the ticket submit() returns
+        ********************************************************************************************************************************/
+        inline computeTaskHandle computeTaskGraph::addTask(uint32_t queueIndex, computeTaskRecorder record)
+        {
+            std::lock_guard<std::recursive_mutex> lock(mutex);
+
+            if (queueIndex >= queues.size())
+            {
+                throw std::runtime_error("Task added for a queue that is not part of the graph");
+            }
+
+            task added;
+            added.queueIndex = queueIndex;
+            added.record = std::move(record);
+            tasks.push_back(std::move(added));
+            return static_cast<computeTaskHandle>(tasks.size() - 1);
+        }
+
+
+        /******************************************************************************************************************************
+        * Make a task wait for another one of the same graph
+        *
+        * @param before Task that has to complete first
+        * @param after Task that waits
+        * @param waitStage Stages of after that wait, earlier stages may already run (e.g. COMPUTE_SHADER for a dispatch
+        * reading what before uploaded)
+        ********************************************************************************************************************************/
+        inline void computeTaskGraph::addDependency(computeTaskHandle before, computeTaskHandle after, VkPipelineStageFlags waitStage)
+        {
+            std::lock_guard<std::recursive_mutex> lock(mutex);
+
+            if (before >= tasks.size() || after >= tasks.size() || before == after)
+            {
+                throw std::runtime_error("Invalid task dependency");
+            }
+            tasks[after].dependencies.push_back(std::make_pair(before, waitStage));
+        }
+
+
+        /** @brief Make a task wait for one submitted by an earlier submit(), e.g. the previous frame's readback */
+        inline void computeTaskGraph::addDependency(const computeTaskTicket &before, computeTaskHandle after, VkPipelineStageFlags waitStage)
+        {
+            std::lock_guard<std::recursive_mutex> lock(mutex);
+
+            if (before.queueIndex >= queues.size() || after >= tasks.size())
+            {
+                throw std::runtime_error("Invalid task dependency");
+            }
+            tasks[after].externalWaits.push_back(taskWait { before.queueIndex, before.timelineValue, waitStage });
+        }
+
+
+        /** @brief Tasks in an order where every task comes after its dependencies, ties keep the order they were added in */
+        inline std::vector<computeTaskHandle> computeTaskGraph::sortTasks()
+        {
+            std::vector<uint32_t> pending(tasks.size(), 0);
+            std::vector<std::vector<computeTaskHandle>> dependents(tasks.size());
+            for (computeTaskHandle handle = 0; handle < tasks.size(); handle++)
+            {
+                for (const auto &dependency : tasks[handle].dependencies)
+                {
+                    pending[handle]++;
+                    dependents[dependency.first].push_back(handle);
+                }
+            }
+
+            std::vector<computeTaskHandle> order;
+            order.reserve(tasks.size());
+            for (computeTaskHandle handle = 0; handle < tasks.size(); handle++)
+            {
+                if (pending[handle] == 0)
+                {
+                    order.push_back(handle);
+                }
+            }
+            for (size_t i = 0; i < order.size(); i++)
+            {
+                for (computeTaskHandle dependent : dependents[order[i]])
+                {
+                    if (--pending[dependent] == 0)
+                    {
+                        order.push_back(dependent);
+                    }
+                }
+            }
+
+            if (order.size() != tasks.size())
+            {
+                throw std::runtime_error("Task graph has a dependency cycle");
+            }
+            return order;
+        }
+
+
+        /** @brief Record pending and submit it on its own, so staging waits during recording never depend on an unsubmitted task */
+        inline void computeTaskGraph::submitTask(const task &pending, computeTaskTicket *ticket, const std::vector<computeTaskTicket> &tickets)
+        {
+            taskQueue &queue = queues[pending.queueIndex];
+
+            if (queue.freeCommandBuffers.empty())
+            {
+                VkCommandBufferAllocateInfo cmdBufAllocateInfo = sourav::initializers::commandBufferAllocateInfo(queue.commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+                VkCommandBuffer commandBuffer;
+                ST_CHECK_RESULT(vkAllocateCommandBuffers(device->logicalDevice, &cmdBufAllocateInfo, &commandBuffer));
+                queue.freeCommandBuffers.push_back(commandBuffer);
+            }
+            VkCommandBuffer commandBuffer = queue.freeCommandBuffers.back();
+            queue.freeCommandBuffers.pop_back();
+
+            ticket->queueIndex = pending.queueIndex;
+            ticket->submissionValue = device->beginSubmission();
+
+            VkCommandBufferBeginInfo cmdBufInfo = sourav::initializers::commandBufferBeginInfo();
+            cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            ST_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+            try
+            {
+                pending.record(commandBuffer, ticket->submissionValue);
+            }
+            catch (...)
+            {
+                // Nothing was submitted, the staging the recorder took is released with the submission
+                ST_CHECK_RESULT(vkResetCommandBuffer(commandBuffer, 0));
+                queue.freeCommandBuffers.push_back(commandBuffer);
+                device->completeSubmission(ticket->submissionValue);
+                *ticket = computeTaskTicket();
+                throw;
+            }
+            ST_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+
+            // One wait per semaphore: the highest value covers the lower ones, the stages are merged
+            std::vector<taskWait> waits = pending.externalWaits;
+            for (const auto &dependency : pending.dependencies)
+            {
+                const computeTaskTicket &before = tickets[dependency.first];
+                waits.push_back(taskWait { before.queueIndex, before.timelineValue, dependency.second });
+            }
+
+            std::vector<VkSemaphore> waitSemaphores;
+            std::vector<uint64_t> waitValues;
+            std::vector<VkPipelineStageFlags> waitStages;
+            for (const taskWait &wait : waits)
+            {
+                VkSemaphore semaphore = queues[wait.queueIndex].semaphore;
+                auto it = std::find(waitSemaphores.begin(), waitSemaphores.end(), semaphore);
+                if (it == waitSemaphores.end())
+                {
+                    waitSemaphores.push_back(semaphore);
+                    waitValues.push_back(wait.timelineValue);
+                    waitStages.push_back(wait.waitStage);
+                }
+                else
+                {
+                    size_t index = it - waitSemaphores.begin();
+                    waitValues[index] = std::max(waitValues[index], wait.timelineValue);
+                    waitStages[index] |= wait.waitStage;
+                }
+            }
+
+            ticket->timelineValue = ++queue.lastValue;
+
+            VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+            timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+            timelineInfo.pWaitSemaphoreValues = waitValues.data();
+            timelineInfo.signalSemaphoreValueCount = 1;
+            timelineInfo.pSignalSemaphoreValues = &ticket->timelineValue;
+
+            VkSubmitInfo submitInfo = sourav::initializers::submitInfo();
+            submitInfo.pNext = &timelineInfo;
+            submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+            submitInfo.pWaitSemaphores = waitSemaphores.data();
+            submitInfo.pWaitDstStageMask = waitStages.data();
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &commandBuffer;
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &queue.semaphore;
+            ST_CHECK_RESULT(vkQueueSubmit(queue.queue, 1, &submitInfo, VK_NULL_HANDLE));
+
+            inFlight.push_back(submittedTask { *ticket, commandBuffer });
+        }
+
+
+        /******************************************************************************************************************************
+        * Record and submit every task added since the last submit, in dependency order, then start a new graph
+        *
+        * Returns without waiting for the GPU. Completed tasks of earlier submits are retired first
+        *
+        * @return One ticket per task, indexed by its handle
+        *
+        * @throw Throws an exception if the dependencies contain a cycle, nothing is submitted and the graph is discarded.
+        * Rethrows what a recorder throws, the tasks submitted before it still run and are retired as usual, the rest of
+        * the graph is discarded
+        ********************************************************************************************************************************/
+        inline std::vector<computeTaskTicket> computeTaskGraph::submit()
+        {
+            std::lock_guard<std::recursive_mutex> lock(mutex);
+
+            retire();
+
+            std::vector<computeTaskTicket> tickets;
+            try
+            {
+                std::vector<computeTaskHandle> order = sortTasks();
+
+                tickets.resize(tasks.size());
+                for (computeTaskHandle handle : order)
+                {
+                    submitTask(tasks[handle], &tickets[handle], tickets);
+                }
+            }
+            catch (...)
+            {
+                tasks.clear();
+                throw;
+            }
+
+            tasks.clear();
+            return tickets;
+        }
+
+
+        /** @brief Complete the device submissions of finished tasks and recycle their command buffers */
+        inline void computeTaskGraph::retire()
+        {
+            std::vector<uint64_t> counters(queues.size(), 0);
+            for (size_t i = 0; i < queues.size(); i++)
+            {
+                ST_CHECK_RESULT(vkGetSemaphoreCounterValue(device->logicalDevice, queues[i].semaphore, &counters[i]));
+            }
+
+            auto retired = std::partition(inFlight.begin(), inFlight.end(),
+                [&counters](const submittedTask &t) { return t.ticket.timelineValue > counters[t.ticket.queueIndex]; });
+            for (auto it = retired; it != inFlight.end(); ++it)
+            {
+                device->completeSubmission(it->ticket.submissionValue);
+                ST_CHECK_RESULT(vkResetCommandBuffer(it->commandBuffer, 0));
+                queues[it->ticket.queueIndex].freeCommandBuffers.push_back(it->commandBuffer);
+            }
+            inFlight.erase(retired, inFlight.end());
+        }
+
+
+        /** @brief True once the ticket's task has completed, unrelated submissions still open on the device don't hold it back */
+        inline bool computeTaskGraph::isComplete(const computeTaskTicket &ticket)
+        {
+            std::lock_guard<std::recursive_mutex> lock(mutex);
+
+            uint64_t counter = 0;
+            ST_CHECK_RESULT(vkGetSemaphoreCounterValue(device->logicalDevice, queues[ticket.queueIndex].semaphore, &counter));
+            retire();
+            return counter >= ticket.timelineValue;
+        }
+
+
+        /** @brief Block until the ticket's task has completed on the GPU */
+        inline void computeTaskGraph::wait(const computeTaskTicket &ticket)
+        {
+            VkSemaphore semaphore;
+            {
+                std::lock_guard<std::recursive_mutex> lock(mutex);
+                semaphore = queues[ticket.queueIndex].semaphore;
+            }
+
+            VkSemaphoreWaitInfo waitInfo = {};
+            waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+            waitInfo.semaphoreCount = 1;
+            waitInfo.pSemaphores = &semaphore;
+            waitInfo.pValues = &ticket.timelineValue;
+            ST_CHECK_RESULT(vkWaitSemaphores(device->logicalDevice, &waitInfo, DEFAULT_FENCE_TIMEOUT));
+
+            std::lock_guard<std::recursive_mutex> lock(mutex);
+            retire();
+        }
+
+
+        inline void computeTaskGraph::waitIdle()
+        {
+            std::lock_guard<std::recursive_mutex> lock(mutex);
+
+            std::vector<VkSemaphore> semaphores;
+            std::vector<uint64_t> values;
+            for (const taskQueue &queue : queues)
+            {
+                semaphores.push_back(queue.semaphore);
+                values.push_back(queue.lastValue);
+            }
+
+            if (!semaphores.empty())
+            {
+                VkSemaphoreWaitInfo waitInfo = {};
+                waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+                waitInfo.semaphoreCount = static_cast<uint32_t>(semaphores.size());
+                waitInfo.pSemaphores = semaphores.data();
+                waitInfo.pValues = values.data();
+                ST_CHECK_RESULT(vkWaitSemaphores(device->logicalDevice, &waitInfo, DEFAULT_FENCE_TIMEOUT));
+            }
+            retire();
+        }
+
+
+        /**
+        * @brief Staging ring waiter, waits on the graph's task for submissionValue, false if no in-flight task has that value
+        *
+        * Also false if another thread holds the graph: it may be recording a task and itself be waiting in the ring for
+        * a submitter this thread holds. The ring then falls back to transient staging instead of deadlocking
+        */
+        inline bool computeTaskGraph::waitForSubmission(uint64_t submissionValue)
+        {
+            std::unique_lock<std::recursive_mutex> lock(mutex, std::try_to_lock);
+            if (!lock.owns_lock())
+            {
+                return false;
+            }
+
+            auto it = std::find_if(inFlight.begin(), inFlight.end(),
+                [submissionValue](const submittedTask &t) { return t.ticket.submissionValue == submissionValue; });
+            if (it == inFlight.end())
+            {
+                return false;
+            }
+            // The lock stays held, wait() takes it again to retire and must not block on another thread meanwhile
+            wait(it->ticket);
+            return true;
+        }
+    }
+}
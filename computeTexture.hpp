@@ -1,206 +1,1881 @@
+#pragma once
+
 #include <vulkan/vulkan.h>
 
-#include "computeDeviceUtils.hpp"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "computeBarriers.hpp"
+#include "computeBlockEncoder.hpp"
+#include "computeConvert.hpp"
+#include "computeDevice.hpp"
+#include "computeDeviceUtils.hpp"
+#include "computeKtx2.hpp"
+#include "computeMappedFile.hpp"
+#include "computeMipmaps.hpp"
+#include "computeReadback.hpp"
+#include "computeThreadPool.hpp"
+
+namespace sourav
+{
+    namespace Texture
+    {
+        /** @brief Where the levels below the base level come from */
+        enum class computeMipMode
+        {
+            /** @brief Base level only */
+            None,
+            /**
+            * @brief Full chain, blitted on the GPU if the format supports linear blits and the copy queue supports graphics,
+            * downsampled on the host otherwise
+            */
+            Generate,
+            /** @brief Full chain, always downsampled on the host */
+            GenerateOnHost,
+            /** @brief The buffer holds the levels tightly packed, largest first, the chain may stop before 1x1 */
+            Pregenerated
+        };
+
+        /** @brief How texel data gets into the image */
+        enum class computeUploadMode
+        {
+            /** @brief Copy from staging memory on the GPU */
+            Staged,
+            /**
+            * @brief Write from the host without a GPU copy: with VK_EXT_host_image_copy if the device enabled it, otherwise
+            * into a linear image in DEVICE_LOCAL | HOST_VISIBLE memory (integrated GPUs, resizable BAR). Falls back to
+            * Staged when neither is available, for mip chains and for queue family transfers
+            */
+            Direct
+        };
+
+        /** @brief Shape of the image and of the view behind its descriptor */
+        enum class computeTextureType
+        {
+            Texture2D,
+            /** @brief Same sized layers behind one 2D_ARRAY view */
+            Array2D,
+            /** @brief Depth slices behind one 3D view, filtered across slices */
+            Texture3D,
+            /** @brief Six faces per cube in the order +X, -X, +Y, -Y, +Z, -Z, a CUBE_ARRAY view for more than one cube */
+            Cube
+        };
+
+        /** @brief Data of one mip level as the image stores it (whole blocks for BC / ASTC), all layers or depth slices back to back */
+        struct computeTextureLevel
+        {
+            const void * data = nullptr;
+            VkDeviceSize size = 0;
+        };
+
+        /**
+        * @brief Image, memory, view and sampler of one texture, move-only
+        *
+        * Owns its resources: destroy(), the destructor and assigning another texture hand them to the device's deferred
+        * destruction queue, which frees them once lastUse has completed. Submissions that use the texture after its
+        * upload must be reported with markUsed()
+        */
+        class computeTexture
+        {
+            public:
+                VkImage               image       = VK_NULL_HANDLE;
+                VkImageLayout         imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                sourav::Memory::computeAllocation allocation;
+                VkImageView           view        = VK_NULL_HANDLE;
+                VkFormat              format      = VK_FORMAT_UNDEFINED;
+                uint32_t              width       = 0, height = 0;
+                /** @brief Depth of a Texture3D, 1 otherwise */
+                uint32_t              depth       = 1;
+                uint32_t              mipLevels   = 0;
+                uint32_t              layerCount  = 0;
+                computeTextureType    type        = computeTextureType::Texture2D;
+                VkImageUsageFlags     usage       = 0;
+                VkDescriptorImageInfo descriptor  = {};
+                /** @brief STORAGE_IMAGE for storage images in GENERAL, COMBINED_IMAGE_SAMPLER otherwise */
+                VkDescriptorType      descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+                /** @brief VK_NULL_HANDLE if the image was created without SAMPLED usage */
+                VkSampler             sampler     = VK_NULL_HANDLE;
+                /** @brief Device the resources were created through, null while the texture is empty */
+                sourav::Device::computeDevice *owner = nullptr;
+                /** @brief Last submission that reads or writes the image, 0 if none is pending */
+                uint64_t              lastUse     = 0;
+
+                computeTexture() = default;
+                ~computeTexture();
+                computeTexture(const computeTexture &) = delete;
+                computeTexture &operator=(const computeTexture &) = delete;
+                computeTexture(computeTexture &&other) noexcept;
+                computeTexture &operator=(computeTexture &&other) noexcept;
+
+                void destroy();
+                void markUsed(uint64_t submissionValue);
+                void setSampler(const computeSamplerDesc &desc);
+
+                void fromBuffer(
+                    sourav::Device::computeDevice &device,
+                    void *             buffer,
+                    VkDeviceSize       bufferSize,
+                    VkFormat           format,
+                    uint32_t           texWidth,
+                    uint32_t           texHeight,
+                    VkQueue            copyQueue,
+                    VkFilter           filter          = VK_FILTER_LINEAR,
+                    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    computeMipMode     mipMode         = computeMipMode::None,
+                    computeUploadMode  uploadMode      = computeUploadMode::Staged);
+
+                /**
+                * @brief fromBuffer for texels of a format known at compile time, the vector's size is checked against the extent
+                *
+                * Texel is the texel type (e.g. uint32_t for RGBA8) or the component type (uint8_t, uint16_t, float, ...)
+                */
+                template <VkFormat Format, typename Texel>
+                void fromTexels(
+                    sourav::Device::computeDevice &device,
+                    const std::vector<Texel> &texels,
+                    uint32_t           texWidth,
+                    uint32_t           texHeight,
+                    VkQueue            copyQueue,
+                    VkFilter           filter          = VK_FILTER_LINEAR,
+                    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    computeMipMode     mipMode         = computeMipMode::None,
+                    computeUploadMode  uploadMode      = computeUploadMode::Staged);
+
+                /** @brief fromTexels for a Width x Height array, a size mismatch does not compile */
+                template <VkFormat Format, uint32_t Width, uint32_t Height, typename Texel, size_t Count>
+                void fromTexels(
+                    sourav::Device::computeDevice &device,
+                    const Texel        (&texels)[Count],
+                    VkQueue            copyQueue,
+                    VkFilter           filter          = VK_FILTER_LINEAR,
+                    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    computeMipMode     mipMode         = computeMipMode::None,
+                    computeUploadMode  uploadMode      = computeUploadMode::Staged);
+
+                /**
+                * @brief Create a layered texture (array, cubemap or volume) and upload every layer with one copy
+                *
+                * buffer holds the layers (or depth slices) back to back, for Pregenerated each layer with its whole chain
+                */
+                void fromBufferLayered(
+                    sourav::Device::computeDevice &device,
+                    void *             buffer,
+                    VkDeviceSize       bufferSize,
+                    VkFormat           format,
+                    uint32_t           texWidth,
+                    uint32_t           texHeight,
+                    computeTextureType type,
+                    uint32_t           depthOrLayers,
+                    VkQueue            copyQueue,
+                    VkFilter           filter          = VK_FILTER_LINEAR,
+                    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    computeMipMode     mipMode         = computeMipMode::None);
+
+                /** @brief 2D array of layerCount layers, see fromBufferLayered */
+                void fromBufferArray(
+                    sourav::Device::computeDevice &device,
+                    void *             buffer,
+                    VkDeviceSize       bufferSize,
+                    VkFormat           format,
+                    uint32_t           texWidth,
+                    uint32_t           texHeight,
+                    uint32_t           layerCount,
+                    VkQueue            copyQueue,
+                    VkFilter           filter          = VK_FILTER_LINEAR,
+                    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    computeMipMode     mipMode         = computeMipMode::None);
+
+                /** @brief cubeCount cubemaps of size x size faces, see fromBufferLayered */
+                void fromBufferCube(
+                    sourav::Device::computeDevice &device,
+                    void *             buffer,
+                    VkDeviceSize       bufferSize,
+                    VkFormat           format,
+                    uint32_t           size,
+                    VkQueue            copyQueue,
+                    uint32_t           cubeCount       = 1,
+                    VkFilter           filter          = VK_FILTER_LINEAR,
+                    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    computeMipMode     mipMode         = computeMipMode::None);
+
+                /**
+                * @brief Create a texture from a KTX2 file holding BC, ASTC or uncompressed levels, blocks until the copy has finished
+                *
+                * The file is memory mapped and every level is copied from the mapping straight into staging memory
+                */
+                void fromKtx2(
+                    sourav::Device::computeDevice &device,
+                    const std::string &path,
+                    VkQueue            copyQueue,
+                    VkFilter           filter          = VK_FILTER_LINEAR,
+                    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+                /**
+                * @brief fromBuffer that encodes 8-bit RGB(A) texels to BC1 or BC7 on the host first
+                *
+                * Uploads uncompressed through fromBuffer if format cannot be encoded or the device lacks the encoded format
+                * for imageUsageFlags
+                */
+                void fromBufferCompressed(
+                    sourav::Device::computeDevice &device,
+                    sourav::Threading::computeThreadPool *threadPool,
+                    void *             buffer,
+                    VkDeviceSize       bufferSize,
+                    VkFormat           format,
+                    uint32_t           texWidth,
+                    uint32_t           texHeight,
+                    sourav::Compression::computeBlockEncoding encoding,
+                    VkQueue            copyQueue,
+                    VkFilter           filter          = VK_FILTER_LINEAR,
+                    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    computeMipMode     mipMode         = computeMipMode::None);
+
+                /** @brief 3D volume of texDepth slices, mips are not generated for volumes */
+                void fromBufferVolume(
+                    sourav::Device::computeDevice &device,
+                    void *             buffer,
+                    VkDeviceSize       bufferSize,
+                    VkFormat           format,
+                    uint32_t           texWidth,
+                    uint32_t           texHeight,
+                    uint32_t           texDepth,
+                    VkQueue            copyQueue,
+                    VkFilter           filter          = VK_FILTER_LINEAR,
+                    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+                /**
+                * @brief Create an image compute shaders write to, left in GENERAL with a STORAGE_IMAGE descriptor
+                *
+                * Falls back to another format (see sourav::Formats::fallbackFormats) if format is not storage capable,
+                * the format member holds the one that was used. Blocks until the layout transition has finished
+                */
+                void createStorage(
+                    sourav::Device::computeDevice &device,
+                    VkFormat           format,
+                    uint32_t           texWidth,
+                    uint32_t           texHeight,
+                    VkQueue            queue,
+                    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                    uint32_t           mipLevels       = 1,
+                    computeTextureType type            = computeTextureType::Texture2D,
+                    uint32_t           depthOrLayers   = 1);
+
+                /**
+                * @brief Create the optimal tiled image and bind device local memory to it, contents are undefined
+                *
+                * depthOrLayers is the depth of a Texture3D and the layer count otherwise, a multiple of 6 for Cube
+                */
+                void createImage(
+                    sourav::Device::computeDevice &device,
+                    VkFormat           format,
+                    uint32_t           texWidth,
+                    uint32_t           texHeight,
+                    VkImageUsageFlags  imageUsageFlags,
+                    uint32_t           mipLevels     = 1,
+                    computeTextureType type          = computeTextureType::Texture2D,
+                    uint32_t           depthOrLayers = 1);
+
+                VkDeviceSize recordFromBuffer(
+                    sourav::Device::computeDevice &device,
+                    VkCommandBuffer    copyCmd,
+                    uint64_t           submissionValue,
+                    const void *       buffer,
+                    VkDeviceSize       bufferSize,
+                    VkFormat           format,
+                    uint32_t           texWidth,
+                    uint32_t           texHeight,
+                    VkImageUsageFlags  imageUsageFlags,
+                    VkImageLayout      imageLayout,
+                    computeMipMode     mipMode,
+                    uint32_t           srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    uint32_t           dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    computeUploadMode  uploadMode          = computeUploadMode::Staged);
+
+                VkDeviceSize recordFromBufferLayered(
+                    sourav::Device::computeDevice &device,
+                    VkCommandBuffer    copyCmd,
+                    uint64_t           submissionValue,
+                    const void *       buffer,
+                    VkDeviceSize       bufferSize,
+                    VkFormat           format,
+                    uint32_t           texWidth,
+                    uint32_t           texHeight,
+                    computeTextureType type,
+                    uint32_t           depthOrLayers,
+                    VkImageUsageFlags  imageUsageFlags,
+                    VkImageLayout      imageLayout,
+                    computeMipMode     mipMode,
+                    uint32_t           srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    uint32_t           dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED);
+
+                VkDeviceSize recordFromLevels(
+                    sourav::Device::computeDevice &device,
+                    VkCommandBuffer    copyCmd,
+                    uint64_t           submissionValue,
+                    const std::vector<computeTextureLevel> &levels,
+                    VkFormat           format,
+                    uint32_t           texWidth,
+                    uint32_t           texHeight,
+                    computeTextureType type,
+                    uint32_t           depthOrLayers,
+                    VkImageUsageFlags  imageUsageFlags,
+                    VkImageLayout      imageLayout,
+                    uint32_t           srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    uint32_t           dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED);
+
+                VkDeviceSize recordFromKtx2(
+                    sourav::Device::computeDevice &device,
+                    VkCommandBuffer    copyCmd,
+                    uint64_t           submissionValue,
+                    const uint8_t *    data,
+                    size_t             size,
+                    VkImageUsageFlags  imageUsageFlags,
+                    VkImageLayout      imageLayout,
+                    uint32_t           srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    uint32_t           dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED);
+
+                /** @brief Create the image and fill it with vkCopyMemoryToImageEXT, false if the device or format cannot */
+                bool uploadHostImageCopy(
+                    sourav::Device::computeDevice &device,
+                    const void *       buffer,
+                    VkFormat           format,
+                    uint32_t           texWidth,
+                    uint32_t           texHeight,
+                    VkImageUsageFlags  imageUsageFlags,
+                    VkImageLayout      imageLayout);
+
+                /**
+                * @brief Create a linear image in host visible device memory, write it through the mapping and record its
+                * transition to imageLayout. False if there is no such memory or the format cannot be linear
+                */
+                bool uploadLinear(
+                    sourav::Device::computeDevice &device,
+                    VkCommandBuffer    copyCmd,
+                    const void *       buffer,
+                    VkFormat           format,
+                    uint32_t           texWidth,
+                    uint32_t           texHeight,
+                    VkImageUsageFlags  imageUsageFlags,
+                    VkImageLayout      imageLayout);
+
+                /**
+                * @brief Record the copies from a staging buffer into the image and the transition to its final layout
+                *
+                * With generateMips, only level 0 is expected in regions and the other levels are blitted from it. With
+                * differing queue families the final transition is the release half of an ownership transfer, the other
+                * queue completes it with recordOwnershipAcquire. With a profiler, the transitions, the copy and the blits are
+                * recorded as separate scopes of submissionValue, with the queries copyCmd's family (srcQueueFamilyIndex) supports
+                */
+                void recordUpload(
+                    VkCommandBuffer                       copyCmd,
+                    VkBuffer                              stagingBuffer,
+                    const std::vector<VkBufferImageCopy> &regions,
+                    VkImageLayout                         imageLayout,
+                    bool                                  generateMips = false,
+                    uint32_t                              srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    uint32_t                              dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    sourav::Profiler::computeProfiler    *profiler = nullptr,
+                    uint64_t                              submissionValue = 0);
+
+                /** @brief Record the acquire half of the ownership transfer released by recordUpload, on a queue of dstQueueFamilyIndex */
+                void recordOwnershipAcquire(
+                    VkCommandBuffer    cmd,
+                    uint32_t           srcQueueFamilyIndex,
+                    uint32_t           dstQueueFamilyIndex);
+
+                sourav::Transfer::computeReadback recordReadback(
+                    sourav::Device::computeDevice &device,
+                    VkCommandBuffer    cmd,
+                    uint64_t           submissionValue,
+                    uint32_t           mipLevel = 0,
+                    uint32_t           layer    = 0);
+
+                /** @brief Copy one level of one layer back to the host, blocks until the copy has finished. See recordReadback */
+                void toBuffer(
+                    sourav::Device::computeDevice &device,
+                    VkQueue            queue,
+                    void *             buffer,
+                    VkDeviceSize       bufferSize,
+                    uint32_t           mipLevel = 0,
+                    uint32_t           layer    = 0);
+
+                /** @brief Get the shared sampler, create the view and fill in the descriptor */
+                void createDescriptor(
+                    VkDevice           logicalDevice,
+                    VkFilter           filter,
+                    VkImageLayout      imageLayout);
+
+            private:
+                void forget();
+        };
+
+
+        inline computeTexture::~computeTexture()
+        {
+            destroy();
+        }
+
+        inline computeTexture::computeTexture(computeTexture &&other) noexcept
+        {
+            *this = std::move(other);
+        }
+
+        /** @brief Take over the resources of other, the resources held so far are destroyed */
+        inline computeTexture &computeTexture::operator=(computeTexture &&other) noexcept
+        {
+            if (this != &other)
+            {
+                destroy();
+
+                image = other.image;
+                imageLayout = other.imageLayout;
+                allocation = other.allocation;
+                view = other.view;
+                format = other.format;
+                width = other.width;
+                height = other.height;
+                depth = other.depth;
+                mipLevels = other.mipLevels;
+                layerCount = other.layerCount;
+                type = other.type;
+                usage = other.usage;
+                descriptor = other.descriptor;
+                descriptorType = other.descriptorType;
+                sampler = other.sampler;
+                owner = other.owner;
+                lastUse = other.lastUse;
+
+                other.forget();
+            }
+            return *this;
+        }
+
+        /** @brief Queue the resources for destruction after lastUse and leave the texture empty, safe to call on an empty texture */
+        inline void computeTexture::destroy()
+        {
+            if (owner && (image != VK_NULL_HANDLE || view != VK_NULL_HANDLE || sampler != VK_NULL_HANDLE))
+            {
+                sourav::Device::computeDeferredResources resources;
+                resources.image = image;
+                resources.view = view;
+                resources.sampler = sampler;
+                resources.allocation = allocation;
+                owner->deferDestruction(resources, lastUse);
+            }
+            forget();
+        }
+
+        /** @brief Record that the submission reads or writes the image, destruction waits for the latest one */
+        inline void computeTexture::markUsed(uint64_t submissionValue)
+        {
+            lastUse = std::max(lastUse, submissionValue);
+        }
+
+        /******************************************************************************************************************************
+        * Switch to the shared sampler for desc (anisotropy, addressing, LOD range, ...)
+        *
+        * The previous sampler is released once lastUse has completed. Descriptor sets written before hold the old
+        * sampler and have to be written again
+        *
+        * @throw Throws an exception if the texture is empty or was created without SAMPLED usage
+        ********************************************************************************************************************************/
+        inline void computeTexture::setSampler(const computeSamplerDesc &desc)
+        {
+            if (!owner || !(usage & VK_IMAGE_USAGE_SAMPLED_BIT))
+            {
+                throw std::runtime_error("Texture has no sampled image to set a sampler for");
+            }
+
+            VkSampler previous = sampler;
+            sampler = owner->samplerCache.acquire(desc);
+            descriptor.sampler = sampler;
+
+            if (previous != VK_NULL_HANDLE)
+            {
+                sourav::Device::computeDeferredResources resources;
+                resources.sampler = previous;
+                owner->deferDestruction(resources, lastUse);
+            }
+        }
+
+        inline void computeTexture::forget()
+        {
+            image = VK_NULL_HANDLE;
+            view = VK_NULL_HANDLE;
+            sampler = VK_NULL_HANDLE;
+            allocation = sourav::Memory::computeAllocation();
+            descriptor = {};
+            owner = nullptr;
+            lastUse = 0;
+        }
+
+        /******************************************************************************************************************************
+        * Create the texture and upload its contents, blocks until the copy has finished
+        *
+        * @param device Device context the image, staging memory and command buffer come from
+        * @param buffer Texel data, for Pregenerated all levels back to back
+        * @param bufferSize Size of buffer in bytes
+        * @param format Format of the image
+        * @param texWidth Width of level 0
+        * @param texHeight Height of level 0
+        * @param copyQueue Queue the copy is submitted to
+        * @param filter Min / mag filter of the sampler
+        * @param imageUsageFlags Usage of the image, TRANSFER_DST (and TRANSFER_SRC for blitted mips) is added. With
+        *        STORAGE usage and the GENERAL layout compute shaders can write to the texture in place
+        * @param imageLayout Layout the image is left in
+        * @param mipMode Where levels below the base level come from
+        * @param uploadMode Staged, or Direct to skip the GPU copy where the device allows it
+        ********************************************************************************************************************************/
+        inline void computeTexture::fromBuffer(
+                sourav::Device::computeDevice &device,
+                void *             buffer,
+                VkDeviceSize       bufferSize,
+                VkFormat           format,
+                uint32_t           texWidth,
+                uint32_t           texHeight,
+                VkQueue            copyQueue,
+                VkFilter           filter,
+                VkImageUsageFlags  imageUsageFlags,
+                VkImageLayout      imageLayout,
+                computeMipMode     mipMode,
+                computeUploadMode  uploadMode)
+        {
+            assert(buffer);
+
+            VkDevice logicalDevice = device.logicalDevice;
+
+            // Use a separate command buffer for texture loading, recycled through the device's per-thread pool
+            VkCommandBuffer copyCmd = sourav::utils::createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, device.commandPool);
+
+            uint64_t submission = device.beginSubmission();
+            try
+            {
+                recordFromBuffer(device, copyCmd, submission, buffer, bufferSize, format, texWidth, texHeight, imageUsageFlags, imageLayout,
+                    mipMode, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, uploadMode);
+            }
+            catch (...)
+            {
+                // Nothing was submitted, retire the value so later submissions are not held back by it
+                device.commandPool.discardCommandBuffer(copyCmd);
+                device.completeSubmission(submission);
+                throw;
+            }
+
+            sourav::utils::flushCommandBuffer(copyCmd, copyQueue, device.commandPool);
+
+            // The flush waited for the copy, hand the staging region back
+            device.completeSubmission(submission);
+
+            createDescriptor(logicalDevice, filter, imageLayout);
+        }
+
+
+        /******************************************************************************************************************************
+        * Create a texture of Format from a vector of texels, blocks until the copy has finished
+        *
+        * Texel must be as large as a texel or a component of Format, which is checked at compile time. The byte size
+        * must match texWidth x texHeight, for Pregenerated it must hold at least the base level
+        *
+        * See fromBuffer for the other parameters
+        *
+        * @throw Throws an exception if the vector does not match the extent
+        ********************************************************************************************************************************/
+        template <VkFormat Format, typename Texel>
+        inline void computeTexture::fromTexels(
+                sourav::Device::computeDevice &device,
+                const std::vector<Texel> &texels,
+                uint32_t           texWidth,
+                uint32_t           texHeight,
+                VkQueue            copyQueue,
+                VkFilter           filter,
+                VkImageUsageFlags  imageUsageFlags,
+                VkImageLayout      imageLayout,
+                computeMipMode     mipMode,
+                computeUploadMode  uploadMode)
+        {
+            using Traits = sourav::Formats::computeFormatTraits<Format>;
+            static_assert(std::is_trivially_copyable<Texel>::value, "Texels must be trivially copyable");
+            static_assert(sizeof(Texel) == Traits::texelSize || sizeof(Texel) == Traits::componentSize,
+                "Texel type is neither a texel nor a component of the format");
+
+            const VkDeviceSize size = (VkDeviceSize)texels.size() * sizeof(Texel);
+            const VkDeviceSize baseSize = Traits::levelSize(texWidth, texHeight);
+            if (mipMode == computeMipMode::Pregenerated ? size < baseSize : size != baseSize)
+            {
+                throw std::runtime_error("Texel count does not match the texture extent");
+            }
+
+            // Only read, fromBuffer predates const buffers
+            fromBuffer(device, const_cast<Texel *>(texels.data()), size, Format, texWidth, texHeight, copyQueue, filter,
+                imageUsageFlags, imageLayout, mipMode, uploadMode);
+        }
+
+
+        /** @brief See the vector overload, Count is checked against Width x Height of Format at compile time */
+        template <VkFormat Format, uint32_t Width, uint32_t Height, typename Texel, size_t Count>
+        inline void computeTexture::fromTexels(
+                sourav::Device::computeDevice &device,
+                const Texel        (&texels)[Count],
+                VkQueue            copyQueue,
+                VkFilter           filter,
+                VkImageUsageFlags  imageUsageFlags,
+                VkImageLayout      imageLayout,
+                computeMipMode     mipMode,
+                computeUploadMode  uploadMode)
+        {
+            using Traits = sourav::Formats::computeFormatTraits<Format>;
+            static_assert(std::is_trivially_copyable<Texel>::value, "Texels must be trivially copyable");
+            static_assert(sizeof(Texel) == Traits::texelSize || sizeof(Texel) == Traits::componentSize,
+                "Texel type is neither a texel nor a component of the format");
+            static_assert(Count * sizeof(Texel) == Traits::levelSize(Width, Height), "Array size does not match Width x Height");
+
+            if (mipMode == computeMipMode::Pregenerated)
+            {
+                throw std::runtime_error("A single level array cannot hold a pregenerated chain");
+            }
+
+            fromBuffer(device, const_cast<Texel *>(texels), sizeof(texels), Format, Width, Height, copyQueue, filter,
+                imageUsageFlags, imageLayout, mipMode, uploadMode);
+        }
+
+
+        /******************************************************************************************************************************
+        * Create a layered texture and upload its contents, blocks until the copy has finished
+        *
+        * Every layer and level goes up in one vkCmdCopyBufferToImage, one region per level covering all layers, and the
+        * texture ends up behind a single descriptor
+        *
+        * @param type Array2D, Cube or Texture3D (Texture2D is the same as fromBuffer)
+        * @param depthOrLayers Depth of a Texture3D, the layer count otherwise (6 per cube for Cube)
+        *
+        * See fromBuffer for the other parameters. Texture3D supports the None mip mode only
+        ********************************************************************************************************************************/
+        inline void computeTexture::fromBufferLayered(
+                sourav::Device::computeDevice &device,
+                void *             buffer,
+                VkDeviceSize       bufferSize,
+                VkFormat           format,
+                uint32_t           texWidth,
+                uint32_t           texHeight,
+                computeTextureType type,
+                uint32_t           depthOrLayers,
+                VkQueue            copyQueue,
+                VkFilter           filter,
+                VkImageUsageFlags  imageUsageFlags,
+                VkImageLayout      imageLayout,
+                computeMipMode     mipMode)
+        {
+            assert(buffer);
+
+            VkCommandBuffer copyCmd = sourav::utils::createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, device.commandPool);
+
+            uint64_t submission = device.beginSubmission();
+            try
+            {
+                recordFromBufferLayered(device, copyCmd, submission, buffer, bufferSize, format, texWidth, texHeight, type, depthOrLayers,
+                    imageUsageFlags, imageLayout, mipMode);
+            }
+            catch (...)
+            {
+                device.commandPool.discardCommandBuffer(copyCmd);
+                device.completeSubmission(submission);
+                throw;
+            }
+
+            sourav::utils::flushCommandBuffer(copyCmd, copyQueue, device.commandPool);
+            device.completeSubmission(submission);
+
+            createDescriptor(device.logicalDevice, filter, imageLayout);
+        }
+
+
+        inline void computeTexture::fromBufferArray(
+                sourav::Device::computeDevice &device,
+                void *             buffer,
+                VkDeviceSize       bufferSize,
+                VkFormat           format,
+                uint32_t           texWidth,
+                uint32_t           texHeight,
+                uint32_t           layerCount,
+                VkQueue            copyQueue,
+                VkFilter           filter,
+                VkImageUsageFlags  imageUsageFlags,
+                VkImageLayout      imageLayout,
+                computeMipMode     mipMode)
+        {
+            fromBufferLayered(device, buffer, bufferSize, format, texWidth, texHeight, computeTextureType::Array2D, layerCount,
+                copyQueue, filter, imageUsageFlags, imageLayout, mipMode);
+        }
+
+
+        inline void computeTexture::fromBufferCube(
+                sourav::Device::computeDevice &device,
+                void *             buffer,
+                VkDeviceSize       bufferSize,
+                VkFormat           format,
+                uint32_t           size,
+                VkQueue            copyQueue,
+                uint32_t           cubeCount,
+                VkFilter           filter,
+                VkImageUsageFlags  imageUsageFlags,
+                VkImageLayout      imageLayout,
+                computeMipMode     mipMode)
+        {
+            fromBufferLayered(device, buffer, bufferSize, format, size, size, computeTextureType::Cube, cubeCount * 6,
+                copyQueue, filter, imageUsageFlags, imageLayout, mipMode);
+        }
+
+
+        inline void computeTexture::fromBufferVolume(
+                sourav::Device::computeDevice &device,
+                void *             buffer,
+                VkDeviceSize       bufferSize,
+                VkFormat           format,
+                uint32_t           texWidth,
+                uint32_t           texHeight,
+                uint32_t           texDepth,
+                VkQueue            copyQueue,
+                VkFilter           filter,
+                VkImageUsageFlags  imageUsageFlags,
+                VkImageLayout      imageLayout)
+        {
+            fromBufferLayered(device, buffer, bufferSize, format, texWidth, texHeight, computeTextureType::Texture3D, texDepth,
+                copyQueue, filter, imageUsageFlags, imageLayout, computeMipMode::None);
+        }
+
+
+        /******************************************************************************************************************************
+        * Create a texture from a KTX2 file, blocks until the copy has finished
+        *
+        * Arrays, cubemaps and volumes keep their shape, the levels stored in the file become the mip chain. Nothing is
+        * transcoded, so the device must support the file's format for imageUsageFlags
+        *
+        * @param path KTX2 file, see Transfer::parseKtx2 for what it may hold
+        *
+        * See fromBuffer for the other parameters
+        *
+        * @throw Throws an exception if the file cannot be read or its format is not supported by the device
+        ********************************************************************************************************************************/
+        inline void computeTexture::fromKtx2(
+                sourav::Device::computeDevice &device,
+                const std::string &path,
+                VkQueue            copyQueue,
+                VkFilter           filter,
+                VkImageUsageFlags  imageUsageFlags,
+                VkImageLayout      imageLayout)
+        {
+            sourav::Transfer::computeMappedFile file;
+            file.open(path);
+
+            VkCommandBuffer copyCmd = sourav::utils::createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, device.commandPool);
+
+            uint64_t submission = device.beginSubmission();
+            try
+            {
+                recordFromKtx2(device, copyCmd, submission, file.data, file.size, imageUsageFlags, imageLayout);
+            }
+            catch (...)
+            {
+                file.close();
+                device.commandPool.discardCommandBuffer(copyCmd);
+                device.completeSubmission(submission);
+                throw;
+            }
+            // The levels are in staging memory now
+            file.close();
+
+            sourav::utils::flushCommandBuffer(copyCmd, copyQueue, device.commandPool);
+            device.completeSubmission(submission);
+
+            createDescriptor(device.logicalDevice, filter, imageLayout);
+        }
+
+
+        /******************************************************************************************************************************
+        * Encode an 8-bit RGB(A) image to BC1 or BC7 on the host and upload the blocks, blocks until the copy has finished
+        *
+        * The image ends up 4x (BC7) or 8x (BC1 from RGBA) smaller in device memory. Mips are always downsampled on the host
+        * for Generate and GenerateOnHost, compressed formats cannot be blitted. sRGB sources give sRGB blocks
+        *
+        * @param threadPool (Optional) Pool the blocks are encoded on, the calling thread encodes alone without one
+        * @param encoding BC1 or BC7
+        *
+        * See fromBuffer for the other parameters
+        ********************************************************************************************************************************/
+        inline void computeTexture::fromBufferCompressed(
+                sourav::Device::computeDevice &device,
+                sourav::Threading::computeThreadPool *threadPool,
+                void *             buffer,
+                VkDeviceSize       bufferSize,
+                VkFormat           format,
+                uint32_t           texWidth,
+                uint32_t           texHeight,
+                sourav::Compression::computeBlockEncoding encoding,
+                VkQueue            copyQueue,
+                VkFilter           filter,
+                VkImageUsageFlags  imageUsageFlags,
+                VkImageLayout      imageLayout,
+                computeMipMode     mipMode)
+        {
+            assert(buffer);
+
+            const VkFormat blockFormat = sourav::Compression::encodedFormat(format, encoding);
+            if (blockFormat == VK_FORMAT_UNDEFINED ||
+                !sourav::Formats::supportsUsage(device.physicalDevice, blockFormat, imageUsageFlags | VK_IMAGE_USAGE_TRANSFER_DST_BIT))
+            {
+                fromBuffer(device, buffer, bufferSize, format, texWidth, texHeight, copyQueue, filter, imageUsageFlags, imageLayout, mipMode);
+                return;
+            }
+
+            // The encoder and the host downsampler work on RGBA8
+            const VkFormat rgbaFormat = sourav::Formats::formatInfo(format).type == sourav::Formats::computeComponentType::Srgb ?
+                VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+            const sourav::Formats::computeTexelConversion conversion = sourav::Formats::texelConversion(format, rgbaFormat);
+            const uint32_t srcTexelSize = sourav::Formats::texelSize(format);
+
+            uint32_t levelCount = 1;
+            if (mipMode == computeMipMode::Generate || mipMode == computeMipMode::GenerateOnHost)
+            {
+                levelCount = sourav::Mipmaps::mipLevelCount(texWidth, texHeight);
+            }
+            else if (mipMode == computeMipMode::Pregenerated)
+            {
+                levelCount = sourav::Mipmaps::pregeneratedLevelCount(format, texWidth, texHeight, bufferSize);
+            }
+            if (bufferSize < sourav::Mipmaps::mipLevelSize(srcTexelSize, texWidth, texHeight, 0))
+            {
+                throw std::runtime_error("Buffer is smaller than the texture");
+            }
+
+            VkDeviceSize blocksSize = 0;
+            for (uint32_t level = 0; level < levelCount; level++)
+            {
+                blocksSize += sourav::Formats::blockImageSize(blockFormat,
+                    sourav::Mipmaps::mipExtent(texWidth, level), sourav::Mipmaps::mipExtent(texHeight, level));
+            }
+            std::vector<uint8_t> blocks(blocksSize);
+            std::vector<computeTextureLevel> levels;
+
+            std::vector<uint8_t> rgba[2];
+            const uint8_t *source = (const uint8_t *)buffer;
+            VkDeviceSize blocksOffset = 0;
+            for (uint32_t level = 0; level < levelCount; level++)
+            {
+                const uint32_t levelWidth = sourav::Mipmaps::mipExtent(texWidth, level);
+                const uint32_t levelHeight = sourav::Mipmaps::mipExtent(texHeight, level);
+                std::vector<uint8_t> &levelTexels = rgba[level & 1];
+                levelTexels.resize((size_t)levelWidth * levelHeight * 4);
+
+                if (level == 0 || mipMode == computeMipMode::Pregenerated)
+                {
+                    sourav::Formats::convertTexels(conversion, source, levelTexels.data(), (size_t)levelWidth * levelHeight);
+                    source += (size_t)levelWidth * levelHeight * srcTexelSize;
+                }
+                else
+                {
+                    sourav::Mipmaps::downsample(rgbaFormat, rgba[(level - 1) & 1].data(),
+                        sourav::Mipmaps::mipExtent(texWidth, level - 1), sourav::Mipmaps::mipExtent(texHeight, level - 1), levelTexels.data());
+                }
+
+                computeTextureLevel levelBlocks;
+                levelBlocks.data = blocks.data() + blocksOffset;
+                levelBlocks.size = sourav::Formats::blockImageSize(blockFormat, levelWidth, levelHeight);
+                sourav::Compression::compressImage(blockFormat, levelTexels.data(), levelWidth, levelHeight,
+                    blocks.data() + blocksOffset, threadPool);
+                levels.push_back(levelBlocks);
+                blocksOffset += levelBlocks.size;
+            }
+
+            VkCommandBuffer copyCmd = sourav::utils::createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, device.commandPool);
+
+            uint64_t submission = device.beginSubmission();
+            try
+            {
+                recordFromLevels(device, copyCmd, submission, levels, blockFormat, texWidth, texHeight, computeTextureType::Texture2D, 1,
+                    imageUsageFlags, imageLayout);
+            }
+            catch (...)
+            {
+                device.commandPool.discardCommandBuffer(copyCmd);
+                device.completeSubmission(submission);
+                throw;
+            }
+
+            sourav::utils::flushCommandBuffer(copyCmd, copyQueue, device.commandPool);
+            device.completeSubmission(submission);
+
+            createDescriptor(device.logicalDevice, filter, imageLayout);
+        }
+
+
+        inline void computeTexture::createStorage(
+                sourav::Device::computeDevice &device,
+                VkFormat           format,
+                uint32_t           texWidth,
+                uint32_t           texHeight,
+                VkQueue            queue,
+                VkImageUsageFlags  imageUsageFlags,
+                uint32_t           mipLevels,
+                computeTextureType type,
+                uint32_t           depthOrLayers)
+        {
+            imageUsageFlags |= VK_IMAGE_USAGE_STORAGE_BIT;
+
+            // Nothing is uploaded, a fallback with another texel layout is as good as the requested format
+            VkFormat imageFormat = sourav::Formats::selectFormat(
+                device.physicalDevice, format, imageUsageFlags | VK_IMAGE_USAGE_TRANSFER_DST_BIT, false);
+            createImage(device, imageFormat, texWidth, texHeight, imageUsageFlags, mipLevels, type, depthOrLayers);
+
+            VkCommandBuffer layoutCmd = sourav::utils::createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, device.commandPool);
+
+            VkImageSubresourceRange subresourceRange = {};
+            subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            subresourceRange.levelCount = mipLevels;
+            subresourceRange.layerCount = layerCount;
+            sourav::utils::setImageLayout(
+                layoutCmd,
+                image,
+                VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_IMAGE_LAYOUT_GENERAL,
+                subresourceRange,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+            sourav::utils::flushCommandBuffer(layoutCmd, queue, device.commandPool);
+
+            imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+            createDescriptor(device.logicalDevice, VK_FILTER_LINEAR, VK_IMAGE_LAYOUT_GENERAL);
+        }
+
+
+        inline void computeTexture::createImage(
+                sourav::Device::computeDevice &device,
+                VkFormat           format,
+                uint32_t           texWidth,
+                uint32_t           texHeight,
+                VkImageUsageFlags  imageUsageFlags,
+                uint32_t           mipLevels,
+                computeTextureType type,
+                uint32_t           depthOrLayers)
+        {
+            const VkPhysicalDeviceLimits &limits = sourav::Device::getDeviceCaps(device.physicalDevice).properties.limits;
+            if (depthOrLayers == 0 ||
+                (type == computeTextureType::Texture3D && depthOrLayers > limits.maxImageDimension3D) ||
+                (type != computeTextureType::Texture3D && depthOrLayers > limits.maxImageArrayLayers))
+            {
+                throw std::runtime_error("Texture depth or layer count is out of the device's range");
+            }
+            if (type == computeTextureType::Cube &&
+                (texWidth != texHeight || depthOrLayers % 6 != 0 || texWidth > limits.maxImageDimensionCube))
+            {
+                throw std::runtime_error("Cubemaps need square faces and six layers per cube");
+            }
+
+            // Creating again replaces what the texture held
+            destroy();
+            owner = &device;
+
+            this->format = format;
+            width = texWidth;
+            height = texHeight;
+            depth = type == computeTextureType::Texture3D ? depthOrLayers : 1;
+            this->mipLevels = mipLevels;
+            layerCount = type == computeTextureType::Texture3D ? 1 : depthOrLayers;
+            this->type = type;
+            usage = imageUsageFlags | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+            imageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            // Create optimal tiled target image
+            VkImageCreateInfo imageCreateInfo = sourav::initializers::imageCreateInfo();
+            imageCreateInfo.imageType = type == computeTextureType::Texture3D ? VK_IMAGE_TYPE_3D : VK_IMAGE_TYPE_2D;
+            imageCreateInfo.format = format;
+            imageCreateInfo.mipLevels = mipLevels;
+            imageCreateInfo.arrayLayers = layerCount;
+            imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+            imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            imageCreateInfo.extent = { width, height, depth };
+            // TRANSFER_DST is always set for staging
+            imageCreateInfo.usage = usage;
+            if (type == computeTextureType::Cube)
+            {
+                imageCreateInfo.flags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
+            }
+
+            ST_CHECK_RESULT(vkCreateImage(device.logicalDevice, &imageCreateInfo, nullptr, &image));
 
-namespace sourav
-{
-    namespace Texture
-    {
-        class computeTexture
+            allocation = device.allocator.allocateImage(image, sourav::Memory::computeMemoryUsage::gpuOnly());
+        }
+
+
+        /******************************************************************************************************************************
+        * Create the image, stage its contents and record the upload, without submitting anything
+        *
+        * The image gets a full chain for Generate / GenerateOnHost and as many levels as the buffer holds for Pregenerated.
+        * Levels are staged at offsets aligned to the texel size and 4 bytes, as buffer to image copies require. If format
+        * lacks a feature imageUsageFlags needs, a fallback is used (e.g. UNORM for an sRGB storage image, RGBA8 for RGB8)
+        * and the texels are converted while they are written to staging memory
+        *
+        * @param device Device context the image and staging memory come from
+        * @param copyCmd Command buffer in the recording state
+        * @param submissionValue Submission copyCmd will be part of, the staging memory is held until it completes
+        * @param srcQueueFamilyIndex Family of the queue copyCmd is submitted to, VK_QUEUE_FAMILY_IGNORED for
+        *        device.queueFamilyIndex. Generate only blits on graphics families, the chain is downsampled on the host otherwise
+        * @param dstQueueFamilyIndex Family the image is released to, the blit path is not available across families
+        * @param uploadMode Staged, or Direct to write the image from the host where the device allows it
+        *
+        * @return Number of staging bytes used, 0 if the image was written directly
+        ********************************************************************************************************************************/
+        inline VkDeviceSize computeTexture::recordFromBuffer(
+                sourav::Device::computeDevice &device,
+                VkCommandBuffer    copyCmd,
+                uint64_t           submissionValue,
+                const void *       buffer,
+                VkDeviceSize       bufferSize,
+                VkFormat           format,
+                uint32_t           texWidth,
+                uint32_t           texHeight,
+                VkImageUsageFlags  imageUsageFlags,
+                VkImageLayout      imageLayout,
+                computeMipMode     mipMode,
+                uint32_t           srcQueueFamilyIndex,
+                uint32_t           dstQueueFamilyIndex,
+                computeUploadMode  uploadMode)
         {
-            public:
-                VkImage               image;
-                VkImageLayout         imageLayout;
-                VkDeviceMemory        deviceMemory;
-                VkImageView           view;
-                uint32_t              width, height;
-                uint32_t              mipLevels;
-                uint32_t              layerCount;
-                VkDescriptorImageInfo descriptor;
-                VkSampler             sampler;
+            if (uploadMode == computeUploadMode::Direct && mipMode == computeMipMode::None && srcQueueFamilyIndex == dstQueueFamilyIndex)
+            {
+                VkFormat imageFormat = sourav::Formats::selectUploadFormat(
+                    device.physicalDevice, format, imageUsageFlags | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
 
-                void fromBuffer(
-                    VkPhysicalDevice   physicalDevice,
-                    VkDevice           logicalDevice,
-                    VkCommandPool      pool,
-                    void *             buffer,
-                    VkDeviceSize       bufferSize,
-                    VkFormat           format,
-                    uint32_t           texWidth,
-                    uint32_t           texHeight,
-                    VkQueue            copyQueue,
-                    VkFilter           filter          = VK_FILTER_LINEAR,
-                    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
-                    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-        };
+                if (bufferSize < (VkDeviceSize)sourav::Formats::texelSize(format) * texWidth * texHeight)
+                {
+                    throw std::runtime_error("Buffer is smaller than the texture");
+                }
+                // Both direct paths write the caller's texels as they are, converted data always goes through staging
+                if (sourav::Formats::texelConversion(format, imageFormat).identity &&
+                    uploadHostImageCopy(device, buffer, imageFormat, texWidth, texHeight, imageUsageFlags, imageLayout))
+                {
+                    return 0;
+                }
+                if (sourav::Formats::texelConversion(format, imageFormat).identity &&
+                    uploadLinear(device, copyCmd, buffer, imageFormat, texWidth, texHeight, imageUsageFlags, imageLayout))
+                {
+                    lastUse = submissionValue;
+                    return 0;
+                }
+            }
 
-        void computeTexture::fromBuffer(
-                VkPhysicalDevice   physicalDevice,
-                VkDevice           logicalDevice,
-                VkCommandPool      pool,
-                void *             buffer,
+            return recordFromBufferLayered(device, copyCmd, submissionValue, buffer, bufferSize, format, texWidth, texHeight,
+                computeTextureType::Texture2D, 1, imageUsageFlags, imageLayout, mipMode, srcQueueFamilyIndex, dstQueueFamilyIndex);
+        }
+
+
+        /******************************************************************************************************************************
+        * Staged part of recordFromBuffer for any texture type
+        *
+        * Levels are staged level by level with all layers of a level back to back, so each level is a single copy region
+        * covering every layer. Host generated and pregenerated chains are built per layer
+        *
+        * @param type Shape of the image
+        * @param depthOrLayers Depth of a Texture3D, the layer count otherwise (6 per cube for Cube)
+        *
+        * See recordFromBuffer for the other parameters and the return value
+        ********************************************************************************************************************************/
+        inline VkDeviceSize computeTexture::recordFromBufferLayered(
+                sourav::Device::computeDevice &device,
+                VkCommandBuffer    copyCmd,
+                uint64_t           submissionValue,
+                const void *       buffer,
                 VkDeviceSize       bufferSize,
                 VkFormat           format,
                 uint32_t           texWidth,
                 uint32_t           texHeight,
-                VkQueue            copyQueue,
-                VkFilter           filter,
+                computeTextureType type,
+                uint32_t           depthOrLayers,
                 VkImageUsageFlags  imageUsageFlags,
-                VkImageLayout      imageLayout)
+                VkImageLayout      imageLayout,
+                computeMipMode     mipMode,
+                uint32_t           srcQueueFamilyIndex,
+                uint32_t           dstQueueFamilyIndex)
         {
-            assert(buffer);
+            if (type == computeTextureType::Texture3D && mipMode != computeMipMode::None)
+            {
+                throw std::runtime_error("3D textures support the None mip mode only");
+            }
 
-            width = texWidth;
-            height = texHeight;
-            mipLevels = 1;
+            // The data keeps its own format for host downsampling, only the image may use a fallback. Texels are
+            // converted to the fallback's layout while they are written to staging memory
+            VkFormat imageFormat = sourav::Formats::selectUploadFormat(
+                device.physicalDevice, format, imageUsageFlags | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+            const sourav::Formats::computeTexelConversion conversion = sourav::Formats::texelConversion(format, imageFormat);
+
+            // Layers of an array or cube, slices of a volume
+            const uint32_t slices = depthOrLayers;
+            const uint32_t srcTexelSize = sourav::Formats::texelSize(format);
+            const uint32_t texelSize = sourav::Formats::texelSize(imageFormat);
+
+            uint32_t levels = 1;
+            bool blit = false;
+            if (mipMode == computeMipMode::Generate || mipMode == computeMipMode::GenerateOnHost)
+            {
+                // Blits need a graphics queue, without an ownership transfer copyCmd runs on the device's family
+                const uint32_t copyQueueFamilyIndex =
+                    srcQueueFamilyIndex != VK_QUEUE_FAMILY_IGNORED ? srcQueueFamilyIndex : device.queueFamilyIndex;
+
+                levels = sourav::Mipmaps::mipLevelCount(texWidth, texHeight);
+                blit = mipMode == computeMipMode::Generate && srcQueueFamilyIndex == dstQueueFamilyIndex &&
+                    sourav::Mipmaps::supportsBlitGeneration(device.physicalDevice, imageFormat, copyQueueFamilyIndex);
+            }
+            else if (mipMode == computeMipMode::Pregenerated)
+            {
+                if (bufferSize % slices != 0)
+                {
+                    throw std::runtime_error("Buffer size is not a multiple of the layer count");
+                }
+                levels = sourav::Mipmaps::pregeneratedLevelCount(format, texWidth, texHeight, bufferSize / slices);
+            }
+
+            if (blit && levels > 1)
+            {
+                imageUsageFlags |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            }
+            createImage(device, imageFormat, texWidth, texHeight, imageUsageFlags, levels, type, depthOrLayers);
+            lastUse = submissionValue;
+
+            VkBufferImageCopy bufferCopyRegion = {};
+            bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+            bufferCopyRegion.imageSubresource.layerCount = layerCount;
+            bufferCopyRegion.imageExtent.depth = depth;
+
+            std::vector<VkBufferImageCopy> regions;
+
+            if (levels == 1 || blit)
+            {
+                // Only the base level comes from the buffer, its layers are already back to back
+                const VkDeviceSize baseTexels = (VkDeviceSize)width * height * slices;
+                const VkDeviceSize baseSize = baseTexels * texelSize;
+                if (bufferSize < baseTexels * srcTexelSize)
+                {
+                    throw std::runtime_error("Buffer is smaller than the texture");
+                }
+
+                sourav::Memory::computeStagingRegion staging = device.acquireStaging(baseSize, submissionValue);
+                sourav::Formats::convertTexels(conversion, buffer, staging.mapped, (size_t)baseTexels);
 
-            VkMemoryAllocateInfo memAllocInfo = sourav::initializers::memoryAllocateInfo();
-		    VkMemoryRequirements memReqs;
+                bufferCopyRegion.imageSubresource.mipLevel = 0;
+                bufferCopyRegion.imageExtent.width = width;
+                bufferCopyRegion.imageExtent.height = height;
+                bufferCopyRegion.bufferOffset = staging.offset;
+                regions.push_back(bufferCopyRegion);
 
-            // Use a separate command buffer for texture loading
-		    VkCommandBuffer copyCmd = sourav::utils::createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, pool, logicalDevice);
+                recordUpload(copyCmd, staging.buffer, regions, imageLayout, blit, srcQueueFamilyIndex, dstQueueFamilyIndex,
+                    device.profiler, submissionValue);
+                return baseSize;
+            }
+
+            const VkDeviceSize levelAlignment = texelSize % 4 == 0 ? texelSize : (texelSize % 2 == 0 ? texelSize * 2 : texelSize * 4);
+
+            std::vector<VkDeviceSize> levelOffsets(levels);
+            VkDeviceSize stagingSize = 0;
+            VkDeviceSize chainSize = 0;
+            for (uint32_t level = 0; level < levels; level++)
+            {
+                levelOffsets[level] = stagingSize;
+                stagingSize += sourav::Mipmaps::mipLevelSize(texelSize, width, height, level) * slices;
+                stagingSize = (stagingSize + levelAlignment - 1) / levelAlignment * levelAlignment;
+                chainSize += sourav::Mipmaps::mipLevelSize(srcTexelSize, width, height, level);
+            }
+            if (mipMode != computeMipMode::Pregenerated &&
+                bufferSize < sourav::Mipmaps::mipLevelSize(srcTexelSize, width, height, 0) * slices)
+            {
+                throw std::runtime_error("Buffer is smaller than the texture");
+            }
+
+            sourav::Memory::computeStagingRegion staging = device.acquireStaging(stagingSize, submissionValue);
+            uint8_t *mapped = (uint8_t *)staging.mapped;
+
+            for (uint32_t slice = 0; slice < slices; slice++)
+            {
+                const size_t baseTexels = (size_t)width * height;
+                uint8_t *sliceTarget = mapped + slice * baseTexels * texelSize;
+
+                if (mipMode == computeMipMode::Pregenerated)
+                {
+                    const uint8_t *chain = (const uint8_t *)buffer + slice * chainSize;
+                    VkDeviceSize packedOffset = 0;
+                    for (uint32_t level = 0; level < levels; level++)
+                    {
+                        const size_t levelTexels =
+                            (size_t)sourav::Mipmaps::mipExtent(width, level) * sourav::Mipmaps::mipExtent(height, level);
+                        sourav::Formats::convertTexels(conversion, chain + packedOffset,
+                            mapped + levelOffsets[level] + slice * levelTexels * texelSize, levelTexels);
+                        packedOffset += levelTexels * srcTexelSize;
+                    }
+                    continue;
+                }
+
+                // Downsample in cached host memory, staging memory is only ever written
+                const uint8_t *sliceSource = (const uint8_t *)buffer + slice * baseTexels * srcTexelSize;
+                sourav::Formats::convertTexels(conversion, sliceSource, sliceTarget, baseTexels);
+
+                std::vector<uint8_t> scratch[2];
+                const void *source = sliceSource;
+                for (uint32_t level = 1; level < levels; level++)
+                {
+                    std::vector<uint8_t> &target = scratch[level & 1];
+                    const size_t levelTexels =
+                        (size_t)sourav::Mipmaps::mipExtent(width, level) * sourav::Mipmaps::mipExtent(height, level);
+                    target.resize(levelTexels * srcTexelSize);
+
+                    sourav::Mipmaps::downsample(format, source,
+                        sourav::Mipmaps::mipExtent(width, level - 1), sourav::Mipmaps::mipExtent(height, level - 1), target.data());
+                    sourav::Formats::convertTexels(conversion, target.data(),
+                        mapped + levelOffsets[level] + slice * levelTexels * texelSize, levelTexels);
+                    source = target.data();
+                }
+            }
+
+            for (uint32_t level = 0; level < levels; level++)
+            {
+                bufferCopyRegion.imageSubresource.mipLevel = level;
+                bufferCopyRegion.imageExtent.width = sourav::Mipmaps::mipExtent(width, level);
+                bufferCopyRegion.imageExtent.height = sourav::Mipmaps::mipExtent(height, level);
+                bufferCopyRegion.bufferOffset = staging.offset + levelOffsets[level];
+                regions.push_back(bufferCopyRegion);
+            }
+
+            recordUpload(copyCmd, staging.buffer, regions, imageLayout, false, srcQueueFamilyIndex, dstQueueFamilyIndex,
+                device.profiler, submissionValue);
+            return stagingSize;
+        }
 
-            // Create a host-visible staging buffer that contains the raw image data
-            VkBuffer stagingBuffer;
-            VkDeviceMemory stagingMemory;
 
-            VkBufferCreateInfo bufferCreateInfo = sourav::initializers::bufferCreateInfo();
-            bufferCreateInfo.size = bufferSize;
-            
-            // This buffer is used as a transfer source for the buffer copy
-            bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-            bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        /******************************************************************************************************************************
+        * Create the image and record the upload of levels laid out as the image stores them, e.g. BC or ASTC blocks
+        *
+        * Every level is staged at a block aligned offset and copied with one region covering all layers, whose row length
+        * and image height are whole blocks. Nothing is converted, the device must support format for imageUsageFlags
+        *
+        * @param levels Base level first, each sized for its extent: whole blocks times the layer count, or times the
+        *        level's depth for a Texture3D
+        * @param format Format of the image, block compressed or any format formatInfo knows
+        * @param type Shape of the image
+        * @param depthOrLayers Depth of a Texture3D, the layer count otherwise (6 per cube for Cube)
+        *
+        * See recordFromBuffer for the other parameters and the return value
+        *
+        * @throw Throws an exception if a level does not match the extent or the device does not support format
+        ********************************************************************************************************************************/
+        inline VkDeviceSize computeTexture::recordFromLevels(
+                sourav::Device::computeDevice &device,
+                VkCommandBuffer    copyCmd,
+                uint64_t           submissionValue,
+                const std::vector<computeTextureLevel> &levels,
+                VkFormat           format,
+                uint32_t           texWidth,
+                uint32_t           texHeight,
+                computeTextureType type,
+                uint32_t           depthOrLayers,
+                VkImageUsageFlags  imageUsageFlags,
+                VkImageLayout      imageLayout,
+                uint32_t           srcQueueFamilyIndex,
+                uint32_t           dstQueueFamilyIndex)
+        {
+            const sourav::Formats::computeBlockInfo block = sourav::Formats::blockInfo(format);
+            if (block.blockSize == 0)
+            {
+                throw std::runtime_error("Unsupported format");
+            }
+            if (!sourav::Formats::supportsUsage(device.physicalDevice, format, imageUsageFlags | VK_IMAGE_USAGE_TRANSFER_DST_BIT))
+            {
+                throw std::runtime_error("Format does not support the requested image usage");
+            }
 
-            ST_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
+            const bool volume = type == computeTextureType::Texture3D;
+            const uint32_t levelCount = static_cast<uint32_t>(levels.size());
+            if (levelCount == 0 ||
+                levelCount > sourav::Mipmaps::mipLevelCount(volume ? std::max(texWidth, depthOrLayers) : texWidth, texHeight))
+            {
+                throw std::runtime_error("Level count does not fit the texture extent");
+            }
 
-            // Get memory requirements for the staging buffer (alignment, memory type bits)
-		    vkGetBufferMemoryRequirements(logicalDevice, stagingBuffer, &memReqs);
+            // Whole blocks, 4 byte aligned as buffer to image copies require
+            const uint32_t blockSize = block.blockSize;
+            const VkDeviceSize levelAlignment = blockSize % 4 == 0 ? blockSize : (blockSize % 2 == 0 ? blockSize * 2 : blockSize * 4);
 
-            memAllocInfo.allocationSize = memReqs.size;
+            std::vector<VkDeviceSize> levelOffsets(levelCount);
+            VkDeviceSize stagingSize = 0;
+            for (uint32_t level = 0; level < levelCount; level++)
+            {
+                const uint32_t slices = volume ? sourav::Mipmaps::mipExtent(depthOrLayers, level) : depthOrLayers;
+                const VkDeviceSize levelSize = sourav::Formats::blockImageSize(format,
+                    sourav::Mipmaps::mipExtent(texWidth, level), sourav::Mipmaps::mipExtent(texHeight, level)) * slices;
+                if (!levels[level].data || levels[level].size != levelSize)
+                {
+                    throw std::runtime_error("Level size does not match its format and extent");
+                }
 
-            // Get memory type index for a host visible buffer
-		    memAllocInfo.memoryTypeIndex = sourav::utils::getMemoryType(physicalDevice, memReqs.memoryTypeBits,         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, nullptr);
+                levelOffsets[level] = stagingSize;
+                stagingSize += levelSize;
+                stagingSize = (stagingSize + levelAlignment - 1) / levelAlignment * levelAlignment;
+            }
 
-            ST_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-		    ST_CHECK_RESULT(vkBindBufferMemory(logicalDevice, stagingBuffer, stagingMemory, 0));
+            createImage(device, format, texWidth, texHeight, imageUsageFlags, levelCount, type, depthOrLayers);
+            lastUse = submissionValue;
 
-            // Copy texture data into staging buffer
-            uint8_t *data;
-            ST_CHECK_RESULT(vkMapMemory(logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-            memcpy(data, buffer, bufferSize);
-            vkUnmapMemory(logicalDevice, stagingMemory);
+            sourav::Memory::computeStagingRegion staging = device.acquireStaging(stagingSize, submissionValue);
+            uint8_t *mapped = (uint8_t *)staging.mapped;
 
             VkBufferImageCopy bufferCopyRegion = {};
             bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            bufferCopyRegion.imageSubresource.mipLevel = 0;
             bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
-            bufferCopyRegion.imageSubresource.layerCount = 1;
-            bufferCopyRegion.imageExtent.width = width;
-            bufferCopyRegion.imageExtent.height = height;
-            bufferCopyRegion.imageExtent.depth = 1;
-            bufferCopyRegion.bufferOffset = 0;
+            bufferCopyRegion.imageSubresource.layerCount = layerCount;
+
+            std::vector<VkBufferImageCopy> regions;
+            for (uint32_t level = 0; level < levelCount; level++)
+            {
+                memcpy(mapped + levelOffsets[level], levels[level].data, levels[level].size);
+
+                const uint32_t levelWidth = sourav::Mipmaps::mipExtent(width, level);
+                const uint32_t levelHeight = sourav::Mipmaps::mipExtent(height, level);
+                bufferCopyRegion.imageSubresource.mipLevel = level;
+                // In texels, rounded up to whole blocks. The extent may end inside a block at the image's edge
+                bufferCopyRegion.bufferRowLength = (levelWidth + block.blockWidth - 1) / block.blockWidth * block.blockWidth;
+                bufferCopyRegion.bufferImageHeight = (levelHeight + block.blockHeight - 1) / block.blockHeight * block.blockHeight;
+                bufferCopyRegion.imageExtent.width = levelWidth;
+                bufferCopyRegion.imageExtent.height = levelHeight;
+                bufferCopyRegion.imageExtent.depth = sourav::Mipmaps::mipExtent(depth, level);
+                bufferCopyRegion.bufferOffset = staging.offset + levelOffsets[level];
+                regions.push_back(bufferCopyRegion);
+            }
+
+            recordUpload(copyCmd, staging.buffer, regions, imageLayout, false, srcQueueFamilyIndex, dstQueueFamilyIndex,
+                device.profiler, submissionValue);
+            return stagingSize;
+        }
+
+
+        /******************************************************************************************************************************
+        * Create the image for a KTX2 file in memory and record the upload of its levels, see recordFromLevels
+        *
+        * @param data The file, e.g. from a computeMappedFile. It is only read while recording
+        * @param size Size of the file in bytes
+        *
+        * See recordFromBuffer for the other parameters and the return value
+        ********************************************************************************************************************************/
+        inline VkDeviceSize computeTexture::recordFromKtx2(
+                sourav::Device::computeDevice &device,
+                VkCommandBuffer    copyCmd,
+                uint64_t           submissionValue,
+                const uint8_t *    data,
+                size_t             size,
+                VkImageUsageFlags  imageUsageFlags,
+                VkImageLayout      imageLayout,
+                uint32_t           srcQueueFamilyIndex,
+                uint32_t           dstQueueFamilyIndex)
+        {
+            const sourav::Transfer::computeKtx2Info info = sourav::Transfer::parseKtx2(data, size);
+
+            std::vector<computeTextureLevel> levels;
+            for (const sourav::Transfer::computeKtx2Level &level : info.levels)
+            {
+                computeTextureLevel textureLevel;
+                textureLevel.data = data + level.offset;
+                textureLevel.size = level.size;
+                levels.push_back(textureLevel);
+            }
+
+            // Cube array layers are stored face by face within each array element, the order of the image's layers
+            computeTextureType textureType = computeTextureType::Texture2D;
+            uint32_t depthOrLayers = std::max(1u, info.layers) * info.faces;
+            if (info.faces == 6)
+            {
+                textureType = computeTextureType::Cube;
+            }
+            else if (info.depth > 1)
+            {
+                textureType = computeTextureType::Texture3D;
+                depthOrLayers = info.depth;
+            }
+            else if (info.layers > 0)
+            {
+                textureType = computeTextureType::Array2D;
+            }
+
+            return recordFromLevels(device, copyCmd, submissionValue, levels, info.format, info.width, info.height, textureType,
+                depthOrLayers, imageUsageFlags, imageLayout, srcQueueFamilyIndex, dstQueueFamilyIndex);
+        }
+
+
+        inline bool computeTexture::uploadHostImageCopy(
+                sourav::Device::computeDevice &device,
+                const void *       buffer,
+                VkFormat           format,
+                uint32_t           texWidth,
+                uint32_t           texHeight,
+                VkImageUsageFlags  imageUsageFlags,
+                VkImageLayout      imageLayout)
+        {
+            if (!device.supportsHostImageCopy(imageLayout))
+            {
+                return false;
+            }
+
+            imageUsageFlags |= VK_IMAGE_USAGE_HOST_TRANSFER_BIT_EXT;
+            VkImageFormatProperties imageFormatProperties;
+            if (vkGetPhysicalDeviceImageFormatProperties(device.physicalDevice, format, VK_IMAGE_TYPE_2D, VK_IMAGE_TILING_OPTIMAL,
+                    imageUsageFlags | VK_IMAGE_USAGE_TRANSFER_DST_BIT, 0, &imageFormatProperties) != VK_SUCCESS)
+            {
+                return false;
+            }
+
+            createImage(device, format, texWidth, texHeight, imageUsageFlags, 1);
+
+            VkHostImageLayoutTransitionInfoEXT transitionInfo = {};
+            transitionInfo.sType = VK_STRUCTURE_TYPE_HOST_IMAGE_LAYOUT_TRANSITION_INFO_EXT;
+            transitionInfo.image = image;
+            transitionInfo.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            transitionInfo.newLayout = imageLayout;
+            transitionInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+            ST_CHECK_RESULT(device.transitionImageLayout(device.logicalDevice, 1, &transitionInfo));
+
+            // Rows are tightly packed in buffer
+            VkMemoryToImageCopyEXT region = {};
+            region.sType = VK_STRUCTURE_TYPE_MEMORY_TO_IMAGE_COPY_EXT;
+            region.pHostPointer = buffer;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent = { texWidth, texHeight, 1 };
+
+            VkCopyMemoryToImageInfoEXT copyInfo = {};
+            copyInfo.sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_IMAGE_INFO_EXT;
+            copyInfo.dstImage = image;
+            copyInfo.dstImageLayout = imageLayout;
+            copyInfo.regionCount = 1;
+            copyInfo.pRegions = &region;
+            ST_CHECK_RESULT(device.copyMemoryToImage(device.logicalDevice, &copyInfo));
+
+            this->imageLayout = imageLayout;
+            return true;
+        }
+
+
+        inline bool computeTexture::uploadLinear(
+                sourav::Device::computeDevice &device,
+                VkCommandBuffer    copyCmd,
+                const void *       buffer,
+                VkFormat           format,
+                uint32_t           texWidth,
+                uint32_t           texHeight,
+                VkImageUsageFlags  imageUsageFlags,
+                VkImageLayout      imageLayout)
+        {
+            // Coherent memory only, writes through the mapping need no flush before the submission
+            const VkMemoryPropertyFlags memoryFlags =
+                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+            VkImageFormatProperties imageFormatProperties;
+            if (!device.hasHostVisibleDeviceMemory() ||
+                !sourav::Formats::supportsUsage(device.physicalDevice, format, imageUsageFlags, VK_IMAGE_TILING_LINEAR) ||
+                vkGetPhysicalDeviceImageFormatProperties(device.physicalDevice, format, VK_IMAGE_TYPE_2D, VK_IMAGE_TILING_LINEAR,
+                    imageUsageFlags, 0, &imageFormatProperties) != VK_SUCCESS ||
+                imageFormatProperties.maxExtent.width < texWidth || imageFormatProperties.maxExtent.height < texHeight)
+            {
+                return false;
+            }
 
-            // Create optimal tiled target image
             VkImageCreateInfo imageCreateInfo = sourav::initializers::imageCreateInfo();
             imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
             imageCreateInfo.format = format;
-            imageCreateInfo.mipLevels = mipLevels;
+            imageCreateInfo.mipLevels = 1;
             imageCreateInfo.arrayLayers = 1;
             imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-            imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+            imageCreateInfo.tiling = VK_IMAGE_TILING_LINEAR;
             imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-            imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            imageCreateInfo.extent = { width, height, 1 };
+            // Keeps the contents written through the mapping across the first transition
+            imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
+            imageCreateInfo.extent = { texWidth, texHeight, 1 };
             imageCreateInfo.usage = imageUsageFlags;
 
-            // Ensure that the TRANSFER_DST bit is set for staging
-            if (!(imageCreateInfo.usage & VK_IMAGE_USAGE_TRANSFER_DST_BIT))
+            destroy();
+
+            VkImage linearImage;
+            ST_CHECK_RESULT(vkCreateImage(device.logicalDevice, &imageCreateInfo, nullptr, &linearImage));
+
+            VkMemoryRequirements memReqs;
+            vkGetImageMemoryRequirements(device.logicalDevice, linearImage, &memReqs);
+            VkBool32 memoryTypeFound = VK_FALSE;
+            device.allocator.findMemoryType(memReqs.memoryTypeBits, memoryFlags, &memoryTypeFound);
+            if (!memoryTypeFound)
             {
-                imageCreateInfo.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+                vkDestroyImage(device.logicalDevice, linearImage, nullptr);
+                return false;
             }
 
-            ST_CHECK_RESULT(vkCreateImage(logicalDevice, &imageCreateInfo, nullptr, &image));
+            image = linearImage;
+            owner = &device;
+            this->format = format;
+            width = texWidth;
+            height = texHeight;
+            depth = 1;
+            mipLevels = 1;
+            layerCount = 1;
+            type = computeTextureType::Texture2D;
+            usage = imageUsageFlags;
+            allocation = device.allocator.allocateImage(image, memoryFlags, VK_IMAGE_TILING_LINEAR);
+
+            // The driver decides the row pitch of a linear image
+            VkImageSubresource subresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0 };
+            VkSubresourceLayout subresourceLayout;
+            vkGetImageSubresourceLayout(device.logicalDevice, image, &subresource, &subresourceLayout);
+
+            const size_t rowSize = (size_t)sourav::Formats::texelSize(format) * texWidth;
+            uint8_t *mapped = (uint8_t *)allocation.mapped + subresourceLayout.offset;
+            for (uint32_t row = 0; row < texHeight; row++)
+            {
+                memcpy(mapped + row * subresourceLayout.rowPitch, (const uint8_t *)buffer + row * rowSize, rowSize);
+            }
 
-            vkGetImageMemoryRequirements(logicalDevice, image, &memReqs);
+            // Host writes before the submission are visible to it, the barrier only changes the layout
+            VkPipelineStageFlags dstStageMask = sourav::Sync::legacyStageMask(sourav::Sync::layoutState(imageLayout).stageMask);
+            if (dstStageMask == 0)
+            {
+                dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+            }
+            sourav::utils::setImageLayout(
+                copyCmd,
+                image,
+                VK_IMAGE_LAYOUT_PREINITIALIZED,
+                imageLayout,
+                { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
+                VK_PIPELINE_STAGE_HOST_BIT,
+                dstStageMask);
 
-            memAllocInfo.allocationSize = memReqs.size;
+            this->imageLayout = imageLayout;
+            return true;
+        }
 
-            memAllocInfo.memoryTypeIndex = sourav::utils::getMemoryType(physicalDevice, memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, nullptr);
 
-            ST_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-		    ST_CHECK_RESULT(vkBindImageMemory(logicalDevice, image, deviceMemory, 0));
+        inline void computeTexture::recordUpload(
+                VkCommandBuffer                       copyCmd,
+                VkBuffer                              stagingBuffer,
+                const std::vector<VkBufferImageCopy> &regions,
+                VkImageLayout                         imageLayout,
+                bool                                  generateMips,
+                uint32_t                              srcQueueFamilyIndex,
+                uint32_t                              dstQueueFamilyIndex,
+                sourav::Profiler::computeProfiler    *profiler,
+                uint64_t                              submissionValue)
+        {
+            // Blits need the image on one queue until the chain is complete
+            assert(!generateMips || srcQueueFamilyIndex == dstQueueFamilyIndex);
 
             VkImageSubresourceRange subresourceRange = {};
             subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
             subresourceRange.baseMipLevel = 0;
             subresourceRange.levelCount = mipLevels;
-            subresourceRange.layerCount = 1;
+            subresourceRange.layerCount = layerCount;
 
             // Image barrier for optimal image (target)
-		    // Optimal image will be used as destination for the copy
-            sourav::utils::setImageLayout(
-                copyCmd,
-                image,
-                VK_IMAGE_LAYOUT_UNDEFINED,
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                subresourceRange);
+            // Optimal image will be used as destination for the copy
+            {
+                sourav::Profiler::computeProfileScope scope(profiler, copyCmd, "texture.transition", submissionValue, false, srcQueueFamilyIndex);
+                sourav::utils::setImageLayout(
+                    copyCmd,
+                    image,
+                    VK_IMAGE_LAYOUT_UNDEFINED,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    subresourceRange,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT);
+            }
 
             // Copy mip levels from staging buffer
-            vkCmdCopyBufferToImage(
-                copyCmd,
-                stagingBuffer,
-                image,
-                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                1,
-                &bufferCopyRegion
-            );
+            {
+                sourav::Profiler::computeProfileScope scope(profiler, copyCmd, "texture.copy", submissionValue, false, srcQueueFamilyIndex);
+                vkCmdCopyBufferToImage(
+                    copyCmd,
+                    stagingBuffer,
+                    image,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    static_cast<uint32_t>(regions.size()),
+                    regions.data()
+                );
+            }
 
             // Change texture image layout to shader read after all mip levels have been copied
-		    this->imageLayout = imageLayout;
+            this->imageLayout = imageLayout;
 
-            sourav::utils::setImageLayout(
-                copyCmd,
+            if (generateMips)
+            {
+                sourav::Profiler::computeProfileScope scope(profiler, copyCmd, "texture.mipmaps", submissionValue, false, srcQueueFamilyIndex);
+                sourav::Mipmaps::recordBlitChain(copyCmd, image, width, height, mipLevels, layerCount, imageLayout);
+            }
+            else if (srcQueueFamilyIndex != dstQueueFamilyIndex)
+            {
+                sourav::utils::releaseImageOwnership(
+                    copyCmd,
+                    image,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    imageLayout,
+                    subresourceRange,
+                    srcQueueFamilyIndex,
+                    dstQueueFamilyIndex,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    VK_ACCESS_TRANSFER_WRITE_BIT);
+            }
+            else
+            {
+                sourav::Profiler::computeProfileScope scope(profiler, copyCmd, "texture.transition", submissionValue, false, srcQueueFamilyIndex);
+
+                // Only the stages that use imageLayout wait for the copy
+                VkPipelineStageFlags dstStageMask = sourav::Sync::legacyStageMask(sourav::Sync::layoutState(imageLayout).stageMask);
+                if (dstStageMask == 0)
+                {
+                    dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+                }
+                sourav::utils::setImageLayout(
+                    copyCmd,
+                    image,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    imageLayout,
+                    subresourceRange,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    dstStageMask);
+            }
+        }
+
+
+        inline void computeTexture::recordOwnershipAcquire(
+                VkCommandBuffer    cmd,
+                uint32_t           srcQueueFamilyIndex,
+                uint32_t           dstQueueFamilyIndex)
+        {
+            VkImageSubresourceRange subresourceRange = {};
+            subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            subresourceRange.baseMipLevel = 0;
+            subresourceRange.levelCount = mipLevels;
+            subresourceRange.layerCount = layerCount;
+
+            VkAccessFlags dstAccessMask;
+            switch (imageLayout)
+            {
+                case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+                    dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                    break;
+                case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+                    dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+                    break;
+                default:
+                    dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+                    break;
+            }
+
+            // Same layouts as the release in recordUpload, the transition itself happens only once
+            sourav::utils::acquireImageOwnership(
+                cmd,
                 image,
                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                 imageLayout,
-                subresourceRange);
-
-            sourav::utils::flushCommandBuffer(logicalDevice, copyCmd, copyQueue, pool);
-
-            // Clean up staging resources
-            vkDestroyBuffer(logicalDevice, stagingBuffer, nullptr);
-            vkFreeMemory(logicalDevice, stagingMemory, nullptr);
-
-            // Create sampler
-            VkSamplerCreateInfo samplerCreateInfo = {};
-            samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-            samplerCreateInfo.magFilter = filter;
-            samplerCreateInfo.minFilter = filter;
-            samplerCreateInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-            samplerCreateInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-            samplerCreateInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-            samplerCreateInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-            samplerCreateInfo.mipLodBias = 0.0f;
-            samplerCreateInfo.compareOp = VK_COMPARE_OP_NEVER;
-            samplerCreateInfo.minLod = 0.0f;
-            samplerCreateInfo.maxLod = 0.0f;
-            samplerCreateInfo.maxAnisotropy = 1.0f;
-            ST_CHECK_RESULT(vkCreateSampler(logicalDevice, &samplerCreateInfo, nullptr, &sampler));
-
-            // Create image view
+                subresourceRange,
+                srcQueueFamilyIndex,
+                dstQueueFamilyIndex,
+                VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                dstAccessMask);
+        }
+
+
+        /******************************************************************************************************************************
+        * Record a copy of one level of one layer into a pooled readback buffer
+        *
+        * The image goes to TRANSFER_SRC_OPTIMAL for the copy and back to imageLayout after it, waiting for the stages
+        * imageLayout is normally used with. Texels are tightly packed rows, all depth slices of the level for a Texture3D.
+        * Block compressed levels come back as tightly packed rows of blocks
+        *
+        * @param device Device context owning the readback pool
+        * @param cmd Command buffer of submissionValue, on a queue that owns the image
+        * @param submissionValue Submission cmd is part of (from beginSubmission), the texture is marked as used by it
+        * @param mipLevel Level to read
+        * @param layer Array layer (or cube face) to read, 0 for a Texture3D
+        *
+        * @return Readback whose view() holds the texels once submissionValue has completed
+        *
+        * @throw Throws an exception if the image lacks TRANSFER_SRC usage, has no contents, or the level or layer is out
+        * of range
+        ********************************************************************************************************************************/
+        inline sourav::Transfer::computeReadback computeTexture::recordReadback(
+                sourav::Device::computeDevice &device,
+                VkCommandBuffer    cmd,
+                uint64_t           submissionValue,
+                uint32_t           mipLevel,
+                uint32_t           layer)
+        {
+            if (!(usage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT))
+            {
+                throw std::runtime_error("Texture needs TRANSFER_SRC usage to be read back");
+            }
+            if (imageLayout == VK_IMAGE_LAYOUT_UNDEFINED || mipLevel >= mipLevels || layer >= layerCount)
+            {
+                throw std::runtime_error("Nothing to read back at the requested level and layer");
+            }
+
+            uint32_t levelWidth = std::max(1u, width >> mipLevel);
+            uint32_t levelHeight = std::max(1u, height >> mipLevel);
+            uint32_t levelDepth = std::max(1u, depth >> mipLevel);
+            // Block compressed levels are read back as whole blocks, like they are uploaded
+            VkDeviceSize size = sourav::Formats::blockImageSize(format, levelWidth, levelHeight) * levelDepth;
+
+            sourav::Transfer::computeReadback readback;
+            readback.allocate(device, size, submissionValue);
+
+            VkImageSubresourceRange subresourceRange = {};
+            subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            subresourceRange.baseMipLevel = mipLevel;
+            subresourceRange.levelCount = 1;
+            subresourceRange.baseArrayLayer = layer;
+            subresourceRange.layerCount = 1;
+
+            // Wait for whatever last used the image in its layout, e.g. the compute shader writing a storage image
+            VkPipelineStageFlags layoutStageMask = sourav::Sync::legacyStageMask(sourav::Sync::layoutState(imageLayout).stageMask);
+            if (layoutStageMask == 0)
+            {
+                layoutStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+            }
+            if (imageLayout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+            {
+                sourav::utils::setImageLayout(
+                    cmd,
+                    image,
+                    imageLayout,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    subresourceRange,
+                    layoutStageMask,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT);
+            }
+
+            VkBufferImageCopy region = {};
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = mipLevel;
+            region.imageSubresource.baseArrayLayer = layer;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent.width = levelWidth;
+            region.imageExtent.height = levelHeight;
+            region.imageExtent.depth = levelDepth;
+            vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer.buffer, 1, &region);
+
+            if (imageLayout != VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL)
+            {
+                sourav::utils::setImageLayout(
+                    cmd,
+                    image,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    imageLayout,
+                    subresourceRange,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    layoutStageMask);
+            }
+
+            readback.recordHostBarrier(cmd);
+            markUsed(submissionValue);
+            return readback;
+        }
+
+
+        inline void computeTexture::toBuffer(
+                sourav::Device::computeDevice &device,
+                VkQueue            queue,
+                void *             buffer,
+                VkDeviceSize       bufferSize,
+                uint32_t           mipLevel,
+                uint32_t           layer)
+        {
+            assert(buffer);
+
+            VkCommandBuffer copyCmd = sourav::utils::createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, device.commandPool);
+
+            uint64_t submission = device.beginSubmission();
+            sourav::Transfer::computeReadback readback;
+            try
+            {
+                readback = recordReadback(device, copyCmd, submission, mipLevel, layer);
+            }
+            catch (...)
+            {
+                // Nothing was submitted, retire the value so later submissions are not held back by it
+                device.commandPool.discardCommandBuffer(copyCmd);
+                device.completeSubmission(submission);
+                throw;
+            }
+
+            sourav::utils::flushCommandBuffer(copyCmd, queue, device.commandPool);
+            device.completeSubmission(submission);
+
+            readback.copyTo(buffer, bufferSize);
+        }
+
+
+        inline void computeTexture::createDescriptor(
+                VkDevice           logicalDevice,
+                VkFilter           filter,
+                VkImageLayout      imageLayout)
+        {
+            // Storage images are accessed without a sampler. Sampled ones share the device's sampler for filter with repeat
+            // addressing over the whole chain, setSampler() picks another
+            sampler = VK_NULL_HANDLE;
+            if (usage & VK_IMAGE_USAGE_SAMPLED_BIT)
+            {
+                sampler = owner->samplerCache.acquire(computeSamplerDesc().setFilter(filter));
+            }
+
+            const bool storage = imageLayout == VK_IMAGE_LAYOUT_GENERAL && (usage & VK_IMAGE_USAGE_STORAGE_BIT);
+
+            // Create image view, one view over every layer
             VkImageViewCreateInfo viewCreateInfo = {};
             viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
             viewCreateInfo.pNext = NULL;
-            viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            switch (type)
+            {
+                case computeTextureType::Array2D:
+                    viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+                    break;
+                case computeTextureType::Texture3D:
+                    viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_3D;
+                    break;
+                case computeTextureType::Cube:
+                    // Compute shaders address the faces of a storage cubemap as layers
+                    viewCreateInfo.viewType = storage ? VK_IMAGE_VIEW_TYPE_2D_ARRAY :
+                        (layerCount > 6 ? VK_IMAGE_VIEW_TYPE_CUBE_ARRAY : VK_IMAGE_VIEW_TYPE_CUBE);
+                    break;
+                default:
+                    viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+                    break;
+            }
             viewCreateInfo.format = format;
             viewCreateInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
-            viewCreateInfo.subresourceRange.levelCount = 1;
+            viewCreateInfo.subresourceRange.levelCount = mipLevels;
+            viewCreateInfo.subresourceRange.layerCount = layerCount;
             viewCreateInfo.image = image;
             ST_CHECK_RESULT(vkCreateImageView(logicalDevice, &viewCreateInfo, nullptr, &view));
 
             descriptor.sampler = sampler;
             descriptor.imageView = view;
             descriptor.imageLayout = imageLayout;
+            descriptorType = storage ? VK_DESCRIPTOR_TYPE_STORAGE_IMAGE : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
         }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,397 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <vector>
+
+#include "computeCommandPool.hpp"
+#include "computeDevice.hpp"
+#include "computeDeviceUtils.hpp"
+#include "computeFormats.hpp"
+#include "computeMipmaps.hpp"
+#include "computeTexture.hpp"
+#include "computeThreadPool.hpp"
+
+namespace sourav
+{
+    namespace Transfer
+    {
+        /** @brief One texture for computeTextureLoader::load, the source is either buffer or decode */
+        struct computeTextureLoadInfo
+        {
+            sourav::Texture::computeTexture *texture = nullptr;
+            const void *       buffer          = nullptr;
+            VkDeviceSize       bufferSize      = 0;
+            /** @brief Produces the source texels on a worker thread (e.g. decodes a file), replaces buffer when set */
+            std::function<void(std::vector<uint8_t> &texels)> decode;
+            VkFormat           format          = VK_FORMAT_R8G8B8A8_UNORM;
+            uint32_t           width           = 0;
+            uint32_t           height          = 0;
+            /** @brief Depth of a Texture3D, the layer count otherwise. The source holds the layers back to back */
+            uint32_t           depthOrLayers   = 1;
+            sourav::Texture::computeTextureType textureType = sourav::Texture::computeTextureType::Texture2D;
+            VkFilter           filter          = VK_FILTER_LINEAR;
+            VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT;
+            VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            sourav::Texture::computeMipMode    mipMode    = sourav::Texture::computeMipMode::None;
+            sourav::Texture::computeUploadMode uploadMode = sourav::Texture::computeUploadMode::Staged;
+        };
+
+        /**
+        * @brief Loads many textures at once, decoding, staging and recording on a thread pool
+        *
+        * Each worker records the textures it picked up into its own command buffer, from a per-thread pool. When a
+        * dedicated transfer queue is given the copies run there and ownership of the images is released to the device's
+        * queue family, which acquires it in a second submission waiting on a semaphore. Blitted mips need a graphics
+        * queue, so Generate falls back to host downsampling on a dedicated transfer queue
+        */
+        class computeTextureLoader
+        {
+            public:
+                VkDeviceSize maxBatchBytes = 0;
+
+                void create(
+                    sourav::Device::computeDevice        &device,
+                    sourav::Threading::computeThreadPool &threadPool,
+                    VkQueue                               queue,
+                    VkQueue                               transferQueue            = VK_NULL_HANDLE,
+                    uint32_t                              transferQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED);
+                void destroy();
+
+                void load(std::vector<computeTextureLoadInfo> &infos);
+
+            private:
+                struct loadBatch
+                {
+                    uint64_t                     submissionValue = 0;
+                    // One per texture that recorded completely, in completion order
+                    std::vector<VkCommandBuffer> commandBuffers;
+                    VkCommandBuffer              acquireCommandBuffer = VK_NULL_HANDLE;
+                    VkSemaphore                  semaphore = VK_NULL_HANDLE;
+                    VkFence                      fence = VK_NULL_HANDLE;
+                };
+
+                sourav::Device::computeDevice        *device     = nullptr;
+                sourav::Threading::computeThreadPool *threadPool = nullptr;
+                VkQueue                               queue         = VK_NULL_HANDLE;
+                VkQueue                               copyQueue     = VK_NULL_HANDLE;
+                uint32_t                              copyQueueFamilyIndex = 0;
+                // Pools for the copy queue's family, only ever recorded from inside load()
+                sourav::Command::computeCommandPool   copyCommandPool;
+
+                std::mutex                            loadMutex;
+                std::mutex                            batchMutex;
+                std::deque<loadBatch>                 inFlight;
+                std::vector<VkSemaphore>              freeSemaphores;
+                std::vector<VkSemaphore>              allSemaphores;
+
+                bool ownershipTransfer() const { return copyQueueFamilyIndex != device->queueFamilyIndex; }
+
+                void loadOne(loadBatch &batch, computeTextureLoadInfo &info);
+                void submitBatch(loadBatch &batch, const std::vector<computeTextureLoadInfo *> &loaded);
+                void retireBatch();
+
+                static VkDeviceSize stagingEstimate(const computeTextureLoadInfo &info);
+        };
+
+
+        /******************************************************************************************************************************
+        * Set up the loader
+        *
+        * @param device Device context, textures end up owned by its queue family
+        * @param threadPool Pool the decoding, staging and recording runs on
+        * @param queue Queue of device.queueFamilyIndex
+        * @param transferQueue (Optional) Queue of a dedicated transfer family, see utils::getQueueFamilyIndex
+        * @param transferQueueFamilyIndex Family of transferQueue
+        ********************************************************************************************************************************/
+        inline void computeTextureLoader::create(
+            sourav::Device::computeDevice        &device,
+            sourav::Threading::computeThreadPool &threadPool,
+            VkQueue                               queue,
+            VkQueue                               transferQueue,
+            uint32_t                              transferQueueFamilyIndex)
+        {
+            this->device = &device;
+            this->threadPool = &threadPool;
+            this->queue = queue;
+
+            if (transferQueue != VK_NULL_HANDLE && transferQueueFamilyIndex != VK_QUEUE_FAMILY_IGNORED)
+            {
+                copyQueue = transferQueue;
+                copyQueueFamilyIndex = transferQueueFamilyIndex;
+            }
+            else
+            {
+                copyQueue = queue;
+                copyQueueFamilyIndex = device.queueFamilyIndex;
+            }
+
+            if (maxBatchBytes == 0)
+            {
+                // One batch in flight while the next one fills the other half of the ring
+                maxBatchBytes = device.stagingRing.capacity / 2;
+            }
+
+            copyCommandPool.create(device.logicalDevice, copyQueueFamilyIndex);
+        }
+
+
+        inline void computeTextureLoader::destroy()
+        {
+            if (!device)
+            {
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(loadMutex);
+                while (!inFlight.empty())
+                {
+                    retireBatch();
+                }
+            }
+
+            for (VkSemaphore semaphore : allSemaphores)
+            {
+                vkDestroySemaphore(device->logicalDevice, semaphore, nullptr);
+            }
+            allSemaphores.clear();
+            freeSemaphores.clear();
+
+            copyCommandPool.destroy();
+            device = nullptr;
+        }
+
+
+        /** @brief Staging memory a texture takes at most, every mip level the upload stages included */
+        inline VkDeviceSize computeTextureLoader::stagingEstimate(const computeTextureLoadInfo &info)
+        {
+            // The buffer is exactly what gets staged
+            if (!info.decode && (info.mipMode == sourav::Texture::computeMipMode::None ||
+                info.mipMode == sourav::Texture::computeMipMode::Pregenerated))
+            {
+                return info.bufferSize;
+            }
+
+            // Decoded texels are not known yet and host generated levels are staged too, assume a full chain
+            const uint32_t texelSize = sourav::Formats::formatInfo(info.format).texelSize;
+            const uint32_t levels = info.mipMode == sourav::Texture::computeMipMode::None ? 1 : sourav::Mipmaps::mipLevelCount(info.width, info.height);
+            VkDeviceSize chainSize = 0;
+            for (uint32_t level = 0; level < levels; level++)
+            {
+                chainSize += sourav::Mipmaps::mipLevelSize(texelSize, info.width, info.height, level);
+            }
+            return chainSize * info.depthOrLayers;
+        }
+
+
+        /**
+        * @brief Runs on a worker: decode, stage and record one texture
+        *
+        * Each texture records into a command buffer of its own, so a texture that throws halfway leaves nothing behind
+        * in the batch's submission
+        */
+        inline void computeTextureLoader::loadOne(loadBatch &batch, computeTextureLoadInfo &info)
+        {
+            std::vector<uint8_t> texels;
+            const void *source = info.buffer;
+            VkDeviceSize sourceSize = info.bufferSize;
+            if (info.decode)
+            {
+                info.decode(texels);
+                source = texels.data();
+                sourceSize = texels.size();
+            }
+            assert(source);
+
+            VkCommandBuffer commandBuffer = copyCommandPool.acquireCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, false);
+            try
+            {
+                VkCommandBufferBeginInfo cmdBufInfo = sourav::initializers::commandBufferBeginInfo();
+                cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+                ST_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufInfo));
+
+                uint32_t dstQueueFamilyIndex = ownershipTransfer() ? device->queueFamilyIndex : copyQueueFamilyIndex;
+                if (info.textureType == sourav::Texture::computeTextureType::Texture2D)
+                {
+                    info.texture->recordFromBuffer(*device, commandBuffer, batch.submissionValue, source, sourceSize,
+                        info.format, info.width, info.height, info.imageUsageFlags, info.imageLayout, info.mipMode,
+                        copyQueueFamilyIndex, dstQueueFamilyIndex, info.uploadMode);
+                }
+                else
+                {
+                    info.texture->recordFromBufferLayered(*device, commandBuffer, batch.submissionValue, source, sourceSize,
+                        info.format, info.width, info.height, info.textureType, info.depthOrLayers, info.imageUsageFlags, info.imageLayout,
+                        info.mipMode, copyQueueFamilyIndex, dstQueueFamilyIndex);
+                }
+                info.texture->createDescriptor(device->logicalDevice, info.filter, info.imageLayout);
+
+                ST_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+            }
+            catch (...)
+            {
+                copyCommandPool.discardCommandBuffer(commandBuffer);
+                throw;
+            }
+
+            std::lock_guard<std::mutex> lock(batchMutex);
+            batch.commandBuffers.push_back(commandBuffer);
+        }
+
+
+        /******************************************************************************************************************************
+        * Load a set of textures, blocks until all of them are ready for use on the device's queue
+        *
+        * Textures are split into batches of about maxBatchBytes of staging memory. A batch is submitted as soon as its
+        * textures are recorded, the next one is prepared while it runs. If a decode callback throws, the remaining textures
+        * are still loaded and the first exception is rethrown at the end. Must not be called from a worker of threadPool
+        *
+        * @param infos Textures to load, each texture member must point to a distinct texture
+        ********************************************************************************************************************************/
+        inline void computeTextureLoader::load(std::vector<computeTextureLoadInfo> &infos)
+        {
+            std::lock_guard<std::mutex> lock(loadMutex);
+
+            std::exception_ptr failure;
+            size_t next = 0;
+            while (next < infos.size())
+            {
+                // One batch stays on the GPU while this one is staged into the other half of the ring
+                while (inFlight.size() > 1)
+                {
+                    retireBatch();
+                }
+
+                inFlight.emplace_back();
+                loadBatch &batch = inFlight.back();
+                batch.submissionValue = device->beginSubmission();
+
+                std::vector<computeTextureLoadInfo *> queued;
+                std::vector<std::future<void>> futures;
+                VkDeviceSize batchBytes = 0;
+                while (next < infos.size())
+                {
+                    // A texture larger than maxBatchBytes still gets a batch of its own
+                    VkDeviceSize estimate = stagingEstimate(infos[next]);
+                    if (!queued.empty() && batchBytes + estimate > maxBatchBytes)
+                    {
+                        break;
+                    }
+                    batchBytes += estimate;
+
+                    computeTextureLoadInfo &info = infos[next++];
+
+                    queued.push_back(&info);
+                    futures.push_back(threadPool->submit([this, &batch, &info]() { loadOne(batch, info); }));
+                }
+
+                // Textures whose task threw have nothing in the submission and are left out of the ownership acquire
+                std::vector<computeTextureLoadInfo *> loaded;
+                for (size_t i = 0; i < futures.size(); i++)
+                {
+                    try
+                    {
+                        threadPool->wait(futures[i]);
+                        loaded.push_back(queued[i]);
+                    }
+                    catch (...)
+                    {
+                        if (!failure)
+                        {
+                            failure = std::current_exception();
+                        }
+                    }
+                }
+
+                submitBatch(batch, loaded);
+            }
+
+            while (!inFlight.empty())
+            {
+                retireBatch();
+            }
+
+            if (failure)
+            {
+                std::rethrow_exception(failure);
+            }
+        }
+
+
+        /** @brief Submit the recorded copies, followed by the ownership acquire on the device's queue when needed */
+        inline void computeTextureLoader::submitBatch(loadBatch &batch, const std::vector<computeTextureLoadInfo *> &loaded)
+        {
+            batch.fence = device->commandPool.acquireFence();
+
+            // Every task has finished, so the list is complete and every command buffer in it has ended
+            VkSubmitInfo submitInfo = sourav::initializers::submitInfo();
+            submitInfo.commandBufferCount = static_cast<uint32_t>(batch.commandBuffers.size());
+            submitInfo.pCommandBuffers = batch.commandBuffers.data();
+
+            if (!ownershipTransfer())
+            {
+                ST_CHECK_RESULT(vkQueueSubmit(copyQueue, 1, &submitInfo, batch.fence));
+                return;
+            }
+
+            if (freeSemaphores.empty())
+            {
+                VkSemaphoreCreateInfo semaphoreCreateInfo = sourav::initializers::semaphoreCreateInfo();
+                VkSemaphore semaphore;
+                ST_CHECK_RESULT(vkCreateSemaphore(device->logicalDevice, &semaphoreCreateInfo, nullptr, &semaphore));
+                allSemaphores.push_back(semaphore);
+                freeSemaphores.push_back(semaphore);
+            }
+            batch.semaphore = freeSemaphores.back();
+            freeSemaphores.pop_back();
+
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &batch.semaphore;
+            ST_CHECK_RESULT(vkQueueSubmit(copyQueue, 1, &submitInfo, VK_NULL_HANDLE));
+
+            batch.acquireCommandBuffer = device->commandPool.acquireCommandBuffer();
+            for (computeTextureLoadInfo *info : loaded)
+            {
+                info->texture->recordOwnershipAcquire(batch.acquireCommandBuffer, copyQueueFamilyIndex, device->queueFamilyIndex);
+            }
+            ST_CHECK_RESULT(vkEndCommandBuffer(batch.acquireCommandBuffer));
+
+            VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+            VkSubmitInfo acquireSubmitInfo = sourav::initializers::submitInfo();
+            acquireSubmitInfo.waitSemaphoreCount = 1;
+            acquireSubmitInfo.pWaitSemaphores = &batch.semaphore;
+            acquireSubmitInfo.pWaitDstStageMask = &waitStageMask;
+            acquireSubmitInfo.commandBufferCount = 1;
+            acquireSubmitInfo.pCommandBuffers = &batch.acquireCommandBuffer;
+            ST_CHECK_RESULT(vkQueueSubmit(queue, 1, &acquireSubmitInfo, batch.fence));
+        }
+
+
+        /** @brief Wait for the oldest batch in flight and recycle what it used */
+        inline void computeTextureLoader::retireBatch()
+        {
+            loadBatch &batch = inFlight.front();
+
+            ST_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &batch.fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+            device->completeSubmission(batch.submissionValue);
+
+            device->commandPool.releaseFence(batch.fence);
+            device->commandPool.releaseCommandBuffer(batch.acquireCommandBuffer);
+            for (VkCommandBuffer commandBuffer : batch.commandBuffers)
+            {
+                copyCommandPool.releaseCommandBuffer(commandBuffer);
+            }
+            if (batch.semaphore != VK_NULL_HANDLE)
+            {
+                freeSemaphores.push_back(batch.semaphore);
+            }
+
+            inFlight.pop_front();
+        }
+    }
+}
@@ -0,0 +1,490 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "computeBarriers.hpp"
+#include "computeDevice.hpp"
+#include "computeDeviceUtils.hpp"
+#include "computeFormats.hpp"
+#include "computeMappedFile.hpp"
+#include "computeMipmaps.hpp"
+#include "computeTexture.hpp"
+
+// Staging memory a streamed upload holds at most, split evenly between the chunks in flight
+#define DEFAULT_STREAM_WINDOW_SIZE (16ull * 1024 * 1024)
+// Chunks submitted but not yet retired, the host fills the next one while the GPU copies the previous
+#define STREAM_CHUNKS_IN_FLIGHT 2
+
+namespace sourav
+{
+    namespace Transfer
+    {
+        /** @brief Counters of a computeTextureStreamer, peakStagingBytes stays at or below windowSize */
+        struct computeStreamStats
+        {
+            uint64_t     uploadCount      = 0;
+            uint64_t     chunkCount       = 0;
+            uint64_t     regionCount      = 0;
+            VkDeviceSize bytesStreamed    = 0;
+            VkDeviceSize peakStagingBytes = 0;
+        };
+
+        /**
+        * @brief Uploads textures of any size through a bounded staging window
+        *
+        * The source is read row band by row band (tiles when a single row does not fit a chunk) straight into staging
+        * memory, each chunk becomes one vkCmdCopyBufferToImage with a region per band or tile and is submitted on its
+        * own. Host memory use is bounded by windowSize no matter how large the image is, a file source is memory mapped
+        * and its pages are dropped as soon as they have been copied
+        */
+        class computeTextureStreamer
+        {
+            public:
+                VkDeviceSize windowSize = DEFAULT_STREAM_WINDOW_SIZE;
+
+                void create(sourav::Device::computeDevice &device, VkQueue queue, VkDeviceSize windowSize = DEFAULT_STREAM_WINDOW_SIZE);
+                void destroy();
+
+                void upload(
+                    sourav::Texture::computeTexture &texture,
+                    const void *       texels,
+                    VkDeviceSize       rowPitch,
+                    VkFormat           format,
+                    uint32_t           texWidth,
+                    uint32_t           texHeight,
+                    VkFilter           filter          = VK_FILTER_LINEAR,
+                    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    sourav::Texture::computeMipMode mipMode = sourav::Texture::computeMipMode::None);
+
+                void uploadFile(
+                    sourav::Texture::computeTexture &texture,
+                    const std::string &path,
+                    VkDeviceSize       offset,
+                    VkFormat           format,
+                    uint32_t           texWidth,
+                    uint32_t           texHeight,
+                    VkFilter           filter          = VK_FILTER_LINEAR,
+                    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    sourav::Texture::computeMipMode mipMode = sourav::Texture::computeMipMode::None);
+
+                computeStreamStats getStats();
+
+            private:
+                struct streamChunk
+                {
+                    uint64_t        submissionValue = 0;
+                    VkCommandBuffer commandBuffer   = VK_NULL_HANDLE;
+                    VkFence         fence           = VK_NULL_HANDLE;
+                    VkDeviceSize    stagingBytes    = 0;
+                };
+
+                sourav::Device::computeDevice *device = nullptr;
+                VkQueue                        queue  = VK_NULL_HANDLE;
+
+                std::mutex                     mutex;
+                std::deque<streamChunk>        inFlight;
+                VkDeviceSize                   stagingInFlight = 0;
+                computeStreamStats             stats;
+
+                void stream(
+                    sourav::Texture::computeTexture &texture,
+                    const uint8_t *    texels,
+                    VkDeviceSize       rowPitch,
+                    VkFormat           format,
+                    uint32_t           texWidth,
+                    uint32_t           texHeight,
+                    VkFilter           filter,
+                    VkImageUsageFlags  imageUsageFlags,
+                    VkImageLayout      imageLayout,
+                    sourav::Texture::computeMipMode mipMode,
+                    computeMappedFile *file);
+                void submitChunk(streamChunk &chunk);
+                void retireChunk();
+                void abandonChunk(streamChunk &chunk);
+        };
+
+
+        /******************************************************************************************************************************
+        * Set up the streamer
+        *
+        * @param device Device context the images, staging memory and command buffers come from
+        * @param queue Queue of device.queueFamilyIndex the copies are submitted to, must support graphics for blitted mips
+        * @param windowSize Staging memory held at most, every chunk should fit the device's staging ring
+        ********************************************************************************************************************************/
+        inline void computeTextureStreamer::create(sourav::Device::computeDevice &device, VkQueue queue, VkDeviceSize windowSize)
+        {
+            this->device = &device;
+            this->queue = queue;
+            this->windowSize = windowSize;
+            stats = computeStreamStats();
+        }
+
+
+        inline void computeTextureStreamer::destroy()
+        {
+            if (!device)
+            {
+                return;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            while (!inFlight.empty())
+            {
+                retireChunk();
+            }
+            device = nullptr;
+        }
+
+
+        /******************************************************************************************************************************
+        * Create the texture and stream its contents from memory, blocks until the last chunk has been copied
+        *
+        * @param texture Texture to create
+        * @param texels Level 0 texels, row by row
+        * @param rowPitch Bytes from one row of texels to the next, 0 for tightly packed rows
+        * @param format Format of the image, must be uncompressed
+        * @param texWidth Width of the image
+        * @param texHeight Height of the image
+        * @param filter Min / mag filter of the sampler
+        * @param imageUsageFlags Usage of the image, TRANSFER_DST (and TRANSFER_SRC for blitted mips) is added
+        * @param imageLayout Layout the image is left in
+        * @param mipMode None, or Generate for a chain blitted on the GPU. Host downsampling would need the whole level
+        *        in host memory and is not available here
+        ********************************************************************************************************************************/
+        inline void computeTextureStreamer::upload(
+            sourav::Texture::computeTexture &texture,
+            const void *       texels,
+            VkDeviceSize       rowPitch,
+            VkFormat           format,
+            uint32_t           texWidth,
+            uint32_t           texHeight,
+            VkFilter           filter,
+            VkImageUsageFlags  imageUsageFlags,
+            VkImageLayout      imageLayout,
+            sourav::Texture::computeMipMode mipMode)
+        {
+            assert(texels);
+            std::lock_guard<std::mutex> lock(mutex);
+            stream(texture, static_cast<const uint8_t *>(texels), rowPitch, format, texWidth, texHeight,
+                filter, imageUsageFlags, imageLayout, mipMode, nullptr);
+        }
+
+
+        /******************************************************************************************************************************
+        * Create the texture and stream its contents from a file of raw, tightly packed texels
+        *
+        * The file is memory mapped, nothing is read into host memory besides the pages of the band being copied
+        *
+        * @param path File to read
+        * @param offset Byte offset of the first texel in the file (e.g. past a header)
+        *
+        * See upload() for the other parameters
+        ********************************************************************************************************************************/
+        inline void computeTextureStreamer::uploadFile(
+            sourav::Texture::computeTexture &texture,
+            const std::string &path,
+            VkDeviceSize       offset,
+            VkFormat           format,
+            uint32_t           texWidth,
+            uint32_t           texHeight,
+            VkFilter           filter,
+            VkImageUsageFlags  imageUsageFlags,
+            VkImageLayout      imageLayout,
+            sourav::Texture::computeMipMode mipMode)
+        {
+            computeMappedFile file;
+            file.open(path);
+
+            const VkDeviceSize imageSize = (VkDeviceSize)sourav::Formats::texelSize(format) * texWidth * texHeight;
+            if (file.size < offset || file.size - offset < imageSize)
+            {
+                file.close();
+                throw std::runtime_error("File " + path + " is too small for the given format and extent");
+            }
+
+            try
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stream(texture, file.data + offset, 0, format, texWidth, texHeight, filter, imageUsageFlags, imageLayout, mipMode, &file);
+            }
+            catch (...)
+            {
+                file.close();
+                throw;
+            }
+            file.close();
+        }
+
+
+        /** @brief Fill, record and submit the chunks of one texture, the mutex must be held */
+        inline void computeTextureStreamer::stream(
+            sourav::Texture::computeTexture &texture,
+            const uint8_t *    texels,
+            VkDeviceSize       rowPitch,
+            VkFormat           format,
+            uint32_t           texWidth,
+            uint32_t           texHeight,
+            VkFilter           filter,
+            VkImageUsageFlags  imageUsageFlags,
+            VkImageLayout      imageLayout,
+            sourav::Texture::computeMipMode mipMode,
+            computeMappedFile *file)
+        {
+            const uint32_t texelSize = sourav::Formats::texelSize(format);
+            const VkDeviceSize rowSize = (VkDeviceSize)texelSize * texWidth;
+            if (rowPitch == 0)
+            {
+                rowPitch = rowSize;
+            }
+            assert(rowPitch >= rowSize);
+
+            VkFormat imageFormat = sourav::Formats::selectFormat(
+                device->physicalDevice, format, imageUsageFlags | VK_IMAGE_USAGE_TRANSFER_DST_BIT, true);
+
+            uint32_t levels = 1;
+            if (mipMode == sourav::Texture::computeMipMode::Generate)
+            {
+                levels = sourav::Mipmaps::mipLevelCount(texWidth, texHeight);
+                if (levels > 1 && !sourav::Mipmaps::supportsBlitGeneration(device->physicalDevice, imageFormat, device->queueFamilyIndex))
+                {
+                    throw std::runtime_error("Streamed uploads can only generate mips with blits, the format or queue family does not support them");
+                }
+                imageUsageFlags |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            }
+            else if (mipMode != sourav::Texture::computeMipMode::None)
+            {
+                throw std::runtime_error("Streamed uploads support the None and Generate mip modes only");
+            }
+
+            texture.createImage(*device, imageFormat, texWidth, texHeight, imageUsageFlags, levels);
+
+            // Bands or tiles within a chunk start at offsets buffer to image copies accept
+            const VkDeviceSize regionAlignment = texelSize % 4 == 0 ? texelSize : (texelSize % 2 == 0 ? texelSize * 2 : texelSize * 4);
+            // Small images take a single chunk of their own size
+            const VkDeviceSize chunkSize = std::max(std::min(windowSize / STREAM_CHUNKS_IN_FLIGHT, rowSize * texHeight), regionAlignment);
+
+            // Whole rows per band when one fits a chunk, otherwise single row tiles as wide as a chunk allows
+            const uint32_t tileWidth = (uint32_t)std::min<VkDeviceSize>(texWidth, chunkSize / texelSize);
+            const uint32_t bandHeight = tileWidth == texWidth ? (uint32_t)std::min<VkDeviceSize>(texHeight, chunkSize / rowSize) : 1;
+            const VkDeviceSize fileOffset = file ? (VkDeviceSize)(texels - file->data) : 0;
+            VkDeviceSize releasedUpTo = fileOffset;
+
+            VkImageSubresourceRange subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, levels, 0, 1 };
+
+            streamChunk chunk;
+            try
+            {
+                std::vector<VkBufferImageCopy> regions;
+                sourav::Memory::computeStagingRegion staging;
+                VkDeviceSize chunkUsed = 0;
+                bool first = true;
+
+                auto recordChunk = [&]()
+                {
+                    vkCmdCopyBufferToImage(chunk.commandBuffer, staging.buffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        static_cast<uint32_t>(regions.size()), regions.data());
+                    stats.regionCount += regions.size();
+                    regions.clear();
+                };
+
+                for (uint32_t y = 0; y < texHeight; y += bandHeight)
+                {
+                    const uint32_t rows = std::min(bandHeight, texHeight - y);
+                    for (uint32_t x = 0; x < texWidth; x += tileWidth)
+                    {
+                        const uint32_t columns = std::min(tileWidth, texWidth - x);
+                        const VkDeviceSize regionSize = (VkDeviceSize)columns * texelSize * rows;
+                        VkDeviceSize offset = (chunkUsed + regionAlignment - 1) / regionAlignment * regionAlignment;
+
+                        if (chunk.commandBuffer != VK_NULL_HANDLE && offset + regionSize > chunkSize)
+                        {
+                            recordChunk();
+                            submitChunk(chunk);
+                            chunk = streamChunk();
+                        }
+
+                        if (chunk.commandBuffer == VK_NULL_HANDLE)
+                        {
+                            // Keep the window bounded, the oldest chunk's staging is reused once its copy has finished
+                            while (inFlight.size() >= STREAM_CHUNKS_IN_FLIGHT)
+                            {
+                                retireChunk();
+                            }
+
+                            chunk.submissionValue = device->beginSubmission();
+                            texture.markUsed(chunk.submissionValue);
+                            chunk.commandBuffer = device->commandPool.acquireCommandBuffer();
+                            staging = device->acquireStaging(chunkSize, chunk.submissionValue);
+                            chunkUsed = 0;
+                            offset = 0;
+
+                            chunk.stagingBytes = chunkSize;
+                            stagingInFlight += chunkSize;
+                            stats.peakStagingBytes = std::max(stats.peakStagingBytes, stagingInFlight);
+
+                            if (first)
+                            {
+                                sourav::utils::setImageLayout(
+                                    chunk.commandBuffer,
+                                    texture.image,
+                                    VK_IMAGE_LAYOUT_UNDEFINED,
+                                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                    subresourceRange,
+                                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                    VK_PIPELINE_STAGE_TRANSFER_BIT);
+                                first = false;
+                            }
+                        }
+
+                        uint8_t *target = (uint8_t *)staging.mapped + offset;
+                        const uint8_t *source = texels + y * rowPitch + (VkDeviceSize)x * texelSize;
+                        const VkDeviceSize copySize = (VkDeviceSize)columns * texelSize;
+                        for (uint32_t row = 0; row < rows; row++)
+                        {
+                            memcpy(target + row * copySize, source + row * rowPitch, copySize);
+                        }
+                        chunkUsed = offset + regionSize;
+
+                        VkBufferImageCopy region = {};
+                        region.bufferOffset = staging.offset + offset;
+                        region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+                        region.imageOffset = { (int32_t)x, (int32_t)y, 0 };
+                        region.imageExtent = { columns, rows, 1 };
+                        regions.push_back(region);
+                        stats.bytesStreamed += regionSize;
+                    }
+
+                    // Rows above the next band are never read again
+                    if (file)
+                    {
+                        VkDeviceSize consumedUpTo = fileOffset + (VkDeviceSize)(y + rows) * rowPitch;
+                        file->release((size_t)releasedUpTo, (size_t)(consumedUpTo - releasedUpTo));
+                        releasedUpTo = consumedUpTo;
+                    }
+                }
+
+                recordChunk();
+
+                texture.imageLayout = imageLayout;
+                if (levels > 1)
+                {
+                    sourav::Mipmaps::recordBlitChain(chunk.commandBuffer, texture.image, texWidth, texHeight, levels, 1, imageLayout);
+                }
+                else
+                {
+                    // The barrier covers the copies of every earlier chunk on this queue as well
+                    VkPipelineStageFlags dstStageMask = sourav::Sync::legacyStageMask(sourav::Sync::layoutState(imageLayout).stageMask);
+                    if (dstStageMask == 0)
+                    {
+                        dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+                    }
+                    sourav::utils::setImageLayout(
+                        chunk.commandBuffer,
+                        texture.image,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                        imageLayout,
+                        subresourceRange,
+                        VK_PIPELINE_STAGE_TRANSFER_BIT,
+                        dstStageMask);
+                }
+                submitChunk(chunk);
+
+                while (!inFlight.empty())
+                {
+                    retireChunk();
+                }
+            }
+            catch (...)
+            {
+                // The chunk being recorded was never submitted, the ones in flight still read the staging memory
+                if (chunk.submissionValue != 0)
+                {
+                    abandonChunk(chunk);
+                }
+                try
+                {
+                    while (!inFlight.empty())
+                    {
+                        retireChunk();
+                    }
+                }
+                catch (...)
+                {
+                    // The device is most likely lost, report the original error
+                }
+                throw;
+            }
+
+            stats.uploadCount++;
+            texture.createDescriptor(device->logicalDevice, filter, imageLayout);
+        }
+
+
+        inline void computeTextureStreamer::submitChunk(streamChunk &chunk)
+        {
+            ST_CHECK_RESULT(vkEndCommandBuffer(chunk.commandBuffer));
+            chunk.fence = device->commandPool.acquireFence();
+
+            VkSubmitInfo submitInfo = sourav::initializers::submitInfo();
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &chunk.commandBuffer;
+            ST_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, chunk.fence));
+
+            stats.chunkCount++;
+            inFlight.push_back(chunk);
+        }
+
+
+        /** @brief Wait for the oldest chunk and hand its staging memory back */
+        inline void computeTextureStreamer::retireChunk()
+        {
+            streamChunk &chunk = inFlight.front();
+
+            ST_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &chunk.fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+            device->completeSubmission(chunk.submissionValue);
+            device->commandPool.releaseFence(chunk.fence);
+            device->commandPool.releaseCommandBuffer(chunk.commandBuffer);
+            stagingInFlight -= chunk.stagingBytes;
+
+            inFlight.pop_front();
+        }
+
+
+        /** @brief Drop a chunk that failed before it was submitted, its submission completes as nothing reads its staging */
+        inline void computeTextureStreamer::abandonChunk(streamChunk &chunk)
+        {
+            device->commandPool.discardCommandBuffer(chunk.commandBuffer);
+            if (chunk.fence != VK_NULL_HANDLE)
+            {
+                try
+                {
+                    device->commandPool.releaseFence(chunk.fence);
+                }
+                catch (...)
+                {
+                    // The fence stays out of the free list, the pool still destroys it
+                }
+            }
+            stagingInFlight -= chunk.stagingBytes;
+            device->completeSubmission(chunk.submissionValue);
+            chunk = streamChunk();
+        }
+
+
+        inline computeStreamStats computeTextureStreamer::getStats()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return stats;
+        }
+    }
+}
@@ -0,0 +1,268 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace sourav
+{
+    namespace Threading
+    {
+        /**
+        * @brief Fixed size pool of worker threads with one task deque per worker
+        *
+        * A worker takes tasks from the back of its own deque and steals from the front of the others when it runs dry.
+        * Tasks submitted from a worker go to that worker's deque, tasks from other threads are spread round robin.
+        * Threads waiting on a future from the pool help with the pending tasks instead of sleeping. A pool without
+        * workers (not created or destroyed) runs each task on the submitting thread
+        */
+        class computeThreadPool
+        {
+            public:
+                void create(uint32_t threadCount = 0);
+                void destroy();
+
+                /** @brief Queue a task, the returned future rethrows anything the task throws */
+                template <typename F>
+                std::future<typename std::invoke_result<F>::type> submit(F &&task);
+
+                /** @brief Wait for a future from this pool, running pending tasks on the calling thread meanwhile */
+                template <typename T>
+                T wait(std::future<T> &future);
+
+                void waitIdle();
+
+                uint32_t threadCount() const { return static_cast<uint32_t>(threads.size()); }
+
+            private:
+                struct workerQueue
+                {
+                    std::mutex                        mutex;
+                    std::deque<std::function<void()>> tasks;
+                };
+
+                struct workerContext
+                {
+                    computeThreadPool *pool  = nullptr;
+                    uint32_t           index = 0;
+                };
+
+                std::vector<std::unique_ptr<workerQueue>> queues;
+                std::vector<std::thread>                  threads;
+
+                std::mutex              sleepMutex;
+                std::condition_variable wake;
+                std::condition_variable idle;
+                std::atomic<uint64_t>   queued { 0 };
+                std::atomic<uint64_t>   pending { 0 };
+                std::atomic<uint32_t>   nextQueue { 0 };
+                bool                    stopping = false;
+
+                static workerContext &currentWorker();
+
+                void push(std::function<void()> task);
+                bool pop(uint32_t index, std::function<void()> &task);
+                void execute(std::function<void()> &task);
+                void run(uint32_t index);
+        };
+
+
+        /******************************************************************************************************************************
+        * Start the worker threads
+        *
+        * @param threadCount Number of workers, 0 uses one per hardware thread
+        ********************************************************************************************************************************/
+        inline void computeThreadPool::create(uint32_t threadCount)
+        {
+            if (threadCount == 0)
+            {
+                threadCount = std::max(1u, std::thread::hardware_concurrency());
+            }
+
+            stopping = false;
+            for (uint32_t i = 0; i < threadCount; i++)
+            {
+                queues.emplace_back(new workerQueue());
+            }
+            for (uint32_t i = 0; i < threadCount; i++)
+            {
+                threads.emplace_back(&computeThreadPool::run, this, i);
+            }
+        }
+
+
+        /** @brief Finish every queued task and join the workers */
+        inline void computeThreadPool::destroy()
+        {
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                stopping = true;
+            }
+            wake.notify_all();
+
+            for (std::thread &thread : threads)
+            {
+                thread.join();
+            }
+            threads.clear();
+            queues.clear();
+        }
+
+
+        inline computeThreadPool::workerContext &computeThreadPool::currentWorker()
+        {
+            static thread_local workerContext context;
+            return context;
+        }
+
+
+        template <typename F>
+        inline std::future<typename std::invoke_result<F>::type> computeThreadPool::submit(F &&task)
+        {
+            typedef typename std::invoke_result<F>::type result;
+
+            std::shared_ptr<std::packaged_task<result()>> packaged =
+                std::make_shared<std::packaged_task<result()>>(std::forward<F>(task));
+            std::future<result> future = packaged->get_future();
+
+            push([packaged]() { (*packaged)(); });
+            return future;
+        }
+
+
+        template <typename T>
+        inline T computeThreadPool::wait(std::future<T> &future)
+        {
+            if (queues.empty())
+            {
+                // The task already ran in submit
+                return future.get();
+            }
+
+            uint32_t start = nextQueue++;
+            while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                std::function<void()> task;
+                if (pop(start % queues.size(), task))
+                {
+                    execute(task);
+                }
+                else
+                {
+                    // Everything left is already running on a worker
+                    future.wait_for(std::chrono::microseconds(100));
+                }
+            }
+            return future.get();
+        }
+
+
+        /** @brief Block until every submitted task has finished */
+        inline void computeThreadPool::waitIdle()
+        {
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            idle.wait(lock, [this]() { return pending == 0; });
+        }
+
+
+        inline void computeThreadPool::push(std::function<void()> task)
+        {
+            if (queues.empty())
+            {
+                pending++;
+                execute(task);
+                return;
+            }
+
+            workerContext &context = currentWorker();
+            uint32_t index = context.pool == this ? context.index : nextQueue++ % static_cast<uint32_t>(queues.size());
+
+            pending++;
+            {
+                std::lock_guard<std::mutex> lock(queues[index]->mutex);
+                queues[index]->tasks.push_back(std::move(task));
+            }
+            {
+                // Counted under the sleep lock so a worker checking for work cannot miss it
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                queued++;
+            }
+            wake.notify_one();
+        }
+
+
+        /** @brief Take the newest task of queue index, or steal the oldest task of another queue */
+        inline bool computeThreadPool::pop(uint32_t index, std::function<void()> &task)
+        {
+            const uint32_t queueCount = static_cast<uint32_t>(queues.size());
+            for (uint32_t i = 0; i < queueCount; i++)
+            {
+                workerQueue &queue = *queues[(index + i) % queueCount];
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                if (queue.tasks.empty())
+                {
+                    continue;
+                }
+
+                if (i == 0)
+                {
+                    task = std::move(queue.tasks.back());
+                    queue.tasks.pop_back();
+                }
+                else
+                {
+                    task = std::move(queue.tasks.front());
+                    queue.tasks.pop_front();
+                }
+                queued--;
+                return true;
+            }
+            return false;
+        }
+
+
+        inline void computeThreadPool::execute(std::function<void()> &task)
+        {
+            task();
+            task = nullptr;
+
+            if (--pending == 0)
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                idle.notify_all();
+            }
+        }
+
+
+        inline void computeThreadPool::run(uint32_t index)
+        {
+            currentWorker().pool = this;
+            currentWorker().index = index;
+
+            for (;;)
+            {
+                std::function<void()> task;
+                if (pop(index, task))
+                {
+                    execute(task);
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                wake.wait(lock, [this]() { return stopping || queued > 0; });
+                if (stopping && queued == 0)
+                {
+                    return;
+                }
+            }
+        }
+    }
+}
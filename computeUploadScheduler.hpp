@@ -0,0 +1,376 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+#include "computeDevice.hpp"
+#include "computeDeviceUtils.hpp"
+#include "computeTexture.hpp"
+
+// Number of uploads gathered into one command buffer before it is submitted automatically
+#define DEFAULT_UPLOAD_BATCH_SIZE 256
+
+namespace sourav
+{
+    namespace Transfer
+    {
+        /** @brief Handle for an upload in flight, complete once the device has retired its submission value */
+        struct computeUploadTicket
+        {
+            uint64_t submissionValue = 0;
+        };
+
+        /** @brief Submission counters, submitCount should stay far below uploadCount when batching works */
+        struct computeUploadStats
+        {
+            uint64_t uploadCount = 0;
+            uint64_t submitCount = 0;
+            uint64_t bytesUploaded = 0;
+        };
+
+        /**
+        * @brief Gathers uploads into one command buffer and submits them together
+        *
+        * uploadAsync() stages the data and records the copy without touching the queue. A batch is submitted when
+        * flush() is called, when it reaches maxBatchUploads / maxBatchBytes, or when a caller waits on one of its
+        * tickets. Completion is tracked with fences from the device's command pool, nothing blocks until a ticket is
+        * waited on. The scheduler records from whichever thread calls it, so it keeps a command pool of its own
+        */
+        class computeUploadScheduler
+        {
+            public:
+                uint32_t     maxBatchUploads = DEFAULT_UPLOAD_BATCH_SIZE;
+                VkDeviceSize maxBatchBytes   = 0;
+
+                void create(sourav::Device::computeDevice &device, VkQueue queue, uint32_t queueFamilyIndex);
+                void destroy();
+
+                computeUploadTicket uploadAsync(
+                    sourav::Texture::computeTexture &texture,
+                    const void *       buffer,
+                    VkDeviceSize       bufferSize,
+                    VkFormat           format,
+                    uint32_t           texWidth,
+                    uint32_t           texHeight,
+                    VkFilter           filter          = VK_FILTER_LINEAR,
+                    VkImageUsageFlags  imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VkImageLayout      imageLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                    sourav::Texture::computeMipMode    mipMode    = sourav::Texture::computeMipMode::None,
+                    sourav::Texture::computeUploadMode uploadMode = sourav::Texture::computeUploadMode::Staged);
+
+                computeUploadTicket flush();
+                bool isComplete(computeUploadTicket ticket);
+                void wait(computeUploadTicket ticket);
+                void waitIdle();
+
+                computeUploadStats getStats();
+
+            private:
+                struct uploadBatch
+                {
+                    uint64_t        submissionValue = 0;
+                    VkCommandBuffer commandBuffer   = VK_NULL_HANDLE;
+                    VkFence         fence           = VK_NULL_HANDLE;
+                    uint32_t        uploads         = 0;
+                    VkDeviceSize    bytes           = 0;
+                };
+
+                sourav::Device::computeDevice *device = nullptr;
+                VkQueue                        queue  = VK_NULL_HANDLE;
+                uint32_t                       queueFamilyIndex = 0;
+                VkCommandPool                  commandPool = VK_NULL_HANDLE;
+
+                // Recursive because a full staging ring calls back into waitForSubmission while an upload holds the lock.
+                // Held while recording, other threads' ring waits only try to take it
+                std::recursive_mutex           mutex;
+                uploadBatch                    openBatch;
+                std::deque<uploadBatch>        inFlight;
+                std::vector<VkCommandBuffer>   freeCommandBuffers;
+                computeUploadStats             stats;
+                uint32_t                       stagingWaiter = 0;
+
+                void beginBatch();
+                void submitBatch();
+                void retireBatches(uint64_t submissionValue, bool block);
+                bool waitForSubmission(uint64_t submissionValue);
+                bool waitForBatch(uint64_t submissionValue);
+        };
+
+
+        /******************************************************************************************************************************
+        * Set up the scheduler
+        *
+        * @param device Device context, the scheduler registers a waiter for its batches with the staging ring
+        * @param queue Queue the batches are submitted to, must support transfer operations
+        * @param queueFamilyIndex Family of queue, used for the scheduler's own command pool
+        ********************************************************************************************************************************/
+        inline void computeUploadScheduler::create(sourav::Device::computeDevice &device, VkQueue queue, uint32_t queueFamilyIndex)
+        {
+            this->device = &device;
+            this->queue = queue;
+            this->queueFamilyIndex = queueFamilyIndex;
+
+            if (maxBatchBytes == 0)
+            {
+                // Leave half the ring for the next batch to fill while this one is in flight
+                maxBatchBytes = device.stagingRing.capacity / 2;
+            }
+
+            VkCommandPoolCreateInfo poolCreateInfo = sourav::initializers::commandPoolCreateInfo();
+            poolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+            poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            ST_CHECK_RESULT(vkCreateCommandPool(device.logicalDevice, &poolCreateInfo, nullptr, &commandPool));
+
+            stagingWaiter = device.stagingRing.addSubmissionWaiter([this](uint64_t submissionValue) { return waitForSubmission(submissionValue); });
+        }
+
+
+        inline void computeUploadScheduler::destroy()
+        {
+            if (!device)
+            {
+                return;
+            }
+
+            waitIdle();
+            device->stagingRing.removeSubmissionWaiter(stagingWaiter);
+            stagingWaiter = 0;
+
+            freeCommandBuffers.clear();
+
+            // Destroying the pool frees every command buffer allocated from it
+            vkDestroyCommandPool(device->logicalDevice, commandPool, nullptr);
+            commandPool = VK_NULL_HANDLE;
+            device = nullptr;
+        }
+
+
+        inline void computeUploadScheduler::beginBatch()
+        {
+            if (freeCommandBuffers.empty())
+            {
+                VkCommandBufferAllocateInfo cmdBufAllocateInfo = sourav::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+                VkCommandBuffer commandBuffer;
+                ST_CHECK_RESULT(vkAllocateCommandBuffers(device->logicalDevice, &cmdBufAllocateInfo, &commandBuffer));
+                freeCommandBuffers.push_back(commandBuffer);
+            }
+
+            openBatch = uploadBatch();
+            openBatch.commandBuffer = freeCommandBuffers.back();
+            freeCommandBuffers.pop_back();
+            openBatch.submissionValue = device->beginSubmission();
+
+            VkCommandBufferBeginInfo cmdBufInfo = sourav::initializers::commandBufferBeginInfo();
+            cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            ST_CHECK_RESULT(vkBeginCommandBuffer(openBatch.commandBuffer, &cmdBufInfo));
+        }
+
+
+        inline void computeUploadScheduler::submitBatch()
+        {
+            if (openBatch.commandBuffer == VK_NULL_HANDLE)
+            {
+                return;
+            }
+
+            ST_CHECK_RESULT(vkEndCommandBuffer(openBatch.commandBuffer));
+
+            openBatch.fence = device->commandPool.acquireFence();
+
+            VkSubmitInfo submitInfo = sourav::initializers::submitInfo();
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = &openBatch.commandBuffer;
+            ST_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, openBatch.fence));
+
+            stats.submitCount++;
+            inFlight.push_back(openBatch);
+            openBatch = uploadBatch();
+        }
+
+
+        /** @brief Retire in-flight batches up to submissionValue, either only those already done or waiting for them */
+        inline void computeUploadScheduler::retireBatches(uint64_t submissionValue, bool block)
+        {
+            while (!inFlight.empty() && inFlight.front().submissionValue <= submissionValue)
+            {
+                uploadBatch &batch = inFlight.front();
+
+                if (block)
+                {
+                    ST_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &batch.fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+                }
+                else if (vkGetFenceStatus(device->logicalDevice, batch.fence) != VK_SUCCESS)
+                {
+                    break;
+                }
+
+                device->completeSubmission(batch.submissionValue);
+
+                device->commandPool.releaseFence(batch.fence);
+                ST_CHECK_RESULT(vkResetCommandBuffer(batch.commandBuffer, 0));
+                freeCommandBuffers.push_back(batch.commandBuffer);
+                inFlight.pop_front();
+            }
+        }
+
+
+        /**
+        * @brief Staging ring waiter, see waitForBatch
+        *
+        * Also false if another thread holds the scheduler: it may be recording an upload and itself be waiting in the
+        * ring for a submitter this thread holds. The ring then falls back to transient staging instead of deadlocking
+        */
+        inline bool computeUploadScheduler::waitForSubmission(uint64_t submissionValue)
+        {
+            std::unique_lock<std::recursive_mutex> lock(mutex, std::try_to_lock);
+            if (!lock.owns_lock())
+            {
+                return false;
+            }
+            return waitForBatch(submissionValue);
+        }
+
+
+        /**
+        * @brief Block until the batch of submissionValue has completed, submitting it first if it is open. The mutex must be held
+        *
+        * False if no open or in-flight batch has that value, it was submitted by someone else or has already been retired
+        */
+        inline bool computeUploadScheduler::waitForBatch(uint64_t submissionValue)
+        {
+            bool owned = openBatch.commandBuffer != VK_NULL_HANDLE && openBatch.submissionValue == submissionValue;
+            if (owned)
+            {
+                submitBatch();
+            }
+            owned = owned || std::any_of(inFlight.begin(), inFlight.end(),
+                [submissionValue](const uploadBatch &batch) { return batch.submissionValue == submissionValue; });
+            if (!owned)
+            {
+                return false;
+            }
+
+            retireBatches(submissionValue, true);
+            return true;
+        }
+
+
+        /******************************************************************************************************************************
+        * Create a texture and queue its upload, returns without waiting for the GPU
+        *
+        * The image, view and sampler exist when this returns. The contents and the final layout are only valid once the
+        * returned ticket is complete, the source buffer may be reused immediately. Mips generated on the host are
+        * downsampled on the calling thread. Direct uploads use no staging memory and do not count towards maxBatchBytes
+        *
+        * @return Ticket to pass to isComplete / wait
+        ********************************************************************************************************************************/
+        inline computeUploadTicket computeUploadScheduler::uploadAsync(
+            sourav::Texture::computeTexture &texture,
+            const void *       buffer,
+            VkDeviceSize       bufferSize,
+            VkFormat           format,
+            uint32_t           texWidth,
+            uint32_t           texHeight,
+            VkFilter           filter,
+            VkImageUsageFlags  imageUsageFlags,
+            VkImageLayout      imageLayout,
+            sourav::Texture::computeMipMode    mipMode,
+            sourav::Texture::computeUploadMode uploadMode)
+        {
+            assert(buffer);
+
+            std::lock_guard<std::recursive_mutex> lock(mutex);
+
+            // Keep the number of open batches small without ever blocking here
+            retireBatches(UINT64_MAX, false);
+
+            if (openBatch.commandBuffer != VK_NULL_HANDLE &&
+                (openBatch.uploads >= maxBatchUploads || openBatch.bytes + bufferSize > maxBatchBytes))
+            {
+                submitBatch();
+            }
+            if (openBatch.commandBuffer == VK_NULL_HANDLE)
+            {
+                beginBatch();
+            }
+
+            // The same family on both sides: no ownership transfer, but blitted mips check the scheduler's queue
+            VkDeviceSize stagedSize = texture.recordFromBuffer(*device, openBatch.commandBuffer, openBatch.submissionValue,
+                buffer, bufferSize, format, texWidth, texHeight, imageUsageFlags, imageLayout, mipMode,
+                queueFamilyIndex, queueFamilyIndex, uploadMode);
+            texture.createDescriptor(device->logicalDevice, filter, imageLayout);
+
+            openBatch.uploads++;
+            openBatch.bytes += stagedSize;
+            stats.uploadCount++;
+            stats.bytesUploaded += bufferSize;
+
+            computeUploadTicket ticket;
+            ticket.submissionValue = openBatch.submissionValue;
+            return ticket;
+        }
+
+
+        /** @brief Submit the open batch now, returns a ticket that completes with everything queued so far */
+        inline computeUploadTicket computeUploadScheduler::flush()
+        {
+            std::lock_guard<std::recursive_mutex> lock(mutex);
+
+            computeUploadTicket ticket;
+            if (openBatch.commandBuffer != VK_NULL_HANDLE)
+            {
+                ticket.submissionValue = openBatch.submissionValue;
+                submitBatch();
+            }
+            else if (!inFlight.empty())
+            {
+                ticket.submissionValue = inFlight.back().submissionValue;
+            }
+            return ticket;
+        }
+
+
+        inline bool computeUploadScheduler::isComplete(computeUploadTicket ticket)
+        {
+            std::lock_guard<std::recursive_mutex> lock(mutex);
+
+            retireBatches(ticket.submissionValue, false);
+
+            // Batches retire in order, other submitters' open submissions don't hold the ticket back
+            if (openBatch.commandBuffer != VK_NULL_HANDLE && openBatch.submissionValue <= ticket.submissionValue)
+            {
+                return false;
+            }
+            return inFlight.empty() || inFlight.front().submissionValue > ticket.submissionValue;
+        }
+
+
+        /** @brief Block until the ticket's upload has completed, submitting its batch first if it is still open */
+        inline void computeUploadScheduler::wait(computeUploadTicket ticket)
+        {
+            std::lock_guard<std::recursive_mutex> lock(mutex);
+            waitForBatch(ticket.submissionValue);
+        }
+
+
+        inline void computeUploadScheduler::waitIdle()
+        {
+            std::lock_guard<std::recursive_mutex> lock(mutex);
+
+            submitBatch();
+            retireBatches(UINT64_MAX, true);
+        }
+
+
+        inline computeUploadStats computeUploadScheduler::getStats()
+        {
+            std::lock_guard<std::recursive_mutex> lock(mutex);
+            return stats;
+        }
+    }
+}
@@ -0,0 +1,367 @@
+/**
+* Tests for the BC1 / BC7 block encoder, the blocks are decoded again on the host and compared with the source
+*
+*   g++ -std=c++17 -I.. computeBlockEncoderTests.cpp -o computeBlockEncoderTests
+*   ./computeBlockEncoderTests
+*
+* Returns non-zero if any check fails
+*/
+
+#include <vulkan/vulkan.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../computeBlockEncoder.hpp"
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool condition, const char *expression, int line)
+    {
+        if (!condition)
+        {
+            fprintf(stderr, "line %d: %s failed\n", line, expression);
+            failures++;
+        }
+    }
+
+    /** @brief Reference BC1 decoder, alpha is 0 for the transparent entry of the three color palette and 255 otherwise */
+    void decodeBC1(const uint8_t block[8], uint8_t texels[64])
+    {
+        const uint16_t color0 = (uint16_t)(block[0] | (block[1] << 8));
+        const uint16_t color1 = (uint16_t)(block[2] | (block[3] << 8));
+        uint32_t indices;
+        memcpy(&indices, block + 4, 4);
+
+        int palette[4][4];
+        sourav::Compression::detail::unpackRGB565(color0, palette[0]);
+        sourav::Compression::detail::unpackRGB565(color1, palette[1]);
+        for (uint32_t c = 0; c < 3; c++)
+        {
+            if (color0 > color1)
+            {
+                palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+            }
+            else
+            {
+                palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                palette[3][c] = 0;
+            }
+        }
+        palette[0][3] = palette[1][3] = palette[2][3] = 255;
+        palette[3][3] = color0 > color1 ? 255 : 0;
+
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            const int *entry = palette[(indices >> (i * 2)) & 3];
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                texels[i * 4 + c] = (uint8_t)entry[c];
+            }
+        }
+    }
+
+    /** @brief Reads bit fields least significant bit first */
+    struct blockReader
+    {
+        const uint8_t *block;
+        uint32_t       position = 0;
+
+        uint32_t read(uint32_t bits)
+        {
+            uint32_t value = 0;
+            for (uint32_t bit = 0; bit < bits; bit++, position++)
+            {
+                value |= (uint32_t)((block[position >> 3] >> (position & 7)) & 1) << bit;
+            }
+            return value;
+        }
+    };
+
+    /** @brief Reference BC7 decoder for mode 6 blocks, false for any other mode */
+    bool decodeBC7Mode6(const uint8_t block[16], uint8_t texels[64])
+    {
+        blockReader reader = { block };
+        if (reader.read(7) != (1u << 6))
+        {
+            return false;
+        }
+
+        uint32_t endpoints[2][4];
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            endpoints[0][c] = reader.read(7) << 1;
+            endpoints[1][c] = reader.read(7) << 1;
+        }
+        const uint32_t pbit0 = reader.read(1);
+        const uint32_t pbit1 = reader.read(1);
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            endpoints[0][c] |= pbit0;
+            endpoints[1][c] |= pbit1;
+        }
+
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            // The anchor index drops its top bit
+            const uint32_t index = reader.read(i == 0 ? 3 : 4);
+            const uint32_t weight = sourav::Compression::detail::BC7_WEIGHTS[index];
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                texels[i * 4 + c] = (uint8_t)(((64 - weight) * endpoints[0][c] + weight * endpoints[1][c] + 32) >> 6);
+            }
+        }
+        return reader.position == 128;
+    }
+
+    struct blockError
+    {
+        double rms     = 0.0;
+        int    maximum = 0;
+    };
+
+    /** @brief Error of decoded against source over the first components channels */
+    blockError compare(const uint8_t source[64], const uint8_t decoded[64], uint32_t components)
+    {
+        blockError error;
+        double sum = 0.0;
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            for (uint32_t c = 0; c < components; c++)
+            {
+                const int difference = std::abs(source[i * 4 + c] - decoded[i * 4 + c]);
+                sum += difference * difference;
+                error.maximum = std::max(error.maximum, difference);
+            }
+        }
+        error.rms = std::sqrt(sum / (16.0 * components));
+        return error;
+    }
+
+    /** @brief RMS error of replacing the block by its mean color, what any encoding has to beat */
+    double flatError(const uint8_t source[64], uint32_t components)
+    {
+        double sum = 0.0;
+        for (uint32_t c = 0; c < components; c++)
+        {
+            double mean = 0.0;
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                mean += source[i * 4 + c] / 16.0;
+            }
+            for (uint32_t i = 0; i < 16; i++)
+            {
+                sum += (source[i * 4 + c] - mean) * (source[i * 4 + c] - mean);
+            }
+        }
+        return std::sqrt(sum / (16.0 * components));
+    }
+
+    void fillSolid(uint8_t texels[64], uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+    {
+        for (uint32_t i = 0; i < 16; i++)
+        {
+            texels[i * 4 + 0] = r;
+            texels[i * 4 + 1] = g;
+            texels[i * 4 + 2] = b;
+            texels[i * 4 + 3] = a;
+        }
+    }
+
+    /** @brief Diagonal ramp from the color from at texel 0 to the color to at texel 15 */
+    void fillRamp(uint8_t texels[64], const uint8_t from[4], const uint8_t to[4])
+    {
+        for (uint32_t y = 0; y < 4; y++)
+        {
+            for (uint32_t x = 0; x < 4; x++)
+            {
+                for (uint32_t c = 0; c < 4; c++)
+                {
+                    texels[(y * 4 + x) * 4 + c] = (uint8_t)((from[c] * (6 - x - y) + to[c] * (x + y) + 3) / 6);
+                }
+            }
+        }
+    }
+
+    void fillNoise(uint8_t texels[64], uint32_t seed)
+    {
+        for (uint32_t i = 0; i < 64; i++)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            texels[i] = (uint8_t)(seed >> 24);
+        }
+    }
+}
+
+/** @brief Solid colors only lose the 5:6:5 quantization, a ramp of seven steps is held by the four palette entries */
+static void testBC1RoundTrip()
+{
+    uint8_t texels[64];
+    uint8_t block[8];
+    uint8_t decoded[64];
+
+    const uint8_t solids[][4] = { { 0, 0, 0, 255 }, { 255, 255, 255, 255 }, { 200, 30, 90, 255 }, { 13, 147, 251, 255 } };
+    for (const uint8_t *solid : solids)
+    {
+        fillSolid(texels, solid[0], solid[1], solid[2], solid[3]);
+        sourav::Compression::encodeBC1Block(texels, block, false);
+        decodeBC1(block, decoded);
+        CHECK(compare(texels, decoded, 4).maximum <= 4);
+    }
+
+    const uint8_t from[4] = { 10, 40, 200, 255 };
+    const uint8_t to[4] = { 240, 180, 20, 255 };
+    fillRamp(texels, from, to);
+    sourav::Compression::encodeBC1Block(texels, block, false);
+    decodeBC1(block, decoded);
+    blockError ramp = compare(texels, decoded, 3);
+    CHECK(ramp.rms <= 16.0);
+    CHECK(ramp.maximum <= 32);
+    CHECK(compare(texels, decoded, 4).maximum <= ramp.maximum);
+
+    // Without punch-through alpha is ignored, the block is opaque
+    fillNoise(texels, 7);
+    sourav::Compression::encodeBC1Block(texels, block, false);
+    decodeBC1(block, decoded);
+    CHECK(compare(texels, decoded, 3).rms < flatError(texels, 3));
+    bool opaque = true;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        opaque = opaque && decoded[i * 4 + 3] == 255;
+    }
+    CHECK(opaque);
+}
+
+/** @brief With punch-through, texels with alpha below 128 and only those decode transparent */
+static void testBC1PunchThrough()
+{
+    uint8_t texels[64];
+    uint8_t block[8];
+    uint8_t decoded[64];
+
+    const uint8_t from[4] = { 255, 0, 0, 255 };
+    const uint8_t to[4] = { 0, 0, 255, 255 };
+    fillRamp(texels, from, to);
+    for (uint32_t i = 0; i < 16; i += 3)
+    {
+        texels[i * 4 + 3] = (uint8_t)(i * 8);
+    }
+    sourav::Compression::encodeBC1Block(texels, block, true);
+    decodeBC1(block, decoded);
+
+    uint32_t misplaced = 0;
+    for (uint32_t i = 0; i < 16; i++)
+    {
+        const bool transparent = texels[i * 4 + 3] < 128;
+        misplaced += (decoded[i * 4 + 3] == 0) != transparent;
+    }
+    CHECK(misplaced == 0);
+
+    // An opaque block keeps the four color palette even with punch-through
+    fillRamp(texels, from, to);
+    sourav::Compression::encodeBC1Block(texels, block, true);
+    CHECK((block[0] | (block[1] << 8)) > (block[2] | (block[3] << 8)));
+}
+
+/** @brief Mode 6 keeps 7 bits and a p-bit per endpoint and 16 steps, much closer than BC1 on the same blocks */
+static void testBC7RoundTrip()
+{
+    uint8_t texels[64];
+    uint8_t block[16];
+    uint8_t decoded[64];
+
+    const uint8_t solids[][4] = { { 0, 0, 0, 0 }, { 255, 255, 255, 255 }, { 200, 30, 90, 128 }, { 13, 147, 251, 7 } };
+    for (const uint8_t *solid : solids)
+    {
+        fillSolid(texels, solid[0], solid[1], solid[2], solid[3]);
+        sourav::Compression::encodeBC7Block(texels, block);
+        CHECK(decodeBC7Mode6(block, decoded));
+        CHECK(compare(texels, decoded, 4).maximum <= 1);
+    }
+
+    const uint8_t from[4] = { 10, 40, 200, 0 };
+    const uint8_t to[4] = { 240, 180, 20, 255 };
+    fillRamp(texels, from, to);
+    sourav::Compression::encodeBC7Block(texels, block);
+    CHECK(decodeBC7Mode6(block, decoded));
+    blockError ramp = compare(texels, decoded, 4);
+    CHECK(ramp.rms <= 4.0);
+    CHECK(ramp.maximum <= 8);
+
+    uint8_t bc1Block[8];
+    uint8_t bc1Decoded[64];
+    sourav::Compression::encodeBC1Block(texels, bc1Block, false);
+    decodeBC1(bc1Block, bc1Decoded);
+    CHECK(ramp.rms < compare(texels, bc1Decoded, 3).rms);
+
+    for (uint32_t seed = 1; seed <= 8; seed++)
+    {
+        fillNoise(texels, seed);
+        sourav::Compression::encodeBC7Block(texels, block);
+        CHECK(decodeBC7Mode6(block, decoded));
+        CHECK(compare(texels, decoded, 4).rms < flatError(texels, 4));
+    }
+}
+
+/**
+* The anchor (first) index is stored in 3 bits, so the encoder swaps the endpoints when texel 0 would use the upper
+* half. Ramps in both directions put texel 0 at either end, both have to decode with texel 0 in place
+*/
+static void testBC7AnchorIndex()
+{
+    const uint8_t dark[4] = { 0, 0, 0, 0 };
+    const uint8_t bright[4] = { 255, 255, 255, 255 };
+    const uint8_t *ramps[2][2] = { { dark, bright }, { bright, dark } };
+
+    for (const auto &ramp : ramps)
+    {
+        uint8_t texels[64];
+        uint8_t block[16];
+        uint8_t decoded[64];
+        fillRamp(texels, ramp[0], ramp[1]);
+        sourav::Compression::encodeBC7Block(texels, block);
+
+        CHECK(decodeBC7Mode6(block, decoded));
+        CHECK(compare(texels, decoded, 4).maximum <= 8);
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            CHECK(std::abs(decoded[c] - ramp[0][c]) <= 8);
+        }
+
+        // With at most index 7, texel 0 only decodes in place if the first endpoint is the one at its end of the ramp
+        blockReader reader = { block };
+        reader.position = 7;
+        uint32_t endpoint0 = 0;
+        uint32_t endpoint1 = 0;
+        for (uint32_t c = 0; c < 4; c++)
+        {
+            endpoint0 += reader.read(7);
+            endpoint1 += reader.read(7);
+        }
+        CHECK((endpoint0 < endpoint1) == (ramp[0] == dark));
+    }
+}
+
+int main()
+{
+    testBC1RoundTrip();
+    testBC1PunchThrough();
+    testBC7RoundTrip();
+    testBC7AnchorIndex();
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All block encoder tests passed\n");
+    return 0;
+}
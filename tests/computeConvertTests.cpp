@@ -0,0 +1,188 @@
+/**
+* Tests for the texel conversions between a format and its fallbacks, run without a device
+*
+* Build once plainly and once for the vector paths, texel counts around every vector width cover the scalar tails:
+*   g++ -std=c++17 -I.. computeConvertTests.cpp -o computeConvertTests
+*   g++ -std=c++17 -mavx2 -I.. computeConvertTests.cpp -o computeConvertTestsAVX2
+*   ./computeConvertTests && ./computeConvertTestsAVX2
+*
+* Returns non-zero if any check fails
+*/
+
+#include <vulkan/vulkan.h>
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "../computeConvert.hpp"
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+// Past the widest vector loop (16 texels with NEON) several times over
+#define TEST_MAX_TEXELS 67
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool condition, const char *expression, int line)
+    {
+        if (!condition)
+        {
+            fprintf(stderr, "line %d: %s failed\n", line, expression);
+            failures++;
+        }
+    }
+
+    std::vector<uint8_t> sourceTexels(size_t bytes)
+    {
+        std::vector<uint8_t> texels(bytes);
+        for (size_t i = 0; i < bytes; i++)
+        {
+            texels[i] = (uint8_t)(i * 7 + 3);
+        }
+        return texels;
+    }
+
+    /**
+    * Convert every texel count up to TEST_MAX_TEXELS from buffers of exactly that size and compare with expected
+    *
+    * expected(src, c) is destination byte c of a texel whose source bytes start at src
+    */
+    template <typename Expected>
+    bool convertsAs(VkFormat srcFormat, VkFormat dstFormat, Expected expected)
+    {
+        const sourav::Formats::computeTexelConversion conversion = sourav::Formats::texelConversion(srcFormat, dstFormat);
+        if (!conversion.valid)
+        {
+            return false;
+        }
+
+        bool matches = true;
+        for (size_t count = 0; count <= TEST_MAX_TEXELS; count++)
+        {
+            // Sized exactly, a vector path reading or writing past the end is caught by the sanitizers
+            const std::vector<uint8_t> src = sourceTexels(count * conversion.srcTexelSize);
+            std::vector<uint8_t> dst(count * conversion.dstTexelSize + 1, 0xcd);
+            sourav::Formats::convertTexels(conversion, src.data(), dst.data(), count);
+
+            for (size_t i = 0; i < count; i++)
+            {
+                for (uint32_t c = 0; c < conversion.dstTexelSize; c++)
+                {
+                    matches = matches && dst[i * conversion.dstTexelSize + c] == expected(src.data() + i * conversion.srcTexelSize, c);
+                }
+            }
+            matches = matches && dst.back() == 0xcd;
+        }
+        return matches;
+    }
+}
+
+/** @brief RGB -> RGBA with alpha 1, in the same and in swapped component order */
+static void testExpand()
+{
+    CHECK(convertsAs(VK_FORMAT_R8G8B8_UNORM, VK_FORMAT_R8G8B8A8_UNORM,
+        [](const uint8_t *src, uint32_t c) { return c < 3 ? src[c] : (uint8_t)0xff; }));
+    CHECK(convertsAs(VK_FORMAT_B8G8R8_UNORM, VK_FORMAT_R8G8B8A8_UNORM,
+        [](const uint8_t *src, uint32_t c) { return c < 3 ? src[2 - c] : (uint8_t)0xff; }));
+    CHECK(convertsAs(VK_FORMAT_R8G8B8_UNORM, VK_FORMAT_B8G8R8A8_UNORM,
+        [](const uint8_t *src, uint32_t c) { return c < 3 ? src[2 - c] : (uint8_t)0xff; }));
+    CHECK(convertsAs(VK_FORMAT_R8G8B8_SRGB, VK_FORMAT_R8G8B8A8_SRGB,
+        [](const uint8_t *src, uint32_t c) { return c < 3 ? src[c] : (uint8_t)0xff; }));
+
+    // Integer formats get a 1, not all ones
+    CHECK(convertsAs(VK_FORMAT_R8G8B8_UINT, VK_FORMAT_R8G8B8A8_UINT,
+        [](const uint8_t *src, uint32_t c) { return c < 3 ? src[c] : (uint8_t)1; }));
+
+    // Missing color components are 0, missing alpha is 1
+    CHECK(convertsAs(VK_FORMAT_R8G8_UNORM, VK_FORMAT_R8G8B8A8_UNORM,
+        [](const uint8_t *src, uint32_t c) { return c < 2 ? src[c] : (uint8_t)(c == 3 ? 0xff : 0); }));
+
+    // 16-bit floats take the scalar path, alpha is half precision 1.0 (0x3c00, little endian)
+    CHECK(convertsAs(VK_FORMAT_R16G16B16_SFLOAT, VK_FORMAT_R16G16B16A16_SFLOAT,
+        [](const uint8_t *src, uint32_t c) { return c < 6 ? src[c] : (uint8_t)(c == 6 ? 0x00 : 0x3c); }));
+}
+
+/** @brief Four component reorders and copies */
+static void testSwizzle()
+{
+    CHECK(convertsAs(VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM,
+        [](const uint8_t *src, uint32_t c) { return c < 3 ? src[2 - c] : src[3]; }));
+    CHECK(convertsAs(VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_B8G8R8A8_UNORM,
+        [](const uint8_t *src, uint32_t c) { return c < 3 ? src[2 - c] : src[3]; }));
+
+    // Same bits, and sRGB to UNORM for storage is a plain copy without decoding
+    const sourav::Formats::computeTexelConversion same =
+        sourav::Formats::texelConversion(VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM);
+    CHECK(same.valid && same.identity);
+    CHECK(convertsAs(VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_R8G8B8A8_UNORM,
+        [](const uint8_t *src, uint32_t c) { return src[c]; }));
+    CHECK(convertsAs(VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_UNORM,
+        [](const uint8_t *src, uint32_t c) { return c < 3 ? src[2 - c] : src[3]; }));
+}
+
+/** @brief Vector paths agree with the component by component conversion they stand in for */
+static void testMatchesScalar()
+{
+    const VkFormat pairs[][2] = {
+        { VK_FORMAT_R8G8B8_UNORM, VK_FORMAT_R8G8B8A8_UNORM },
+        { VK_FORMAT_B8G8R8_SRGB, VK_FORMAT_R8G8B8A8_SRGB },
+        { VK_FORMAT_B8G8R8A8_UNORM, VK_FORMAT_R8G8B8A8_UNORM },
+    };
+    for (const auto &pair : pairs)
+    {
+        const sourav::Formats::computeTexelConversion conversion = sourav::Formats::texelConversion(pair[0], pair[1]);
+        CHECK(conversion.valid && !conversion.identity);
+
+        const size_t count = 1000;
+        const std::vector<uint8_t> src = sourceTexels(count * conversion.srcTexelSize);
+        std::vector<uint8_t> vectorized(count * conversion.dstTexelSize);
+        std::vector<uint8_t> scalar(count * conversion.dstTexelSize);
+        sourav::Formats::convertTexels(conversion, src.data(), vectorized.data(), count);
+        sourav::Formats::detail::convertTexelsScalar(conversion, src.data(), scalar.data(), 0, count);
+        CHECK(vectorized == scalar);
+    }
+}
+
+/** @brief Pairs that would lose data or change the component type have no conversion */
+static void testInvalid()
+{
+    CHECK(!sourav::Formats::texelConversion(VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8_UNORM).valid);
+    CHECK(!sourav::Formats::texelConversion(VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R16G16B16A16_UNORM).valid);
+    CHECK(!sourav::Formats::texelConversion(VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8A8_UINT).valid);
+    CHECK(!sourav::Formats::texelConversion(VK_FORMAT_R16G16B16_SFLOAT, VK_FORMAT_R16G16B16A16_UNORM).valid);
+
+    const sourav::Formats::computeTexelConversion invalid =
+        sourav::Formats::texelConversion(VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_R8G8B8_UNORM);
+    uint8_t src[4] = {};
+    uint8_t dst[4] = {};
+    bool threw = false;
+    try
+    {
+        sourav::Formats::convertTexels(invalid, src, dst, 1);
+    }
+    catch (const std::runtime_error &)
+    {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+int main()
+{
+    testExpand();
+    testSwizzle();
+    testMatchesScalar();
+    testInvalid();
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All texel conversion tests passed\n");
+    return 0;
+}
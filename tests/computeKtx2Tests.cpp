@@ -0,0 +1,255 @@
+/**
+* Tests for the KTX2 header parser on files built in memory, valid ones and truncated or damaged ones
+*
+*   g++ -std=c++17 -I.. computeKtx2Tests.cpp -o computeKtx2Tests
+*   ./computeKtx2Tests
+*
+* Returns non-zero if any check fails
+*/
+
+#include <vulkan/vulkan.h>
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "../computeKtx2.hpp"
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool condition, const char *expression, int line)
+    {
+        if (!condition)
+        {
+            fprintf(stderr, "line %d: %s failed\n", line, expression);
+            failures++;
+        }
+    }
+
+    // Header fields, from the start of the file
+    const size_t FORMAT_OFFSET           = 12;
+    const size_t WIDTH_OFFSET            = 20;
+    const size_t DEPTH_OFFSET            = 28;
+    const size_t LAYERS_OFFSET           = 32;
+    const size_t FACES_OFFSET            = 36;
+    const size_t LEVEL_COUNT_OFFSET      = 40;
+    const size_t SUPERCOMPRESSION_OFFSET = 44;
+
+    template <typename T>
+    void write(std::vector<uint8_t> &file, size_t offset, T value)
+    {
+        memcpy(file.data() + offset, &value, sizeof(T));
+    }
+
+    template <typename T>
+    T read(const std::vector<uint8_t> &file, size_t offset)
+    {
+        T value;
+        memcpy(&value, file.data() + offset, sizeof(T));
+        return value;
+    }
+
+    size_t levelEntry(uint32_t level)
+    {
+        return KTX2_HEADER_SIZE + (size_t)level * 24;
+    }
+
+    /** @brief A complete file with levelCount levels of a 2D image, the level data follows the level index */
+    std::vector<uint8_t> makeKtx2(VkFormat format, uint32_t width, uint32_t height, uint32_t levelCount, uint32_t layers = 0, uint32_t faces = 1)
+    {
+        static const uint8_t identifier[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+        std::vector<uint8_t> file(levelEntry(levelCount), 0);
+        memcpy(file.data(), identifier, sizeof(identifier));
+        write<uint32_t>(file, FORMAT_OFFSET, format);
+        write<uint32_t>(file, WIDTH_OFFSET, width);
+        write<uint32_t>(file, WIDTH_OFFSET + 4, height);
+        write<uint32_t>(file, LAYERS_OFFSET, layers);
+        write<uint32_t>(file, FACES_OFFSET, faces);
+        write<uint32_t>(file, LEVEL_COUNT_OFFSET, levelCount);
+
+        const uint32_t images = (layers > 0 ? layers : 1) * faces;
+        for (uint32_t level = 0; level < levelCount; level++)
+        {
+            const uint64_t size = sourav::Formats::blockImageSize(format,
+                std::max(1u, width >> level), std::max(1u, height >> level)) * images;
+            write<uint64_t>(file, levelEntry(level), file.size());
+            write<uint64_t>(file, levelEntry(level) + 8, size);
+            file.resize(file.size() + size, (uint8_t)level);
+        }
+        return file;
+    }
+
+    bool parseThrows(const std::vector<uint8_t> &file, size_t size)
+    {
+        try
+        {
+            sourav::Transfer::parseKtx2(file.data(), size);
+        }
+        catch (const std::runtime_error &)
+        {
+            return true;
+        }
+        return false;
+    }
+
+    bool parseThrows(const std::vector<uint8_t> &file)
+    {
+        return parseThrows(file, file.size());
+    }
+}
+
+/** @brief Valid files report their shape and the levels exactly where makeKtx2 put them */
+static void testValidFiles()
+{
+    std::vector<uint8_t> file = makeKtx2(VK_FORMAT_R8G8B8A8_UNORM, 4, 4, 1);
+    sourav::Transfer::computeKtx2Info info = sourav::Transfer::parseKtx2(file.data(), file.size());
+    CHECK(info.format == VK_FORMAT_R8G8B8A8_UNORM);
+    CHECK(info.width == 4 && info.height == 4 && info.depth == 1);
+    CHECK(info.layers == 0 && info.faces == 1);
+    CHECK(info.levels.size() == 1);
+    CHECK(info.levels[0].offset == levelEntry(1) && info.levels[0].size == 64);
+
+    // Block compressed with a full chain, the levels below one block still take a whole block
+    file = makeKtx2(VK_FORMAT_BC7_UNORM_BLOCK, 8, 8, 4);
+    info = sourav::Transfer::parseKtx2(file.data(), file.size());
+    CHECK(info.levels.size() == 4);
+    CHECK(info.levels[0].size == 64);
+    CHECK(info.levels[1].size == 16 && info.levels[2].size == 16 && info.levels[3].size == 16);
+    CHECK(info.levels[3].offset + info.levels[3].size == file.size());
+
+    // A cubemap array, each level holds every face of every layer
+    file = makeKtx2(VK_FORMAT_R8G8B8A8_UNORM, 2, 2, 2, 3, 6);
+    info = sourav::Transfer::parseKtx2(file.data(), file.size());
+    CHECK(info.layers == 3 && info.faces == 6);
+    CHECK(info.levels[0].size == 2 * 2 * 4 * 18);
+    CHECK(info.levels[1].size == 4 * 18);
+
+    // A height of 0 is a 1D image, the level count 0 asks for one level
+    file = makeKtx2(VK_FORMAT_R8G8B8A8_UNORM, 4, 0, 1);
+    write<uint32_t>(file, LEVEL_COUNT_OFFSET, 0);
+    info = sourav::Transfer::parseKtx2(file.data(), file.size());
+    CHECK(info.height == 1 && info.levels.size() == 1 && info.levels[0].size == 16);
+}
+
+/** @brief Files cut anywhere, from inside the identifier to inside the last level, are rejected */
+static void testTruncatedFiles()
+{
+    const std::vector<uint8_t> file = makeKtx2(VK_FORMAT_BC7_UNORM_BLOCK, 8, 8, 4);
+
+    CHECK(parseThrows(file, 0));
+    CHECK(parseThrows(file, 11));
+    CHECK(parseThrows(file, KTX2_HEADER_SIZE - 1));
+    // Header complete, level index cut
+    CHECK(parseThrows(file, KTX2_HEADER_SIZE));
+    CHECK(parseThrows(file, levelEntry(4) - 1));
+    // Level index complete, level data cut
+    CHECK(parseThrows(file, levelEntry(4)));
+    CHECK(parseThrows(file, file.size() - 1));
+    CHECK(!parseThrows(file, file.size()));
+
+    std::vector<uint8_t> empty;
+    CHECK(parseThrows(empty));
+    bool threw = false;
+    try
+    {
+        sourav::Transfer::parseKtx2(nullptr, file.size());
+    }
+    catch (const std::runtime_error &)
+    {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+/** @brief Header fields and level entries that disagree with each other or with the file */
+static void testMismatchedHeaders()
+{
+    const std::vector<uint8_t> valid = makeKtx2(VK_FORMAT_R8G8B8A8_UNORM, 8, 8, 2);
+    CHECK(!parseThrows(valid));
+
+    std::vector<uint8_t> file = valid;
+    file[5] = '1';
+    CHECK(parseThrows(file));
+
+    // Level sizes that do not match the format and extent, in either direction
+    file = valid;
+    write<uint64_t>(file, levelEntry(0) + 8, read<uint64_t>(file, levelEntry(0) + 8) - 4);
+    CHECK(parseThrows(file));
+    file = valid;
+    write<uint64_t>(file, levelEntry(1) + 8, read<uint64_t>(file, levelEntry(1) + 8) + 4);
+    CHECK(parseThrows(file));
+
+    // Same data read as another format or extent
+    file = valid;
+    write<uint32_t>(file, FORMAT_OFFSET, VK_FORMAT_R16G16B16A16_SFLOAT);
+    CHECK(parseThrows(file));
+    file = valid;
+    write<uint32_t>(file, WIDTH_OFFSET, 16);
+    CHECK(parseThrows(file));
+    file = valid;
+    write<uint32_t>(file, LAYERS_OFFSET, 2);
+    CHECK(parseThrows(file));
+
+    // More levels than the index holds
+    file = valid;
+    write<uint32_t>(file, LEVEL_COUNT_OFFSET, 3);
+    CHECK(parseThrows(file));
+    file = valid;
+    write<uint32_t>(file, LEVEL_COUNT_OFFSET, 0xffffffffu);
+    CHECK(parseThrows(file));
+
+    // Offsets past the end, including ones where offset + size wraps around
+    file = valid;
+    write<uint64_t>(file, levelEntry(1), file.size() + 1);
+    CHECK(parseThrows(file));
+    file = valid;
+    write<uint64_t>(file, levelEntry(1), ~uint64_t(0) - 8);
+    CHECK(parseThrows(file));
+
+    // Data this loader cannot upload as stored
+    file = valid;
+    write<uint32_t>(file, FORMAT_OFFSET, VK_FORMAT_UNDEFINED);
+    CHECK(parseThrows(file));
+    file = valid;
+    write<uint32_t>(file, SUPERCOMPRESSION_OFFSET, 2);
+    CHECK(parseThrows(file));
+    file = valid;
+    write<uint32_t>(file, WIDTH_OFFSET, 0);
+    CHECK(parseThrows(file));
+    file = valid;
+    write<uint32_t>(file, FACES_OFFSET, 2);
+    CHECK(parseThrows(file));
+    file = valid;
+    write<uint32_t>(file, DEPTH_OFFSET, 2);
+    write<uint32_t>(file, LAYERS_OFFSET, 2);
+    CHECK(parseThrows(file));
+}
+
+int main()
+{
+    try
+    {
+        testValidFiles();
+        testTruncatedFiles();
+        testMismatchedHeaders();
+    }
+    catch (const std::exception &exception)
+    {
+        fprintf(stderr, "Test failed: %s\n", exception.what());
+        failures++;
+    }
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All KTX2 tests passed\n");
+    return 0;
+}
@@ -0,0 +1,348 @@
+/**
+* Tests for the sub-allocating device memory allocator, run without a device through mocked allocation callbacks
+*
+*   g++ -std=c++17 -I.. computeMemoryAllocatorTests.cpp -lvulkan -o computeMemoryAllocatorTests
+*   ./computeMemoryAllocatorTests
+*
+* Returns non-zero if any check fails
+*/
+
+#include <vulkan/vulkan.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+#include "../computeMemoryAllocator.hpp"
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+namespace
+{
+    int failures = 0;
+
+    // What the mocked driver has been asked for
+    int          driverAllocations = 0;
+    int          driverAllocateCalls = 0;
+    VkDeviceSize granularity = 1024;
+
+    void check(bool condition, const char *expression, int line)
+    {
+        if (!condition)
+        {
+            fprintf(stderr, "line %d: %s failed\n", line, expression);
+            failures++;
+        }
+    }
+
+    VKAPI_ATTR void VKAPI_CALL mockGetPhysicalDeviceProperties(VkPhysicalDevice, VkPhysicalDeviceProperties *properties)
+    {
+        *properties = {};
+        properties->limits.bufferImageGranularity = granularity;
+    }
+
+    /** @brief Type 0 is device local, type 1 host visible and coherent, both in one 1 GiB heap */
+    VKAPI_ATTR void VKAPI_CALL mockGetPhysicalDeviceMemoryProperties(VkPhysicalDevice, VkPhysicalDeviceMemoryProperties *properties)
+    {
+        *properties = {};
+        properties->memoryTypeCount = 2;
+        properties->memoryTypes[0].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        properties->memoryTypes[1].propertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        properties->memoryHeapCount = 1;
+        properties->memoryHeaps[0].size = 1ull << 30;
+    }
+
+    VKAPI_ATTR void VKAPI_CALL mockGetPhysicalDeviceMemoryProperties2(VkPhysicalDevice physicalDevice, VkPhysicalDeviceMemoryProperties2 *properties)
+    {
+        mockGetPhysicalDeviceMemoryProperties(physicalDevice, &properties->memoryProperties);
+    }
+
+    VKAPI_ATTR VkResult VKAPI_CALL mockAllocateMemory(VkDevice, const VkMemoryAllocateInfo *allocateInfo, const VkAllocationCallbacks *, VkDeviceMemory *memory)
+    {
+        // Backed by host memory so mapped blocks can be written to
+        *memory = reinterpret_cast<VkDeviceMemory>(malloc(allocateInfo->allocationSize));
+        driverAllocations++;
+        driverAllocateCalls++;
+        return *memory ? VK_SUCCESS : VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+
+    VKAPI_ATTR void VKAPI_CALL mockFreeMemory(VkDevice, VkDeviceMemory memory, const VkAllocationCallbacks *)
+    {
+        free(reinterpret_cast<void *>(memory));
+        driverAllocations--;
+    }
+
+    VKAPI_ATTR VkResult VKAPI_CALL mockMapMemory(VkDevice, VkDeviceMemory memory, VkDeviceSize offset, VkDeviceSize, VkMemoryMapFlags, void **data)
+    {
+        *data = reinterpret_cast<uint8_t *>(memory) + offset;
+        return VK_SUCCESS;
+    }
+
+    VKAPI_ATTR void VKAPI_CALL mockUnmapMemory(VkDevice, VkDeviceMemory)
+    {
+    }
+
+    sourav::Memory::computeAllocatorFunctions mockFunctions()
+    {
+        sourav::Memory::computeAllocatorFunctions functions;
+        functions.getPhysicalDeviceProperties = mockGetPhysicalDeviceProperties;
+        functions.getPhysicalDeviceMemoryProperties = mockGetPhysicalDeviceMemoryProperties;
+        functions.getPhysicalDeviceMemoryProperties2 = mockGetPhysicalDeviceMemoryProperties2;
+        functions.allocateMemory = mockAllocateMemory;
+        functions.freeMemory = mockFreeMemory;
+        functions.mapMemory = mockMapMemory;
+        functions.unmapMemory = mockUnmapMemory;
+        return functions;
+    }
+
+    VkMemoryRequirements requirements(VkDeviceSize size, VkDeviceSize alignment, uint32_t typeBits = 1)
+    {
+        VkMemoryRequirements memReqs = {};
+        memReqs.size = size;
+        memReqs.alignment = alignment;
+        memReqs.memoryTypeBits = typeBits;
+        return memReqs;
+    }
+
+    bool overlaps(const sourav::Memory::computeAllocation &a, const sourav::Memory::computeAllocation &b)
+    {
+        return a.memory == b.memory && a.offset < b.offset + b.size && b.offset < a.offset + a.size;
+    }
+}
+
+/** @brief Every allocation honours its alignment and linear and optimal resources never share a block unless the granularity is 1 */
+static void testPlacement()
+{
+    using namespace sourav::Memory;
+    const computeAllocatorFunctions functions = mockFunctions();
+
+    granularity = 1024;
+    computeMemoryAllocator allocator;
+    allocator.create(VK_NULL_HANDLE, VK_NULL_HANDLE, 1 << 20, &functions);
+    CHECK(allocator.bufferImageGranularity == 1024);
+
+    std::vector<computeAllocation> allocations;
+    for (uint32_t i = 0; i < 200; i++)
+    {
+        const VkMemoryRequirements memReqs = requirements(100 + (i * 37) % 5000, 1ull << (i % 13));
+        allocations.push_back(allocator.allocate(memReqs, computeMemoryUsage(), i % 2 ? computeResourceTiling::Linear : computeResourceTiling::Optimal));
+        CHECK(allocations.back().offset % memReqs.alignment == 0);
+        CHECK(allocations.back().size == memReqs.size);
+    }
+
+    bool overlap = false;
+    bool mixedTiling = false;
+    for (size_t i = 0; i < allocations.size(); i++)
+    {
+        for (size_t j = i + 1; j < allocations.size(); j++)
+        {
+            overlap = overlap || overlaps(allocations[i], allocations[j]);
+            mixedTiling = mixedTiling || ((i % 2) != (j % 2) && allocations[i].memory == allocations[j].memory);
+        }
+    }
+    CHECK(!overlap);
+    CHECK(!mixedTiling);
+
+    for (computeAllocation &allocation : allocations)
+    {
+        allocator.free(allocation);
+    }
+    allocator.destroy();
+    CHECK(driverAllocations == 0);
+
+    // Without a granularity restriction both tiling classes share one block
+    granularity = 1;
+    allocator.create(VK_NULL_HANDLE, VK_NULL_HANDLE, 1 << 20, &functions);
+    computeAllocation linear = allocator.allocate(requirements(256, 256), computeMemoryUsage(), computeResourceTiling::Linear);
+    computeAllocation optimal = allocator.allocate(requirements(256, 256), computeMemoryUsage(), computeResourceTiling::Optimal);
+    CHECK(linear.memory == optimal.memory);
+    CHECK(!overlaps(linear, optimal));
+    allocator.free(linear);
+    allocator.free(optimal);
+    allocator.destroy();
+    CHECK(driverAllocations == 0);
+    granularity = 1024;
+}
+
+/** @brief Requests split nodes down to the requested power of two and freed buddies merge back into the whole block */
+static void testBuddySplitMerge()
+{
+    using namespace sourav::Memory;
+
+    computeMemoryBlock block;
+    block.init(1 << 16, false);
+    CHECK(block.largestFreeNode() == (1 << 16));
+
+    VkDeviceSize first = 0;
+    VkDeviceSize second = 0;
+    VkDeviceSize third = 0;
+    CHECK(block.allocate(100, 1, &first));
+    CHECK(first == 0);
+    // 100 bytes round up to the minimum node, the split leaves one free buddy on every level
+    CHECK(block.freeBytes() == (1 << 16) - MEMORY_BLOCK_MIN_NODE_SIZE);
+    CHECK(block.largestFreeNode() == (1 << 15));
+
+    CHECK(block.allocate(MEMORY_BLOCK_MIN_NODE_SIZE, 1, &second));
+    CHECK(second == MEMORY_BLOCK_MIN_NODE_SIZE);
+
+    // Alignment larger than the size picks a node of the alignment's size
+    CHECK(block.allocate(64, 4096, &third));
+    CHECK(third % 4096 == 0);
+    CHECK(block.freeBytes() == (1 << 16) - 2 * MEMORY_BLOCK_MIN_NODE_SIZE - 4096);
+
+    // Nothing larger than the block fits
+    VkDeviceSize tooLarge = 0;
+    CHECK(!block.allocate((1 << 16) + 1, 1, &tooLarge));
+
+    block.free(second, MEMORY_BLOCK_MIN_NODE_SIZE);
+    block.free(first, 100);
+    CHECK(block.largestFreeNode() == (1 << 15));
+    block.free(third, 64);
+    CHECK(block.largestFreeNode() == (1 << 16));
+    CHECK(block.freeBytes() == (1 << 16));
+    CHECK(block.allocationCount == 0 && block.bytesUsed == 0);
+
+    // After merging the whole block can be handed out again
+    VkDeviceSize whole = 1;
+    CHECK(block.allocate(1 << 16, 1, &whole));
+    CHECK(whole == 0);
+}
+
+/** @brief Freed space is reused before new blocks are allocated, one empty block is kept and large requests get their own memory */
+static void testBlockReuse()
+{
+    using namespace sourav::Memory;
+    const computeAllocatorFunctions functions = mockFunctions();
+
+    driverAllocateCalls = 0;
+    computeMemoryAllocator allocator;
+    allocator.create(VK_NULL_HANDLE, VK_NULL_HANDLE, 1 << 16, &functions);
+
+    computeAllocation a = allocator.allocate(requirements(1 << 14, 256), computeMemoryUsage(), computeResourceTiling::Linear);
+    CHECK(driverAllocateCalls == 1);
+    allocator.free(a);
+    CHECK(a.block == nullptr);
+
+    // The empty block is kept as a spare and the next request lands in it
+    a = allocator.allocate(requirements(1 << 14, 256), computeMemoryUsage(), computeResourceTiling::Linear);
+    CHECK(driverAllocateCalls == 1);
+    CHECK(allocator.getStats().blockCount == 1);
+
+    // Fill the first block, the next request needs a second one
+    std::vector<computeAllocation> allocations;
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        allocations.push_back(allocator.allocate(requirements(1 << 14, 256), computeMemoryUsage(), computeResourceTiling::Linear));
+    }
+    CHECK(driverAllocateCalls == 1);
+    allocations.push_back(allocator.allocate(requirements(1 << 14, 256), computeMemoryUsage(), computeResourceTiling::Linear));
+    CHECK(driverAllocateCalls == 2);
+    CHECK(allocations.back().memory != a.memory);
+
+    // Emptying both blocks releases one and keeps the other
+    allocator.free(a);
+    for (computeAllocation &allocation : allocations)
+    {
+        allocator.free(allocation);
+    }
+    CHECK(allocator.getStats().blockCount == 1);
+    CHECK(driverAllocations == 1);
+
+    // More than half a block is a dedicated allocation, released as soon as it is freed
+    computeAllocation large = allocator.allocate(requirements((1 << 15) + 1, 256), computeMemoryUsage(), computeResourceTiling::Linear);
+    CHECK(large.offset == 0);
+    CHECK(driverAllocations == 2);
+    allocator.free(large);
+    CHECK(driverAllocations == 1);
+
+    // Host visible blocks are mapped once, allocations point into the mapping
+    computeAllocation host = allocator.allocate(requirements(512, 256, 3), computeMemoryUsage(VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT), computeResourceTiling::Linear);
+    CHECK(host.memoryTypeIndex == 1);
+    CHECK(host.mapped == reinterpret_cast<uint8_t *>(host.memory) + host.offset);
+    allocator.free(host);
+
+    // An alignment larger than a block can never be placed, the allocation throws and the fresh block is released again
+    const int allocationsBefore = driverAllocations;
+    bool threw = false;
+    try
+    {
+        allocator.allocate(requirements(256, 1 << 17), computeMemoryUsage(), computeResourceTiling::Linear);
+    }
+    catch (const std::runtime_error &)
+    {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(driverAllocations == allocationsBefore);
+
+    allocator.destroy();
+    CHECK(driverAllocations == 0);
+}
+
+/** @brief Used, reserved and free byte counts and fragmentation follow allocations and frees */
+static void testStats()
+{
+    using namespace sourav::Memory;
+    const computeAllocatorFunctions functions = mockFunctions();
+
+    computeMemoryAllocator allocator;
+    allocator.create(VK_NULL_HANDLE, VK_NULL_HANDLE, 1 << 16, &functions);
+
+    computeAllocatorStats stats = allocator.getStats();
+    CHECK(stats.blockCount == 0 && stats.bytesReserved == 0 && stats.bytesUsed == 0 && stats.allocationCount == 0);
+    CHECK(stats.heapCount == 1);
+
+    std::vector<computeAllocation> allocations;
+    for (uint32_t i = 0; i < 8; i++)
+    {
+        allocations.push_back(allocator.allocate(requirements(1000, 1), computeMemoryUsage(), computeResourceTiling::Linear));
+    }
+    stats = allocator.getStats();
+    CHECK(stats.blockCount == 1);
+    CHECK(stats.allocationCount == 8);
+    CHECK(stats.bytesUsed == 8000);
+    CHECK(stats.bytesReserved == (1 << 16));
+    // 1000 bytes take a 1024 byte node each
+    CHECK(stats.bytesFree == (1 << 16) - 8 * 1024);
+    CHECK(stats.heaps[0].usage == (1 << 16));
+
+    // Freeing every other allocation leaves holes no larger than a node
+    for (size_t i = 0; i < allocations.size(); i += 2)
+    {
+        allocator.free(allocations[i]);
+    }
+    stats = allocator.getStats();
+    CHECK(stats.allocationCount == 4);
+    CHECK(stats.bytesUsed == 4000);
+    CHECK(stats.largestFreeNode == (1 << 15));
+    CHECK(stats.fragmentation > 0.0f && stats.fragmentation < 1.0f);
+
+    for (size_t i = 1; i < allocations.size(); i += 2)
+    {
+        allocator.free(allocations[i]);
+    }
+    stats = allocator.getStats();
+    CHECK(stats.allocationCount == 0 && stats.bytesUsed == 0);
+    CHECK(stats.bytesFree == (1 << 16));
+    CHECK(stats.fragmentation == 0.0f);
+
+    allocator.destroy();
+    CHECK(driverAllocations == 0);
+}
+
+int main()
+{
+    testPlacement();
+    testBuddySplitMerge();
+    testBlockReuse();
+    testStats();
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All memory allocator tests passed\n");
+    return 0;
+}
@@ -0,0 +1,479 @@
+/**
+* Tests for the task graph: dependency order, cycles, recorders that throw and sharing the staging ring with the
+* upload scheduler
+*
+* Needs a device with timeline semaphores, software drivers work. For example against lavapipe:
+*   g++ -std=c++17 -I.. computeTaskGraphTests.cpp -lvulkan -lpthread -o computeTaskGraphTests
+*   VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json ./computeTaskGraphTests
+*
+* Returns non-zero if any check fails
+*/
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../computeTaskGraph.hpp"
+#include "../computeUploadScheduler.hpp"
+
+#define CHECK(condition) check((condition), #condition, __LINE__)
+
+// Small enough for a graph task and one texture upload to fill it
+#define TEST_STAGING_RING_SIZE (1024ull * 1024)
+// A 256x256 RGBA8 texture
+#define TEST_TEXTURE_SIZE 256
+
+namespace
+{
+    int failures = 0;
+
+    void check(bool condition, const char *expression, int line)
+    {
+        if (!condition)
+        {
+            fprintf(stderr, "line %d: %s failed\n", line, expression);
+            failures++;
+        }
+    }
+
+    /** @brief Submit one task that holds size bytes of staging memory until it completes */
+    sourav::Sync::computeTaskTicket submitStagingTask(sourav::Device::computeDevice &device, sourav::Sync::computeTaskGraph &graph, uint32_t queueIndex, VkDeviceSize size)
+    {
+        sourav::Sync::computeTaskHandle task = graph.addTask(queueIndex, [&device, size](VkCommandBuffer, uint64_t submissionValue)
+        {
+            sourav::Memory::computeStagingRegion staging = device.acquireStaging(size, submissionValue);
+            memset(staging.mapped, 0, size);
+        });
+        return graph.submit()[task];
+    }
+}
+
+/** @brief Tasks are recorded after their dependencies whatever order they were added in, and run in that order */
+static void testDependencyOrder(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkQueue queue, uint32_t queueFamilyIndex)
+{
+    sourav::Device::computeDevice device;
+    device.create(physicalDevice, logicalDevice, queueFamilyIndex, TEST_STAGING_RING_SIZE);
+
+    sourav::Sync::computeTaskGraph graph;
+    graph.create(device);
+    // Two indices on the same queue still get a semaphore each, the waits between them are real
+    const uint32_t uploadQueue = graph.addQueue(queue, queueFamilyIndex);
+    const uint32_t computeQueue = graph.addQueue(queue, queueFamilyIndex);
+
+    std::string recorded;
+    auto recorder = [&recorded](char label) { return [&recorded, label](VkCommandBuffer, uint64_t) { recorded += label; }; };
+
+    // Added readback first, upload last, the independent task keeps its place in front
+    sourav::Sync::computeTaskHandle independent = graph.addTask(computeQueue, recorder('i'));
+    sourav::Sync::computeTaskHandle readback = graph.addTask(uploadQueue, recorder('r'));
+    sourav::Sync::computeTaskHandle dispatch = graph.addTask(computeQueue, recorder('d'));
+    sourav::Sync::computeTaskHandle upload = graph.addTask(uploadQueue, recorder('u'));
+    graph.addDependency(upload, dispatch, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+    graph.addDependency(dispatch, readback, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+    std::vector<sourav::Sync::computeTaskTicket> tickets = graph.submit();
+    CHECK(recorded == "iudr");
+    CHECK(tickets.size() == 4);
+    CHECK(tickets[upload].queueIndex == uploadQueue && tickets[readback].queueIndex == uploadQueue);
+    CHECK(tickets[upload].timelineValue < tickets[readback].timelineValue);
+    CHECK(tickets[independent].timelineValue < tickets[dispatch].timelineValue);
+
+    graph.wait(tickets[readback]);
+    CHECK(graph.isComplete(tickets[upload]));
+    CHECK(graph.isComplete(tickets[dispatch]));
+
+    // A ticket from this submit orders a task of the next one
+    recorded.clear();
+    sourav::Sync::computeTaskHandle next = graph.addTask(computeQueue, recorder('n'));
+    graph.addDependency(tickets[readback], next);
+    sourav::Sync::computeTaskTicket nextTicket = graph.submit()[next];
+    CHECK(recorded == "n");
+    graph.wait(nextTicket);
+    CHECK(graph.isComplete(nextTicket));
+
+    graph.destroy();
+    device.destroy();
+}
+
+/** @brief A cycle submits nothing and discards the graph, the next one starts empty */
+static void testDependencyCycle(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkQueue queue, uint32_t queueFamilyIndex)
+{
+    sourav::Device::computeDevice device;
+    device.create(physicalDevice, logicalDevice, queueFamilyIndex, TEST_STAGING_RING_SIZE);
+
+    sourav::Sync::computeTaskGraph graph;
+    graph.create(device);
+    const uint32_t queueIndex = graph.addQueue(queue, queueFamilyIndex);
+
+    uint32_t recordCount = 0;
+    auto recorder = [&recordCount](VkCommandBuffer, uint64_t) { recordCount++; };
+
+    sourav::Sync::computeTaskHandle first = graph.addTask(queueIndex, recorder);
+    sourav::Sync::computeTaskHandle second = graph.addTask(queueIndex, recorder);
+    sourav::Sync::computeTaskHandle third = graph.addTask(queueIndex, recorder);
+    graph.addDependency(first, second);
+    graph.addDependency(second, third);
+    graph.addDependency(third, second);
+
+    bool threw = false;
+    try
+    {
+        graph.submit();
+    }
+    catch (const std::runtime_error &)
+    {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(recordCount == 0);
+
+    // Nothing of the discarded graph is left to submit
+    CHECK(graph.submit().empty());
+    CHECK(recordCount == 0);
+
+    sourav::Sync::computeTaskHandle task = graph.addTask(queueIndex, recorder);
+    CHECK(task == 0);
+    sourav::Sync::computeTaskTicket ticket = graph.submit()[task];
+    CHECK(recordCount == 1);
+    graph.wait(ticket);
+    CHECK(graph.isComplete(ticket));
+
+    graph.destroy();
+    device.destroy();
+}
+
+/**
+* A recorder that throws after taking staging memory: the tasks submitted before it still run, its submission is
+* completed so the ring gets the memory back, and the rest of the graph is discarded
+*/
+static void testRecorderThrows(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkQueue queue, uint32_t queueFamilyIndex)
+{
+    sourav::Device::computeDevice device;
+    device.create(physicalDevice, logicalDevice, queueFamilyIndex, TEST_STAGING_RING_SIZE);
+
+    sourav::Sync::computeTaskGraph graph;
+    graph.create(device);
+    const uint32_t queueIndex = graph.addQueue(queue, queueFamilyIndex);
+
+    std::string recorded;
+    uint64_t failedSubmission = 0;
+    sourav::Sync::computeTaskHandle before = graph.addTask(queueIndex, [&recorded](VkCommandBuffer, uint64_t) { recorded += 'b'; });
+    sourav::Sync::computeTaskHandle failing = graph.addTask(queueIndex, [&](VkCommandBuffer, uint64_t submissionValue)
+    {
+        recorded += 'f';
+        failedSubmission = submissionValue;
+        device.acquireStaging(TEST_STAGING_RING_SIZE / 2, submissionValue);
+        throw std::runtime_error("recorder failed");
+    });
+    sourav::Sync::computeTaskHandle after = graph.addTask(queueIndex, [&recorded](VkCommandBuffer, uint64_t) { recorded += 'a'; });
+    graph.addDependency(before, failing);
+    graph.addDependency(failing, after);
+
+    bool threw = false;
+    try
+    {
+        graph.submit();
+    }
+    catch (const std::runtime_error &)
+    {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(recorded == "bf");
+    CHECK(failedSubmission != 0 && device.isSubmissionComplete(failedSubmission));
+
+    graph.waitIdle();
+    CHECK(device.stagingRing.bytesInUse() == 0);
+
+    // The graph is empty again and the command buffer of the failed task can be recorded again
+    recorded.clear();
+    CHECK(graph.submit().empty());
+    sourav::Sync::computeTaskHandle task = graph.addTask(queueIndex, [&](VkCommandBuffer, uint64_t submissionValue)
+    {
+        recorded += 'n';
+        device.acquireStaging(TEST_STAGING_RING_SIZE / 2, submissionValue);
+    });
+    sourav::Sync::computeTaskTicket ticket = graph.submit()[task];
+    CHECK(recorded == "n");
+    graph.wait(ticket);
+    CHECK(graph.isComplete(ticket));
+    CHECK(device.stagingRing.bytesInUse() == 0);
+
+    graph.destroy();
+    device.destroy();
+}
+
+/**
+* Create the graph and the scheduler in either order and make each wait for the other's submissions through the
+* full staging ring, then destroy the first one created and keep using the other
+*/
+static void testSharedStagingRing(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkQueue queue, uint32_t queueFamilyIndex, bool graphFirst)
+{
+    sourav::Device::computeDevice device;
+    device.create(physicalDevice, logicalDevice, queueFamilyIndex, TEST_STAGING_RING_SIZE);
+
+    sourav::Sync::computeTaskGraph graph;
+    sourav::Transfer::computeUploadScheduler scheduler;
+    if (graphFirst)
+    {
+        graph.create(device);
+        scheduler.create(device, queue, queueFamilyIndex);
+    }
+    else
+    {
+        scheduler.create(device, queue, queueFamilyIndex);
+        graph.create(device);
+    }
+    const uint32_t queueIndex = graph.addQueue(queue, queueFamilyIndex);
+
+    const std::vector<uint8_t> pixels(TEST_TEXTURE_SIZE * TEST_TEXTURE_SIZE * 4, 0x7f);
+    const VkDeviceSize taskStaging = TEST_STAGING_RING_SIZE - pixels.size() / 2;
+
+    // The upload does not fit next to the task, the ring has to wait for it through the graph
+    sourav::Sync::computeTaskTicket task = submitStagingTask(device, graph, queueIndex, taskStaging);
+    sourav::Texture::computeTexture first;
+    scheduler.uploadAsync(first, pixels.data(), pixels.size(), VK_FORMAT_R8G8B8A8_UNORM, TEST_TEXTURE_SIZE, TEST_TEXTURE_SIZE);
+    CHECK(graph.isComplete(task));
+
+    // The open batch holds the ring now, the next task has to wait for it through the scheduler
+    sourav::Sync::computeTaskTicket next = submitStagingTask(device, graph, queueIndex, taskStaging);
+    graph.wait(next);
+    CHECK(graph.isComplete(next));
+
+    // An open scheduler batch does not keep finished tasks from completing
+    sourav::Texture::computeTexture second;
+    sourav::Transfer::computeUploadTicket upload =
+        scheduler.uploadAsync(second, pixels.data(), pixels.size(), VK_FORMAT_R8G8B8A8_UNORM, TEST_TEXTURE_SIZE, TEST_TEXTURE_SIZE);
+    sourav::Sync::computeTaskTicket small = submitStagingTask(device, graph, queueIndex, 256);
+    graph.wait(small);
+    CHECK(graph.isComplete(small));
+    CHECK(!scheduler.isComplete(upload));
+    scheduler.wait(upload);
+    CHECK(scheduler.isComplete(upload));
+
+    // Whichever was created first goes away first, the other one's waiter has to stay registered
+    if (graphFirst)
+    {
+        graph.destroy();
+
+        // Several batches in flight wrap the ring, each upload waits for the oldest one
+        for (uint32_t i = 0; i < 8; i++)
+        {
+            // Destroyed at the end of the iteration, deferred until its upload has completed
+            sourav::Texture::computeTexture texture;
+            scheduler.uploadAsync(texture, pixels.data(), pixels.size(), VK_FORMAT_R8G8B8A8_UNORM, TEST_TEXTURE_SIZE, TEST_TEXTURE_SIZE);
+        }
+        scheduler.waitIdle();
+        CHECK(device.stagingRing.bytesInUse() == 0);
+        scheduler.destroy();
+    }
+    else
+    {
+        scheduler.destroy();
+
+        sourav::Sync::computeTaskTicket a = submitStagingTask(device, graph, queueIndex, taskStaging);
+        sourav::Sync::computeTaskTicket b = submitStagingTask(device, graph, queueIndex, taskStaging);
+        CHECK(graph.isComplete(a));
+        graph.wait(b);
+        CHECK(graph.isComplete(b));
+        graph.destroy();
+    }
+
+    // Nobody owns the ring's submissions any more, a full ring falls back instead of calling a destroyed owner
+    const uint64_t older = device.beginSubmission();
+    const uint64_t newer = device.beginSubmission();
+    sourav::Memory::computeStagingRegion region;
+    CHECK(device.stagingRing.allocate(TEST_STAGING_RING_SIZE - 1024, STAGING_REGION_ALIGNMENT, older, &region));
+    CHECK(!device.stagingRing.allocate(TEST_STAGING_RING_SIZE - 1024, STAGING_REGION_ALIGNMENT, newer, &region));
+    device.completeSubmission(older);
+    device.completeSubmission(newer);
+
+    first.destroy();
+    second.destroy();
+    device.destroy();
+}
+
+/**
+* Two threads fill the ring at the same time: one records an upload while holding the scheduler, the other records a
+* task while holding the graph. Each asks the other's waiter for room, which has to give up instead of waiting for
+* the other owner's lock
+*/
+static void testConcurrentOwners(VkPhysicalDevice physicalDevice, VkDevice logicalDevice, VkQueue queue, uint32_t queueFamilyIndex)
+{
+    sourav::Device::computeDevice device;
+    device.create(physicalDevice, logicalDevice, queueFamilyIndex, TEST_STAGING_RING_SIZE);
+
+    // Waiters are asked in the order they were added: scheduler, step, graph
+    sourav::Transfer::computeUploadScheduler scheduler;
+    scheduler.create(device, queue, queueFamilyIndex);
+
+    // Keeps the uploading thread inside the ring, holding the scheduler, until the task thread has its staging memory.
+    // Only one thread submits to the queue at a time: the upload does not submit after this point
+    std::mutex              stepMutex;
+    std::condition_variable stepChanged;
+    bool                    uploadWaiting = false;
+    bool                    taskStaged = false;
+    const std::thread::id   uploadThreadId = std::this_thread::get_id();
+    uint32_t step = device.stagingRing.addSubmissionWaiter([&](uint64_t)
+    {
+        if (std::this_thread::get_id() == uploadThreadId)
+        {
+            std::unique_lock<std::mutex> lock(stepMutex);
+            if (!uploadWaiting)
+            {
+                uploadWaiting = true;
+                stepChanged.notify_all();
+                CHECK(stepChanged.wait_for(lock, std::chrono::seconds(10), [&]() { return taskStaged; }));
+            }
+        }
+        return false;
+    });
+
+    sourav::Sync::computeTaskGraph graph;
+    graph.create(device);
+    const uint32_t queueIndex = graph.addQueue(queue, queueFamilyIndex);
+
+    const std::vector<uint8_t> pixels(TEST_TEXTURE_SIZE * TEST_TEXTURE_SIZE * 4, 0x7f);
+    const VkDeviceSize taskStaging = TEST_STAGING_RING_SIZE - pixels.size() / 2;
+
+    // The oldest submission in the ring is the graph's, neither the new upload nor the new task fits next to it
+    submitStagingTask(device, graph, queueIndex, taskStaging);
+
+    std::thread taskThread([&]()
+    {
+        {
+            std::unique_lock<std::mutex> lock(stepMutex);
+            stepChanged.wait(lock, [&]() { return uploadWaiting; });
+        }
+
+        sourav::Sync::computeTaskHandle task = graph.addTask(queueIndex, [&](VkCommandBuffer, uint64_t submissionValue)
+        {
+            sourav::Memory::computeStagingRegion staging = device.acquireStaging(pixels.size(), submissionValue);
+            memset(staging.mapped, 0, pixels.size());
+
+            std::lock_guard<std::mutex> lock(stepMutex);
+            taskStaged = true;
+            stepChanged.notify_all();
+        });
+        graph.wait(graph.submit()[task]);
+    });
+
+    sourav::Texture::computeTexture texture;
+    sourav::Transfer::computeUploadTicket upload =
+        scheduler.uploadAsync(texture, pixels.data(), pixels.size(), VK_FORMAT_R8G8B8A8_UNORM, TEST_TEXTURE_SIZE, TEST_TEXTURE_SIZE);
+    taskThread.join();
+    device.stagingRing.removeSubmissionWaiter(step);
+
+    CHECK(taskStaged);
+    scheduler.wait(upload);
+    CHECK(scheduler.isComplete(upload));
+
+    graph.destroy();
+    scheduler.destroy();
+    texture.destroy();
+    CHECK(device.stagingRing.bytesInUse() == 0);
+    device.destroy();
+}
+
+int main()
+{
+    VkApplicationInfo applicationInfo = {};
+    applicationInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    applicationInfo.pApplicationName = "computeTaskGraphTests";
+    applicationInfo.apiVersion = VK_API_VERSION_1_2;
+
+    VkInstanceCreateInfo instanceCreateInfo = {};
+    instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instanceCreateInfo.pApplicationInfo = &applicationInfo;
+
+    VkInstance instance;
+    if (vkCreateInstance(&instanceCreateInfo, nullptr, &instance) != VK_SUCCESS)
+    {
+        fprintf(stderr, "Could not create a Vulkan instance\n");
+        return 1;
+    }
+
+    uint32_t physicalDeviceCount = 0;
+    vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, nullptr);
+    std::vector<VkPhysicalDevice> physicalDevices(physicalDeviceCount);
+    vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, physicalDevices.data());
+    if (physicalDeviceCount == 0)
+    {
+        fprintf(stderr, "No physical device available\n");
+        vkDestroyInstance(instance, nullptr);
+        return 1;
+    }
+    VkPhysicalDevice physicalDevice = physicalDevices[0];
+
+    try
+    {
+        VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures = {};
+        timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+        VkPhysicalDeviceFeatures2 features = {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = &timelineFeatures;
+        vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+        if (!timelineFeatures.timelineSemaphore)
+        {
+            throw std::runtime_error("Device does not support timeline semaphores");
+        }
+
+        const uint32_t queueFamilyIndex = sourav::utils::getQueueFamilyIndex(physicalDevice, VK_QUEUE_COMPUTE_BIT);
+
+        const float queuePriority = 1.0f;
+        VkDeviceQueueCreateInfo queueCreateInfo = {};
+        queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+        queueCreateInfo.queueFamilyIndex = queueFamilyIndex;
+        queueCreateInfo.queueCount = 1;
+        queueCreateInfo.pQueuePriorities = &queuePriority;
+
+        VkPhysicalDeviceTimelineSemaphoreFeatures enabledTimelineFeatures = {};
+        enabledTimelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+        enabledTimelineFeatures.timelineSemaphore = VK_TRUE;
+
+        VkDeviceCreateInfo deviceCreateInfo = {};
+        deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        deviceCreateInfo.pNext = &enabledTimelineFeatures;
+        deviceCreateInfo.queueCreateInfoCount = 1;
+        deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
+
+        VkDevice logicalDevice;
+        ST_CHECK_RESULT(vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &logicalDevice));
+
+        VkQueue queue;
+        vkGetDeviceQueue(logicalDevice, queueFamilyIndex, 0, &queue);
+
+        testDependencyOrder(physicalDevice, logicalDevice, queue, queueFamilyIndex);
+        testDependencyCycle(physicalDevice, logicalDevice, queue, queueFamilyIndex);
+        testRecorderThrows(physicalDevice, logicalDevice, queue, queueFamilyIndex);
+        testSharedStagingRing(physicalDevice, logicalDevice, queue, queueFamilyIndex, true);
+        testSharedStagingRing(physicalDevice, logicalDevice, queue, queueFamilyIndex, false);
+        testConcurrentOwners(physicalDevice, logicalDevice, queue, queueFamilyIndex);
+
+        vkDestroyDevice(logicalDevice, nullptr);
+    }
+    catch (const std::exception &exception)
+    {
+        fprintf(stderr, "Test failed: %s\n", exception.what());
+        failures++;
+    }
+
+    sourav::Device::clearDeviceCaps();
+    vkDestroyInstance(instance, nullptr);
+
+    if (failures > 0)
+    {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All task graph tests passed\n");
+    return 0;
+}